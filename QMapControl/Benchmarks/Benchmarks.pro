@@ -0,0 +1,9 @@
+# Build the sub directory projects.
+TEMPLATE = subdirs
+
+# Sub directory projects.
+SUBDIRS +=                  \
+    InteractionReplay       \
+    Microbench              \
+    TileNetwork             \
+    UnitTests               \
@@ -0,0 +1,162 @@
+#include "datasets.h"
+
+// STL includes.
+#include <algorithm>
+#include <cmath>
+
+namespace datasets
+{
+    namespace
+    {
+        /// Web mercator latitude limit.
+        const double kMaxLatitude = 85.0;
+
+        /// Number of clusters in a clustered dataset.
+        const int kClusterCount = 32;
+
+        /// Cluster spread in degrees.
+        const double kClusterSigmaDegrees = 0.5;
+
+        /// Minimum number of vertices per line.
+        const int kLineVerticesMinimum = 16;
+
+        /// Maximum number of vertices per line.
+        const int kLineVerticesMaximum = 256;
+
+        /// Maximum step between two line vertices in degrees.
+        const double kLineStepDegrees = 0.01;
+
+        PointWorldCoord clamped(const double longitude, const double latitude)
+        {
+            // Keep the point inside the world bounds.
+            return PointWorldCoord(std::max(-180.0, std::min(longitude, 179.999999)),
+                                   std::max(-kMaxLatitude, std::min(latitude, kMaxLatitude)));
+        }
+    }
+
+    double Random::unit()
+    {
+        // 53 random bits mapped onto [0, 1).
+        return double(m_engine() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    double Random::uniform(const double minimum, const double maximum)
+    {
+        return minimum + (maximum - minimum) * unit();
+    }
+
+    int Random::uniformInt(const int minimum, const int maximum)
+    {
+        return minimum + int(m_engine() % std::uint64_t(maximum - minimum + 1));
+    }
+
+    double Random::normal(const double mean, const double sigma)
+    {
+        // Box-Muller transform (avoid log(0)).
+        const double u1 = 1.0 - unit();
+        const double u2 = unit();
+        return mean + sigma * std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * M_PI * u2);
+    }
+
+    QString toString(const Distribution distribution)
+    {
+        switch (distribution)
+        {
+            case Distribution::Uniform:
+                return "uniform";
+            case Distribution::Clustered:
+                return "clustered";
+            case Distribution::LineHeavy:
+                return "line-heavy";
+        }
+        return QString();
+    }
+
+    Dataset generate(const Distribution distribution, const std::size_t size, const std::uint64_t seed)
+    {
+        Random random(seed);
+
+        Dataset dataset;
+        dataset.name = toString(distribution);
+        dataset.points.reserve(size);
+
+        switch (distribution)
+        {
+            case Distribution::Uniform:
+            {
+                // Spread the points over the whole world.
+                for (std::size_t i = 0; i < size; ++i)
+                {
+                    dataset.points.emplace_back(random.uniform(-180.0, 180.0), random.uniform(-kMaxLatitude, kMaxLatitude));
+                }
+                break;
+            }
+
+            case Distribution::Clustered:
+            {
+                // Pick the cluster centres first.
+                std::vector<PointWorldCoord> centres;
+                for (int i = 0; i < kClusterCount; ++i)
+                {
+                    centres.emplace_back(random.uniform(-170.0, 170.0), random.uniform(-70.0, 70.0));
+                }
+
+                // Gather the points around the centres.
+                for (std::size_t i = 0; i < size; ++i)
+                {
+                    const PointWorldCoord& centre = centres[std::size_t(random.uniformInt(0, kClusterCount - 1))];
+                    dataset.points.push_back(clamped(random.normal(centre.longitude(), kClusterSigmaDegrees),
+                                                     random.normal(centre.latitude(), kClusterSigmaDegrees)));
+                }
+                break;
+            }
+
+            case Distribution::LineHeavy:
+            {
+                // Random walks until we have the requested number of vertices.
+                while (dataset.points.size() < size)
+                {
+                    const std::size_t vertices = std::min(size - dataset.points.size(),
+                                                          std::size_t(random.uniformInt(kLineVerticesMinimum, kLineVerticesMaximum)));
+
+                    std::vector<PointWorldCoord> line;
+                    line.reserve(vertices);
+
+                    double longitude = random.uniform(-179.0, 179.0);
+                    double latitude = random.uniform(-80.0, 80.0);
+                    for (std::size_t i = 0; i < vertices; ++i)
+                    {
+                        longitude += random.uniform(-kLineStepDegrees, kLineStepDegrees);
+                        latitude += random.uniform(-kLineStepDegrees, kLineStepDegrees);
+
+                        line.push_back(clamped(longitude, latitude));
+                        dataset.points.push_back(line.back());
+                    }
+
+                    dataset.lines.push_back(std::move(line));
+                }
+                break;
+            }
+        }
+
+        return dataset;
+    }
+
+    std::vector<RectWorldCoord> generateRects(const std::size_t count, const double span_degrees, const std::uint64_t seed)
+    {
+        Random random(seed ^ 0x9E3779B97F4A7C15ULL);
+
+        std::vector<RectWorldCoord> rects;
+        rects.reserve(count);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            // Same orientation as the viewport rects QMapControl uses (top-left has the larger latitude).
+            const double left = random.uniform(-180.0, 180.0 - span_degrees);
+            const double bottom = random.uniform(-kMaxLatitude, kMaxLatitude - span_degrees);
+            rects.emplace_back(PointWorldCoord(left, bottom + span_degrees), PointWorldCoord(left + span_degrees, bottom));
+        }
+
+        return rects;
+    }
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+// Qt includes.
+#include <QtCore/QString>
+
+// STL includes.
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// QMapControl includes.
+#include <QMapControl/Point.h>
+
+using namespace qmapcontrol;
+
+/*!
+ * Reproducible synthetic datasets for the benchmarks.
+ *
+ * Only std::mt19937_64 (whose output sequence is fixed by the standard) is used together with
+ * our own value mapping, so the same seed yields the same dataset on every compiler/platform.
+ */
+namespace datasets
+{
+    /// Default seed used by all benchmarks.
+    constexpr std::uint64_t kDefaultSeed = 0x51A7E5EEDULL;
+
+    //! Dataset distributions available.
+    enum class Distribution
+    {
+        /// Points uniformly spread over the (web mercator) world.
+        Uniform,
+        /// Points gathered in a fixed number of gaussian clusters (cities/harbours).
+        Clustered,
+        /// Points forming random-walk line strings (tracks/roads).
+        LineHeavy
+    };
+
+    //! A generated dataset.
+    struct Dataset
+    {
+        /// The dataset name (eg: "uniform").
+        QString name;
+
+        /// All points (for line-heavy datasets, all the line vertices).
+        std::vector<PointWorldCoord> points;
+
+        /// The line strings (line-heavy datasets only).
+        std::vector<std::vector<PointWorldCoord>> lines;
+    };
+
+    //! Reproducible random number helper.
+    class Random
+    {
+    public:
+        /*!
+         * Construct a random generator.
+         * @param seed The seed to use.
+         */
+        explicit Random(const std::uint64_t seed) : m_engine(seed) { }
+
+        /*!
+         * Fetch a value in [0, 1).
+         * @return the value.
+         */
+        double unit();
+
+        /*!
+         * Fetch a value in [minimum, maximum).
+         * @param minimum The minimum value.
+         * @param maximum The maximum value.
+         * @return the value.
+         */
+        double uniform(const double minimum, const double maximum);
+
+        /*!
+         * Fetch a value in [minimum, maximum].
+         * @param minimum The minimum value.
+         * @param maximum The maximum value.
+         * @return the value.
+         */
+        int uniformInt(const int minimum, const int maximum);
+
+        /*!
+         * Fetch a normally distributed value (Box-Muller).
+         * @param mean The mean.
+         * @param sigma The standard deviation.
+         * @return the value.
+         */
+        double normal(const double mean, const double sigma);
+
+    private:
+        /// The engine.
+        std::mt19937_64 m_engine;
+    };
+
+    /*!
+     * Fetch the name of a distribution.
+     * @param distribution The distribution.
+     * @return the name.
+     */
+    QString toString(const Distribution distribution);
+
+    /*!
+     * Generate a dataset.
+     * @param distribution The distribution to use.
+     * @param size The number of points to generate.
+     * @param seed The seed to use.
+     * @return the generated dataset.
+     */
+    Dataset generate(const Distribution distribution, const std::size_t size, const std::uint64_t seed = kDefaultSeed);
+
+    /*!
+     * Generate query rects (viewports) within the world.
+     * @param count The number of rects to generate.
+     * @param span_degrees The width/height of each rect in degrees.
+     * @param seed The seed to use.
+     * @return the generated rects.
+     */
+    std::vector<RectWorldCoord> generateRects(const std::size_t count, const double span_degrees, const std::uint64_t seed = kDefaultSeed);
+}
@@ -0,0 +1,31 @@
+# Include benchmark configurations.
+include(../Benchmarks.pri)
+
+# Target name.
+TARGET = InteractionReplay
+
+# Target version.
+VERSION = 0.1
+
+# Build an application.
+TEMPLATE = app
+
+# Console application (the report is written to stdout).
+CONFIG += console
+
+# Add header files.
+HEADERS +=                  \
+    ../Common/datasets.h    \
+    src/frametrace.h        \
+    src/replay.h            \
+    src/tilestandin.h       \
+    src/timeline.h          \
+
+# Add source files.
+SOURCES +=                  \
+    ../Common/datasets.cpp  \
+    src/frametrace.cpp      \
+    src/main.cpp            \
+    src/replay.cpp          \
+    src/tilestandin.cpp     \
+    src/timeline.cpp        \
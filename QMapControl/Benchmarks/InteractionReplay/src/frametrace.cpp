@@ -0,0 +1,95 @@
+#include "frametrace.h"
+
+// Qt includes.
+#include <QtCore/QFile>
+#include <QtCore/QJsonDocument>
+
+namespace
+{
+    /// Track names shown by the trace viewers.
+    const char* trackName(const FrameTrace::Track track)
+    {
+        switch (track)
+        {
+            case FrameTrace::Track::Gui:
+                return "gui";
+            case FrameTrace::Track::Render:
+                return "render";
+            case FrameTrace::Track::Tiles:
+                return "tiles";
+            case FrameTrace::Track::Frames:
+                return "frames";
+            case FrameTrace::Track::Steps:
+                return "steps";
+        }
+        return "";
+    }
+}
+
+void FrameTrace::complete(const Track track, const QString& name, const qint64 start_ns, const qint64 end_ns, const QJsonObject& args)
+{
+    QJsonObject event{
+        { "name", name },
+        { "ph", "X" },
+        { "pid", 1 },
+        { "tid", int(track) },
+        { "ts", double(start_ns) / 1000.0 },
+        { "dur", double(end_ns - start_ns) / 1000.0 }
+    };
+    if (args.isEmpty() == false)
+    {
+        event["args"] = args;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_events.append(event);
+}
+
+void FrameTrace::instant(const Track track, const QString& name, const qint64 time_ns, const QJsonObject& args)
+{
+    QJsonObject event{
+        { "name", name },
+        { "ph", "i" },
+        { "s", "t" },
+        { "pid", 1 },
+        { "tid", int(track) },
+        { "ts", double(time_ns) / 1000.0 }
+    };
+    if (args.isEmpty() == false)
+    {
+        event["args"] = args;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_events.append(event);
+}
+
+bool FrameTrace::write(const QString& path) const
+{
+    QJsonArray events;
+    {
+        QMutexLocker locker(&m_mutex);
+        events = m_events;
+    }
+
+    // Name the tracks.
+    for (const auto track : { Track::Gui, Track::Render, Track::Tiles, Track::Frames, Track::Steps })
+    {
+        events.append(QJsonObject{
+            { "name", "thread_name" },
+            { "ph", "M" },
+            { "pid", 1 },
+            { "tid", int(track) },
+            { "args", QJsonObject{ { "name", trackName(track) } } }
+        });
+    }
+
+    // Write the trace.
+    QFile file(path);
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate) == false)
+    {
+        return false;
+    }
+    file.write(QJsonDocument(QJsonObject{ { "traceEvents", events }, { "displayTimeUnit", "ms" } }).toJson(QJsonDocument::Compact));
+    return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+// Qt includes.
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonObject>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+
+// STL includes.
+#include <vector>
+
+/*!
+ * Thread-safe collector of trace events, written in the Chrome trace event format
+ * (load the file in chrome://tracing or https://ui.perfetto.dev).
+ */
+class FrameTrace
+{
+public:
+    //! Well known trace tracks.
+    enum class Track
+    {
+        /// Input dispatch and paints (GUI thread).
+        Gui = 1,
+        /// Backbuffer redraws (render thread).
+        Render = 2,
+        /// Tile requests.
+        Tiles = 3,
+        /// Frames (input to paint).
+        Frames = 4,
+        /// Timeline steps.
+        Steps = 5
+    };
+
+public:
+    //! Constructor.
+    FrameTrace() = default;
+
+    //! Disable copy constructor.
+    FrameTrace(const FrameTrace&) = delete;
+
+    //! Disable copy assignment.
+    FrameTrace& operator=(const FrameTrace&) = delete;
+
+    /*!
+     * Add a complete event (a span).
+     * @param track The track to add the event to.
+     * @param name The event name.
+     * @param start_ns The start time (ns).
+     * @param end_ns The end time (ns).
+     * @param args Additional event arguments.
+     */
+    void complete(const Track track, const QString& name, const qint64 start_ns, const qint64 end_ns, const QJsonObject& args = QJsonObject());
+
+    /*!
+     * Add an instant event.
+     * @param track The track to add the event to.
+     * @param name The event name.
+     * @param time_ns The event time (ns).
+     * @param args Additional event arguments.
+     */
+    void instant(const Track track, const QString& name, const qint64 time_ns, const QJsonObject& args = QJsonObject());
+
+    /*!
+     * Write the trace.
+     * @param path The file to write to.
+     * @return whether the trace was written.
+     */
+    bool write(const QString& path) const;
+
+private:
+    /// Mutex to protect the events.
+    mutable QMutex m_mutex;
+
+    /// The trace events.
+    QJsonArray m_events;
+};
@@ -0,0 +1,176 @@
+// Qt includes.
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QDateTime>
+#include <QtCore/QFile>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QSysInfo>
+#include <QtCore/QTextStream>
+#include <QtGui/QGuiApplication>
+
+// STL includes.
+#include <memory>
+
+// Local includes.
+#include "datasets.h"
+#include "replay.h"
+#include "timeline.h"
+
+namespace
+{
+    /// Read a JSON object from a file.
+    bool readJson(const QString& path, QJsonObject& return_object, QString& return_error)
+    {
+        QFile file(path);
+        if (file.open(QIODevice::ReadOnly) == false)
+        {
+            return_error = QString("Unable to read %1").arg(path);
+            return false;
+        }
+
+        QJsonParseError parse_error;
+        const QJsonDocument document(QJsonDocument::fromJson(file.readAll(), &parse_error));
+        if (document.isObject() == false)
+        {
+            return_error = QString("Invalid JSON in %1: %2").arg(path, parse_error.errorString());
+            return false;
+        }
+
+        return_object = document.object();
+        return true;
+    }
+
+    /// Write data to a file (or stdout if no path is given).
+    bool writeOutput(const QString& path, const QByteArray& data)
+    {
+        if (path.isEmpty())
+        {
+            QTextStream(stdout) << data;
+            return true;
+        }
+
+        QFile file(path);
+        if (file.open(QIODevice::WriteOnly | QIODevice::Truncate) == false)
+        {
+            QTextStream(stderr) << "Unable to write to " << path << "\n";
+            return false;
+        }
+        file.write(data);
+        return true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    // Recording requires a display, replaying runs without one unless told otherwise.
+    bool record = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        record = record || QByteArray(argv[i]).startsWith("--record");
+    }
+    if (record == false && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    // Create the application (it times the paint events).
+    ReplayApplication app(argc, argv);
+    app.setApplicationName("QMapControl InteractionReplay");
+
+    // Setup the command line options.
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays a scripted interaction timeline and measures frame latency, dropped frames and tiles-ready time.");
+    parser.addHelpOption();
+    const QCommandLineOption option_timeline("timeline", "Replay this timeline (JSON) instead of the default one.", "file");
+    const QCommandLineOption option_record("record", "Show the map and record the interaction into this timeline file (written on exit).", "file");
+    const QCommandLineOption option_tiles("tiles", "Tile directory (missing tiles are synthesised into it).", "directory", QDir::temp().filePath("qmapcontrol-replay-tiles"));
+    const QCommandLineOption option_latency("latency-ms", "Tile latency.", "ms", "50");
+    const QCommandLineOption option_jitter("jitter-ms", "Tile latency jitter (+/-).", "ms", "20");
+    const QCommandLineOption option_latency_mode("latency-mode", "Tile latency mode: deferred (network like) or blocking (slow provider).", "mode", "deferred");
+    const QCommandLineOption option_frame_budget("frame-budget-ms", "Frame budget.", "ms", QString::number(1000.0 / 60.0));
+    const QCommandLineOption option_points("points", "Number of points in the point layer.", "count", "10000");
+    const QCommandLineOption option_line_vertices("line-vertices", "Number of vertices in the line layer.", "count", "50000");
+    const QCommandLineOption option_seed("seed", "Dataset, jitter and update seed.", "seed", QString::number(datasets::kDefaultSeed));
+    const QCommandLineOption option_trace("trace", "Write a Chrome trace (chrome://tracing, ui.perfetto.dev) to this file.", "file");
+    const QCommandLineOption option_output("output", "Write the report to this file instead of stdout.", "file");
+    parser.addOptions({ option_timeline, option_record, option_tiles, option_latency, option_jitter, option_latency_mode,
+                        option_frame_budget, option_points, option_line_vertices, option_seed, option_trace, option_output });
+    parser.process(app);
+
+    // Load the timeline.
+    InteractionReplay::Config config;
+    config.timeline = timeline::defaultTimeline();
+    if (parser.isSet(option_timeline))
+    {
+        QJsonObject document;
+        QString error;
+        if (readJson(parser.value(option_timeline), document, error) == false || timeline::fromJson(document, config.timeline, error) == false)
+        {
+            QTextStream(stderr) << error << "\n";
+            return 1;
+        }
+    }
+
+    // Build the configuration.
+    config.tiles.directory = QDir(parser.value(option_tiles));
+    config.tiles.latency_mode = parser.value(option_latency_mode) == "blocking" ? TileStandIn::LatencyMode::Blocking : TileStandIn::LatencyMode::Deferred;
+    config.tiles.latency_ms = parser.value(option_latency).toInt();
+    config.tiles.jitter_ms = parser.value(option_jitter).toInt();
+    config.seed = parser.value(option_seed).toULongLong(nullptr, 0);
+    config.tiles.seed = config.seed;
+    config.frame_budget_ms = parser.value(option_frame_budget).toDouble();
+    config.points = parser.value(option_points).toInt();
+    config.line_vertices = parser.value(option_line_vertices).toInt();
+    if (config.tiles.directory.mkpath(".") == false)
+    {
+        QTextStream(stderr) << "Unable to create the tile directory " << config.tiles.directory.path() << "\n";
+        return 1;
+    }
+
+    // Create the replay.
+    std::unique_ptr<InteractionReplay> replay(new InteractionReplay(config, app));
+
+    if (parser.isSet(option_record))
+    {
+        // Record the user's interaction against the same layer stack (recording starts once shown).
+        TimelineRecorder recorder(config.timeline);
+        replay->startRecording(recorder);
+        const int result = app.exec();
+
+        // Write the recorded timeline.
+        replay.reset();
+        return writeOutput(parser.value(option_record), QJsonDocument(timeline::toJson(recorder.recorded())).toJson(QJsonDocument::Indented)) ? result : 1;
+    }
+
+    // Replay the timeline.
+    QObject::connect(replay.get(), &InteractionReplay::finished, &app, &QApplication::quit);
+    replay->start();
+    app.exec();
+
+    // Write the trace.
+    if (parser.isSet(option_trace) && replay->writeTrace(parser.value(option_trace)) == false)
+    {
+        QTextStream(stderr) << "Unable to write the trace to " << parser.value(option_trace) << "\n";
+    }
+
+    // Include enough metadata to compare runs.
+    QJsonObject metadata;
+    metadata["qt_version"] = QString(qVersion());
+    metadata["platform"] = QGuiApplication::platformName();
+    metadata["cpu_architecture"] = QSysInfo::currentCpuArchitecture();
+    metadata["os"] = QSysInfo::prettyProductName();
+    metadata["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    metadata["seed"] = QString::number(config.seed);
+    metadata["viewport"] = QString("%1x%2").arg(config.timeline.viewport_size.width()).arg(config.timeline.viewport_size.height());
+    metadata["latency_mode"] = parser.value(option_latency_mode);
+    metadata["latency_ms"] = config.tiles.latency_ms;
+    metadata["jitter_ms"] = config.tiles.jitter_ms;
+    metadata["points"] = config.points;
+    metadata["line_vertices"] = config.line_vertices;
+
+    QJsonObject root(replay->report());
+    root["metadata"] = metadata;
+
+    // Write the report.
+    return writeOutput(parser.value(option_output), QJsonDocument(root).toJson(QJsonDocument::Indented)) ? 0 : 1;
+}
@@ -0,0 +1,820 @@
+#include "replay.h"
+
+// Qt includes.
+#include <QtCore/QJsonArray>
+#include <QtCore/QThreadPool>
+#include <QtGui/QMouseEvent>
+#include <QtGui/QWheelEvent>
+
+// STL includes.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// QMapControl includes.
+#include <QMapControl/GeometryLineString.h>
+#include <QMapControl/ImageManager.h>
+#include <QMapControl/LayerMapAdapter.h>
+#include <QMapControl/MapAdapterTile.h>
+#include <QMapControl/Projection.h>
+
+// Local includes.
+#include "datasets.h"
+
+namespace
+{
+    /// The tile url template (the host is never contacted, TileStandIn serves the path).
+    const char* kTileUrl = "http://tiles.invalid/%zoom/%x/%y.png";
+
+    /// Half extent (degrees) of the area the geometries are spread over, around the initial focus.
+    const double kGeometryExtentLongitude = 0.5;
+    const double kGeometryExtentLatitude = 0.3;
+
+    /// Scale applied to the line dataset's vertex steps (0.01deg steps become ~100m).
+    const double kLineStepScale = 0.1;
+
+    /// Maximum distance (degrees) a geometry moves per update.
+    const double kGeometryUpdateStep = 0.002;
+
+    /// Quiet time (no redraw, no tile in flight) after which the map is considered settled.
+    const qint64 kSettledNs = 250 * 1000000LL;
+
+    /// Interval between polls of the tile stand-in.
+    const int kPollIntervalMs = 5;
+
+    /// Tolerance (pixels) when comparing backbuffer and viewport rects.
+    const double kRectTolerancePx = 0.5;
+
+    /// Summarise a set of values (ms).
+    QJsonObject summarise(std::vector<double> values)
+    {
+        QJsonObject summary{ { "count", int(values.size()) } };
+        if (values.empty())
+        {
+            return summary;
+        }
+
+        // Nearest-rank percentiles.
+        std::sort(values.begin(), values.end());
+        const auto percentile = [&values](const double p)
+        {
+            const std::size_t rank = std::size_t(std::ceil(p / 100.0 * double(values.size())));
+            return values[std::min(values.size() - 1, rank == 0 ? 0 : rank - 1)];
+        };
+
+        double sum = 0.0;
+        for (const double value : values)
+        {
+            sum += value;
+        }
+
+        summary["p50"] = percentile(50.0);
+        summary["p95"] = percentile(95.0);
+        summary["p99"] = percentile(99.0);
+        summary["max"] = values.back();
+        summary["mean"] = sum / double(values.size());
+        return summary;
+    }
+
+    /// Convert nanoseconds to milliseconds.
+    double toMs(const qint64 ns)
+    {
+        return double(ns) / 1.0e6;
+    }
+
+    /// Map a dataset point (world wide) into the area around a focus point.
+    PointWorldCoord aroundFocus(const PointWorldCoord& point, const PointWorldCoord& focus)
+    {
+        return PointWorldCoord(focus.longitude() + point.longitude() / 180.0 * kGeometryExtentLongitude,
+                               focus.latitude() + point.latitude() / 85.0 * kGeometryExtentLatitude);
+    }
+}
+
+ReplayApplication::ReplayApplication(int& argc, char** argv)
+    : QApplication(argc, argv),
+      m_paint_widget(nullptr),
+      m_paint_clock(nullptr)
+{
+
+}
+
+void ReplayApplication::watchPaint(QWidget* widget, const QElapsedTimer* clock, const PaintCallback& callback)
+{
+    m_paint_widget = widget;
+    m_paint_clock = clock;
+    m_paint_callback = callback;
+}
+
+bool ReplayApplication::notify(QObject* receiver, QEvent* event)
+{
+    // Time the paint events of the watched widget.
+    if (event->type() == QEvent::Paint && receiver == m_paint_widget && m_paint_callback)
+    {
+        const qint64 start_ns = m_paint_clock->nsecsElapsed();
+        const bool handled = QApplication::notify(receiver, event);
+        m_paint_callback(m_paint_widget, start_ns, m_paint_clock->nsecsElapsed());
+        return handled;
+    }
+
+    // Dispatch as normal.
+    return QApplication::notify(receiver, event);
+}
+
+FrameProbeLayer::FrameProbeLayer(const DrawCallback& callback)
+    : Layer(LayerType::LayerMapAdapter, "frame_probe"),
+      m_callback(callback)
+{
+
+}
+
+bool FrameProbeLayer::mousePressEvent(const QMouseEvent* /*mouse_event*/, const PointWorldCoord& /*mouse_point_coord*/, const int /*controller_zoom*/) const
+{
+    // Do nothing.
+    return false;
+}
+
+void FrameProbeLayer::draw(QPainter& /*painter*/, const RectWorldPx& backbuffer_rect_px, const int controller_zoom) const
+{
+    // Mark the start of the backbuffer redraw.
+    m_callback(backbuffer_rect_px, controller_zoom);
+}
+
+InteractionReplay::InteractionReplay(const Config& config, ReplayApplication& app)
+    : QObject(nullptr),
+      m_config(config),
+      m_app(app),
+      m_random(config.seed),
+      m_start_ns(0),
+      m_next_event(0),
+      m_animation_step(-1),
+      m_dispatching(false),
+      m_settled(false),
+      m_input_sequence(0)
+{
+    // Start the clock, everything is timed against it.
+    m_clock.start();
+    m_backbuffer_in_progress.start_ns = -1;
+
+    // Setup the tile stand-in, tracing each delivered tile.
+    m_tiles.reset(new TileStandIn(m_config.tiles, m_clock));
+    m_tiles->setRequestCallback([this](const QUrl& url, const qint64 requested_ns, const qint64 delivered_ns)
+    {
+        m_trace.complete(FrameTrace::Track::Tiles, "tile", requested_ns, delivered_ns, QJsonObject{ { "url", url.path() } });
+    });
+
+    // Create the map (fixed viewport size, so the replay is repeatable).
+    m_map.reset(new QMapControl(m_config.timeline.viewport_size));
+    m_map->setWindowTitle("QMapControl: InteractionReplay");
+    m_map->setMouseButtonLeft(QMapControl::MouseButtonMode::Pan, false);
+    m_map->setMouseButtonRight(QMapControl::MouseButtonMode::SelectBox, false);
+
+    // Serve the tiles from the stand-in.
+    ImageManager::get().setCustomTileProvider(m_tiles.get());
+    ImageManager::get().setMemoryCacheCapacity(m_config.memory_cache_mib);
+
+    // Capture when each backbuffer is emitted (in the render thread).
+    QObject::connect(m_map.get(), &QMapControl::updatedBackBuffer, this, [this]()
+    {
+        const qint64 now_ns = m_clock.nsecsElapsed();
+
+        // Collect the redraw started by the probe layer.
+        QMutexLocker locker(&m_backbuffers_mutex);
+        BackbufferRecord record(m_backbuffer_in_progress);
+        m_backbuffer_in_progress.start_ns = -1;
+        if (record.start_ns < 0)
+        {
+            // Redraw without the probe layer (before the layers were added), never shows an input.
+            record = BackbufferRecord{ now_ns, now_ns, -1, -1, QRectF(), -1, 0 };
+        }
+        else
+        {
+            record.end_ns = now_ns;
+            record.pending_tiles = m_tiles->pendingTiles(record.zoom, record.rect_px, ImageManager::get().tileSizePx());
+        }
+        m_backbuffers.push_back(record);
+        locker.unlock();
+
+        m_trace.complete(FrameTrace::Track::Render, "backbuffer", record.start_ns, record.end_ns,
+                         QJsonObject{ { "zoom", record.zoom }, { "sequence", record.sequence }, { "pending_tiles", record.pending_tiles } });
+    }, Qt::DirectConnection);
+
+    // Capture when each backbuffer has become the primary screen (queued after QMapControl::updatePrimaryScreen).
+    QObject::connect(m_map.get(), &QMapControl::updatedBackBuffer, this, [this]()
+    {
+        const qint64 now_ns = m_clock.nsecsElapsed();
+
+        QMutexLocker locker(&m_backbuffers_mutex);
+        for (auto& record : m_backbuffers)
+        {
+            if (record.applied_ns < 0)
+            {
+                record.applied_ns = now_ns;
+                break;
+            }
+        }
+    }, Qt::QueuedConnection);
+
+    // Animation ticks are inputs too (they move the map without user input).
+    QObject::connect(m_map.get(), &QMapControl::mapFocusPointChanged, this, [this]()
+    {
+        if (m_dispatching == false && m_animation_step >= 0)
+        {
+            recordInput("animation_tick", m_animation_step, -1, m_clock.nsecsElapsed(), false);
+        }
+    });
+
+    // Time the paint events.
+    m_app.watchPaint(m_map.get(), &m_clock, [this](QWidget* /*widget*/, const qint64 start_ns, const qint64 end_ns)
+    {
+        m_paints.push_back(PaintRecord{ start_ns, end_ns });
+        m_trace.complete(FrameTrace::Track::Gui, "paint", start_ns, end_ns);
+    });
+
+    // Setup the timers.
+    m_dispatch_timer.setSingleShot(true);
+    m_dispatch_timer.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&m_dispatch_timer, &QTimer::timeout, this, &InteractionReplay::dispatchDue);
+    m_poll_timer.setInterval(kPollIntervalMs);
+    m_poll_timer.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&m_poll_timer, &QTimer::timeout, this, &InteractionReplay::poll);
+}
+
+InteractionReplay::~InteractionReplay()
+{
+    // Stop replaying.
+    m_dispatch_timer.stop();
+    m_poll_timer.stop();
+    m_app.watchPaint(nullptr, nullptr, ReplayApplication::PaintCallback());
+
+    // Wait for any backbuffer redraw before the map goes (this also destroys the image manager).
+    QThreadPool::globalInstance()->waitForDone();
+    m_map.reset();
+    m_tiles.reset();
+}
+
+void InteractionReplay::start()
+{
+    // Show the map (offscreen when headless).
+    m_map->show();
+
+    // The timeline starts now.
+    m_start_ns = m_clock.nsecsElapsed();
+    m_trace.instant(FrameTrace::Track::Steps, "start", m_start_ns);
+
+    // Set the initial view and add the layers.
+    m_dispatching = true;
+    m_map->setMapFocusPoint(m_config.timeline.start_focus);
+    m_map->setZoom(m_config.timeline.start_zoom);
+    setupLayers();
+    m_dispatching = false;
+
+    // The initial load is the first input (it belongs to the step starting at 0 - if any).
+    int initial_step = -1;
+    for (std::size_t i = 0; i < m_config.timeline.steps.size(); ++i)
+    {
+        if (m_config.timeline.steps[i].start_ms == 0)
+        {
+            initial_step = int(i);
+            break;
+        }
+    }
+    recordInput("initial", initial_step, m_start_ns, m_start_ns, true);
+
+    // Start replaying.
+    m_poll_timer.start();
+    dispatchDue();
+}
+
+void InteractionReplay::startRecording(TimelineRecorder& recorder)
+{
+    // Set the initial view and add the layers.
+    m_map->setMapFocusPoint(m_config.timeline.start_focus);
+    m_map->setZoom(m_config.timeline.start_zoom);
+    setupLayers();
+
+    // Record the input and show the map.
+    m_map->installEventFilter(&recorder);
+    m_map->show();
+
+    // Keep delivering the tiles that arrive.
+    m_poll_timer.start();
+}
+
+void InteractionReplay::setupLayers()
+{
+    // The probe layer marks the start of each backbuffer redraw.
+    const auto probe = std::make_shared<FrameProbeLayer>([this](const RectWorldPx& backbuffer_rect_px, const int controller_zoom)
+    {
+        QMutexLocker locker(&m_backbuffers_mutex);
+        m_backbuffer_in_progress = BackbufferRecord{ m_clock.nsecsElapsed(), -1, -1, controller_zoom, backbuffer_rect_px.rawRect(), m_input_sequence.load(), 0 };
+    });
+
+    // The tile layer.
+    const auto map_adapter = std::make_shared<MapAdapterTile>(QUrl(kTileUrl), std::set<projection::EPSG>{ projection::EPSG::SphericalMercator });
+    const auto layer_tiles = std::make_shared<LayerMapAdapter>("tiles", map_adapter);
+
+    // The line layer (random walks around the initial focus).
+    const auto layer_lines = std::make_shared<LayerGeometry>("lines");
+    if (m_config.line_vertices > 0)
+    {
+        const datasets::Dataset lines(datasets::generate(datasets::Distribution::LineHeavy, std::size_t(m_config.line_vertices), m_config.seed));
+        QPen pen(QColor(200, 40, 40));
+        pen.setWidth(2);
+        for (const auto& line : lines.lines)
+        {
+            const PointWorldCoord origin(aroundFocus(line.front(), m_config.timeline.start_focus));
+            std::vector<PointWorldCoord> points;
+            points.reserve(line.size());
+            for (const auto& point : line)
+            {
+                points.emplace_back(origin.longitude() + (point.longitude() - line.front().longitude()) * kLineStepScale,
+                                    origin.latitude() + (point.latitude() - line.front().latitude()) * kLineStepScale);
+            }
+
+            const auto geometry = std::make_shared<GeometryLineString>(points);
+            geometry->setPen(pen);
+            layer_lines->addGeometry(geometry, true);
+        }
+    }
+
+    // The point layer (clusters around the initial focus).
+    m_layer_points = std::make_shared<LayerGeometry>("points");
+    if (m_config.points > 0)
+    {
+        const datasets::Dataset points(datasets::generate(datasets::Distribution::Clustered, std::size_t(m_config.points), m_config.seed));
+        const QPen pen(QColor(20, 60, 160));
+        const QBrush brush(QColor(60, 120, 220, 160));
+        m_points.reserve(points.points.size());
+        for (const auto& point : points.points)
+        {
+            const auto geometry = std::make_shared<GeometryPointCircle>(aroundFocus(point, m_config.timeline.start_focus), QSizeF(8.0, 8.0));
+            geometry->setPen(pen);
+            geometry->setBrush(brush);
+            m_layer_points->addGeometry(geometry, true);
+            m_points.push_back(geometry);
+        }
+    }
+
+    // Add the layers (probe first, so it is drawn first).
+    m_map->addLayer(probe);
+    m_map->addLayer(layer_tiles);
+    m_map->addLayer(layer_lines);
+    m_map->addLayer(m_layer_points);
+}
+
+void InteractionReplay::dispatchDue()
+{
+    const auto& events = m_config.timeline.events;
+
+    // Dispatch the events that are due (when running late, catch up without waiting).
+    while (m_next_event < events.size() && timelineNs(events[m_next_event].time_ms) <= m_clock.nsecsElapsed())
+    {
+        dispatch(events[m_next_event]);
+        ++m_next_event;
+    }
+
+    // Schedule the next dispatch.
+    if (m_next_event < events.size())
+    {
+        const qint64 wait_ns = timelineNs(events[m_next_event].time_ms) - m_clock.nsecsElapsed();
+        m_dispatch_timer.start(int(std::max<qint64>(wait_ns / 1000000, 0)));
+    }
+}
+
+void InteractionReplay::dispatch(const TimelineEvent& event)
+{
+    const qint64 dispatched_ns = m_clock.nsecsElapsed();
+    QString type;
+    bool content_changed = false;
+
+    m_dispatching = true;
+    switch (event.type)
+    {
+        case TimelineEvent::Type::MousePress:
+        case TimelineEvent::Type::MouseMove:
+        case TimelineEvent::Type::MouseRelease:
+        {
+            // Synthesise the mouse event.
+            QEvent::Type mouse_type = QEvent::MouseMove;
+            Qt::MouseButton button = Qt::NoButton;
+            Qt::MouseButtons buttons = event.button;
+            if (event.type == TimelineEvent::Type::MousePress)
+            {
+                mouse_type = QEvent::MouseButtonPress;
+                button = event.button;
+                type = "mouse_press";
+            }
+            else if (event.type == TimelineEvent::Type::MouseRelease)
+            {
+                mouse_type = QEvent::MouseButtonRelease;
+                button = event.button;
+                buttons = Qt::NoButton;
+                type = "mouse_release";
+            }
+            else
+            {
+                type = "mouse_move";
+            }
+
+            const QPointF global_position(m_map->mapToGlobal(event.position.toPoint()));
+            QMouseEvent mouse_event(mouse_type, event.position, event.position, global_position, button, buttons, Qt::NoModifier);
+            QApplication::sendEvent(m_map.get(), &mouse_event);
+            break;
+        }
+
+        case TimelineEvent::Type::Wheel:
+        {
+            // Synthesise the wheel event.
+            const QPointF global_position(m_map->mapToGlobal(event.position.toPoint()));
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+            QWheelEvent wheel_event(event.position, global_position, QPoint(), QPoint(0, event.delta), Qt::NoButton, Qt::NoModifier, Qt::NoScrollPhase, false);
+#else
+            QWheelEvent wheel_event(event.position, global_position, QPoint(), QPoint(0, event.delta), event.delta, Qt::Vertical, Qt::NoButton, Qt::NoModifier);
+#endif
+            QApplication::sendEvent(m_map.get(), &wheel_event);
+            type = "wheel";
+            break;
+        }
+
+        case TimelineEvent::Type::FocusAnimated:
+        {
+            // The animation ticks are recorded against this step.
+            m_animation_step = event.step;
+            m_map->setMapFocusPointAnimated(event.coord, event.steps, std::chrono::milliseconds(event.interval_ms));
+            type = "focus_animated";
+            break;
+        }
+
+        case TimelineEvent::Type::UpdateGeometries:
+        {
+            updateGeometries(event.count);
+            type = "update_geometries";
+            content_changed = true;
+            break;
+        }
+    }
+    m_dispatching = false;
+
+    // Record the input.
+    recordInput(type, event.step, timelineNs(event.time_ms), dispatched_ns, content_changed);
+}
+
+void InteractionReplay::updateGeometries(const int count)
+{
+    if (m_points.empty())
+    {
+        return;
+    }
+
+    // Move random points (re-inserting them so the layer's index stays valid).
+    std::uniform_int_distribution<std::size_t> pick(0, m_points.size() - 1);
+    std::uniform_real_distribution<double> step(-kGeometryUpdateStep, kGeometryUpdateStep);
+    for (int i = 0; i < count; ++i)
+    {
+        const auto& geometry = m_points[pick(m_random)];
+        const PointWorldCoord coord(geometry->coord());
+
+        m_layer_points->removeGeometry(geometry, true);
+        geometry->setCoord(PointWorldCoord(coord.longitude() + step(m_random), coord.latitude() + step(m_random)));
+        m_layer_points->addGeometry(geometry, true);
+    }
+
+    // Redraw once for the whole update.
+    m_map->requestRedraw();
+}
+
+void InteractionReplay::recordInput(const QString& type, const int step, const qint64 planned_ns, const qint64 dispatched_ns, const bool content_changed)
+{
+    InputRecord record;
+    record.type = type;
+    record.step = step;
+    record.sequence = m_input_sequence.load() + 1;
+    record.planned_ns = planned_ns;
+    record.dispatched_ns = dispatched_ns;
+    record.handled_ns = m_clock.nsecsElapsed();
+    record.content_changed = content_changed;
+
+    // Capture the view the input has led to.
+    record.zoom = m_map->getCurrentZoom();
+    const PointWorldPx focus_px(projection::get().toPointWorldPx(m_map->mapFocusPointCoord(), record.zoom));
+    const QSizeF viewport_size_px(m_config.timeline.viewport_size);
+    record.viewport_px = QRectF(focus_px.rawPoint() - QPointF(viewport_size_px.width() / 2.0, viewport_size_px.height() / 2.0), viewport_size_px);
+
+    // Redraws from now on have seen the input.
+    m_inputs.push_back(record);
+    m_input_sequence.store(record.sequence);
+
+    m_trace.instant(FrameTrace::Track::Gui, type, dispatched_ns, QJsonObject{ { "step", step }, { "sequence", record.sequence } });
+}
+
+void InteractionReplay::poll()
+{
+    // Arrived tiles require a redraw (the image manager's imageUpdated equivalent).
+    if (m_tiles->takeArrivedTiles() > 0)
+    {
+        m_map->requestRedraw();
+    }
+
+    // Has the timeline finished?
+    const qint64 now_ns = m_clock.nsecsElapsed();
+    const qint64 end_ns = timelineNs(m_config.timeline.duration_ms);
+    if (m_next_event < m_config.timeline.events.size() || now_ns < end_ns)
+    {
+        return;
+    }
+
+    // Has the map settled (no redraw pending, no tile in flight, nothing redrawn for a while)?
+    bool settled = m_tiles->tilesInFlight() == 0;
+    {
+        QMutexLocker locker(&m_backbuffers_mutex);
+        settled = settled && m_backbuffer_in_progress.start_ns < 0 &&
+                  (m_backbuffers.empty() || (m_backbuffers.back().applied_ns >= 0 && now_ns - m_backbuffers.back().applied_ns > kSettledNs));
+    }
+
+    if (settled || now_ns - end_ns > qint64(m_config.settle_timeout_ms) * 1000000)
+    {
+        finish(settled);
+    }
+}
+
+void InteractionReplay::finish(const bool settled)
+{
+    // Stop replaying.
+    m_dispatch_timer.stop();
+    m_poll_timer.stop();
+    m_settled = settled;
+
+    // Add the frames and steps to the trace.
+    for (const auto& frame : resolveFrames())
+    {
+        const QJsonObject args{ { "step", frame.input->step }, { "sequence", frame.input->sequence },
+                                { "backbuffer_ms", frame.backbuffer_ms }, { "present_ms", frame.present_ms } };
+        if (frame.presented)
+        {
+            m_trace.complete(FrameTrace::Track::Frames, frame.input->type, frame.input->dispatched_ns,
+                             frame.input->dispatched_ns + qint64(frame.latency_ms * 1.0e6), args);
+        }
+        else
+        {
+            m_trace.instant(FrameTrace::Track::Frames, frame.input->type + " (coalesced)", frame.input->dispatched_ns, args);
+        }
+    }
+    for (std::size_t i = 0; i < m_config.timeline.steps.size(); ++i)
+    {
+        const TimelineStep& step = m_config.timeline.steps[i];
+        m_trace.complete(FrameTrace::Track::Steps, step.name, timelineNs(step.start_ms), timelineNs(step.end_ms),
+                         QJsonObject{ { "type", step.type }, { "tiles_ready_ms", tilesReadyMs(int(i)) } });
+    }
+
+    emit finished();
+}
+
+std::vector<InteractionReplay::FrameRecord> InteractionReplay::resolveFrames() const
+{
+    std::vector<FrameRecord> frames;
+    frames.reserve(m_inputs.size());
+
+    QMutexLocker locker(&m_backbuffers_mutex);
+
+    // Backbuffers that reached the primary screen, in the order they did.
+    std::vector<const BackbufferRecord*> applied;
+    for (const auto& backbuffer : m_backbuffers)
+    {
+        if (backbuffer.applied_ns >= 0)
+        {
+            applied.push_back(&backbuffer);
+        }
+    }
+
+    for (const auto& input : m_inputs)
+    {
+        FrameRecord frame{ &input, false, -1.0, -1.0, -1.0 };
+
+        // Find the first paint (after the input) that shows the input's view.
+        const BackbufferRecord* on_screen = nullptr;
+        std::size_t next_applied = 0;
+        for (const auto& paint : m_paints)
+        {
+            // Track the backbuffer on screen at the time of the paint.
+            while (next_applied < applied.size() && applied[next_applied]->applied_ns <= paint.start_ns)
+            {
+                on_screen = applied[next_applied];
+                ++next_applied;
+            }
+
+            if (paint.start_ns < input.handled_ns || on_screen == nullptr || shows(*on_screen, input) == false)
+            {
+                continue;
+            }
+
+            // Found it.
+            frame.presented = true;
+            frame.latency_ms = toMs(paint.end_ns - input.dispatched_ns);
+            if (on_screen->start_ns >= input.dispatched_ns)
+            {
+                // A new backbuffer was drawn for the input.
+                frame.backbuffer_ms = toMs(on_screen->end_ns - input.dispatched_ns);
+                frame.present_ms = toMs(paint.end_ns - on_screen->end_ns);
+            }
+            break;
+        }
+
+        // Inputs never shown have been coalesced into a later frame.
+        frames.push_back(frame);
+    }
+
+    // Return the frames.
+    return frames;
+}
+
+double InteractionReplay::tilesReadyMs(const int step) const
+{
+    if (step < 0 || step >= int(m_config.timeline.steps.size()))
+    {
+        return -1.0;
+    }
+    const qint64 step_start_ns = timelineNs(m_config.timeline.steps[std::size_t(step)].start_ms);
+
+    // The step's final view: its last input, else the last input before it.
+    const InputRecord* final_input = nullptr;
+    for (const auto& input : m_inputs)
+    {
+        if (input.step == step || (input.step < step && input.dispatched_ns <= step_start_ns))
+        {
+            final_input = &input;
+        }
+    }
+    if (final_input == nullptr)
+    {
+        return -1.0;
+    }
+    const qint64 last_ns = std::max(final_input->handled_ns, step_start_ns);
+
+    QMutexLocker locker(&m_backbuffers_mutex);
+
+    // The backbuffer on screen after the final input, then each later one.
+    const BackbufferRecord* on_screen = nullptr;
+    for (const auto& backbuffer : m_backbuffers)
+    {
+        if (backbuffer.applied_ns < 0)
+        {
+            continue;
+        }
+
+        if (backbuffer.applied_ns <= last_ns)
+        {
+            on_screen = &backbuffer;
+            continue;
+        }
+
+        if (on_screen != nullptr && shows(*on_screen, *final_input) && on_screen->pending_tiles == 0)
+        {
+            return toMs(std::max(on_screen->applied_ns, last_ns) - step_start_ns);
+        }
+        on_screen = &backbuffer;
+    }
+
+    if (on_screen != nullptr && shows(*on_screen, *final_input) && on_screen->pending_tiles == 0)
+    {
+        return toMs(std::max(on_screen->applied_ns, last_ns) - step_start_ns);
+    }
+
+    // Never ready.
+    return -1.0;
+}
+
+bool InteractionReplay::shows(const BackbufferRecord& backbuffer, const InputRecord& input)
+{
+    // Same zoom, the viewport is covered, and content changes have been drawn.
+    return backbuffer.zoom == input.zoom &&
+           backbuffer.rect_px.adjusted(-kRectTolerancePx, -kRectTolerancePx, kRectTolerancePx, kRectTolerancePx).contains(input.viewport_px) &&
+           (input.content_changed == false || backbuffer.sequence >= input.sequence);
+}
+
+qint64 InteractionReplay::timelineNs(const qint64 time_ms) const
+{
+    return m_start_ns + time_ms * 1000000;
+}
+
+QJsonObject InteractionReplay::report() const
+{
+    const std::vector<FrameRecord> frames(resolveFrames());
+    const double budget_ms = m_config.frame_budget_ms;
+
+    // Frames missed by a frame (slow frames miss whole budgets, coalesced inputs miss their own).
+    const auto dropped = [budget_ms](const FrameRecord& frame)
+    {
+        return frame.presented ? std::max(0, int(std::ceil(frame.latency_ms / budget_ms)) - 1) : 1;
+    };
+
+    // Summarise the frames of a step (-2 for all steps, the initial load excluded).
+    const auto summariseFrames = [&](const int step)
+    {
+        std::vector<double> latency;
+        std::vector<double> backbuffer;
+        std::vector<double> present;
+        std::vector<double> dispatch_lag;
+        int inputs = 0;
+        int coalesced = 0;
+        int reused = 0;
+        int dropped_frames = 0;
+        int janky_frames = 0;
+        for (const auto& frame : frames)
+        {
+            if ((step == -2 && frame.input->type == "initial") || (step != -2 && frame.input->step != step))
+            {
+                continue;
+            }
+
+            ++inputs;
+            dropped_frames += dropped(frame);
+            if (frame.input->planned_ns >= 0)
+            {
+                dispatch_lag.push_back(toMs(frame.input->dispatched_ns - frame.input->planned_ns));
+            }
+            if (frame.presented == false)
+            {
+                ++coalesced;
+                continue;
+            }
+
+            latency.push_back(frame.latency_ms);
+            if (frame.latency_ms > budget_ms)
+            {
+                ++janky_frames;
+            }
+            if (frame.backbuffer_ms < 0.0)
+            {
+                ++reused;
+            }
+            else
+            {
+                backbuffer.push_back(frame.backbuffer_ms);
+                present.push_back(frame.present_ms);
+            }
+        }
+
+        return QJsonObject{
+            { "inputs", inputs },
+            { "frames_presented", int(latency.size()) },
+            { "frames_coalesced", coalesced },
+            { "frames_reusing_backbuffer", reused },
+            { "dropped_frames", dropped_frames },
+            { "janky_frames", janky_frames },
+            { "latency_ms", summarise(latency) },
+            { "input_to_backbuffer_ms", summarise(backbuffer) },
+            { "backbuffer_to_paint_ms", summarise(present) },
+            { "dispatch_lag_ms", summarise(dispatch_lag) }
+        };
+    };
+
+    // Backbuffer and paint durations.
+    std::vector<double> backbuffer_draw;
+    int backbuffers = 0;
+    {
+        QMutexLocker locker(&m_backbuffers_mutex);
+        for (const auto& backbuffer : m_backbuffers)
+        {
+            if (backbuffer.zoom >= 0)
+            {
+                backbuffer_draw.push_back(toMs(backbuffer.end_ns - backbuffer.start_ns));
+            }
+        }
+        backbuffers = int(m_backbuffers.size());
+    }
+    std::vector<double> paint;
+    for (const auto& record : m_paints)
+    {
+        paint.push_back(toMs(record.end_ns - record.start_ns));
+    }
+
+    // Overall summary.
+    QJsonObject summary(summariseFrames(-2));
+    summary["frame_budget_ms"] = budget_ms;
+    summary["settled"] = m_settled;
+    summary["backbuffers"] = backbuffers;
+    summary["backbuffer_draw_ms"] = summarise(backbuffer_draw);
+    summary["paints"] = int(m_paints.size());
+    summary["paint_ms"] = summarise(paint);
+    summary["tiles_delivered"] = m_tiles->tilesDelivered();
+    summary["tiles_synthesised"] = m_tiles->tilesSynthesised();
+
+    // Per step.
+    QJsonArray steps;
+    for (std::size_t i = 0; i < m_config.timeline.steps.size(); ++i)
+    {
+        QJsonObject step(summariseFrames(int(i)));
+        step["name"] = m_config.timeline.steps[i].name;
+        step["type"] = m_config.timeline.steps[i].type;
+        const double tiles_ready_ms = tilesReadyMs(int(i));
+        step["tiles_ready_ms"] = tiles_ready_ms < 0.0 ? QJsonValue() : QJsonValue(tiles_ready_ms);
+        steps.append(step);
+    }
+
+    return QJsonObject{ { "summary", summary }, { "steps", steps } };
+}
+
+bool InteractionReplay::writeTrace(const QString& path) const
+{
+    return m_trace.write(path);
+}
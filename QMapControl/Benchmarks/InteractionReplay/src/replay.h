@@ -0,0 +1,408 @@
+#pragma once
+
+// Qt includes.
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QJsonObject>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QRectF>
+#include <QtCore/QTimer>
+#include <QtWidgets/QApplication>
+
+// STL includes.
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+
+// QMapControl includes.
+#include <QMapControl/GeometryPointCircle.h>
+#include <QMapControl/Layer.h>
+#include <QMapControl/LayerGeometry.h>
+#include <QMapControl/QMapControl.h>
+
+// Local includes.
+#include "frametrace.h"
+#include "tilestandin.h"
+#include "timeline.h"
+
+/*!
+ * QApplication that reports when paint events have been handled (QWidget::paintEvent is not
+ * observable from the outside otherwise).
+ */
+class ReplayApplication : public QApplication
+{
+    Q_OBJECT
+public:
+    //! Paint callback (widget, start ns, end ns).
+    using PaintCallback = std::function<void(QWidget*, qint64, qint64)>;
+
+public:
+    /*!
+     * Construct the application.
+     * @param argc The argument count.
+     * @param argv The arguments.
+     */
+    ReplayApplication(int& argc, char** argv);
+
+    /*!
+     * Watch the paint events of a widget.
+     * @param widget The widget to watch.
+     * @param clock The clock the timestamps are relative to.
+     * @param callback The callback.
+     */
+    void watchPaint(QWidget* widget, const QElapsedTimer* clock, const PaintCallback& callback);
+
+    /*!
+     * Dispatch an event (timing paint events of the watched widget).
+     * @param receiver The receiver of the event.
+     * @param event The event.
+     * @return whether the event was handled.
+     */
+    bool notify(QObject* receiver, QEvent* event) override;
+
+private:
+    /// The watched widget.
+    QWidget* m_paint_widget;
+
+    /// The clock the timestamps are relative to.
+    const QElapsedTimer* m_paint_clock;
+
+    /// The paint callback.
+    PaintCallback m_paint_callback;
+};
+
+/*!
+ * Layer that draws nothing, added first so that its draw call marks the start of a backbuffer redraw.
+ */
+class FrameProbeLayer : public Layer
+{
+    Q_OBJECT
+public:
+    //! Draw callback (backbuffer rect, zoom).
+    using DrawCallback = std::function<void(const RectWorldPx&, int)>;
+
+public:
+    /*!
+     * Construct the probe layer.
+     * @param callback The callback invoked (in the render thread) when a backbuffer redraw starts.
+     */
+    explicit FrameProbeLayer(const DrawCallback& callback);
+
+    bool mousePressEvent(const QMouseEvent* mouse_event, const PointWorldCoord& mouse_point_coord, const int controller_zoom) const final;
+
+    void draw(QPainter& painter, const RectWorldPx& backbuffer_rect_px, const int controller_zoom) const final;
+
+private:
+    /// The draw callback.
+    const DrawCallback m_callback;
+};
+
+/*!
+ * Replays an interaction timeline against a QMapControl with a fixed layer stack (tiles served by
+ * TileStandIn, a clustered point layer and a line layer) and measures:
+ *  - frame latency: input dispatched -> backbuffer (updatedBackBuffer) -> paint handled, for the
+ *    first paint that shows the input's view (zoom, viewport and - for geometry updates - content).
+ *  - dropped frames: frames missed by slow frames (latency / frame budget) and inputs that were
+ *    never shown on their own (coalesced into a later frame).
+ *  - tiles-ready time: step start -> first backbuffer of the step's final view without pending tiles.
+ */
+class InteractionReplay : public QObject
+{
+    Q_OBJECT
+public:
+    //! Replay configuration.
+    struct Config
+    {
+        /// The timeline to replay.
+        Timeline timeline;
+
+        /// The tile stand-in configuration.
+        TileStandIn::Config tiles;
+
+        /// The frame budget in milliseconds (60Hz).
+        double frame_budget_ms = 1000.0 / 60.0;
+
+        /// How long to wait for the map to settle after the timeline (ms).
+        int settle_timeout_ms = 10000;
+
+        /// The number of points in the point layer.
+        int points = 10000;
+
+        /// The number of line vertices in the line layer.
+        int line_vertices = 50000;
+
+        /// The memory cache capacity in MiB.
+        int memory_cache_mib = 64;
+
+        /// The dataset seed.
+        std::uint64_t seed = 0;
+    };
+
+public:
+    /*!
+     * Construct the replay.
+     * @param config The configuration to use.
+     * @param app The application (used to time paint events).
+     */
+    InteractionReplay(const Config& config, ReplayApplication& app);
+
+    //! Destructor.
+    ~InteractionReplay();
+
+    /*!
+     * Start the replay, finished() is emitted once the map has settled.
+     */
+    void start();
+
+    /*!
+     * Show the map for interactive use, recording the mouse/wheel input (no replay).
+     * @param recorder The recorder to install on the map.
+     */
+    void startRecording(TimelineRecorder& recorder);
+
+    /*!
+     * Summarise the measurements.
+     * @return the report.
+     */
+    QJsonObject report() const;
+
+    /*!
+     * Write the trace.
+     * @param path The file to write to.
+     * @return whether the trace was written.
+     */
+    bool writeTrace(const QString& path) const;
+
+signals:
+    /*!
+     * Signal emitted when the replay has finished.
+     */
+    void finished();
+
+private slots:
+    /*!
+     * Dispatch the events that are due and schedule the next dispatch.
+     */
+    void dispatchDue();
+
+    /*!
+     * Poll the tile stand-in (redraw on arrived tiles) and check whether the replay has finished.
+     */
+    void poll();
+
+private:
+    //! A dispatched input.
+    struct InputRecord
+    {
+        /// The input type.
+        QString type;
+
+        /// The step the input belongs to.
+        int step;
+
+        /// The input sequence number.
+        int sequence;
+
+        /// When the timeline planned the dispatch (ns, -1 for inputs not on the timeline).
+        qint64 planned_ns;
+
+        /// When the dispatch started (ns).
+        qint64 dispatched_ns;
+
+        /// When the dispatch finished (ns).
+        qint64 handled_ns;
+
+        /// The zoom after the input.
+        int zoom;
+
+        /// The viewport (world pixels) after the input.
+        QRectF viewport_px;
+
+        /// Whether the input changed the map content (a backbuffer drawn after it is required).
+        bool content_changed;
+    };
+
+    //! A backbuffer redraw.
+    struct BackbufferRecord
+    {
+        /// When the redraw started (ns).
+        qint64 start_ns;
+
+        /// When updatedBackBuffer was emitted (ns).
+        qint64 end_ns;
+
+        /// When the primary screen was updated in the GUI thread (ns, -1 until then).
+        qint64 applied_ns;
+
+        /// The backbuffer zoom.
+        int zoom;
+
+        /// The backbuffer rect (world pixels).
+        QRectF rect_px;
+
+        /// The last input sequence the redraw has seen.
+        int sequence;
+
+        /// Tiles within the backbuffer that were still pending.
+        int pending_tiles;
+    };
+
+    //! A handled paint event.
+    struct PaintRecord
+    {
+        /// When the paint started (ns).
+        qint64 start_ns;
+
+        /// When the paint finished (ns).
+        qint64 end_ns;
+    };
+
+    //! A resolved frame (input shown on screen).
+    struct FrameRecord
+    {
+        /// The input.
+        const InputRecord* input;
+
+        /// Whether the input was shown by its own frame.
+        bool presented;
+
+        /// Input -> paint handled (ms).
+        double latency_ms;
+
+        /// Input -> backbuffer emitted (ms, -1 when an existing backbuffer was reused).
+        double backbuffer_ms;
+
+        /// Backbuffer emitted -> paint handled (ms, -1 when an existing backbuffer was reused).
+        double present_ms;
+    };
+
+    /*!
+     * Setup the layer stack.
+     */
+    void setupLayers();
+
+    /*!
+     * Dispatch an event.
+     * @param event The event to dispatch.
+     */
+    void dispatch(const TimelineEvent& event);
+
+    /*!
+     * Move random geometries of the point layer (remove, move, re-add and redraw once).
+     * @param count The number of geometries to move.
+     */
+    void updateGeometries(const int count);
+
+    /*!
+     * Record an input once it has been dispatched.
+     * @param type The input type.
+     * @param step The step the input belongs to.
+     * @param planned_ns When the timeline planned the dispatch (-1 if not on the timeline).
+     * @param dispatched_ns When the dispatch started.
+     * @param content_changed Whether the input changed the map content.
+     */
+    void recordInput(const QString& type, const int step, const qint64 planned_ns, const qint64 dispatched_ns, const bool content_changed);
+
+    /*!
+     * Stop the replay and add the frames/steps to the trace.
+     * @param settled Whether the map settled before the timeout.
+     */
+    void finish(const bool settled);
+
+    /*!
+     * Resolve the frame that showed each input.
+     * @return the frames.
+     */
+    std::vector<FrameRecord> resolveFrames() const;
+
+    /*!
+     * Calculate when the tiles of a step's final view were ready.
+     * @param step The step.
+     * @return the tiles-ready time since the start of the step (ms), or -1 if never.
+     */
+    double tilesReadyMs(const int step) const;
+
+    /*!
+     * Whether a backbuffer shows the view of an input.
+     * @param backbuffer The backbuffer.
+     * @param input The input.
+     * @return whether the view is shown.
+     */
+    static bool shows(const BackbufferRecord& backbuffer, const InputRecord& input);
+
+    /*!
+     * Fetch the time of a timeline offset.
+     * @param time_ms The offset since the start of the replay (ms).
+     * @return the time (ns).
+     */
+    qint64 timelineNs(const qint64 time_ms) const;
+
+private:
+    /// The configuration.
+    const Config m_config;
+
+    /// The application.
+    ReplayApplication& m_app;
+
+    /// The replay clock (all timestamps are relative to it).
+    QElapsedTimer m_clock;
+
+    /// The trace.
+    FrameTrace m_trace;
+
+    /// The tile stand-in (must outlive the map).
+    std::unique_ptr<TileStandIn> m_tiles;
+
+    /// The map.
+    std::unique_ptr<QMapControl> m_map;
+
+    /// The point layer.
+    std::shared_ptr<LayerGeometry> m_layer_points;
+
+    /// The points of the point layer.
+    std::vector<std::shared_ptr<GeometryPointCircle>> m_points;
+
+    /// Random generator for geometry updates.
+    std::mt19937_64 m_random;
+
+    /// When the timeline started (ns).
+    qint64 m_start_ns;
+
+    /// The next event to dispatch.
+    std::size_t m_next_event;
+
+    /// The current step of the focus animation (-1 if none).
+    int m_animation_step;
+
+    /// Whether an input is currently being dispatched.
+    bool m_dispatching;
+
+    /// Whether the map settled before the timeout.
+    bool m_settled;
+
+    /// The last dispatched input sequence number.
+    std::atomic<int> m_input_sequence;
+
+    /// The dispatch timer.
+    QTimer m_dispatch_timer;
+
+    /// The poll timer.
+    QTimer m_poll_timer;
+
+    /// The dispatched inputs.
+    std::vector<InputRecord> m_inputs;
+
+    /// Mutex to protect the backbuffer records (written from the render thread).
+    mutable QMutex m_backbuffers_mutex;
+
+    /// The backbuffer currently being redrawn.
+    BackbufferRecord m_backbuffer_in_progress;
+
+    /// The backbuffer redraws.
+    std::vector<BackbufferRecord> m_backbuffers;
+
+    /// The handled paint events.
+    std::vector<PaintRecord> m_paints;
+};
@@ -0,0 +1,236 @@
+#include "tilestandin.h"
+
+// Qt includes.
+#include <QtCore/QBuffer>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include <QtGui/QImage>
+#include <QtGui/QPainter>
+
+// STL includes.
+#include <algorithm>
+
+TileStandIn::TileStandIn(const Config& config, const QElapsedTimer& clock)
+    : m_config(config),
+      m_clock(clock),
+      m_random(config.seed),
+      m_tiles_delivered(0),
+      m_tiles_synthesised(0)
+{
+
+}
+
+void TileStandIn::setRequestCallback(const RequestCallback& callback)
+{
+    m_request_callback = callback;
+}
+
+bool TileStandIn::getTileData(const QUrl& url, QByteArray& data)
+{
+    // Parse the tile requested.
+    TileKey key;
+    if (parseTileKey(url, key) == false)
+    {
+        return false;
+    }
+
+    // The request time.
+    const qint64 now_ns = m_clock.nsecsElapsed();
+    qint64 requested_ns = now_ns;
+
+    if (m_config.latency_mode == LatencyMode::Deferred)
+    {
+        // Gain a lock to protect the pending tiles.
+        QMutexLocker locker(&m_mutex);
+
+        // Is this the first request for the tile?
+        const auto itr_find = m_pending.find(key);
+        if (itr_find == m_pending.end())
+        {
+            // Start the "download", the tile is not available yet.
+            m_pending[key] = PendingTile{ now_ns, now_ns + nextLatencyNs(), false };
+            return false;
+        }
+
+        // Has the tile arrived?
+        if (itr_find->second.available_ns > now_ns)
+        {
+            // Not yet.
+            return false;
+        }
+
+        // The tile has arrived, it is no longer pending (the image manager caches it from here on).
+        requested_ns = itr_find->second.requested_ns;
+        m_pending.erase(itr_find);
+    }
+    else
+    {
+        // Calculate the latency to wait.
+        qint64 latency_ns;
+        {
+            QMutexLocker locker(&m_mutex);
+            latency_ns = nextLatencyNs();
+        }
+
+        // Block for the latency (outside of the lock, so the harness can still query us).
+        QThread::usleep(static_cast<unsigned long>(latency_ns / 1000));
+    }
+
+    // Read the tile.
+    const bool success = readTile(key, data);
+
+    // Trace the request.
+    if (m_request_callback)
+    {
+        m_request_callback(url, requested_ns, m_clock.nsecsElapsed());
+    }
+
+    // Return the tile.
+    return success;
+}
+
+int TileStandIn::takeArrivedTiles()
+{
+    // Gain a lock to protect the pending tiles.
+    QMutexLocker locker(&m_mutex);
+
+    // Announce the tiles that have arrived since the last call.
+    const qint64 now_ns = m_clock.nsecsElapsed();
+    int arrived = 0;
+    for (auto& pending : m_pending)
+    {
+        if (pending.second.announced == false && pending.second.available_ns <= now_ns)
+        {
+            pending.second.announced = true;
+            ++arrived;
+        }
+    }
+
+    // Return the number of tiles arrived.
+    return arrived;
+}
+
+int TileStandIn::tilesInFlight() const
+{
+    // Gain a lock to protect the pending tiles.
+    QMutexLocker locker(&m_mutex);
+
+    // Count the tiles that have not arrived yet (arrived tiles wait for the next redraw to collect them).
+    const qint64 now_ns = m_clock.nsecsElapsed();
+    return int(std::count_if(m_pending.begin(), m_pending.end(), [now_ns](const std::pair<const TileKey, PendingTile>& pending) { return pending.second.available_ns > now_ns; }));
+}
+
+int TileStandIn::pendingTiles(const int zoom, const QRectF& rect_px, const int tile_size_px) const
+{
+    // Gain a lock to protect the pending tiles.
+    QMutexLocker locker(&m_mutex);
+
+    // Count the pending tiles at the zoom that intersect the rect.
+    int pending = 0;
+    for (const auto& tile : m_pending)
+    {
+        if (std::get<0>(tile.first) == zoom)
+        {
+            const QRectF tile_rect_px(std::get<1>(tile.first) * tile_size_px, std::get<2>(tile.first) * tile_size_px, tile_size_px, tile_size_px);
+            if (tile_rect_px.intersects(rect_px))
+            {
+                ++pending;
+            }
+        }
+    }
+
+    // Return the number of pending tiles.
+    return pending;
+}
+
+int TileStandIn::tilesDelivered() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_tiles_delivered;
+}
+
+int TileStandIn::tilesSynthesised() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_tiles_synthesised;
+}
+
+bool TileStandIn::parseTileKey(const QUrl& url, TileKey& key)
+{
+    // Expected path: /<zoom>/<x>/<y>.<extension>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    const QStringList parts = url.path().split('/', Qt::SkipEmptyParts);
+#else
+    const QStringList parts = url.path().split('/', QString::SkipEmptyParts);
+#endif
+    if (parts.size() != 3)
+    {
+        return false;
+    }
+
+    bool valid_zoom = false;
+    bool valid_x = false;
+    bool valid_y = false;
+    key = TileKey(parts.at(0).toInt(&valid_zoom), parts.at(1).toInt(&valid_x), parts.at(2).section('.', 0, 0).toInt(&valid_y));
+    return valid_zoom && valid_x && valid_y;
+}
+
+qint64 TileStandIn::nextLatencyNs()
+{
+    // Uniform jitter around the configured latency (never negative).
+    const qint64 latency_ns = qint64(m_config.latency_ms) * 1000000;
+    const qint64 jitter_ns = qint64(m_config.jitter_ms) * 1000000;
+    if (jitter_ns <= 0)
+    {
+        return std::max<qint64>(latency_ns, 0);
+    }
+    const qint64 offset_ns = qint64(m_random() % std::uint64_t(2 * jitter_ns + 1)) - jitter_ns;
+    return std::max<qint64>(latency_ns + offset_ns, 0);
+}
+
+bool TileStandIn::readTile(const TileKey& key, QByteArray& data)
+{
+    // The tile file path.
+    const QString relative_path(QString("%1/%2/%3.png").arg(std::get<0>(key)).arg(std::get<1>(key)).arg(std::get<2>(key)));
+    QFile file(m_config.directory.filePath(relative_path));
+
+    // Read the tile if it exists.
+    if (file.open(QIODevice::ReadOnly))
+    {
+        data = file.readAll();
+
+        QMutexLocker locker(&m_mutex);
+        ++m_tiles_delivered;
+        return data.isEmpty() == false;
+    }
+
+    // Synthesise the missing tile (coloured by its key and labelled with it).
+    QImage image(ImageManager::get().tileSizePx(), ImageManager::get().tileSizePx(), QImage::Format_RGB32);
+    const uint hash = qHash(relative_path);
+    image.fill(QColor::fromHsv(int(hash % 360), 40, 235));
+    {
+        QPainter painter(&image);
+        painter.setPen(QColor::fromHsv(int(hash % 360), 120, 120));
+        painter.drawRect(image.rect().adjusted(0, 0, -1, -1));
+        painter.drawText(image.rect(), Qt::AlignCenter, relative_path);
+    }
+
+    // Encode the tile.
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+
+    // Store it for the next run.
+    m_config.directory.mkpath(QFileInfo(file).absolutePath());
+    if (file.open(QIODevice::WriteOnly))
+    {
+        file.write(data);
+    }
+
+    QMutexLocker locker(&m_mutex);
+    ++m_tiles_delivered;
+    ++m_tiles_synthesised;
+    return true;
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+// Qt includes.
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QMutex>
+#include <QtCore/QRectF>
+#include <QtCore/QUrl>
+
+// STL includes.
+#include <functional>
+#include <map>
+#include <random>
+#include <tuple>
+
+// QMapControl includes.
+#include <QMapControl/ImageManager.h>
+
+using namespace qmapcontrol;
+
+/*!
+ * File based tile source with a configurable latency, standing in for a tile server.
+ *
+ * Tiles are read from "<directory>/<zoom>/<x>/<y>.png" (the url path of the requested tile).
+ * Missing tiles are synthesised once and written to the directory, so later runs are served from
+ * files only (tilesSynthesised() reports whether a run was cold).
+ *
+ * Latency modes:
+ *  - Deferred: the first request for a tile fails (an empty tile is drawn) and the tile becomes
+ *              available once its latency has elapsed, like a network download does.
+ *  - Blocking: every request sleeps for the latency before returning, like a slow custom
+ *              provider (eg: a remote database) does.
+ */
+class TileStandIn : public ITileProvider
+{
+public:
+    //! Latency modes available.
+    enum class LatencyMode
+    {
+        /// Tiles arrive asynchronously after the latency.
+        Deferred,
+        /// Requests block for the latency.
+        Blocking
+    };
+
+    //! Tile stand-in configuration.
+    struct Config
+    {
+        /// The tile directory.
+        QDir directory;
+
+        /// The latency mode.
+        LatencyMode latency_mode = LatencyMode::Deferred;
+
+        /// The latency per tile in milliseconds.
+        int latency_ms = 50;
+
+        /// The latency jitter (+/-) in milliseconds.
+        int jitter_ms = 20;
+
+        /// The jitter seed.
+        std::uint64_t seed = 0;
+    };
+
+    //! Tile request trace callback (url, requested ns, delivered ns).
+    using RequestCallback = std::function<void(const QUrl&, qint64, qint64)>;
+
+public:
+    /*!
+     * Construct the tile stand-in.
+     * @param config The configuration to use.
+     * @param clock The clock all timestamps are relative to.
+     */
+    TileStandIn(const Config& config, const QElapsedTimer& clock);
+
+    //! Disable copy constructor.
+    TileStandIn(const TileStandIn&) = delete;
+
+    //! Disable copy assignment.
+    TileStandIn& operator=(const TileStandIn&) = delete;
+
+    //! Destructor.
+    ~TileStandIn() = default;
+
+    /*!
+     * Set the callback used to trace delivered tile requests.
+     * @param callback The callback.
+     */
+    void setRequestCallback(const RequestCallback& callback);
+
+    /*!
+     * Fetch the tile data (ITileProvider).
+     * @param url The tile url.
+     * @param data The tile data.
+     * @return whether the tile is available.
+     */
+    bool getTileData(const QUrl& url, QByteArray& data) override;
+
+    /*!
+     * Fetch the number of deferred tiles that have become available since the last call.
+     * @return the number of newly available tiles (a redraw is required when non-zero).
+     */
+    int takeArrivedTiles();
+
+    /*!
+     * Fetch the number of requested tiles that have not arrived yet.
+     * @return the number of tiles in flight.
+     */
+    int tilesInFlight() const;
+
+    /*!
+     * Fetch the number of requested tiles within a rect that have not been delivered yet.
+     * @param zoom The zoom level.
+     * @param rect_px The world pixel rect.
+     * @param tile_size_px The tile size in pixels.
+     * @return the number of pending tiles.
+     */
+    int pendingTiles(const int zoom, const QRectF& rect_px, const int tile_size_px) const;
+
+    /*!
+     * Fetch the number of tiles delivered.
+     * @return the number of tiles delivered.
+     */
+    int tilesDelivered() const;
+
+    /*!
+     * Fetch the number of tiles synthesised (missing from the tile directory).
+     * @return the number of tiles synthesised.
+     */
+    int tilesSynthesised() const;
+
+private:
+    /// Tile key (zoom, x, y).
+    using TileKey = std::tuple<int, int, int>;
+
+    //! A requested tile that has not been delivered yet.
+    struct PendingTile
+    {
+        /// When the tile was first requested (ns).
+        qint64 requested_ns;
+
+        /// When the tile becomes available (ns).
+        qint64 available_ns;
+
+        /// Whether the arrival has been announced by takeArrivedTiles().
+        bool announced;
+    };
+
+    /*!
+     * Parse the tile key from a url path.
+     * @param url The tile url.
+     * @param key The parsed key.
+     * @return whether the url is a valid tile path.
+     */
+    static bool parseTileKey(const QUrl& url, TileKey& key);
+
+    /*!
+     * Calculate the latency of the next request.
+     * @return the latency in nanoseconds.
+     */
+    qint64 nextLatencyNs();
+
+    /*!
+     * Read (or synthesise) a tile file.
+     * @param key The tile key.
+     * @param data The tile data.
+     * @return whether the tile data is available.
+     */
+    bool readTile(const TileKey& key, QByteArray& data);
+
+private:
+    /// The configuration.
+    const Config m_config;
+
+    /// The clock all timestamps are relative to.
+    const QElapsedTimer& m_clock;
+
+    /// The request callback.
+    RequestCallback m_request_callback;
+
+    /// Mutex to protect the members below.
+    mutable QMutex m_mutex;
+
+    /// Jitter generator.
+    std::mt19937_64 m_random;
+
+    /// Requested tiles that have not been delivered yet.
+    std::map<TileKey, PendingTile> m_pending;
+
+    /// Number of tiles delivered.
+    int m_tiles_delivered;
+
+    /// Number of tiles synthesised.
+    int m_tiles_synthesised;
+};
@@ -0,0 +1,402 @@
+#include "timeline.h"
+
+// Qt includes.
+#include <QtCore/QJsonArray>
+#include <QtGui/QMouseEvent>
+#include <QtGui/QWheelEvent>
+
+// STL includes.
+#include <algorithm>
+
+namespace timeline
+{
+    namespace
+    {
+        /// Default pause before each scripted step.
+        const int kDefaultPauseMs = 250;
+
+        /// Step type names of the event types.
+        QString toString(const TimelineEvent::Type type)
+        {
+            switch (type)
+            {
+                case TimelineEvent::Type::MousePress:
+                    return "mouse_press";
+                case TimelineEvent::Type::MouseMove:
+                    return "mouse_move";
+                case TimelineEvent::Type::MouseRelease:
+                    return "mouse_release";
+                case TimelineEvent::Type::Wheel:
+                    return "wheel";
+                case TimelineEvent::Type::FocusAnimated:
+                    return "focus_animated";
+                case TimelineEvent::Type::UpdateGeometries:
+                    return "update_geometries";
+            }
+            return QString();
+        }
+
+        bool fromString(const QString& name, TimelineEvent::Type& return_type)
+        {
+            for (const auto type : { TimelineEvent::Type::MousePress, TimelineEvent::Type::MouseMove, TimelineEvent::Type::MouseRelease,
+                                     TimelineEvent::Type::Wheel, TimelineEvent::Type::FocusAnimated, TimelineEvent::Type::UpdateGeometries })
+            {
+                if (toString(type) == name)
+                {
+                    return_type = type;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        QPointF toPoint(const QJsonValue& value, const QPointF& fallback = QPointF())
+        {
+            const QJsonArray array(value.toArray());
+            return array.size() == 2 ? QPointF(array.at(0).toDouble(), array.at(1).toDouble()) : fallback;
+        }
+
+        QJsonArray toArray(const QPointF& point)
+        {
+            return QJsonArray{ point.x(), point.y() };
+        }
+
+        /// Append the events of a mouse drag (press, moves, release).
+        void appendDrag(Timeline& timeline, qint64 time_ms, const int step, const Qt::MouseButton button,
+                        const QPointF& from, const QPointF& to, const int duration_ms, const int moves)
+        {
+            TimelineEvent event;
+            event.step = step;
+            event.button = button;
+
+            // Press.
+            event.time_ms = time_ms;
+            event.type = TimelineEvent::Type::MousePress;
+            event.position = from;
+            timeline.events.push_back(event);
+
+            // Moves (evenly spread over the duration).
+            event.type = TimelineEvent::Type::MouseMove;
+            for (int i = 1; i <= moves; ++i)
+            {
+                event.time_ms = time_ms + (qint64(duration_ms) * i) / moves;
+                event.position = from + (to - from) * (double(i) / moves);
+                timeline.events.push_back(event);
+            }
+
+            // Release.
+            event.time_ms = time_ms + duration_ms;
+            event.type = TimelineEvent::Type::MouseRelease;
+            event.position = to;
+            timeline.events.push_back(event);
+        }
+    }
+
+    Timeline defaultTimeline()
+    {
+        // Steps around the (default) initial view, exercising each kind of interaction.
+        const QJsonObject document{
+            { "steps", QJsonArray{
+                QJsonObject{ { "type", "wait" }, { "name", "initial_load" }, { "duration_ms", 1500 }, { "pause_ms", 0 } },
+                QJsonObject{ { "type", "pan" }, { "name", "pan_east" }, { "from", QJsonArray{ 900, 360 } }, { "by", QJsonArray{ -600, 0 } }, { "duration_ms", 600 }, { "moves", 36 } },
+                QJsonObject{ { "type", "pan" }, { "name", "pan_fling" }, { "from", QJsonArray{ 300, 200 } }, { "by", QJsonArray{ 700, 450 } }, { "duration_ms", 250 }, { "moves", 15 } },
+                QJsonObject{ { "type", "wheel" }, { "name", "zoom_in" }, { "at", QJsonArray{ 900, 300 } }, { "delta", 120 }, { "count", 2 }, { "interval_ms", 300 } },
+                QJsonObject{ { "type", "wheel" }, { "name", "zoom_out" }, { "at", QJsonArray{ 400, 500 } }, { "delta", -120 }, { "count", 3 }, { "interval_ms", 120 } },
+                QJsonObject{ { "type", "focus_animated" }, { "name", "fly_to" }, { "coord", QJsonArray{ -0.0877, 51.5081 } }, { "steps", 25 }, { "interval_ms", 20 } },
+                QJsonObject{ { "type", "select_box" }, { "name", "select" }, { "from", QJsonArray{ 200, 150 } }, { "to", QJsonArray{ 1000, 600 } }, { "duration_ms", 400 }, { "moves", 24 } },
+                QJsonObject{ { "type", "update_geometries" }, { "name", "live_updates" }, { "count", 200 }, { "repeat", 20 }, { "interval_ms", 100 } },
+                QJsonObject{ { "type", "wait" }, { "name", "settle" }, { "duration_ms", 1000 } },
+            } }
+        };
+
+        Timeline return_timeline;
+        QString error;
+        fromJson(document, return_timeline, error);
+        Q_ASSERT(error.isEmpty());
+        return return_timeline;
+    }
+
+    bool fromJson(const QJsonObject& document, Timeline& return_timeline, QString& return_error)
+    {
+        Timeline timeline;
+
+        // The initial view.
+        if (document.contains("viewport"))
+        {
+            const QPointF size(toPoint(document.value("viewport")));
+            timeline.viewport_size = QSize(int(size.x()), int(size.y()));
+        }
+        if (document.contains("focus"))
+        {
+            timeline.start_focus = PointWorldCoord(toPoint(document.value("focus")));
+        }
+        timeline.start_zoom = document.value("zoom").toInt(timeline.start_zoom);
+
+        if (document.contains("events"))
+        {
+            // Recorded events.
+            for (const QJsonValue& value : document.value("steps").toArray())
+            {
+                const QJsonObject object(value.toObject());
+                timeline.steps.push_back(TimelineStep{ object.value("name").toString(), object.value("type").toString(), qint64(object.value("start_ms").toDouble()), qint64(object.value("end_ms").toDouble()) });
+            }
+
+            for (const QJsonValue& value : document.value("events").toArray())
+            {
+                const QJsonObject object(value.toObject());
+
+                TimelineEvent event;
+                if (fromString(object.value("type").toString(), event.type) == false)
+                {
+                    return_error = QString("Unknown event type '%1'").arg(object.value("type").toString());
+                    return false;
+                }
+                event.time_ms = qint64(object.value("t_ms").toDouble());
+                event.step = object.value("step").toInt();
+                event.position = toPoint(object.value("position"));
+                event.button = object.value("button").toString() == "right" ? Qt::RightButton : Qt::LeftButton;
+                event.delta = object.value("delta").toInt();
+                event.coord = PointWorldCoord(toPoint(object.value("coord")));
+                event.steps = object.value("steps").toInt();
+                event.interval_ms = object.value("interval_ms").toInt();
+                event.count = object.value("count").toInt();
+
+                // Ensure the step exists.
+                if (event.step < 0 || event.step >= int(timeline.steps.size()))
+                {
+                    return_error = QString("Event at %1ms references unknown step %2").arg(event.time_ms).arg(event.step);
+                    return false;
+                }
+                timeline.events.push_back(event);
+                timeline.duration_ms = std::max(timeline.duration_ms, event.time_ms);
+            }
+            timeline.duration_ms = qint64(document.value("duration_ms").toDouble(double(timeline.duration_ms)));
+        }
+        else
+        {
+            // Scripted steps.
+            qint64 time_ms = 0;
+            for (const QJsonValue& value : document.value("steps").toArray())
+            {
+                const QJsonObject object(value.toObject());
+                const QString type(object.value("type").toString());
+                const int step = int(timeline.steps.size());
+                // Wait before the step starts.
+                time_ms += object.value("pause_ms").toInt(kDefaultPauseMs);
+                timeline.steps.push_back(TimelineStep{ object.value("name").toString(QString("%1_%2").arg(type).arg(step)), type, time_ms, time_ms });
+
+                TimelineEvent event;
+                event.step = step;
+                if (type == "pan" || type == "select_box")
+                {
+                    const QPointF from(toPoint(object.value("from"), QPointF(timeline.viewport_size.width() / 2.0, timeline.viewport_size.height() / 2.0)));
+                    const QPointF to(type == "pan" ? from + toPoint(object.value("by")) : toPoint(object.value("to")));
+                    const int duration_ms = object.value("duration_ms").toInt(500);
+                    appendDrag(timeline, time_ms, step, type == "pan" ? Qt::LeftButton : Qt::RightButton, from, to, duration_ms, std::max(object.value("moves").toInt(30), 1));
+                    time_ms += duration_ms;
+                }
+                else if (type == "wheel")
+                {
+                    const int count = std::max(object.value("count").toInt(1), 1);
+                    const int interval_ms = object.value("interval_ms").toInt(200);
+                    event.type = TimelineEvent::Type::Wheel;
+                    event.position = toPoint(object.value("at"), QPointF(timeline.viewport_size.width() / 2.0, timeline.viewport_size.height() / 2.0));
+                    event.delta = object.value("delta").toInt(120);
+                    for (int i = 0; i < count; ++i)
+                    {
+                        event.time_ms = time_ms + qint64(i) * interval_ms;
+                        timeline.events.push_back(event);
+                    }
+                    time_ms += qint64(count) * interval_ms;
+                }
+                else if (type == "focus_animated")
+                {
+                    event.type = TimelineEvent::Type::FocusAnimated;
+                    event.time_ms = time_ms;
+                    event.coord = PointWorldCoord(toPoint(object.value("coord")));
+                    event.steps = std::max(object.value("steps").toInt(25), 1);
+                    event.interval_ms = object.value("interval_ms").toInt(50);
+                    timeline.events.push_back(event);
+                    time_ms += qint64(event.steps) * event.interval_ms;
+                }
+                else if (type == "update_geometries")
+                {
+                    const int repeat = std::max(object.value("repeat").toInt(1), 1);
+                    const int interval_ms = object.value("interval_ms").toInt(100);
+                    event.type = TimelineEvent::Type::UpdateGeometries;
+                    event.count = object.value("count").toInt(100);
+                    for (int i = 0; i < repeat; ++i)
+                    {
+                        event.time_ms = time_ms + qint64(i) * interval_ms;
+                        timeline.events.push_back(event);
+                    }
+                    time_ms += qint64(repeat) * interval_ms;
+                }
+                else if (type == "wait")
+                {
+                    time_ms += object.value("duration_ms").toInt(1000);
+                }
+                else
+                {
+                    return_error = QString("Unknown step type '%1'").arg(type);
+                    return false;
+                }
+
+                // The step has finished.
+                timeline.steps.back().end_ms = time_ms;
+            }
+
+            // The timeline ends when the last step does.
+            timeline.duration_ms = time_ms;
+        }
+
+        // Ensure the events are in dispatch order.
+        std::stable_sort(timeline.events.begin(), timeline.events.end(), [](const TimelineEvent& lhs, const TimelineEvent& rhs) { return lhs.time_ms < rhs.time_ms; });
+
+        return_timeline = timeline;
+        return true;
+    }
+
+    QJsonObject toJson(const Timeline& timeline)
+    {
+        QJsonArray steps;
+        for (const auto& step : timeline.steps)
+        {
+            steps.append(QJsonObject{ { "name", step.name }, { "type", step.type }, { "start_ms", double(step.start_ms) }, { "end_ms", double(step.end_ms) } });
+        }
+
+        QJsonArray events;
+        for (const auto& event : timeline.events)
+        {
+            QJsonObject object{ { "t_ms", double(event.time_ms) }, { "type", toString(event.type) }, { "step", event.step } };
+            switch (event.type)
+            {
+                case TimelineEvent::Type::MousePress:
+                case TimelineEvent::Type::MouseMove:
+                case TimelineEvent::Type::MouseRelease:
+                    object["position"] = toArray(event.position);
+                    object["button"] = event.button == Qt::RightButton ? "right" : "left";
+                    break;
+                case TimelineEvent::Type::Wheel:
+                    object["position"] = toArray(event.position);
+                    object["delta"] = event.delta;
+                    break;
+                case TimelineEvent::Type::FocusAnimated:
+                    object["coord"] = toArray(event.coord.rawPoint());
+                    object["steps"] = event.steps;
+                    object["interval_ms"] = event.interval_ms;
+                    break;
+                case TimelineEvent::Type::UpdateGeometries:
+                    object["count"] = event.count;
+                    break;
+            }
+            events.append(object);
+        }
+
+        return QJsonObject{
+            { "viewport", QJsonArray{ timeline.viewport_size.width(), timeline.viewport_size.height() } },
+            { "focus", toArray(timeline.start_focus.rawPoint()) },
+            { "zoom", timeline.start_zoom },
+            { "duration_ms", double(timeline.duration_ms) },
+            { "steps", steps },
+            { "events", events }
+        };
+    }
+}
+
+TimelineRecorder::TimelineRecorder(const Timeline& initial, QObject* parent)
+    : QObject(parent),
+      m_gesture_in_progress(false)
+{
+    // Keep the initial view, drop any events.
+    m_timeline.viewport_size = initial.viewport_size;
+    m_timeline.start_focus = initial.start_focus;
+    m_timeline.start_zoom = initial.start_zoom;
+
+    // Start recording.
+    m_clock.start();
+}
+
+const Timeline& TimelineRecorder::recorded() const
+{
+    return m_timeline;
+}
+
+bool TimelineRecorder::eventFilter(QObject* watched, QEvent* event)
+{
+    TimelineEvent recorded_event;
+    recorded_event.time_ms = m_clock.elapsed();
+
+    switch (event->type())
+    {
+        case QEvent::MouseButtonPress:
+        {
+            const QMouseEvent* mouse_event = static_cast<QMouseEvent*>(event);
+            startStep(mouse_event->button() == Qt::RightButton ? "select_box" : "pan");
+            m_gesture_in_progress = true;
+
+            recorded_event.type = TimelineEvent::Type::MousePress;
+            recorded_event.position = mouse_event->localPos();
+            recorded_event.button = mouse_event->button();
+            break;
+        }
+
+        case QEvent::MouseMove:
+        {
+            // Hover moves are not part of a gesture.
+            if (m_gesture_in_progress == false)
+            {
+                return QObject::eventFilter(watched, event);
+            }
+
+            const QMouseEvent* mouse_event = static_cast<QMouseEvent*>(event);
+            recorded_event.type = TimelineEvent::Type::MouseMove;
+            recorded_event.position = mouse_event->localPos();
+            recorded_event.button = (mouse_event->buttons() & Qt::RightButton) ? Qt::RightButton : Qt::LeftButton;
+            break;
+        }
+
+        case QEvent::MouseButtonRelease:
+        {
+            const QMouseEvent* mouse_event = static_cast<QMouseEvent*>(event);
+            m_gesture_in_progress = false;
+
+            recorded_event.type = TimelineEvent::Type::MouseRelease;
+            recorded_event.position = mouse_event->localPos();
+            recorded_event.button = mouse_event->button();
+            break;
+        }
+
+        case QEvent::Wheel:
+        {
+            const QWheelEvent* wheel_event = static_cast<QWheelEvent*>(event);
+            startStep("wheel");
+
+            recorded_event.type = TimelineEvent::Type::Wheel;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+            recorded_event.position = wheel_event->position();
+#else
+            recorded_event.position = wheel_event->posF();
+#endif
+            recorded_event.delta = wheel_event->angleDelta().y();
+            break;
+        }
+
+        default:
+            return QObject::eventFilter(watched, event);
+    }
+
+    // Record the event against the current step.
+    recorded_event.step = int(m_timeline.steps.size()) - 1;
+    m_timeline.steps.back().end_ms = recorded_event.time_ms;
+    m_timeline.events.push_back(recorded_event);
+    m_timeline.duration_ms = recorded_event.time_ms;
+
+    // Never filter the event.
+    return QObject::eventFilter(watched, event);
+}
+
+void TimelineRecorder::startStep(const QString& type)
+{
+    m_timeline.steps.push_back(TimelineStep{ QString("%1_%2").arg(type).arg(m_timeline.steps.size()), type, m_clock.elapsed(), m_clock.elapsed() });
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+// Qt includes.
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QJsonObject>
+#include <QtCore/QObject>
+#include <QtCore/QPointF>
+#include <QtCore/QSize>
+#include <QtCore/QString>
+
+// STL includes.
+#include <vector>
+
+// QMapControl includes.
+#include <QMapControl/Point.h>
+
+using namespace qmapcontrol;
+
+//! A single timed input of a timeline.
+struct TimelineEvent
+{
+    //! Event types available.
+    enum class Type
+    {
+        /// Mouse button press at a viewport position.
+        MousePress,
+        /// Mouse move to a viewport position.
+        MouseMove,
+        /// Mouse button release at a viewport position.
+        MouseRelease,
+        /// Mouse wheel at a viewport position.
+        Wheel,
+        /// QMapControl::setMapFocusPointAnimated.
+        FocusAnimated,
+        /// Move geometries of the geometry layer.
+        UpdateGeometries
+    };
+
+    /// When the event is dispatched (ms since the start of the replay).
+    qint64 time_ms = 0;
+
+    /// The event type.
+    Type type = Type::MouseMove;
+
+    /// The index of the step the event belongs to.
+    int step = 0;
+
+    /// The viewport position (mouse/wheel events).
+    QPointF position;
+
+    /// The mouse button (mouse events).
+    Qt::MouseButton button = Qt::NoButton;
+
+    /// The wheel angle delta (wheel events).
+    int delta = 0;
+
+    /// The focus point (focus animated events).
+    PointWorldCoord coord = PointWorldCoord(0.0, 0.0);
+
+    /// The number of animation steps (focus animated events).
+    int steps = 0;
+
+    /// The animation step interval in milliseconds (focus animated events).
+    int interval_ms = 0;
+
+    /// The number of geometries to move (update geometries events).
+    int count = 0;
+};
+
+//! A named group of events (eg: one pan gesture).
+struct TimelineStep
+{
+    /// The step name.
+    QString name;
+
+    /// The step type (eg: "pan", "wheel").
+    QString type;
+
+    /// When the step starts (ms since the start of the replay).
+    qint64 start_ms;
+
+    /// When the step ends (ms since the start of the replay).
+    qint64 end_ms;
+};
+
+//! An interaction timeline to replay.
+struct Timeline
+{
+    /// The viewport size.
+    QSize viewport_size = QSize(1280, 720);
+
+    /// The initial map focus point.
+    PointWorldCoord start_focus = PointWorldCoord(-0.1276, 51.5072);
+
+    /// The initial zoom.
+    int start_zoom = 12;
+
+    /// The timeline duration (ms).
+    qint64 duration_ms = 0;
+
+    /// The steps.
+    std::vector<TimelineStep> steps;
+
+    /// The events (sorted by time).
+    std::vector<TimelineEvent> events;
+};
+
+namespace timeline
+{
+    /*!
+     * Fetch the built-in timeline (pans, wheel zooms, an animated focus change, a box selection
+     * and geometry updates).
+     * @return the timeline.
+     */
+    Timeline defaultTimeline();
+
+    /*!
+     * Load a timeline from a JSON document.
+     *
+     * The document holds the initial view ("viewport": [w, h], "focus": [lon, lat], "zoom") and
+     * either scripted "steps" or recorded "events" (as written by TimelineRecorder).
+     * Scripted steps are expanded into events, each step starts "pause_ms" (default 250ms) after
+     * the previous one has finished:
+     *  - {"type": "pan", "from": [x, y], "by": [dx, dy], "duration_ms", "moves"}
+     *  - {"type": "wheel", "at": [x, y], "delta": +-120, "count", "interval_ms"}
+     *  - {"type": "focus_animated", "coord": [lon, lat], "steps", "interval_ms"}
+     *  - {"type": "select_box", "from": [x, y], "to": [x, y], "duration_ms", "moves"}
+     *  - {"type": "update_geometries", "count", "repeat", "interval_ms"}
+     *  - {"type": "wait", "duration_ms"}
+     * @param document The JSON document.
+     * @param return_timeline The loaded timeline.
+     * @param return_error The error (if any).
+     * @return whether the timeline was loaded.
+     */
+    bool fromJson(const QJsonObject& document, Timeline& return_timeline, QString& return_error);
+
+    /*!
+     * Convert a timeline into its JSON document (recorded "events" form).
+     * @param timeline The timeline.
+     * @return the JSON document.
+     */
+    QJsonObject toJson(const Timeline& timeline);
+}
+
+/*!
+ * Records the mouse/wheel input of a QMapControl into a timeline.
+ */
+class TimelineRecorder : public QObject
+{
+    Q_OBJECT
+public:
+    /*!
+     * Construct a recorder.
+     * @param initial The initial view of the timeline.
+     * @param parent QObject parent ownership.
+     */
+    explicit TimelineRecorder(const Timeline& initial, QObject* parent = nullptr);
+
+    /*!
+     * Fetch the recorded timeline.
+     * @return the recorded timeline.
+     */
+    const Timeline& recorded() const;
+
+protected:
+    /*!
+     * Record mouse and wheel events.
+     * @param watched The object the event is for.
+     * @param event The event.
+     * @return false (events are never filtered).
+     */
+    bool eventFilter(QObject* watched, QEvent* event) override;
+
+private:
+    /*!
+     * Start a new step.
+     * @param type The step type.
+     */
+    void startStep(const QString& type);
+
+private:
+    /// The recorded timeline.
+    Timeline m_timeline;
+
+    /// Time since the recording started.
+    QElapsedTimer m_clock;
+
+    /// Whether a mouse gesture (press to release) is in progress.
+    bool m_gesture_in_progress;
+};
@@ -0,0 +1,27 @@
+# Include benchmark configurations.
+include(../Benchmarks.pri)
+
+# Target name.
+TARGET = Microbench
+
+# Target version.
+VERSION = 0.1
+
+# Build an application.
+TEMPLATE = app
+
+# Console application (results are written to stdout).
+CONFIG += console
+
+# Add header files.
+HEADERS +=                  \
+    ../Common/datasets.h    \
+    src/benchmark.h         \
+    src/microbench.h        \
+
+# Add source files.
+SOURCES +=                  \
+    ../Common/datasets.cpp  \
+    src/main.cpp            \
+    src/benchmark.cpp       \
+    src/microbench.cpp      \
@@ -0,0 +1,183 @@
+#include "benchmark.h"
+
+// STL includes.
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    /// Whether allocations are currently being counted.
+    std::atomic<bool> g_counting_enabled(false);
+
+    /// Number of allocations counted.
+    std::atomic<std::uint64_t> g_allocation_count(0);
+
+    /// Number of bytes requested.
+    std::atomic<std::uint64_t> g_allocation_bytes(0);
+
+    inline void countAllocation(const std::size_t size)
+    {
+        // Only count while enabled (keeps start-up/report allocations out of the numbers).
+        if (g_counting_enabled.load(std::memory_order_relaxed))
+        {
+            g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+            g_allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+        }
+    }
+}
+
+#if defined(__GLIBC__)
+// Interpose the malloc family, this also captures operator new and Qt's own allocations.
+extern "C"
+{
+    void* __libc_malloc(std::size_t size);
+    void* __libc_calloc(std::size_t count, std::size_t size);
+    void* __libc_realloc(void* ptr, std::size_t size);
+    void __libc_free(void* ptr);
+
+    void* malloc(std::size_t size) noexcept
+    {
+        countAllocation(size);
+        return __libc_malloc(size);
+    }
+
+    void* calloc(std::size_t count, std::size_t size) noexcept
+    {
+        countAllocation(count * size);
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* ptr, std::size_t size) noexcept
+    {
+        countAllocation(size);
+        return __libc_realloc(ptr, size);
+    }
+
+    void free(void* ptr) noexcept
+    {
+        __libc_free(ptr);
+    }
+}
+#else
+// Fall back to counting operator new only.
+void* operator new(std::size_t size)
+{
+    countAllocation(size);
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+#endif
+
+namespace benchmark
+{
+    void AllocationCounter::setEnabled(const bool enabled)
+    {
+        g_counting_enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    AllocationStats AllocationCounter::snapshot()
+    {
+        AllocationStats stats;
+        stats.count = g_allocation_count.load(std::memory_order_relaxed);
+        stats.bytes = g_allocation_bytes.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void Measurement::start()
+    {
+        // Capture the allocation counter before the clock, so counting is not timed.
+        m_allocations_started = AllocationCounter::snapshot();
+        m_started = std::chrono::steady_clock::now();
+    }
+
+    void Measurement::stop()
+    {
+        // Capture the clock before the allocation counter, so counting is not timed.
+        const auto stopped = std::chrono::steady_clock::now();
+        const AllocationStats allocations = AllocationCounter::snapshot();
+
+        // Accumulate.
+        m_elapsed_ns += std::chrono::duration<double, std::nano>(stopped - m_started).count();
+        m_allocations.count += allocations.count - m_allocations_started.count;
+        m_allocations.bytes += allocations.bytes - m_allocations_started.bytes;
+    }
+
+    QJsonObject Result::toJson() const
+    {
+        QJsonObject object;
+        object["suite"] = suite;
+        object["name"] = name;
+        object["dataset"] = dataset;
+        object["size"] = double(size);
+        object["operations"] = double(operations);
+        object["iterations"] = iterations;
+        object["ns_per_op"] = ns_per_op;
+        object["allocs_per_op"] = allocs_per_op;
+        object["bytes_per_op"] = bytes_per_op;
+        object["ops_per_sec"] = ops_per_sec;
+        return object;
+    }
+
+    Result run(const Case& bench_case, const int iterations, const std::function<void(Measurement&)>& body)
+    {
+        // Per-iteration nanoseconds per operation.
+        std::vector<double> ns_per_op;
+        ns_per_op.reserve(std::size_t(std::max(iterations, 1)));
+
+        // Total allocations over all iterations.
+        AllocationStats allocations;
+
+        // Run the body the requested number of times.
+        AllocationCounter::setEnabled(true);
+        for (int i = 0; i < std::max(iterations, 1); ++i)
+        {
+            Measurement measurement;
+            body(measurement);
+
+            ns_per_op.push_back(measurement.elapsedNs() / double(std::max<std::uint64_t>(bench_case.operations, 1)));
+            allocations.count += measurement.allocations().count;
+            allocations.bytes += measurement.allocations().bytes;
+        }
+        AllocationCounter::setEnabled(false);
+
+        // Use the median to be robust against the odd slow iteration.
+        std::sort(ns_per_op.begin(), ns_per_op.end());
+        const double median_ns = ns_per_op[ns_per_op.size() / 2];
+        const double total_ops = double(std::max<std::uint64_t>(bench_case.operations, 1)) * double(ns_per_op.size());
+
+        // Summarise.
+        Result result;
+        result.suite = bench_case.suite;
+        result.name = bench_case.name;
+        result.dataset = bench_case.dataset;
+        result.size = bench_case.size;
+        result.operations = bench_case.operations;
+        result.iterations = int(ns_per_op.size());
+        result.ns_per_op = median_ns;
+        result.allocs_per_op = double(allocations.count) / total_ops;
+        result.bytes_per_op = double(allocations.bytes) / total_ops;
+        result.ops_per_sec = median_ns > 0.0 ? 1.0e9 / median_ns : 0.0;
+        return result;
+    }
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+// Qt includes.
+#include <QtCore/QJsonObject>
+#include <QtCore/QString>
+
+// STL includes.
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/*!
+ * Minimal benchmark harness shared by the QMapControl benchmarks.
+ *
+ * A benchmark body receives a Measurement and brackets the code to be measured with
+ * start()/stop(), so that setup and tear-down work (building datasets, destroying large
+ * containers) is excluded from the reported numbers.
+ */
+namespace benchmark
+{
+    //! Heap allocation statistics captured between two points in time.
+    struct AllocationStats
+    {
+        /// Number of allocations (malloc/calloc/realloc/operator new).
+        std::uint64_t count = 0;
+
+        /// Number of bytes requested.
+        std::uint64_t bytes = 0;
+    };
+
+    //! Process wide heap allocation counter.
+    /*!
+     * On glibc the malloc family is interposed (which also covers operator new and Qt's
+     * container allocations), elsewhere only operator new/delete are counted.
+     */
+    class AllocationCounter
+    {
+    public:
+        /*!
+         * Enable/disable counting for the whole process.
+         * @param enabled Whether allocations should be counted.
+         */
+        static void setEnabled(const bool enabled);
+
+        /*!
+         * Fetch the allocations counted so far.
+         * @return the allocation statistics.
+         */
+        static AllocationStats snapshot();
+    };
+
+    //! Accumulates time and allocations between start()/stop() pairs.
+    class Measurement
+    {
+    public:
+        /*!
+         * Start (or resume) measuring.
+         */
+        void start();
+
+        /*!
+         * Stop (or pause) measuring.
+         */
+        void stop();
+
+        /*!
+         * Fetch the measured time in nanoseconds.
+         * @return the measured time in nanoseconds.
+         */
+        double elapsedNs() const { return m_elapsed_ns; }
+
+        /*!
+         * Fetch the allocations made while measuring.
+         * @return the allocation statistics.
+         */
+        const AllocationStats& allocations() const { return m_allocations; }
+
+    private:
+        /// Time point of the last start().
+        std::chrono::steady_clock::time_point m_started;
+
+        /// Allocation counter at the last start().
+        AllocationStats m_allocations_started;
+
+        /// Accumulated time in nanoseconds.
+        double m_elapsed_ns = 0.0;
+
+        /// Accumulated allocations.
+        AllocationStats m_allocations;
+    };
+
+    //! A single benchmark result row.
+    struct Result
+    {
+        /// The suite the benchmark belongs to (eg: "quadtree").
+        QString suite;
+
+        /// The benchmark name (eg: "insert").
+        QString name;
+
+        /// The dataset used (eg: "uniform").
+        QString dataset;
+
+        /// The dataset size.
+        std::uint64_t size = 0;
+
+        /// The number of operations measured per iteration.
+        std::uint64_t operations = 0;
+
+        /// The number of iterations run.
+        int iterations = 0;
+
+        /// Median nanoseconds per operation.
+        double ns_per_op = 0.0;
+
+        /// Heap allocations per operation.
+        double allocs_per_op = 0.0;
+
+        /// Heap bytes requested per operation.
+        double bytes_per_op = 0.0;
+
+        /// Operations per second (derived from the median).
+        double ops_per_sec = 0.0;
+
+        /*!
+         * Convert the result to JSON.
+         * @return the JSON object.
+         */
+        QJsonObject toJson() const;
+    };
+
+    //! Describes what is being measured.
+    struct Case
+    {
+        /// The suite the benchmark belongs to.
+        QString suite;
+
+        /// The benchmark name.
+        QString name;
+
+        /// The dataset used.
+        QString dataset;
+
+        /// The dataset size.
+        std::uint64_t size;
+
+        /// The number of operations performed by one call of the body.
+        std::uint64_t operations;
+    };
+
+    /*!
+     * Run a benchmark body several times and summarise the measurements.
+     * @param bench_case What is being measured.
+     * @param iterations The number of times to call the body.
+     * @param body The benchmark body, it must call Measurement::start()/stop().
+     * @return the summarised result.
+     */
+    Result run(const Case& bench_case, const int iterations, const std::function<void(Measurement&)>& body);
+
+    /*!
+     * Prevent the compiler from optimising away a computed value.
+     * @param value The value to keep alive.
+     */
+    template <typename T>
+    inline void doNotOptimize(const T& value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "g"(&value) : "memory");
+#else
+        static volatile const void* sink;
+        sink = &value;
+#endif
+    }
+}
@@ -0,0 +1,116 @@
+// Qt includes.
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QDateTime>
+#include <QtCore/QFile>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QSysInfo>
+#include <QtCore/QTextStream>
+#include <QtWidgets/QApplication>
+
+// Local includes.
+#include "microbench.h"
+
+int main(int argc, char *argv[])
+{
+    // Run without a display unless told otherwise.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    // Create a QApplication (pixmaps require a gui application).
+    QApplication app(argc, argv);
+    app.setApplicationName("QMapControl Microbench");
+
+    // Setup the command line options.
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Micro-benchmarks for the QMapControl hot paths.");
+    parser.addHelpOption();
+    const QCommandLineOption option_max_size("max-size", "Largest dataset size to run (1000 to 10000000).", "size", "1000000");
+    const QCommandLineOption option_iterations("iterations", "Iterations per benchmark.", "count", "5");
+    const QCommandLineOption option_seed("seed", "Dataset seed.", "seed", QString::number(datasets::kDefaultSeed));
+    const QCommandLineOption option_filter("filter", "Only run benchmarks whose suite/name matches this regular expression.", "regex");
+    const QCommandLineOption option_format("format", "Output format: json or csv.", "format", "json");
+    const QCommandLineOption option_output("output", "Write the results to this file instead of stdout.", "file");
+    parser.addOptions({ option_max_size, option_iterations, option_seed, option_filter, option_format, option_output });
+    parser.process(app);
+
+    // Build the configuration.
+    Microbench::Config config;
+    config.max_size = parser.value(option_max_size).toULongLong();
+    config.iterations = parser.value(option_iterations).toInt();
+    config.seed = parser.value(option_seed).toULongLong(nullptr, 0);
+    config.filter = QRegularExpression(parser.value(option_filter));
+    if (!config.filter.isValid())
+    {
+        QTextStream(stderr) << "Invalid filter: " << config.filter.errorString() << "\n";
+        return 1;
+    }
+
+    // Run the benchmarks.
+    const std::vector<benchmark::Result> results = Microbench(config).run();
+
+    // Format the results.
+    QByteArray output;
+    if (parser.value(option_format) == "csv")
+    {
+        output += "suite,name,dataset,size,operations,iterations,ns_per_op,allocs_per_op,bytes_per_op,ops_per_sec\n";
+        for (const auto& result : results)
+        {
+            output += QString("%1,%2,%3,%4,%5,%6,%7,%8,%9,%10\n")
+                      .arg(result.suite, result.name, result.dataset)
+                      .arg(result.size)
+                      .arg(result.operations)
+                      .arg(result.iterations)
+                      .arg(result.ns_per_op, 0, 'f', 3)
+                      .arg(result.allocs_per_op, 0, 'f', 4)
+                      .arg(result.bytes_per_op, 0, 'f', 2)
+                      .arg(result.ops_per_sec, 0, 'f', 1)
+                      .toUtf8();
+        }
+    }
+    else
+    {
+        // Include enough metadata to compare runs.
+        QJsonObject metadata;
+        metadata["qt_version"] = QString(qVersion());
+        metadata["cpu_architecture"] = QSysInfo::currentCpuArchitecture();
+        metadata["os"] = QSysInfo::prettyProductName();
+        metadata["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+        metadata["seed"] = QString::number(config.seed);
+        metadata["max_size"] = double(config.max_size);
+        metadata["iterations"] = config.iterations;
+
+        QJsonArray json_results;
+        for (const auto& result : results)
+        {
+            json_results.append(result.toJson());
+        }
+
+        QJsonObject root;
+        root["metadata"] = metadata;
+        root["results"] = json_results;
+        output = QJsonDocument(root).toJson(QJsonDocument::Indented);
+    }
+
+    // Write the results.
+    if (parser.isSet(option_output))
+    {
+        QFile file(parser.value(option_output));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            QTextStream(stderr) << "Unable to write to " << file.fileName() << "\n";
+            return 1;
+        }
+        file.write(output);
+    }
+    else
+    {
+        QTextStream(stdout) << output;
+    }
+
+    // Success.
+    return 0;
+}
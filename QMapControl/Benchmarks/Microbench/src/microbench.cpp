@@ -0,0 +1,475 @@
+#include "microbench.h"
+
+// Qt includes.
+#include <QtCore/QBuffer>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QTextStream>
+#include <QtGui/QImage>
+#include <QtGui/QPainter>
+
+// STL includes.
+#include <memory>
+#include <set>
+
+// QMapControl includes.
+#include <QMapControl/GeometryLineString.h>
+#include <QMapControl/GeometryPoint.h>
+#include <QMapControl/ImageManager.h>
+#include <QMapControl/LayerGeometry.h>
+#include <QMapControl/MapAdapterTile.h>
+#include <QMapControl/Projection.h>
+#include <QMapControl/QuadTreeContainer.h>
+
+namespace
+{
+    /// The dataset sizes (1k to 10M).
+    const std::uint64_t kSizes[] = { 1000, 10000, 100000, 1000000, 10000000 };
+
+    /// Quad tree node capacity (same as LayerGeometry).
+    const size_t kQuadTreeCapacity = 50;
+
+    /// Number of range queries per query benchmark.
+    const std::size_t kQueryCount = 1000;
+
+    /// Number of distinct payload objects for point datasets.
+    const std::size_t kPointPayloadCount = 1024;
+
+    /// Largest ImageManager working set (every entry is a decoded pixmap).
+    const std::uint64_t kImageManagerMaxSize = 100000;
+
+    /// Largest LayerGeometry scene (every geometry is a QObject).
+    const std::uint64_t kLayerGeometryMaxSize = 1000000;
+
+    /// Memory cache capacity used while benchmarking the ImageManager.
+    const int kImageManagerCacheMiB = 256;
+
+    /// Zoom used for the projection and tile query benchmarks.
+    const int kBenchmarkZoom = 15;
+
+    /// Backbuffer size used by the draw benchmarks.
+    const int kBackbufferSizePx = 2048;
+
+    /// The world boundary used by LayerGeometry.
+    RectWorldCoord worldBoundary()
+    {
+        return RectWorldCoord(PointWorldCoord(-180.0, 90.0), PointWorldCoord(180.0, -90.0));
+    }
+
+    /// Tile provider that returns the same (tiny) encoded image for every url.
+    class StaticTileProvider : public ITileProvider
+    {
+    public:
+        StaticTileProvider()
+        {
+            // Encode a tiny image, so decoding/caching is cheap and we measure the lookup path.
+            QImage image(8, 8, QImage::Format_ARGB32);
+            image.fill(Qt::darkCyan);
+            QBuffer buffer(&m_data);
+            buffer.open(QIODevice::WriteOnly);
+            image.save(&buffer, "PNG");
+        }
+
+        bool getTileData(const QUrl& /*url*/, QByteArray& data) override
+        {
+            data = m_data;
+            return true;
+        }
+
+    private:
+        /// The encoded image.
+        QByteArray m_data;
+    };
+
+    /// The tile url template used by the benchmarks.
+    std::shared_ptr<MapAdapterTile> benchmarkMapAdapter()
+    {
+        return std::make_shared<MapAdapterTile>(QUrl("http://tile.example.com/%zoom/%x/%y.png"),
+                                                std::set<projection::EPSG>{ projection::EPSG::SphericalMercator });
+    }
+}
+
+Microbench::Microbench(const Config& config)
+    : m_config(config)
+{
+
+}
+
+std::vector<benchmark::Result> Microbench::run()
+{
+    // Run each suite.
+    runQuadTree();
+    runProjection();
+    runImageManager();
+    runMapAdapter();
+    runLayerGeometry();
+
+    // Return the results.
+    return m_results;
+}
+
+bool Microbench::enabled(const QString& suite, const QString& name) const
+{
+    // An empty filter matches everything.
+    return m_config.filter.pattern().isEmpty() || m_config.filter.match(suite + "/" + name).hasMatch();
+}
+
+std::vector<std::uint64_t> Microbench::sizes(const std::uint64_t suite_max_size) const
+{
+    std::vector<std::uint64_t> return_sizes;
+    for (const auto size : kSizes)
+    {
+        if (size <= m_config.max_size && size <= suite_max_size)
+        {
+            return_sizes.push_back(size);
+        }
+    }
+    return return_sizes;
+}
+
+void Microbench::record(const benchmark::Result& result)
+{
+    // Log a human readable line (stdout is reserved for the machine readable output).
+    QTextStream(stderr) << QString("%1/%2 [%3, %4]: %5 ns/op, %6 allocs/op, %7 ops/s\n")
+                           .arg(result.suite, result.name, result.dataset)
+                           .arg(result.size)
+                           .arg(result.ns_per_op, 0, 'f', 1)
+                           .arg(result.allocs_per_op, 0, 'f', 2)
+                           .arg(result.ops_per_sec, 0, 'g', 4);
+
+    // Store the result.
+    m_results.push_back(result);
+}
+
+void Microbench::runQuadTree()
+{
+    const QString suite("quadtree");
+    if (!enabled(suite, "insert") && !enabled(suite, "query_1deg") && !enabled(suite, "query_10deg"))
+    {
+        return;
+    }
+
+    for (const auto distribution : { datasets::Distribution::Uniform, datasets::Distribution::Clustered, datasets::Distribution::LineHeavy })
+    {
+        for (const auto size : sizes(kSizes[4]))
+        {
+            const datasets::Dataset dataset(datasets::generate(distribution, size, m_config.seed));
+            const int iterations = size >= 1000000 ? 1 : m_config.iterations;
+
+            // Build the payload of each point (lines share one geometry across their vertices).
+            std::vector<std::shared_ptr<Geometry>> payloads;
+            std::vector<std::size_t> payload_index;
+            payload_index.reserve(dataset.points.size());
+            if (dataset.lines.empty())
+            {
+                for (std::size_t i = 0; i < kPointPayloadCount; ++i)
+                {
+                    payloads.push_back(std::make_shared<GeometryPoint>(dataset.points[i % dataset.points.size()]));
+                }
+                for (std::size_t i = 0; i < dataset.points.size(); ++i)
+                {
+                    payload_index.push_back(i % kPointPayloadCount);
+                }
+            }
+            else
+            {
+                for (const auto& line : dataset.lines)
+                {
+                    payloads.push_back(std::make_shared<GeometryLineString>(line));
+                    payload_index.insert(payload_index.end(), line.size(), payloads.size() - 1);
+                }
+            }
+
+            // Insert.
+            if (enabled(suite, "insert"))
+            {
+                record(benchmark::run({ suite, "insert", dataset.name, size, dataset.points.size() }, iterations, [&](benchmark::Measurement& measurement)
+                {
+                    std::unique_ptr<QuadTreeContainer> container(new QuadTreeContainer(kQuadTreeCapacity, worldBoundary()));
+
+                    measurement.start();
+                    for (std::size_t i = 0; i < dataset.points.size(); ++i)
+                    {
+                        container->insert(dataset.points[i], payloads[payload_index[i]]);
+                    }
+                    measurement.stop();
+                }));
+            }
+
+            // Query (small and large viewports).
+            if (enabled(suite, "query_1deg") || enabled(suite, "query_10deg"))
+            {
+                QuadTreeContainer container(kQuadTreeCapacity, worldBoundary());
+                for (std::size_t i = 0; i < dataset.points.size(); ++i)
+                {
+                    container.insert(dataset.points[i], payloads[payload_index[i]]);
+                }
+
+                for (const auto span : { 1.0, 10.0 })
+                {
+                    const QString name(QString("query_%1deg").arg(span));
+                    if (!enabled(suite, name))
+                    {
+                        continue;
+                    }
+
+                    const std::vector<RectWorldCoord> rects(datasets::generateRects(kQueryCount, span, m_config.seed));
+                    record(benchmark::run({ suite, name, dataset.name, size, rects.size() }, iterations, [&](benchmark::Measurement& measurement)
+                    {
+                        std::set<std::shared_ptr<Geometry>> results;
+
+                        measurement.start();
+                        for (const auto& rect : rects)
+                        {
+                            results.clear();
+                            container.query(results, rect);
+                            benchmark::doNotOptimize(results);
+                        }
+                        measurement.stop();
+                    }));
+                }
+            }
+        }
+    }
+}
+
+void Microbench::runProjection()
+{
+    const QString suite("projection");
+
+    // The projections to benchmark.
+    const std::vector<std::pair<QString, projection::EPSG>> projections = {
+        { "equirectangular", projection::EPSG::Equirectangular },
+        { "spherical_mercator", projection::EPSG::SphericalMercator },
+        { "world_mercator", projection::EPSG::WorldMercator },
+    };
+
+    for (const auto& entry : projections)
+    {
+        const QString name_px(entry.first + "/toPointWorldPx");
+        const QString name_coord(entry.first + "/toPointWorldCoord");
+        if (!enabled(suite, name_px) && !enabled(suite, name_coord))
+        {
+            continue;
+        }
+
+        // Switch to the projection.
+        projection::set(entry.second);
+
+        for (const auto size : sizes(kSizes[4]))
+        {
+            const datasets::Dataset dataset(datasets::generate(datasets::Distribution::Uniform, size, m_config.seed));
+            const int iterations = size >= 1000000 ? 1 : m_config.iterations;
+
+            // Pre-size the outputs, so only the conversion is measured.
+            std::vector<PointWorldPx> points_px(dataset.points.size());
+            std::vector<PointWorldCoord> points_coord(dataset.points.size());
+
+            if (enabled(suite, name_px))
+            {
+                record(benchmark::run({ suite, name_px, dataset.name, size, dataset.points.size() }, iterations, [&](benchmark::Measurement& measurement)
+                {
+                    const Projection& current = projection::get();
+
+                    measurement.start();
+                    for (std::size_t i = 0; i < dataset.points.size(); ++i)
+                    {
+                        points_px[i] = current.toPointWorldPx(dataset.points[i], kBenchmarkZoom);
+                    }
+                    measurement.stop();
+
+                    benchmark::doNotOptimize(points_px);
+                }));
+            }
+
+            if (enabled(suite, name_coord))
+            {
+                // Make sure we have pixel points to convert back.
+                for (std::size_t i = 0; i < dataset.points.size(); ++i)
+                {
+                    points_px[i] = projection::get().toPointWorldPx(dataset.points[i], kBenchmarkZoom);
+                }
+
+                record(benchmark::run({ suite, name_coord, dataset.name, size, dataset.points.size() }, iterations, [&](benchmark::Measurement& measurement)
+                {
+                    const Projection& current = projection::get();
+
+                    measurement.start();
+                    for (std::size_t i = 0; i < points_px.size(); ++i)
+                    {
+                        points_coord[i] = current.toPointWorldCoord(points_px[i], kBenchmarkZoom);
+                    }
+                    measurement.stop();
+
+                    benchmark::doNotOptimize(points_coord);
+                }));
+            }
+        }
+    }
+
+    // Restore the default projection.
+    projection::set(projection::kDefaultEpsg);
+}
+
+void Microbench::runImageManager()
+{
+    const QString suite("image_manager");
+    if (!enabled(suite, "getImage_hit"))
+    {
+        return;
+    }
+
+    // Serve every tile from memory via a custom provider (no network, no disk).
+    StaticTileProvider provider;
+    ImageManager::get().setCustomTileProvider(&provider);
+    ImageManager::get().setMemoryCacheCapacity(kImageManagerCacheMiB);
+
+    const auto map_adapter = benchmarkMapAdapter();
+
+    for (const auto size : sizes(kImageManagerMaxSize))
+    {
+        // Generate the tile urls (random tiles at a high zoom).
+        datasets::Random random(m_config.seed);
+        const int tiles = projection::get().tilesX(kBenchmarkZoom);
+        std::vector<QUrl> urls;
+        urls.reserve(size);
+        for (std::uint64_t i = 0; i < size; ++i)
+        {
+            urls.push_back(map_adapter->tileQuery(random.uniformInt(0, tiles - 1), random.uniformInt(0, tiles - 1), kBenchmarkZoom));
+        }
+
+        // Warm the memory cache (the provider is called in the background, wait for its tiles).
+        for (const auto& url : urls)
+        {
+            benchmark::doNotOptimize(ImageManager::get().getImage(url));
+        }
+        while (ImageManager::get().providerQueueSize() > 0)
+        {
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+        }
+
+        // Measure the hits.
+        record(benchmark::run({ suite, "getImage_hit", "uniform", size, urls.size() }, m_config.iterations, [&](benchmark::Measurement& measurement)
+        {
+            measurement.start();
+            for (const auto& url : urls)
+            {
+                const QPixmap pixmap(ImageManager::get().getImage(url));
+                benchmark::doNotOptimize(pixmap);
+            }
+            measurement.stop();
+        }));
+    }
+
+    // Restore the default tile provider.
+    ImageManager::get().setCustomTileProvider(nullptr);
+}
+
+void Microbench::runMapAdapter()
+{
+    const QString suite("map_adapter");
+    if (!enabled(suite, "tileQuery"))
+    {
+        return;
+    }
+
+    const auto map_adapter = benchmarkMapAdapter();
+
+    for (const auto size : sizes(kSizes[4]))
+    {
+        // Generate the tile indexes.
+        datasets::Random random(m_config.seed);
+        const int tiles = projection::get().tilesX(kBenchmarkZoom);
+        std::vector<std::pair<int, int>> indexes;
+        indexes.reserve(size);
+        for (std::uint64_t i = 0; i < size; ++i)
+        {
+            indexes.emplace_back(random.uniformInt(0, tiles - 1), random.uniformInt(0, tiles - 1));
+        }
+
+        record(benchmark::run({ suite, "tileQuery", "uniform", size, indexes.size() }, size >= 1000000 ? 1 : m_config.iterations, [&](benchmark::Measurement& measurement)
+        {
+            measurement.start();
+            for (const auto& index : indexes)
+            {
+                const QUrl url(map_adapter->tileQuery(index.first, index.second, kBenchmarkZoom));
+                benchmark::doNotOptimize(url);
+            }
+            measurement.stop();
+        }));
+    }
+}
+
+void Microbench::runLayerGeometry()
+{
+    const QString suite("layer_geometry");
+    if (!enabled(suite, "draw_world") && !enabled(suite, "draw_viewport"))
+    {
+        return;
+    }
+
+    for (const auto distribution : { datasets::Distribution::Uniform, datasets::Distribution::Clustered, datasets::Distribution::LineHeavy })
+    {
+        for (const auto size : sizes(kLayerGeometryMaxSize))
+        {
+            const datasets::Dataset dataset(datasets::generate(distribution, size, m_config.seed));
+            const int iterations = size >= 1000000 ? 1 : m_config.iterations;
+
+            // Build the scene (points, or one line string per line).
+            LayerGeometry layer("benchmark");
+            if (dataset.lines.empty())
+            {
+                for (const auto& point : dataset.points)
+                {
+                    layer.addGeometry(std::make_shared<GeometryPoint>(point), true);
+                }
+            }
+            else
+            {
+                for (const auto& line : dataset.lines)
+                {
+                    layer.addGeometry(std::make_shared<GeometryLineString>(line), true);
+                }
+            }
+
+            // The backbuffer to draw to.
+            QImage backbuffer(kBackbufferSizePx, kBackbufferSizePx, QImage::Format_ARGB32_Premultiplied);
+
+            // Draw the whole world (zoom 3 is 2048px wide).
+            if (enabled(suite, "draw_world"))
+            {
+                const RectWorldPx backbuffer_rect_px(PointWorldPx(0.0, 0.0), PointWorldPx(kBackbufferSizePx, kBackbufferSizePx));
+                record(benchmark::run({ suite, "draw_world", dataset.name, size, 1 }, iterations, [&](benchmark::Measurement& measurement)
+                {
+                    backbuffer.fill(Qt::transparent);
+                    QPainter painter(&backbuffer);
+
+                    measurement.start();
+                    layer.draw(painter, backbuffer_rect_px, 3);
+                    measurement.stop();
+                }));
+            }
+
+            // Draw a viewport centred on the dataset (zoom 10).
+            if (enabled(suite, "draw_viewport"))
+            {
+                const int zoom = 10;
+                const PointWorldPx centre_px(projection::get().toPointWorldPx(dataset.points[dataset.points.size() / 2], zoom));
+                const PointPx half_size_px(kBackbufferSizePx / 2.0, kBackbufferSizePx / 2.0);
+                const RectWorldPx backbuffer_rect_px(centre_px - half_size_px, centre_px + half_size_px);
+                record(benchmark::run({ suite, "draw_viewport", dataset.name, size, 1 }, iterations, [&](benchmark::Measurement& measurement)
+                {
+                    backbuffer.fill(Qt::transparent);
+                    QPainter painter(&backbuffer);
+                    painter.translate(-backbuffer_rect_px.topLeftPx().rawPoint());
+
+                    measurement.start();
+                    layer.draw(painter, backbuffer_rect_px, zoom);
+                    measurement.stop();
+                }));
+            }
+
+            // Tear down outside of any measurement.
+            layer.clearGeometries();
+        }
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+// Qt includes.
+#include <QtCore/QRegularExpression>
+#include <QtCore/QString>
+
+// STL includes.
+#include <cstdint>
+#include <vector>
+
+// Local includes.
+#include "benchmark.h"
+#include "datasets.h"
+
+/*!
+ * Micro-benchmarks for the library's hot paths:
+ *  - quadtree:      QuadTreeContainer::insert/query.
+ *  - projection:    Projection*::toPointWorldPx/toPointWorldCoord.
+ *  - image_manager: ImageManager::getImage memory cache hits (hashTileUrl included).
+ *  - map_adapter:   MapAdapterTile::tileQuery.
+ *  - layer_geometry: LayerGeometry::draw on synthetic scenes.
+ */
+class Microbench
+{
+public:
+    //! Benchmark configuration.
+    struct Config
+    {
+        /// The largest dataset size to run (sizes are 1k, 10k, 100k, 1M and 10M).
+        std::uint64_t max_size = 1000000;
+
+        /// The number of iterations per benchmark.
+        int iterations = 5;
+
+        /// The dataset seed.
+        std::uint64_t seed = datasets::kDefaultSeed;
+
+        /// Only run benchmarks whose "suite/name" matches this expression.
+        QRegularExpression filter;
+    };
+
+public:
+    /*!
+     * Construct the micro-benchmarks.
+     * @param config The configuration to use.
+     */
+    explicit Microbench(const Config& config);
+
+    /*!
+     * Run all (matching) benchmarks.
+     * @return the results.
+     */
+    std::vector<benchmark::Result> run();
+
+private:
+    /*!
+     * Whether a benchmark should run.
+     * @param suite The benchmark suite.
+     * @param name The benchmark name.
+     * @return whether the benchmark matches the filter.
+     */
+    bool enabled(const QString& suite, const QString& name) const;
+
+    /*!
+     * The dataset sizes to run for a suite.
+     * @param suite_max_size The largest size the suite supports.
+     * @return the sizes.
+     */
+    std::vector<std::uint64_t> sizes(const std::uint64_t suite_max_size) const;
+
+    /*!
+     * Record (and log) a result.
+     * @param result The result.
+     */
+    void record(const benchmark::Result& result);
+
+    /// Benchmark QuadTreeContainer::insert/query.
+    void runQuadTree();
+
+    /// Benchmark the projections.
+    void runProjection();
+
+    /// Benchmark ImageManager::getImage cache hits.
+    void runImageManager();
+
+    /// Benchmark MapAdapterTile::tileQuery.
+    void runMapAdapter();
+
+    /// Benchmark LayerGeometry::draw.
+    void runLayerGeometry();
+
+private:
+    /// The configuration.
+    const Config m_config;
+
+    /// The results so far.
+    std::vector<benchmark::Result> m_results;
+};
@@ -0,0 +1,25 @@
+# Include benchmark configurations.
+include(../Benchmarks.pri)
+
+# Target name.
+TARGET = TileNetwork
+
+# Target version.
+VERSION = 0.1
+
+# Build an application.
+TEMPLATE = app
+
+# Console application (results are written to stdout).
+CONFIG += console
+
+# Add header files.
+HEADERS +=                  \
+    src/tilenetwork.h       \
+    src/tileserver.h        \
+
+# Add source files.
+SOURCES +=                  \
+    src/main.cpp            \
+    src/tilenetwork.cpp     \
+    src/tileserver.cpp      \
@@ -0,0 +1,127 @@
+// Qt includes.
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QDateTime>
+#include <QtCore/QFile>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QSysInfo>
+#include <QtCore/QTextStream>
+#include <QtWidgets/QApplication>
+
+// STL includes.
+#include <algorithm>
+
+// QMapControl includes.
+#include <QMapControl/ImageManager.h>
+
+// Local includes.
+#include "tilenetwork.h"
+
+int main(int argc, char *argv[])
+{
+    // Run without a display unless told otherwise.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    // Create a QApplication (pixmaps require a gui application).
+    QApplication app(argc, argv);
+    app.setApplicationName("QMapControl TileNetwork");
+
+    // Setup the command line options.
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Tile network throughput benchmark against a local simulated tile server.");
+    parser.addHelpOption();
+    const QCommandLineOption option_latency("latency-ms", "Server latency per request.", "ms", "40");
+    const QCommandLineOption option_jitter("jitter-ms", "Server latency jitter (+/-).", "ms", "20");
+    const QCommandLineOption option_bandwidth("bandwidth-kib", "Bandwidth per connection in KiB/s (0 for unlimited).", "kib", "0");
+    const QCommandLineOption option_error_rate("error-rate", "Fraction of requests answered with 503 (0.0 to 1.0).", "rate", "0");
+    const QCommandLineOption option_hosts("hosts", "Number of tile hosts (sub-domains).", "count", "3");
+    const QCommandLineOption option_slow_hosts("slow-hosts", "Number of slow hosts.", "count", "0");
+    const QCommandLineOption option_slow_factor("slow-factor", "How much slower the slow hosts are.", "factor", "4");
+    const QCommandLineOption option_tile_kib("tile-kib", "Tile payload size in KiB.", "kib", "24");
+    const QCommandLineOption option_timeout("timeout-ms", "How long to wait for the final viewport to complete.", "ms", "30000");
+    const QCommandLineOption option_seed("seed", "Latency jitter and error seed.", "seed", "0");
+    const QCommandLineOption option_filter("filter", "Only run scenarios whose name matches this regular expression.", "regex");
+    const QCommandLineOption option_output("output", "Write the results to this file instead of stdout.", "file");
+    parser.addOptions({ option_latency, option_jitter, option_bandwidth, option_error_rate, option_hosts, option_slow_hosts,
+                        option_slow_factor, option_tile_kib, option_timeout, option_seed, option_filter, option_output });
+    parser.process(app);
+
+    // Build the configuration.
+    TileNetwork::Config config;
+    config.server.latency_ms = parser.value(option_latency).toInt();
+    config.server.jitter_ms = parser.value(option_jitter).toInt();
+    config.server.bandwidth_kib_s = parser.value(option_bandwidth).toInt();
+    config.server.error_rate = parser.value(option_error_rate).toDouble();
+    config.server.hosts = std::max(1, parser.value(option_hosts).toInt());
+    config.server.slow_hosts = parser.value(option_slow_hosts).toInt();
+    config.server.slow_factor = parser.value(option_slow_factor).toDouble();
+    config.server.tile_kib = parser.value(option_tile_kib).toInt();
+    config.server.seed = parser.value(option_seed).toULongLong(nullptr, 0);
+    config.timeout_ms = parser.value(option_timeout).toInt();
+    config.filter = QRegularExpression(parser.value(option_filter));
+    if (!config.filter.isValid())
+    {
+        QTextStream(stderr) << "Invalid filter: " << config.filter.errorString() << "\n";
+        return 1;
+    }
+
+    // Run the scenarios.
+    QJsonArray results;
+    {
+        TileNetwork benchmark(config);
+        if (benchmark.startServer() == false)
+        {
+            QTextStream(stderr) << "Unable to start the tile server\n";
+            return 1;
+        }
+        results = benchmark.run();
+    }
+
+    // Include enough metadata to compare runs.
+    QJsonObject metadata;
+    metadata["qt_version"] = QString(qVersion());
+    metadata["cpu_architecture"] = QSysInfo::currentCpuArchitecture();
+    metadata["os"] = QSysInfo::prettyProductName();
+    metadata["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    metadata["seed"] = QString::number(config.server.seed);
+    metadata["latency_ms"] = config.server.latency_ms;
+    metadata["jitter_ms"] = config.server.jitter_ms;
+    metadata["bandwidth_kib_s"] = config.server.bandwidth_kib_s;
+    metadata["error_rate"] = config.server.error_rate;
+    metadata["hosts"] = config.server.hosts;
+    metadata["slow_hosts"] = config.server.slow_hosts;
+    metadata["slow_factor"] = config.server.slow_factor;
+    metadata["tile_kib"] = config.server.tile_kib;
+    metadata["viewport"] = QString("%1x%2").arg(config.viewport_size.width()).arg(config.viewport_size.height());
+
+    QJsonObject root;
+    root["metadata"] = metadata;
+    root["results"] = results;
+    const QByteArray output(QJsonDocument(root).toJson(QJsonDocument::Indented));
+
+    // Ensure the image manager (and its network manager) goes before the application.
+    ImageManager::destroy();
+
+    // Write the results.
+    if (parser.isSet(option_output))
+    {
+        QFile file(parser.value(option_output));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            QTextStream(stderr) << "Unable to write to " << file.fileName() << "\n";
+            return 1;
+        }
+        file.write(output);
+    }
+    else
+    {
+        QTextStream(stdout) << output;
+    }
+
+    // Success.
+    return 0;
+}
@@ -0,0 +1,357 @@
+#include "tilenetwork.h"
+
+// Qt includes.
+#include <QtCore/QEventLoop>
+#include <QtCore/QTimer>
+
+// STL includes.
+#include <algorithm>
+#include <cmath>
+
+// QMapControl includes.
+#include <QMapControl/ImageManager.h>
+#include <QMapControl/Projection.h>
+
+namespace
+{
+    /// Number of tiles prefetched around the viewport (as LayerMapAdapter does).
+    const int kPrefetchTileExtent = 1;
+
+    /// Time given to the cancelled connections to close between scenarios.
+    const int kDrainMs = 250;
+
+    /// Pan a focus point by a number of pixels at a zoom.
+    PointWorldCoord panned(const PointWorldCoord& focus, const int zoom, const double dx_px, const double dy_px)
+    {
+        const PointWorldPx focus_px(projection::get().toPointWorldPx(focus, zoom));
+        return projection::get().toPointWorldCoord(PointWorldPx(focus_px.x() + dx_px, focus_px.y() + dy_px), zoom);
+    }
+
+    /// Convert nanoseconds to milliseconds.
+    double toMs(const qint64 ns)
+    {
+        return double(ns) / 1.0e6;
+    }
+}
+
+TileNetwork::TileNetwork(const Config& config)
+    : QObject(nullptr),
+      m_config(config),
+      m_server(config.server),
+      m_redraw_requested(false),
+      m_viewport_changed_ns(0),
+      m_first_visible_ns(-1),
+      m_frames_drawn(0),
+      m_tiles_failed(0)
+{
+    // Download every tile (no disk cache).
+    ImageManager::get().setCachePolicy(ImageManager::CachePolicy::AlwaysNetwork);
+    ImageManager::get().setMemoryCacheCapacity(m_config.memory_cache_mib);
+
+    // Use a loading placeholder we can recognise.
+    m_loading_pixmap = QPixmap(ImageManager::get().tileSizePx(), ImageManager::get().tileSizePx());
+    m_loading_pixmap.fill(Qt::lightGray);
+    ImageManager::get().setLoadingPixmap(m_loading_pixmap);
+
+    // Arrived tiles are available immediately (and trigger a redraw, as in QMapControl).
+    QObject::connect(&ImageManager::get(), &ImageManager::imageUpdated, this, [this](const QUrl& url)
+    {
+        markAvailable(url);
+        m_redraw_requested = true;
+    });
+
+    // Failed tiles are requested again by the next redraw.
+    QObject::connect(&ImageManager::get(), &ImageManager::imageDownloadFailed, this, [this]()
+    {
+        ++m_tiles_failed;
+        m_redraw_requested = true;
+    });
+
+    m_viewport.zoom = -1;
+}
+
+TileNetwork::~TileNetwork()
+{
+    // Cancel any download before the server goes.
+    ImageManager::get().abortLoading();
+}
+
+bool TileNetwork::startServer()
+{
+    // Start the server.
+    if (m_server.start() == false)
+    {
+        return false;
+    }
+
+    // Capture the host urls.
+    m_host_urls = m_server.hostUrls();
+    return true;
+}
+
+QJsonArray TileNetwork::run()
+{
+    QJsonArray return_results;
+    for (const auto& scenario : scenarios())
+    {
+        // Does the scenario match the filter?
+        if (m_config.filter.pattern().isEmpty() == false && m_config.filter.match(scenario.name).hasMatch() == false)
+        {
+            continue;
+        }
+
+        return_results.append(runScenario(scenario));
+    }
+    return return_results;
+}
+
+std::vector<TileNetwork::Scenario> TileNetwork::scenarios() const
+{
+    // Each scenario uses its own area, so no tile is shared between scenarios.
+    const double width_px = m_config.viewport_size.width();
+    std::vector<Scenario> return_scenarios;
+
+    // Cold viewport: a single viewport with nothing cached.
+    {
+        const PointWorldCoord london(-0.1276, 51.5072);
+        Scenario scenario;
+        scenario.name = "cold_viewport";
+        scenario.description = "Single viewport at zoom 12, nothing cached.";
+        scenario.keyframes = { Keyframe{ 0, london, 12 } };
+        return_scenarios.push_back(scenario);
+    }
+
+    // Pan sweep: pan east by 3 viewport widths over 3 seconds, then stop.
+    {
+        const PointWorldCoord paris(2.3522, 48.8566);
+        Scenario scenario;
+        scenario.name = "pan_sweep";
+        scenario.description = "Pan east by 3 viewport widths over 3s at zoom 14, then stop.";
+        scenario.keyframes = { Keyframe{ 0, paris, 14 }, Keyframe{ 3000, panned(paris, 14, width_px * 3.0, 0.0), 14 } };
+        return_scenarios.push_back(scenario);
+    }
+
+    // Zoom storm: zoom in a level every 150ms from 10 to 16, then back out to 13.
+    {
+        const PointWorldCoord berlin(13.4050, 52.5200);
+        Scenario scenario;
+        scenario.name = "zoom_storm";
+        scenario.description = "Zoom in a level every 150ms from 10 to 16, then out to 13.";
+        qint64 time_ms = 0;
+        for (int zoom = 10; zoom <= 16; ++zoom, time_ms += 150)
+        {
+            scenario.keyframes.push_back(Keyframe{ time_ms, berlin, zoom });
+        }
+        for (int zoom = 15; zoom >= 13; --zoom, time_ms += 150)
+        {
+            scenario.keyframes.push_back(Keyframe{ time_ms, berlin, zoom });
+        }
+        return_scenarios.push_back(scenario);
+    }
+
+    return return_scenarios;
+}
+
+QJsonObject TileNetwork::runScenario(const Scenario& scenario)
+{
+    // Start from empty caches and statistics.
+    ImageManager::get().abortLoading();
+    ImageManager::get().setMemoryCacheCapacity(0);
+    ImageManager::get().setMemoryCacheCapacity(m_config.memory_cache_mib);
+    m_server.resetStats();
+    m_viewport.zoom = -1;
+    m_visible_tiles.clear();
+    m_available.clear();
+    m_redraw_requested = false;
+    m_first_visible_ns = -1;
+    m_frames_drawn = 0;
+    m_tiles_failed = 0;
+
+    // Run the frames until the final viewport is complete (or the timeout).
+    const qint64 last_keyframe_ms = scenario.keyframes.back().time_ms;
+    qint64 complete_ns = -1;
+    QEventLoop loop;
+    QTimer frame_timer;
+    frame_timer.setTimerType(Qt::PreciseTimer);
+    frame_timer.setInterval(m_config.frame_interval_ms);
+    QObject::connect(&frame_timer, &QTimer::timeout, &loop, [&]()
+    {
+        const qint64 now_ms = m_clock.elapsed();
+
+        // Follow the keyframes.
+        const Viewport viewport(viewportAt(scenario, now_ms));
+        if (viewport.zoom != m_viewport.zoom || viewport.rect_px != m_viewport.rect_px)
+        {
+            // Zoom changes cancel the pending downloads (as QMapControl does).
+            if (m_viewport.zoom >= 0 && viewport.zoom != m_viewport.zoom)
+            {
+                ImageManager::get().abortLoading();
+            }
+
+            m_viewport = viewport;
+            m_viewport_changed_ns = m_clock.nsecsElapsed();
+            m_visible_tiles = tileUrls(m_viewport, 0, false);
+            m_available.clear();
+            m_redraw_requested = true;
+        }
+
+        // Draw the frame.
+        if (m_redraw_requested)
+        {
+            m_redraw_requested = false;
+            drawFrame();
+        }
+
+        // Is the final viewport complete?
+        if (now_ms >= last_keyframe_ms && m_available.size() == int(m_visible_tiles.size()))
+        {
+            complete_ns = m_clock.nsecsElapsed();
+            loop.quit();
+        }
+        else if (now_ms > last_keyframe_ms + m_config.timeout_ms)
+        {
+            loop.quit();
+        }
+    });
+
+    m_clock.start();
+    frame_timer.start();
+    loop.exec();
+    frame_timer.stop();
+
+    // Capture the server statistics, then cancel what is left (prefetches) and let it drain.
+    const TileServerStats stats(m_server.stats());
+    const qint64 end_ns = complete_ns >= 0 ? complete_ns : m_clock.nsecsElapsed();
+    ImageManager::get().abortLoading();
+    QEventLoop drain;
+    QTimer::singleShot(kDrainMs, &drain, &QEventLoop::quit);
+    drain.exec();
+
+    // Summarise.
+    const double duration_s = double(end_ns) / 1.0e9;
+    const qint64 bytes_wasted = stats.bytes_cancelled + stats.bytes_duplicate;
+    QJsonObject result;
+    result["name"] = scenario.name;
+    result["description"] = scenario.description;
+    result["complete"] = complete_ns >= 0;
+    result["duration_ms"] = toMs(end_ns);
+    result["frames_drawn"] = m_frames_drawn;
+    result["viewport_tiles"] = int(m_visible_tiles.size());
+    result["tiles_per_s"] = duration_s > 0.0 ? double(stats.tiles) / duration_s : 0.0;
+    result["time_to_first_visible_tile_ms"] = m_first_visible_ns >= 0 ? QJsonValue(toMs(m_first_visible_ns)) : QJsonValue();
+    result["time_to_complete_viewport_ms"] = complete_ns >= 0 ? QJsonValue(toMs(complete_ns - m_viewport_changed_ns)) : QJsonValue();
+    result["requests"] = stats.requests;
+    result["tiles_received"] = stats.tiles;
+    result["server_errors"] = stats.errors;
+    result["tiles_failed"] = m_tiles_failed;
+    result["requests_cancelled"] = stats.cancelled;
+    result["tiles_duplicate"] = stats.duplicates;
+    result["bytes_sent"] = double(stats.bytes_sent);
+    result["bytes_cancelled"] = double(stats.bytes_cancelled);
+    result["bytes_duplicate"] = double(stats.bytes_duplicate);
+    result["bytes_wasted"] = double(bytes_wasted);
+    result["wasted_ratio"] = stats.bytes_sent > 0 ? double(bytes_wasted) / double(stats.bytes_sent) : 0.0;
+    return result;
+}
+
+void TileNetwork::drawFrame()
+{
+    ++m_frames_drawn;
+
+    // Fetch the visible tiles (tiles not downloaded yet are requested by getImage()).
+    for (const auto& url : m_visible_tiles)
+    {
+        if (m_available.contains(url) == false && ImageManager::get().getImage(url).cacheKey() != m_loading_pixmap.cacheKey())
+        {
+            markAvailable(url);
+        }
+    }
+
+    // Prefetch the tiles around the viewport.
+    for (const auto& url : tileUrls(m_viewport, kPrefetchTileExtent, true))
+    {
+        ImageManager::get().prefetchImage(url);
+    }
+}
+
+void TileNetwork::markAvailable(const QUrl& url)
+{
+    // Only the tiles of the current viewport count.
+    if (m_available.contains(url) || std::find(m_visible_tiles.begin(), m_visible_tiles.end(), url) == m_visible_tiles.end())
+    {
+        return;
+    }
+
+    const qint64 now_ns = m_clock.nsecsElapsed();
+    m_available.insert(url, now_ns);
+    if (m_first_visible_ns < 0)
+    {
+        m_first_visible_ns = now_ns;
+    }
+}
+
+TileNetwork::Viewport TileNetwork::viewportAt(const Scenario& scenario, const qint64 time_ms) const
+{
+    // Find the keyframe in effect.
+    std::size_t index = 0;
+    while (index + 1 < scenario.keyframes.size() && scenario.keyframes[index + 1].time_ms <= time_ms)
+    {
+        ++index;
+    }
+    const Keyframe& keyframe = scenario.keyframes[index];
+    PointWorldPx focus_px(projection::get().toPointWorldPx(keyframe.focus, keyframe.zoom));
+
+    // Pan towards the next keyframe (at the same zoom).
+    if (index + 1 < scenario.keyframes.size() && scenario.keyframes[index + 1].zoom == keyframe.zoom)
+    {
+        const Keyframe& next = scenario.keyframes[index + 1];
+        const PointWorldPx next_px(projection::get().toPointWorldPx(next.focus, next.zoom));
+        const double progress = double(time_ms - keyframe.time_ms) / double(next.time_ms - keyframe.time_ms);
+        focus_px = PointWorldPx(std::round(focus_px.x() + (next_px.x() - focus_px.x()) * progress),
+                                std::round(focus_px.y() + (next_px.y() - focus_px.y()) * progress));
+    }
+
+    // Centre the viewport on the focus point.
+    const QSizeF size_px(m_config.viewport_size);
+    Viewport return_viewport;
+    return_viewport.zoom = keyframe.zoom;
+    return_viewport.rect_px = QRectF(QPointF(focus_px.x() - size_px.width() / 2.0, focus_px.y() - size_px.height() / 2.0), size_px);
+    return return_viewport;
+}
+
+std::vector<QUrl> TileNetwork::tileUrls(const Viewport& viewport, const int extent, const bool ring_only) const
+{
+    // Calculate the tiles covered (as LayerMapAdapter does).
+    const double tile_size_px = ImageManager::get().tileSizePx();
+    const int left = int(std::floor(viewport.rect_px.left() / tile_size_px));
+    const int top = int(std::floor(viewport.rect_px.top() / tile_size_px));
+    const int right = int(std::floor(viewport.rect_px.right() / tile_size_px));
+    const int bottom = int(std::floor(viewport.rect_px.bottom() / tile_size_px));
+
+    std::vector<QUrl> return_urls;
+    for (int x = left - extent; x <= right + extent; ++x)
+    {
+        for (int y = top - extent; y <= bottom + extent; ++y)
+        {
+            // Skip the inner tiles if only the ring is wanted.
+            if (ring_only && x >= left && x <= right && y >= top && y <= bottom)
+            {
+                continue;
+            }
+
+            // Check the tile is valid.
+            if (x >= 0 && y >= 0 && x < projection::get().tilesX(viewport.zoom) && y < projection::get().tilesY(viewport.zoom))
+            {
+                return_urls.push_back(tileUrl(x, y, viewport.zoom));
+            }
+        }
+    }
+    return return_urls;
+}
+
+QUrl TileNetwork::tileUrl(const int x, const int y, const int zoom) const
+{
+    // Spread the tiles over the hosts.
+    const QString& host_url = m_host_urls[std::size_t(x + y) % m_host_urls.size()];
+    return QUrl(QString("%1/%2/%3/%4.png").arg(host_url).arg(zoom).arg(x).arg(y));
+}
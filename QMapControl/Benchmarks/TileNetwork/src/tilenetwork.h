@@ -0,0 +1,214 @@
+#pragma once
+
+// Qt includes.
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonObject>
+#include <QtCore/QObject>
+#include <QtCore/QRectF>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QSize>
+#include <QtCore/QUrl>
+#include <QtGui/QPixmap>
+
+// STL includes.
+#include <memory>
+#include <vector>
+
+// QMapControl includes.
+#include <QMapControl/Point.h>
+
+// Local includes.
+#include "tileserver.h"
+
+using namespace qmapcontrol;
+
+/*!
+ * Drives ImageManager against the local TileServer through scripted fetch patterns and measures
+ * the tile pipeline (NetworkManager in-flight handling, cancellation and decoding):
+ *  - tiles/s: tiles received per second until the final viewport was complete.
+ *  - time-to-first-visible-tile: scenario start -> first tile of the current viewport available.
+ *  - time-to-complete-viewport: last viewport change -> all tiles of the final viewport available.
+ *  - wasted bytes: bytes sent for requests cancelled by the client and for tiles sent twice.
+ *
+ * Each frame (60Hz) the viewport follows the scenario's keyframes and - like LayerMapAdapter -
+ * the visible tiles are fetched with ImageManager::getImage() and a ring of tiles around them is
+ * prefetched. As in QMapControl, a frame is only drawn when the viewport changed or a tile
+ * arrived, and zoom changes abort the pending downloads.
+ */
+class TileNetwork : public QObject
+{
+    Q_OBJECT
+public:
+    //! Benchmark configuration.
+    struct Config
+    {
+        /// The tile server configuration.
+        TileServerConfig server;
+
+        /// The viewport size.
+        QSize viewport_size = QSize(1280, 720);
+
+        /// The frame interval in milliseconds.
+        int frame_interval_ms = 16;
+
+        /// How long to wait for the final viewport to complete (ms after the last keyframe).
+        int timeout_ms = 30000;
+
+        /// The memory cache capacity in MiB.
+        int memory_cache_mib = 64;
+
+        /// Only run scenarios whose name matches this expression.
+        QRegularExpression filter;
+    };
+
+public:
+    /*!
+     * Construct the benchmark.
+     * @param config The configuration to use.
+     */
+    explicit TileNetwork(const Config& config);
+
+    //! Destructor.
+    ~TileNetwork();
+
+    /*!
+     * Start the tile server.
+     * @return whether the tile server is listening.
+     */
+    bool startServer();
+
+    /*!
+     * Run the scenarios.
+     * @return the result of each scenario.
+     */
+    QJsonArray run();
+
+private:
+    //! A scenario keyframe (the viewport pans linearly between keyframes at the same zoom).
+    struct Keyframe
+    {
+        /// Time since the start of the scenario (ms).
+        qint64 time_ms;
+
+        /// The viewport focus point.
+        PointWorldCoord focus;
+
+        /// The zoom.
+        int zoom;
+    };
+
+    //! A fetch pattern.
+    struct Scenario
+    {
+        /// The scenario name.
+        QString name;
+
+        /// The scenario description.
+        QString description;
+
+        /// The viewport keyframes.
+        std::vector<Keyframe> keyframes;
+    };
+
+    //! A viewport.
+    struct Viewport
+    {
+        /// The zoom.
+        int zoom;
+
+        /// The viewport rect (world pixels).
+        QRectF rect_px;
+    };
+
+    /*!
+     * Fetch the scenarios.
+     * @return the scenarios.
+     */
+    std::vector<Scenario> scenarios() const;
+
+    /*!
+     * Run a scenario.
+     * @param scenario The scenario to run.
+     * @return the scenario result.
+     */
+    QJsonObject runScenario(const Scenario& scenario);
+
+    /*!
+     * Draw a frame of the running scenario (fetch the visible tiles, prefetch around them).
+     */
+    void drawFrame();
+
+    /*!
+     * Mark a tile of the current viewport as available.
+     * @param url The tile url.
+     */
+    void markAvailable(const QUrl& url);
+
+    /*!
+     * Calculate the viewport of a scenario at a point in time.
+     * @param scenario The scenario.
+     * @param time_ms The time since the start of the scenario.
+     * @return the viewport.
+     */
+    Viewport viewportAt(const Scenario& scenario, const qint64 time_ms) const;
+
+    /*!
+     * Fetch the tile urls covering a viewport.
+     * @param viewport The viewport.
+     * @param extent The number of extra tiles around the viewport (0 for the visible tiles).
+     * @param ring_only Whether to only return the extra tiles around the viewport.
+     * @return the tile urls.
+     */
+    std::vector<QUrl> tileUrls(const Viewport& viewport, const int extent, const bool ring_only) const;
+
+    /*!
+     * Fetch the url of a tile (tiles are spread over the hosts like tile server sub-domains).
+     * @param x The tile x.
+     * @param y The tile y.
+     * @param zoom The zoom.
+     * @return the tile url.
+     */
+    QUrl tileUrl(const int x, const int y, const int zoom) const;
+
+private:
+    /// The configuration.
+    const Config m_config;
+
+    /// The tile server.
+    TileServer m_server;
+
+    /// The tile server host urls.
+    std::vector<QString> m_host_urls;
+
+    /// The loading placeholder (identifies tiles that are not available yet).
+    QPixmap m_loading_pixmap;
+
+    /// The running scenario clock.
+    QElapsedTimer m_clock;
+
+    /// The current viewport of the running scenario (zoom -1 before the first frame).
+    Viewport m_viewport;
+
+    /// The visible tiles of the current viewport.
+    std::vector<QUrl> m_visible_tiles;
+
+    /// When each tile of the current viewport became available (ns).
+    QHash<QUrl, qint64> m_available;
+
+    /// Whether a redraw is required (viewport changed, tile arrived or failed).
+    bool m_redraw_requested;
+
+    /// When the viewport last changed (ns).
+    qint64 m_viewport_changed_ns;
+
+    /// When the first visible tile became available (ns, -1 if not yet).
+    qint64 m_first_visible_ns;
+
+    /// Number of frames drawn.
+    int m_frames_drawn;
+
+    /// Number of failed tile downloads.
+    int m_tiles_failed;
+};
@@ -0,0 +1,399 @@
+#include "tileserver.h"
+
+// Qt includes.
+#include <QtCore/QBuffer>
+#include <QtCore/QTimer>
+#include <QtGui/QColor>
+#include <QtGui/QImage>
+#include <QtGui/QPainter>
+#include <QtNetwork/QTcpSocket>
+
+// STL includes.
+#include <algorithm>
+#include <array>
+
+namespace
+{
+    /// Interval between the parts of a bandwidth limited response.
+    const int kSendIntervalMs = 10;
+
+    /// Size of the generated tile images.
+    const int kTileSizePx = 256;
+
+    /// Calculate the CRC-32 (as used by PNG chunks) of some data.
+    quint32 crc32(const QByteArray& data)
+    {
+        static const std::array<quint32, 256> table = []()
+        {
+            std::array<quint32, 256> values;
+            for (quint32 i = 0; i < 256; ++i)
+            {
+                quint32 value = i;
+                for (int bit = 0; bit < 8; ++bit)
+                {
+                    value = (value & 1) ? 0xEDB88320U ^ (value >> 1) : value >> 1;
+                }
+                values[i] = value;
+            }
+            return values;
+        }();
+
+        quint32 crc = 0xFFFFFFFFU;
+        for (const char byte : data)
+        {
+            crc = table[(crc ^ quint8(byte)) & 0xFF] ^ (crc >> 8);
+        }
+        return crc ^ 0xFFFFFFFFU;
+    }
+
+    /// Append a big-endian 32-bit value.
+    void appendUInt32(QByteArray& data, const quint32 value)
+    {
+        data.append(char((value >> 24) & 0xFF));
+        data.append(char((value >> 16) & 0xFF));
+        data.append(char((value >> 8) & 0xFF));
+        data.append(char(value & 0xFF));
+    }
+}
+
+TileServerWorker::TileServerWorker(const TileServerConfig& config)
+    : QObject(nullptr),
+      m_config(config),
+      m_random(config.seed)
+{
+
+}
+
+TileServerWorker::~TileServerWorker()
+{
+    // Ensure all connections are closed.
+    close();
+}
+
+std::vector<quint16> TileServerWorker::ports() const
+{
+    std::vector<quint16> return_ports;
+    for (const auto& server : m_servers)
+    {
+        return_ports.push_back(server->serverPort());
+    }
+    return return_ports;
+}
+
+TileServerStats TileServerWorker::stats() const
+{
+    QMutexLocker locker(&m_stats_mutex);
+    return m_stats;
+}
+
+void TileServerWorker::resetStats()
+{
+    QMutexLocker locker(&m_stats_mutex);
+    m_stats = TileServerStats();
+    m_tiles_sent.clear();
+}
+
+bool TileServerWorker::listen()
+{
+    // Listen on a port per host.
+    for (int host = 0; host < std::max(1, m_config.hosts); ++host)
+    {
+        std::unique_ptr<QTcpServer> server(new QTcpServer);
+        if (server->listen(QHostAddress::LocalHost) == false)
+        {
+            close();
+            return false;
+        }
+        QObject::connect(server.get(), &QTcpServer::newConnection, this, [this, host]() { acceptConnections(host); });
+        m_servers.push_back(std::move(server));
+    }
+
+    // Success.
+    return true;
+}
+
+void TileServerWorker::close()
+{
+    // Close the connections.
+    for (auto& entry : m_connections)
+    {
+        QObject::disconnect(entry.first, nullptr, this, nullptr);
+        delete entry.second.timer;
+        entry.first->abort();
+        delete entry.first;
+    }
+    m_connections.clear();
+
+    // Stop listening.
+    m_servers.clear();
+}
+
+void TileServerWorker::acceptConnections(const int host)
+{
+    while (m_servers[std::size_t(host)]->hasPendingConnections())
+    {
+        // Take the connection (it is owned by the connection map from now on).
+        QTcpSocket* socket = m_servers[std::size_t(host)]->nextPendingConnection();
+        socket->setParent(nullptr);
+
+        Connection& connection = m_connections[socket];
+        connection.socket = socket;
+        connection.host = host;
+        connection.busy = false;
+        connection.response_sent = 0;
+        connection.response_is_tile = false;
+        connection.timer = new QTimer;
+        connection.timer->setTimerType(Qt::PreciseTimer);
+        connection.timer->setSingleShot(true);
+
+        QObject::connect(connection.timer, &QTimer::timeout, this, [this, socket]()
+        {
+            sendResponse(m_connections[socket]);
+        });
+
+        QObject::connect(socket, &QTcpSocket::readyRead, this, [this, socket]()
+        {
+            readRequests(m_connections[socket]);
+        });
+        QObject::connect(socket, &QTcpSocket::disconnected, this, [this, socket]()
+        {
+            closeConnection(socket);
+        });
+    }
+}
+
+void TileServerWorker::readRequests(Connection& connection)
+{
+    connection.buffer.append(connection.socket->readAll());
+
+    // Parse each complete request (clients may pipeline requests).
+    int header_end = connection.buffer.indexOf("\r\n\r\n");
+    while (header_end >= 0)
+    {
+        const QByteArray request_line(connection.buffer.left(connection.buffer.indexOf("\r\n")));
+        connection.buffer.remove(0, header_end + 4);
+
+        // "GET /zoom/x/y.png HTTP/1.1".
+        const QList<QByteArray> parts(request_line.split(' '));
+        Request request;
+        request.path = parts.size() >= 2 ? parts[1] : QByteArray();
+        request.valid = parts.size() >= 2 && parts[0] == "GET" && request.path.split('/').size() == 4 && request.path.endsWith(".png");
+        connection.requests.push_back(request);
+
+        {
+            QMutexLocker locker(&m_stats_mutex);
+            ++m_stats.requests;
+        }
+
+        header_end = connection.buffer.indexOf("\r\n\r\n");
+    }
+
+    // Answer the next request if idle.
+    if (connection.busy == false && connection.requests.empty() == false)
+    {
+        startResponse(connection);
+    }
+}
+
+void TileServerWorker::startResponse(Connection& connection)
+{
+    const Request request(connection.requests.front());
+    connection.requests.pop_front();
+    connection.busy = true;
+
+    // Slow hosts are slower.
+    const bool slow_host = connection.host < m_config.slow_hosts;
+    const double latency_factor = slow_host ? m_config.slow_factor : 1.0;
+
+    // Prepare the response.
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    connection.response_sent = 0;
+    connection.response_is_tile = false;
+    if (request.valid == false)
+    {
+        connection.response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: keep-alive\r\n\r\n";
+    }
+    else if (chance(m_random) < m_config.error_rate)
+    {
+        connection.response = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: keep-alive\r\n\r\n";
+
+        QMutexLocker locker(&m_stats_mutex);
+        ++m_stats.errors;
+    }
+    else
+    {
+        const QByteArray& payload = tilePayload(request.path);
+        connection.response = "HTTP/1.1 200 OK\r\nContent-Type: image/png\r\nCache-Control: no-store\r\nConnection: keep-alive\r\nContent-Length: " +
+                              QByteArray::number(payload.size()) + "\r\n\r\n" + payload;
+        connection.response_path = request.path;
+        connection.response_is_tile = true;
+    }
+
+    // Wait for the latency, then send the response.
+    std::uniform_int_distribution<int> jitter(-m_config.jitter_ms, m_config.jitter_ms);
+    const int latency_ms = std::max(0, int(double(m_config.latency_ms + jitter(m_random)) * latency_factor));
+
+    connection.timer->start(latency_ms);
+}
+
+void TileServerWorker::sendResponse(Connection& connection)
+{
+    // How much can be sent now (bandwidth limited responses are sent in parts)?
+    const bool slow_host = connection.host < m_config.slow_hosts;
+    const double bandwidth_factor = slow_host ? 1.0 / m_config.slow_factor : 1.0;
+    int part_size = connection.response.size() - connection.response_sent;
+    if (m_config.bandwidth_kib_s > 0)
+    {
+        part_size = std::min(part_size, std::max(1, int(m_config.bandwidth_kib_s * 1024.0 * bandwidth_factor * kSendIntervalMs / 1000.0)));
+    }
+
+    // Send the part.
+    connection.socket->write(connection.response.constData() + connection.response_sent, part_size);
+    connection.response_sent += part_size;
+    {
+        QMutexLocker locker(&m_stats_mutex);
+        m_stats.bytes_sent += part_size;
+    }
+
+    // More to send?
+    if (connection.response_sent < connection.response.size())
+    {
+        connection.timer->start(kSendIntervalMs);
+        return;
+    }
+
+    // The response is complete.
+    if (connection.response_is_tile)
+    {
+        QMutexLocker locker(&m_stats_mutex);
+        ++m_stats.tiles;
+        if (m_tiles_sent.contains(connection.response_path))
+        {
+            ++m_stats.duplicates;
+            m_stats.bytes_duplicate += connection.response.size();
+        }
+        m_tiles_sent.insert(connection.response_path);
+    }
+    connection.busy = false;
+    connection.response.clear();
+
+    // Answer the next request.
+    if (connection.requests.empty() == false)
+    {
+        startResponse(connection);
+    }
+}
+
+void TileServerWorker::closeConnection(QTcpSocket* socket)
+{
+    const auto itr = m_connections.find(socket);
+    if (itr == m_connections.end())
+    {
+        return;
+    }
+    Connection& connection = itr->second;
+
+    // The client has cancelled the response in progress and the queued requests.
+    {
+        QMutexLocker locker(&m_stats_mutex);
+        if (connection.busy)
+        {
+            ++m_stats.cancelled;
+            m_stats.bytes_cancelled += connection.response_sent;
+        }
+        m_stats.cancelled += int(connection.requests.size());
+    }
+
+    // Remove the connection.
+    connection.timer->stop();
+    connection.timer->deleteLater();
+    m_connections.erase(itr);
+    socket->deleteLater();
+}
+
+const QByteArray& TileServerWorker::tilePayload(const QByteArray& path)
+{
+    auto itr = m_payloads.find(path);
+    if (itr != m_payloads.end())
+    {
+        return itr.value();
+    }
+
+    // Draw a distinct tile.
+    QImage image(kTileSizePx, kTileSizePx, QImage::Format_RGB32);
+    image.fill(QColor::fromHsv(int(qHash(path) % 360), 60, 230));
+    QPainter painter(&image);
+    painter.setPen(QColor(80, 80, 80));
+    painter.drawRect(0, 0, kTileSizePx - 1, kTileSizePx - 1);
+    painter.drawText(image.rect(), Qt::AlignCenter, QString::fromLatin1(path));
+    painter.end();
+
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+
+    // Pad to the payload size with a private ancillary chunk (ignored by decoders) before IEND.
+    const int padding = m_config.tile_kib * 1024 - png.size() - 12;
+    if (padding > 0 && png.size() > 12)
+    {
+        QByteArray chunk_data("qmCp");
+        chunk_data.append(QByteArray(padding, char(0x5A)));
+
+        QByteArray chunk;
+        appendUInt32(chunk, quint32(padding));
+        chunk.append(chunk_data);
+        appendUInt32(chunk, crc32(chunk_data));
+        png.insert(png.size() - 12, chunk);
+    }
+
+    return m_payloads.insert(path, png).value();
+}
+
+TileServer::TileServer(const TileServerConfig& config)
+    : m_worker(new TileServerWorker(config))
+{
+    // The worker lives in the server thread.
+    m_thread.setObjectName("TileServer");
+    m_worker->moveToThread(&m_thread);
+}
+
+TileServer::~TileServer()
+{
+    // Close the connections (in the server thread) and stop the thread.
+    if (m_thread.isRunning())
+    {
+        QMetaObject::invokeMethod(m_worker.get(), "close", Qt::BlockingQueuedConnection);
+        m_thread.quit();
+        m_thread.wait();
+    }
+}
+
+bool TileServer::start()
+{
+    // Start the thread and listen (in the server thread).
+    m_thread.start();
+    bool return_listening(false);
+    QMetaObject::invokeMethod(m_worker.get(), "listen", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, return_listening));
+    return return_listening;
+}
+
+std::vector<QString> TileServer::hostUrls() const
+{
+    std::vector<QString> return_urls;
+    for (const quint16 port : m_worker->ports())
+    {
+        return_urls.push_back(QString("http://127.0.0.1:%1").arg(port));
+    }
+    return return_urls;
+}
+
+TileServerStats TileServer::stats() const
+{
+    return m_worker->stats();
+}
+
+void TileServer::resetStats()
+{
+    m_worker->resetStats();
+}
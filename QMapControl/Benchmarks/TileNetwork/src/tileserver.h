@@ -0,0 +1,289 @@
+#pragma once
+
+// Qt includes.
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QSet>
+#include <QtCore/QThread>
+#include <QtNetwork/QTcpServer>
+
+// STL includes.
+#include <deque>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+class QTcpSocket;
+class QTimer;
+
+//! Tile server configuration.
+struct TileServerConfig
+{
+    /// The latency before a response starts in milliseconds.
+    int latency_ms = 40;
+
+    /// The latency jitter (+/-) in milliseconds.
+    int jitter_ms = 20;
+
+    /// The bandwidth per connection in KiB/s (0 for unlimited).
+    int bandwidth_kib_s = 0;
+
+    /// The fraction of requests answered with "503 Service Unavailable" (0.0 to 1.0).
+    double error_rate = 0.0;
+
+    /// The number of hosts (each host listens on its own port, like tile server sub-domains).
+    int hosts = 3;
+
+    /// The number of hosts (of the above) that are slow.
+    int slow_hosts = 0;
+
+    /// How much slower the slow hosts are (latency multiplied, bandwidth divided).
+    double slow_factor = 4.0;
+
+    /// The tile payload size in KiB (typical raster tiles are 10 to 50 KiB).
+    int tile_kib = 24;
+
+    /// The jitter/error seed.
+    std::uint64_t seed = 0;
+};
+
+//! Tile server statistics.
+struct TileServerStats
+{
+    /// Number of requests received.
+    int requests = 0;
+
+    /// Number of tiles sent completely.
+    int tiles = 0;
+
+    /// Number of error responses sent.
+    int errors = 0;
+
+    /// Number of requests cancelled by the client (connection closed before the response completed).
+    int cancelled = 0;
+
+    /// Number of tiles sent completely that had already been sent since the last reset.
+    int duplicates = 0;
+
+    /// Number of bytes sent.
+    qint64 bytes_sent = 0;
+
+    /// Number of bytes sent for responses the client cancelled.
+    qint64 bytes_cancelled = 0;
+
+    /// Number of bytes sent for duplicate tiles.
+    qint64 bytes_duplicate = 0;
+};
+
+/*!
+ * The part of the tile server living in the server thread.
+ */
+class TileServerWorker : public QObject
+{
+    Q_OBJECT
+public:
+    /*!
+     * Construct the worker.
+     * @param config The configuration to use.
+     */
+    explicit TileServerWorker(const TileServerConfig& config);
+
+    //! Destructor.
+    ~TileServerWorker();
+
+    /*!
+     * Fetch the ports the hosts listen on.
+     * @return the ports (one per host).
+     */
+    std::vector<quint16> ports() const;
+
+    /*!
+     * Fetch the statistics (thread-safe).
+     * @return the statistics since the last reset.
+     */
+    TileServerStats stats() const;
+
+    /*!
+     * Reset the statistics and the sent tiles (thread-safe).
+     */
+    void resetStats();
+
+public slots:
+    /*!
+     * Start listening (one port per host).
+     * @return whether all hosts are listening.
+     */
+    bool listen();
+
+    /*!
+     * Stop listening and close all connections.
+     */
+    void close();
+
+private:
+    //! A parsed tile request.
+    struct Request
+    {
+        /// The tile path ("/zoom/x/y.png").
+        QByteArray path;
+
+        /// Whether the path is a valid tile path.
+        bool valid;
+    };
+
+    //! A client connection (HTTP/1.1 keep-alive, requests are answered in order).
+    struct Connection
+    {
+        /// The socket.
+        QTcpSocket* socket;
+
+        /// The host (index) the connection was made to.
+        int host;
+
+        /// Received data not parsed yet.
+        QByteArray buffer;
+
+        /// Requests waiting to be answered.
+        std::deque<Request> requests;
+
+        /// Whether a response is in progress.
+        bool busy;
+
+        /// The response in progress.
+        QByteArray response;
+
+        /// Bytes of the response sent so far.
+        int response_sent;
+
+        /// Whether the response in progress is a tile.
+        bool response_is_tile;
+
+        /// The tile path of the response in progress.
+        QByteArray response_path;
+
+        /// Timer used to pace the response (latency, then bandwidth).
+        QTimer* timer;
+    };
+
+    /*!
+     * Accept the pending connections of a host.
+     * @param host The host index.
+     */
+    void acceptConnections(const int host);
+
+    /*!
+     * Parse the received requests of a connection.
+     * @param connection The connection.
+     */
+    void readRequests(Connection& connection);
+
+    /*!
+     * Start the next response of a connection (after the latency).
+     * @param connection The connection.
+     */
+    void startResponse(Connection& connection);
+
+    /*!
+     * Send the next part of the response in progress (limited by the bandwidth).
+     * @param connection The connection.
+     */
+    void sendResponse(Connection& connection);
+
+    /*!
+     * Handle a closed connection.
+     * @param socket The socket of the connection.
+     */
+    void closeConnection(QTcpSocket* socket);
+
+    /*!
+     * Fetch (or generate) the payload of a tile.
+     * @param path The tile path.
+     * @return the PNG payload.
+     */
+    const QByteArray& tilePayload(const QByteArray& path);
+
+private:
+    /// The configuration.
+    const TileServerConfig m_config;
+
+    /// The servers (one per host).
+    std::vector<std::unique_ptr<QTcpServer>> m_servers;
+
+    /// The connections.
+    std::map<QTcpSocket*, Connection> m_connections;
+
+    /// The generated tile payloads.
+    QHash<QByteArray, QByteArray> m_payloads;
+
+    /// Jitter/error generator.
+    std::mt19937_64 m_random;
+
+    /// Mutex to protect the members below (read from the benchmark thread).
+    mutable QMutex m_stats_mutex;
+
+    /// The statistics.
+    TileServerStats m_stats;
+
+    /// The tiles sent since the last reset.
+    QSet<QByteArray> m_tiles_sent;
+};
+
+/*!
+ * Local HTTP tile server that simulates per-request latency, per-connection bandwidth, error
+ * rates and slow hosts. The server runs in its own thread, so it keeps pace while the benchmark
+ * thread is busy decoding tiles.
+ *
+ * Tiles are served for any "/<zoom>/<x>/<y>.png" path, as generated PNGs padded to the
+ * configured payload size.
+ */
+class TileServer
+{
+public:
+    /*!
+     * Construct the tile server (call start() to listen).
+     * @param config The configuration to use.
+     */
+    explicit TileServer(const TileServerConfig& config);
+
+    //! Disable copy constructor.
+    TileServer(const TileServer&) = delete;
+
+    //! Disable copy assignment.
+    TileServer& operator=(const TileServer&) = delete;
+
+    //! Destructor.
+    ~TileServer();
+
+    /*!
+     * Start the server thread and listen on 127.0.0.1 (a port per host).
+     * @return whether the server is listening.
+     */
+    bool start();
+
+    /*!
+     * Fetch the base urls of the hosts.
+     * @return the base urls ("http://127.0.0.1:<port>").
+     */
+    std::vector<QString> hostUrls() const;
+
+    /*!
+     * Fetch the statistics.
+     * @return the statistics since the last reset.
+     */
+    TileServerStats stats() const;
+
+    /*!
+     * Reset the statistics and the sent tiles (duplicates are counted since the last reset).
+     */
+    void resetStats();
+
+private:
+    /// The server thread.
+    QThread m_thread;
+
+    /// The worker (lives in the server thread).
+    std::unique_ptr<TileServerWorker> m_worker;
+};
@@ -0,0 +1,36 @@
+# Include benchmark configurations.
+include(../Benchmarks.pri)
+
+# Target name.
+TARGET = UnitTests
+
+# Target version.
+VERSION = 0.1
+
+# Build an application.
+TEMPLATE = app
+
+# Console application (results are written to stdout).
+CONFIG += console
+
+# Qt test library.
+QT += testlib
+
+# Add header files.
+HEADERS +=                          \
+    src/hillshadetest.h             \
+    src/sharedtilecachetest.h       \
+    src/spatialindextest.h          \
+    src/tilecolortransformtest.h    \
+    src/tiledecodetest.h            \
+    src/tileocclusiontest.h         \
+
+# Add source files.
+SOURCES +=                          \
+    src/main.cpp                    \
+    src/hillshadetest.cpp           \
+    src/sharedtilecachetest.cpp     \
+    src/spatialindextest.cpp        \
+    src/tilecolortransformtest.cpp  \
+    src/tiledecodetest.cpp          \
+    src/tileocclusiontest.cpp       \
@@ -0,0 +1,251 @@
+#include "hillshadetest.h"
+
+// Qt includes.
+#include <QtTest/QtTest>
+
+// STL includes.
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+// QMapControl includes.
+#include <QMapControl/Hillshade.h>
+
+using namespace qmapcontrol;
+
+Q_DECLARE_METATYPE(qmapcontrol::HillshadeOptions::Mode)
+
+namespace
+{
+    /// The tile width (not a multiple of the SIMD width).
+    const int kWidth = 7;
+
+    /// The tile height.
+    const int kHeight = 5;
+
+    /// The ground size of a pixel in metres.
+    const double kCellSize = 10.0;
+
+    /*!
+     * Create a tile of a plane.
+     * @param slope_x The height change per pixel eastwards (metres).
+     * @param slope_y The height change per pixel southwards (metres).
+     * @param origin_x The x coordinate of the tile's first pixel on the plane.
+     * @param origin_y The y coordinate of the tile's first pixel on the plane.
+     * @return the heights.
+     */
+    HeightTile planeTile(const double slope_x, const double slope_y, const int origin_x = 0, const int origin_y = 0)
+    {
+        HeightTile tile;
+        tile.width = kWidth;
+        tile.height = kHeight;
+        for (int y = 0; y < kHeight; ++y)
+        {
+            for (int x = 0; x < kWidth; ++x)
+            {
+                tile.heights.push_back(float(1000.0 + slope_x * (origin_x + x) + slope_y * (origin_y + y)));
+            }
+        }
+        return tile;
+    }
+
+    /*!
+     * Calculate the shade of a plane in double precision.
+     * @param slope_x The height change per pixel eastwards (metres).
+     * @param slope_y The height change per pixel southwards (metres).
+     * @param options The shading options.
+     * @return the alpha of the shade.
+     */
+    int expectedAlpha(const double slope_x, const double slope_y, const HillshadeOptions& options)
+    {
+        // Horn's gradient of a plane is its slope.
+        const double pi = std::acos(-1.0);
+        const double dx = options.z_factor * slope_x / kCellSize;
+        const double dy = options.z_factor * slope_y / kCellSize;
+        const double norm = 1.0 / std::sqrt(1.0 + dx * dx + dy * dy);
+
+        // The light direction, relative to its height (y points south).
+        const double azimuth = options.azimuth * pi / 180.0;
+        const double altitude = options.altitude * pi / 180.0;
+        const double light_x = std::cos(altitude) * std::sin(azimuth) / std::sin(altitude);
+        const double light_y = -std::cos(altitude) * std::cos(azimuth) / std::sin(altitude);
+
+        // Shade relative to flat terrain, or by the sine of the slope.
+        double value;
+        if (options.mode == HillshadeOptions::Mode::Slope)
+        {
+            value = std::sqrt(dx * dx + dy * dy) * norm;
+        }
+        else
+        {
+            value = 1.0 - (1.0 - dx * light_x - dy * light_y) * norm;
+        }
+        return int(std::floor(std::min(1.0, std::max(0.0, value)) * options.strength * 255.0 + 0.5));
+    }
+
+    /*!
+     * Shade a tile without neighbours.
+     * @param tile The heights.
+     * @param options The shading options.
+     * @return the shade.
+     */
+    QImage shadeAlone(const HeightTile& tile, const HillshadeOptions& options)
+    {
+        std::array<const HeightTile*, 9> tiles;
+        tiles.fill(nullptr);
+        tiles[4] = &tile;
+        return hillshade::shade(tiles, kCellSize, options);
+    }
+
+    /*!
+     * Fetch the alpha of a shade's pixel.
+     * @param image The shade.
+     * @param x The x coordinate.
+     * @param y The y coordinate.
+     * @return the alpha.
+     */
+    int alphaAt(const QImage& image, const int x, const int y)
+    {
+        return qAlpha(reinterpret_cast<const QRgb*>(image.constScanLine(y))[x]);
+    }
+}
+
+void HillshadeTest::decodeHeights()
+{
+    QImage image(2, 1, QImage::Format_RGB32);
+
+    // Terrain-RGB: -10000 + (R * 65536 + G * 256 + B) * 0.1.
+    image.setPixel(0, 0, qRgb(1, 134, 160));
+    image.setPixel(1, 0, qRgb(1, 134, 170));
+    HeightTile heights = hillshade::decodeHeights(image, DemEncoding::TerrainRGB);
+    QCOMPARE(heights.width, 2);
+    QCOMPARE(heights.height, 1);
+    QCOMPARE(int(heights.heights.size()), 2);
+    QVERIFY(std::abs(heights.heights[0] - 0.0f) < 1e-3f);
+    QVERIFY(std::abs(heights.heights[1] - 1.0f) < 1e-3f);
+
+    // Terrarium: R * 256 + G + B / 256 - 32768.
+    image.setPixel(0, 0, qRgb(128, 0, 0));
+    image.setPixel(1, 0, qRgb(128, 100, 128));
+    heights = hillshade::decodeHeights(image, DemEncoding::Terrarium);
+    QCOMPARE(heights.heights[0], 0.0f);
+    QCOMPARE(heights.heights[1], 100.5f);
+}
+
+void HillshadeTest::flat()
+{
+    HillshadeOptions options;
+    const QImage hillshade = shadeAlone(planeTile(0.0, 0.0), options);
+    options.mode = HillshadeOptions::Mode::Slope;
+    const QImage slope = shadeAlone(planeTile(0.0, 0.0), options);
+    QCOMPARE(hillshade.size(), QSize(kWidth, kHeight));
+    QCOMPARE(hillshade.format(), QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < kHeight; ++y)
+    {
+        for (int x = 0; x < kWidth; ++x)
+        {
+            QCOMPARE(reinterpret_cast<const QRgb*>(hillshade.constScanLine(y))[x], QRgb(0));
+            QCOMPARE(reinterpret_cast<const QRgb*>(slope.constScanLine(y))[x], QRgb(0));
+        }
+    }
+
+    // Nothing to shade without heights.
+    QVERIFY(shadeAlone(HeightTile{ 0, 0, {} }, options).isNull());
+}
+
+void HillshadeTest::plane_data()
+{
+    QTest::addColumn<HillshadeOptions::Mode>("mode");
+    QTest::addColumn<double>("slope_x");
+    QTest::addColumn<double>("slope_y");
+    QTest::addColumn<double>("azimuth");
+    QTest::addColumn<double>("z_factor");
+
+    QTest::newRow("hillshade, facing east") << HillshadeOptions::Mode::Hillshade << -5.0 << 0.0 << 315.0 << 1.0;
+    QTest::newRow("hillshade, facing north") << HillshadeOptions::Mode::Hillshade << 0.0 << 4.0 << 315.0 << 1.0;
+    QTest::newRow("hillshade, facing north-east") << HillshadeOptions::Mode::Hillshade << -3.0 << 3.0 << 315.0 << 1.0;
+    QTest::newRow("hillshade, steep, light from the east") << HillshadeOptions::Mode::Hillshade << 20.0 << -7.0 << 90.0 << 1.0;
+    QTest::newRow("hillshade, exaggerated") << HillshadeOptions::Mode::Hillshade << -2.0 << 1.0 << 315.0 << 3.0;
+    QTest::newRow("hillshade, facing south-west") << HillshadeOptions::Mode::Hillshade << 5.0 << -5.0 << 315.0 << 1.0;
+    QTest::newRow("hillshade, facing the light") << HillshadeOptions::Mode::Hillshade << 5.0 << 5.0 << 315.0 << 1.0;
+    QTest::newRow("slope, gentle") << HillshadeOptions::Mode::Slope << 1.0 << 0.5 << 315.0 << 1.0;
+    QTest::newRow("slope, steep") << HillshadeOptions::Mode::Slope << -30.0 << 25.0 << 315.0 << 1.0;
+}
+
+void HillshadeTest::plane()
+{
+    QFETCH(HillshadeOptions::Mode, mode);
+    QFETCH(double, slope_x);
+    QFETCH(double, slope_y);
+    QFETCH(double, azimuth);
+    QFETCH(double, z_factor);
+
+    HillshadeOptions options;
+    options.mode = mode;
+    options.azimuth = azimuth;
+    options.z_factor = z_factor;
+    const QImage shade = shadeAlone(planeTile(slope_x, slope_y), options);
+    const int expected = expectedAlpha(slope_x, slope_y, options);
+
+    // The inner pixels see the whole plane (single precision allows 1 step of difference).
+    for (int y = 1; y < kHeight - 1; ++y)
+    {
+        for (int x = 1; x < kWidth - 1; ++x)
+        {
+            const int alpha = alphaAt(shade, x, y);
+            QVERIFY2(std::abs(alpha - expected) <= 1, qPrintable(QString("(%1, %2): %3 instead of %4").arg(x).arg(y).arg(alpha).arg(expected)));
+
+            // Premultiplied black.
+            QCOMPARE(reinterpret_cast<const QRgb*>(shade.constScanLine(y))[x] & 0x00FFFFFF, QRgb(0));
+        }
+    }
+}
+
+void HillshadeTest::lightDirection()
+{
+    // The light comes from the north-west: a slope facing west is lit, one facing east is shaded.
+    HillshadeOptions options;
+    const QImage facing_west = shadeAlone(planeTile(5.0, 0.0), options);
+    const QImage facing_east = shadeAlone(planeTile(-5.0, 0.0), options);
+    QCOMPARE(alphaAt(facing_west, kWidth / 2, kHeight / 2), 0);
+    QVERIFY(alphaAt(facing_east, kWidth / 2, kHeight / 2) > 0);
+
+    // The strength scales the shade.
+    const int full = alphaAt(facing_east, kWidth / 2, kHeight / 2);
+    options.strength = 0.3;
+    QVERIFY(std::abs(alphaAt(shadeAlone(planeTile(-5.0, 0.0), options), kWidth / 2, kHeight / 2) - full / 2) <= 1);
+}
+
+void HillshadeTest::neighbours()
+{
+    // The tile and its neighbours cut from one plane.
+    const double slope_x = -4.0;
+    const double slope_y = 3.0;
+    std::array<HeightTile, 9> plane;
+    std::array<const HeightTile*, 9> tiles;
+    for (int row = 0; row < 3; ++row)
+    {
+        for (int column = 0; column < 3; ++column)
+        {
+            plane[std::size_t(row * 3 + column)] = planeTile(slope_x, slope_y, (column - 1) * kWidth, (row - 1) * kHeight);
+            tiles[std::size_t(row * 3 + column)] = &plane[std::size_t(row * 3 + column)];
+        }
+    }
+    const HillshadeOptions options;
+    const int expected = expectedAlpha(slope_x, slope_y, options);
+
+    // Every pixel, the edges included, sees the whole plane.
+    const QImage shade = hillshade::shade(tiles, kCellSize, options);
+    for (int y = 0; y < kHeight; ++y)
+    {
+        for (int x = 0; x < kWidth; ++x)
+        {
+            QVERIFY(std::abs(alphaAt(shade, x, y) - expected) <= 1);
+        }
+    }
+
+    // Without the neighbours the edge is repeated, which halves the gradient across it.
+    const QImage alone = shadeAlone(plane[4], options);
+    QVERIFY(std::abs(alphaAt(alone, 0, kHeight / 2) - expected) > 1);
+    QVERIFY(std::abs(alphaAt(alone, kWidth / 2, kHeight / 2) - expected) <= 1);
+}
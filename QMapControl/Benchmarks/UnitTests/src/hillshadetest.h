@@ -0,0 +1,30 @@
+#pragma once
+
+// Qt includes.
+#include <QtCore/QObject>
+
+/*!
+ * Tests for the hillshade kernel: elevation decoding, and the shade of planes compared with a double
+ * precision evaluation of Horn's gradient (tile widths that are not a multiple of the SIMD width).
+ */
+class HillshadeTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    /// The heights of both encodings.
+    void decodeHeights();
+
+    /// Flat terrain is left clear.
+    void flat();
+
+    /// Planes are shaded as their gradient and the light direction tell.
+    void plane_data();
+    void plane();
+
+    /// The slopes facing away from the light are darker.
+    void lightDirection();
+
+    /// The neighbours continue the slope across the edges of the tile.
+    void neighbours();
+};
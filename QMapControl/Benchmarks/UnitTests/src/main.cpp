@@ -0,0 +1,54 @@
+// Qt includes.
+#include <QtTest/QtTest>
+#include <QtWidgets/QApplication>
+
+// Local includes.
+#include "hillshadetest.h"
+#include "sharedtilecachetest.h"
+#include "spatialindextest.h"
+#include "tilecolortransformtest.h"
+#include "tiledecodetest.h"
+#include "tileocclusiontest.h"
+
+int main(int argc, char *argv[])
+{
+    // Run without a display unless told otherwise.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    // Create a QApplication (pixmaps require a gui application).
+    QApplication app(argc, argv);
+    app.setApplicationName("QMapControl UnitTests");
+
+    // Run each test (the Qt Test options, e.g. -silent, are passed on).
+    int failures = 0;
+    {
+        HillshadeTest test;
+        failures += QTest::qExec(&test, argc, argv);
+    }
+    {
+        SharedTileCacheTest test;
+        failures += QTest::qExec(&test, argc, argv);
+    }
+    {
+        SpatialIndexTest test;
+        failures += QTest::qExec(&test, argc, argv);
+    }
+    {
+        TileColorTransformTest test;
+        failures += QTest::qExec(&test, argc, argv);
+    }
+    {
+        TileDecodeTest test;
+        failures += QTest::qExec(&test, argc, argv);
+    }
+    {
+        TileOcclusionTest test;
+        failures += QTest::qExec(&test, argc, argv);
+    }
+
+    // Return the number of failed tests.
+    return failures;
+}
@@ -0,0 +1,247 @@
+#include "sharedtilecachetest.h"
+
+// Qt includes.
+#include <QtCore/QCoreApplication>
+#include <QtTest/QtTest>
+
+// STL includes.
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// QMapControl includes.
+#include <QMapControl/SharedTileCache.h>
+
+using namespace qmapcontrol;
+
+namespace
+{
+    /// The capacity of the test caches in bytes.
+    const std::size_t kCapacityBytes = 4 * 1024 * 1024;
+
+    /// The maximum size of a tile in bytes.
+    const std::size_t kSlotBytes = 4 * 1024;
+
+    /// The number of caches racing (each stands for a process).
+    const int kRacers = 8;
+
+    /// The number of tiles raced for.
+    const int kRounds = 200;
+
+    /*!
+     * Create a segment key unique to this process and test.
+     * @param test The test name.
+     * @return the segment key.
+     */
+    QString segmentKey(const QString& test)
+    {
+        return QString("qmapcontrol-unittests-%1-%2").arg(QCoreApplication::applicationPid()).arg(test);
+    }
+
+    /*!
+     * Create the bytes of a tile.
+     * @param key The tile key.
+     * @return the tile bytes.
+     */
+    QByteArray tileData(const QByteArray& key)
+    {
+        return "tile:" + key + QByteArray(100, 'x');
+    }
+
+    //! Lets threads run each step together (spins, to make the races as tight as possible).
+    class SpinBarrier
+    {
+    public:
+        /*!
+         * Constructor.
+         * @param count The number of threads.
+         */
+        explicit SpinBarrier(const int count)
+            : m_count(count),
+              m_waiting(0),
+              m_generation(0)
+        {
+
+        }
+
+        /*!
+         * Wait for all the threads to reach the barrier.
+         */
+        void wait()
+        {
+            const int generation = m_generation.load();
+            if (m_waiting.fetch_add(1) + 1 == m_count)
+            {
+                m_waiting.store(0);
+                m_generation.fetch_add(1);
+            }
+            else
+            {
+                while (m_generation.load() == generation)
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+    private:
+        /// The number of threads.
+        const int m_count;
+
+        /// The number of threads waiting.
+        std::atomic<int> m_waiting;
+
+        /// Incremented each time all the threads reach the barrier.
+        std::atomic<int> m_generation;
+    };
+}
+
+void SharedTileCacheTest::acquire()
+{
+    SharedTileCache first(segmentKey("acquire"), kCapacityBytes, kSlotBytes);
+    SharedTileCache second(segmentKey("acquire"), kCapacityBytes, kSlotBytes);
+    if (first.isAttached() == false || second.isAttached() == false)
+    {
+        QSKIP("Shared memory is not available.");
+    }
+
+    // The first cache is elected, the second sees the fetch in flight.
+    const QByteArray key = "0123456789abcdef0123456789abcdef";
+    QByteArray data;
+    QVERIFY(first.acquire(key, data) == SharedTileCache::Acquire::Elected);
+    QVERIFY(second.acquire(key, data) == SharedTileCache::Acquire::InFlight);
+    QVERIFY(first.acquire(key, data) == SharedTileCache::Acquire::InFlight);
+    QCOMPARE(first.stats().pending, std::size_t(1));
+
+    // Both hit once the tile is inserted.
+    first.insert(key, tileData(key));
+    QVERIFY(second.acquire(key, data) == SharedTileCache::Acquire::Hit);
+    QCOMPARE(data, tileData(key));
+    data.clear();
+    QVERIFY(first.acquire(key, data) == SharedTileCache::Acquire::Hit);
+    QCOMPARE(data, tileData(key));
+    QCOMPARE(second.stats().ready, std::size_t(1));
+    QCOMPARE(second.stats().pending, std::size_t(0));
+    QCOMPARE(second.stats().bytes, std::size_t(tileData(key).size()));
+
+    // Keys too large to be stored always miss.
+    const QByteArray long_key(SharedTileCache::kMaxKeySize + 1, 'k');
+    QVERIFY(first.acquire(long_key, data) == SharedTileCache::Acquire::Miss);
+}
+
+void SharedTileCacheTest::abandon()
+{
+    SharedTileCache first(segmentKey("abandon"), kCapacityBytes, kSlotBytes);
+    SharedTileCache second(segmentKey("abandon"), kCapacityBytes, kSlotBytes);
+    if (first.isAttached() == false || second.isAttached() == false)
+    {
+        QSKIP("Shared memory is not available.");
+    }
+
+    // The claim is released, so the next cache to ask is elected.
+    const QByteArray key = "abandoned";
+    QByteArray data;
+    QVERIFY(first.acquire(key, data) == SharedTileCache::Acquire::Elected);
+    first.abandon(key);
+    QCOMPARE(first.stats().pending, std::size_t(0));
+    QVERIFY(second.acquire(key, data) == SharedTileCache::Acquire::Elected);
+    QVERIFY(first.acquire(key, data) == SharedTileCache::Acquire::InFlight);
+
+    // Inserting no bytes abandons the claim too.
+    second.insert(key, QByteArray());
+    QVERIFY(first.acquire(key, data) == SharedTileCache::Acquire::Elected);
+}
+
+void SharedTileCacheTest::oversize()
+{
+    SharedTileCache first(segmentKey("oversize"), kCapacityBytes, kSlotBytes);
+    SharedTileCache second(segmentKey("oversize"), kCapacityBytes, kSlotBytes);
+    if (first.isAttached() == false || second.isAttached() == false)
+    {
+        QSKIP("Shared memory is not available.");
+    }
+
+    // The waiting caches stop waiting and fetch the tile themselves.
+    const QByteArray key = "oversize";
+    QByteArray data;
+    QVERIFY(first.acquire(key, data) == SharedTileCache::Acquire::Elected);
+    QVERIFY(second.acquire(key, data) == SharedTileCache::Acquire::InFlight);
+    first.insert(key, QByteArray(int(kSlotBytes) + 1, 'x'));
+    QVERIFY(second.acquire(key, data) == SharedTileCache::Acquire::Miss);
+    QVERIFY(first.acquire(key, data) == SharedTileCache::Acquire::Miss);
+    QCOMPARE(first.stats().ready, std::size_t(0));
+
+    // A tile of exactly the slot size is shared.
+    const QByteArray full_key = "full";
+    QVERIFY(first.acquire(full_key, data) == SharedTileCache::Acquire::Elected);
+    first.insert(full_key, QByteArray(int(kSlotBytes), 'y'));
+    QVERIFY(second.acquire(full_key, data) == SharedTileCache::Acquire::Hit);
+    QCOMPARE(data.size(), int(kSlotBytes));
+}
+
+void SharedTileCacheTest::concurrentElection()
+{
+    // A cache per thread, as each process has its own.
+    std::vector<std::unique_ptr<SharedTileCache>> caches;
+    for (int racer = 0; racer < kRacers; ++racer)
+    {
+        caches.emplace_back(new SharedTileCache(segmentKey("concurrentElection"), kCapacityBytes, kSlotBytes));
+        if (caches.back()->isAttached() == false)
+        {
+            QSKIP("Shared memory is not available.");
+        }
+    }
+
+    // Each round, the threads acquire the same tile together, the elected thread inserts it, then
+    // they acquire it again.
+    std::vector<SharedTileCache::Acquire> first_results(std::size_t(kRounds * kRacers), SharedTileCache::Acquire::Miss);
+    std::vector<SharedTileCache::Acquire> second_results(first_results.size(), SharedTileCache::Acquire::Miss);
+    std::vector<QByteArray> second_data(first_results.size());
+    SpinBarrier barrier(kRacers);
+    std::vector<std::thread> threads;
+    for (int racer = 0; racer < kRacers; ++racer)
+    {
+        threads.emplace_back([&, racer]()
+        {
+            SharedTileCache& cache = *caches[std::size_t(racer)];
+            for (int round = 0; round < kRounds; ++round)
+            {
+                const QByteArray key = "race-" + QByteArray::number(round);
+                const std::size_t result = std::size_t(round * kRacers + racer);
+                QByteArray data;
+                barrier.wait();
+                first_results[result] = cache.acquire(key, data);
+                barrier.wait();
+                if (first_results[result] == SharedTileCache::Acquire::Elected)
+                {
+                    cache.insert(key, tileData(key));
+                }
+                barrier.wait();
+                second_results[result] = cache.acquire(key, second_data[result]);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    // Exactly one thread was elected per tile, the others saw its fetch in flight, then all hit.
+    for (int round = 0; round < kRounds; ++round)
+    {
+        const QByteArray key = "race-" + QByteArray::number(round);
+        int elected = 0;
+        int in_flight = 0;
+        for (int racer = 0; racer < kRacers; ++racer)
+        {
+            const std::size_t result = std::size_t(round * kRacers + racer);
+            elected += first_results[result] == SharedTileCache::Acquire::Elected ? 1 : 0;
+            in_flight += first_results[result] == SharedTileCache::Acquire::InFlight ? 1 : 0;
+            QVERIFY2(second_results[result] == SharedTileCache::Acquire::Hit, qPrintable(QString("round %1, racer %2 did not hit").arg(round).arg(racer)));
+            QCOMPARE(second_data[result], tileData(key));
+        }
+        QVERIFY2(elected == 1, qPrintable(QString("round %1: %2 threads elected").arg(round).arg(elected)));
+        QCOMPARE(in_flight, kRacers - 1);
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// Qt includes.
+#include <QtCore/QObject>
+
+/*!
+ * Tests for SharedTileCache: one fetcher is elected per tile, however many caches (processes) race to
+ * acquire it, and the others see its fetch in flight then its tile.
+ */
+class SharedTileCacheTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    /// The first acquire is elected, the next ones wait for it, then hit.
+    void acquire();
+
+    /// An abandoned claim lets the next acquire be elected.
+    void abandon();
+
+    /// Tiles larger than a slot are not shared.
+    void oversize();
+
+    /// Threads racing to acquire the same tiles elect one of them per tile.
+    void concurrentElection();
+};
@@ -0,0 +1,371 @@
+#include "spatialindextest.h"
+
+// Qt includes.
+#include <QtTest/QtTest>
+
+// STL includes.
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// QMapControl includes.
+#include <QMapControl/SpatialIndex.h>
+
+using namespace qmapcontrol;
+
+namespace
+{
+    /// A payload with an extent (points have a zero width and height).
+    struct Sample
+    {
+        /// The identifier (payloads are compared by identifier).
+        int id;
+
+        /// The minimum x coordinate.
+        double x;
+
+        /// The minimum y coordinate.
+        double y;
+
+        /// The width.
+        double width;
+
+        /// The height.
+        double height;
+
+        bool operator==(const Sample& other) const
+        {
+            return id == other.id;
+        }
+    };
+
+    /// The location of a sample as a point.
+    struct SamplePoint
+    {
+        spatial::Point<double> operator()(const Sample& sample) const
+        {
+            return spatial::Point<double>{ sample.x, sample.y };
+        }
+    };
+
+    /// The location of a sample as a box.
+    struct SampleBox
+    {
+        spatial::Box<double> operator()(const Sample& sample) const
+        {
+            return spatial::Box<double>{ sample.x, sample.y, sample.x + sample.width, sample.y + sample.height };
+        }
+    };
+
+    /// The area covered by the indexes.
+    const spatial::Box<double> kWorld{ -180.0, -90.0, 180.0, 90.0 };
+
+    /// The number of samples.
+    const int kSampleCount = 2000;
+
+    /// The number of queries per check.
+    const int kQueryCount = 200;
+
+    /*!
+     * Generate samples, some of them (partly) outside the world.
+     * @param seed The random seed.
+     * @return the samples.
+     */
+    std::vector<Sample> generateSamples(const unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<double> x(-190.0, 190.0);
+        std::uniform_real_distribution<double> y(-95.0, 95.0);
+        std::uniform_real_distribution<double> size(0.0, 8.0);
+        std::vector<Sample> samples;
+        samples.reserve(kSampleCount);
+        for (int i = 0; i < kSampleCount; ++i)
+        {
+            samples.push_back(Sample{ i, x(generator), y(generator), size(generator), size(generator) });
+        }
+        return samples;
+    }
+
+    /*!
+     * Generate a random query range.
+     * @param generator The random generator.
+     * @return the range.
+     */
+    spatial::Box<double> randomRange(std::mt19937& generator)
+    {
+        std::uniform_real_distribution<double> x(-200.0, 200.0);
+        std::uniform_real_distribution<double> y(-100.0, 100.0);
+        const double x1 = x(generator);
+        const double x2 = x(generator);
+        const double y1 = y(generator);
+        const double y2 = y(generator);
+        return spatial::Box<double>{ std::min(x1, x2), std::min(y1, y2), std::max(x1, x2), std::max(y1, y2) };
+    }
+
+    /*!
+     * Find the samples within a range by brute force.
+     * @param samples The samples.
+     * @param range The range.
+     * @param accessor The accessor of the samples' locations.
+     * @return the sorted identifiers of the samples within the range.
+     */
+    template<typename Accessor>
+    std::vector<int> bruteForce(const std::vector<Sample>& samples, const spatial::Box<double>& range, const Accessor& accessor)
+    {
+        using Entry = typename spatial::AccessorTraits<Sample, double, Accessor>::Entry;
+        std::vector<int> ids;
+        for (const Sample& sample : samples)
+        {
+            if (Entry(accessor(sample), sample).intersects(range))
+            {
+                ids.push_back(sample.id);
+            }
+        }
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    }
+
+    /*!
+     * Query an index.
+     * @param index The index.
+     * @param range The range.
+     * @return the sorted identifiers of the samples within the range.
+     */
+    template<typename Index>
+    std::vector<int> queryIds(const Index& index, const spatial::Box<double>& range)
+    {
+        std::vector<Sample> samples;
+        index.query(samples, range);
+        std::vector<int> ids;
+        ids.reserve(samples.size());
+        for (const Sample& sample : samples)
+        {
+            ids.push_back(sample.id);
+        }
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    }
+
+    /*!
+     * Check that random queries on an index match a brute force search.
+     * @param index The index.
+     * @param samples The samples in the index.
+     * @param accessor The accessor of the samples' locations.
+     * @param seed The random seed of the queries.
+     * @return the number of queries that did not match.
+     */
+    template<typename Index, typename Accessor>
+    int mismatches(const Index& index, const std::vector<Sample>& samples, const Accessor& accessor, const unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        int count = 0;
+
+        // Random ranges, the whole world and a single point.
+        for (int i = 0; i < kQueryCount; ++i)
+        {
+            const spatial::Box<double> range = randomRange(generator);
+            if (queryIds(index, range) != bruteForce(samples, range, accessor))
+            {
+                ++count;
+            }
+        }
+        const spatial::Box<double> fixed_ranges[] = { kWorld, spatial::Box<double>::fromPoint(spatial::Point<double>{ samples.front().x, samples.front().y }) };
+        for (const spatial::Box<double>& range : fixed_ranges)
+        {
+            if (queryIds(index, range) != bruteForce(samples, range, accessor))
+            {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    /*!
+     * Check erase on a dynamic index: every third sample is erased.
+     * @param index The index, containing the samples.
+     * @param samples The samples in the index.
+     * @param accessor The accessor of the samples' locations.
+     */
+    template<typename Index, typename Accessor>
+    void checkErase(Index& index, const std::vector<Sample>& samples, const Accessor& accessor)
+    {
+        std::vector<Sample> remaining;
+        for (const Sample& sample : samples)
+        {
+            if (sample.id % 3 == 0)
+            {
+                QVERIFY(index.erase(sample));
+            }
+            else
+            {
+                remaining.push_back(sample);
+            }
+        }
+        QCOMPARE(index.size(), remaining.size());
+        QCOMPARE(mismatches(index, remaining, accessor, 2), 0);
+
+        // Erasing again finds nothing.
+        QVERIFY(index.erase(samples.front()) == false);
+        QCOMPARE(index.size(), remaining.size());
+    }
+
+    /*!
+     * Check update on a dynamic index: every other sample is moved.
+     * @param index The index, containing the samples.
+     * @param samples The samples in the index (moved on return).
+     * @param accessor The accessor of the samples' locations.
+     */
+    template<typename Index, typename Accessor>
+    void checkUpdate(Index& index, std::vector<Sample>& samples, const Accessor& accessor)
+    {
+        std::mt19937 generator(3);
+        std::uniform_real_distribution<double> offset(-50.0, 50.0);
+        for (Sample& sample : samples)
+        {
+            if (sample.id % 2 == 0)
+            {
+                const auto old_location = accessor(sample);
+                sample.x += offset(generator);
+                sample.y += offset(generator);
+                QVERIFY(index.update(sample, old_location));
+            }
+        }
+        QCOMPARE(index.size(), samples.size());
+        QCOMPARE(mismatches(index, samples, accessor, 4), 0);
+
+        // Moving a payload that was not inserted inserts it.
+        const Sample added{ kSampleCount, 10.0, 10.0, 1.0, 1.0 };
+        QVERIFY(index.update(added, accessor(added)) == false);
+        QCOMPARE(index.size(), samples.size() + 1);
+    }
+}
+
+void SpatialIndexTest::query()
+{
+    const std::vector<Sample> samples = generateSamples(1);
+
+    // Quad trees (small nodes to subdivide deeply).
+    spatial::QuadTree<Sample, double, SamplePoint> quad_points(kWorld, 8);
+    spatial::QuadTree<Sample, double, SampleBox> quad_boxes(kWorld, 8);
+
+    // Uniform grids.
+    spatial::UniformGrid<Sample, double, SamplePoint> grid_points(kWorld, 10.0);
+    spatial::UniformGrid<Sample, double, SampleBox> grid_boxes(kWorld, 10.0);
+    for (const Sample& sample : samples)
+    {
+        quad_points.insert(sample);
+        quad_boxes.insert(sample);
+        grid_points.insert(sample);
+        grid_boxes.insert(sample);
+    }
+
+    // Packed R-trees (with a node size that does not divide the sample count).
+    spatial::PackedRTree<Sample, double, SamplePoint> rtree_points(9);
+    spatial::PackedRTree<Sample, double, SampleBox> rtree_boxes(16);
+    rtree_points.build(samples);
+    rtree_boxes.build(samples);
+
+    QCOMPARE(quad_points.size(), samples.size());
+    QCOMPARE(rtree_boxes.size(), samples.size());
+    QCOMPARE(grid_boxes.size(), samples.size());
+    QCOMPARE(mismatches(quad_points, samples, SamplePoint(), 1), 0);
+    QCOMPARE(mismatches(quad_boxes, samples, SampleBox(), 1), 0);
+    QCOMPARE(mismatches(rtree_points, samples, SamplePoint(), 1), 0);
+    QCOMPARE(mismatches(rtree_boxes, samples, SampleBox(), 1), 0);
+    QCOMPARE(mismatches(grid_points, samples, SamplePoint(), 1), 0);
+    QCOMPARE(mismatches(grid_boxes, samples, SampleBox(), 1), 0);
+
+    // Every payload is visited once.
+    std::size_t visited = 0;
+    quad_boxes.visitAll([&visited](const Sample&) { ++visited; });
+    QCOMPARE(visited, samples.size());
+}
+
+void SpatialIndexTest::queryEmpty()
+{
+    const spatial::Box<double> range{ -10.0, -10.0, 10.0, 10.0 };
+    spatial::QuadTree<Sample, double, SampleBox> quad(kWorld);
+    spatial::PackedRTree<Sample, double, SampleBox> rtree;
+    spatial::UniformGrid<Sample, double, SampleBox> grid(kWorld, 10.0);
+    rtree.build(std::vector<Sample>());
+    QVERIFY(queryIds(quad, range).empty());
+    QVERIFY(queryIds(rtree, range).empty());
+    QVERIFY(queryIds(grid, range).empty());
+
+    // A range outside the boundary only finds the payloads outside it.
+    const Sample outside{ 0, 500.0, 500.0, 1.0, 1.0 };
+    quad.insert(outside);
+    grid.insert(outside);
+    const spatial::Box<double> far_range{ 400.0, 400.0, 600.0, 600.0 };
+    QCOMPARE(queryIds(quad, far_range), std::vector<int>{ 0 });
+    QCOMPARE(queryIds(grid, far_range), std::vector<int>{ 0 });
+    QVERIFY(queryIds(quad, range).empty());
+    QVERIFY(queryIds(grid, range).empty());
+}
+
+void SpatialIndexTest::erase()
+{
+    const std::vector<Sample> samples = generateSamples(5);
+    spatial::QuadTree<Sample, double, SamplePoint> quad_points(kWorld, 8);
+    spatial::QuadTree<Sample, double, SampleBox> quad_boxes(kWorld, 8);
+    spatial::UniformGrid<Sample, double, SamplePoint> grid_points(kWorld, 10.0);
+    spatial::UniformGrid<Sample, double, SampleBox> grid_boxes(kWorld, 10.0);
+    for (const Sample& sample : samples)
+    {
+        quad_points.insert(sample);
+        quad_boxes.insert(sample);
+        grid_points.insert(sample);
+        grid_boxes.insert(sample);
+    }
+    checkErase(quad_points, samples, SamplePoint());
+    checkErase(quad_boxes, samples, SampleBox());
+    checkErase(grid_points, samples, SamplePoint());
+    checkErase(grid_boxes, samples, SampleBox());
+}
+
+void SpatialIndexTest::update()
+{
+    const std::vector<Sample> samples = generateSamples(7);
+    spatial::QuadTree<Sample, double, SamplePoint> quad_points(kWorld, 8);
+    spatial::QuadTree<Sample, double, SampleBox> quad_boxes(kWorld, 8);
+    spatial::UniformGrid<Sample, double, SamplePoint> grid_points(kWorld, 10.0);
+    spatial::UniformGrid<Sample, double, SampleBox> grid_boxes(kWorld, 10.0);
+    for (const Sample& sample : samples)
+    {
+        quad_points.insert(sample);
+        quad_boxes.insert(sample);
+        grid_points.insert(sample);
+        grid_boxes.insert(sample);
+    }
+    std::vector<Sample> moved = samples;
+    checkUpdate(quad_points, moved, SamplePoint());
+    moved = samples;
+    checkUpdate(quad_boxes, moved, SampleBox());
+    moved = samples;
+    checkUpdate(grid_points, moved, SamplePoint());
+    moved = samples;
+    checkUpdate(grid_boxes, moved, SampleBox());
+}
+
+void SpatialIndexTest::clear()
+{
+    const std::vector<Sample> samples = generateSamples(9);
+    spatial::QuadTree<Sample, double, SampleBox> quad(kWorld, 8);
+    spatial::PackedRTree<Sample, double, SampleBox> rtree;
+    spatial::UniformGrid<Sample, double, SampleBox> grid(kWorld, 10.0);
+    for (const Sample& sample : samples)
+    {
+        quad.insert(sample);
+        grid.insert(sample);
+    }
+    rtree.build(samples);
+    quad.clear();
+    rtree.clear();
+    grid.clear();
+    QCOMPARE(quad.size(), std::size_t(0));
+    QCOMPARE(rtree.size(), std::size_t(0));
+    QCOMPARE(grid.size(), std::size_t(0));
+    QVERIFY(queryIds(quad, kWorld).empty());
+    QVERIFY(queryIds(rtree, kWorld).empty());
+    QVERIFY(queryIds(grid, kWorld).empty());
+}
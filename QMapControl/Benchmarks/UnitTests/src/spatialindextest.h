@@ -0,0 +1,29 @@
+#pragma once
+
+// Qt includes.
+#include <QtCore/QObject>
+
+/*!
+ * Tests for the spatial indexes (QuadTree, PackedRTree and UniformGrid): queries, erase and update are
+ * compared with a brute force search over the same payloads, for point and box payloads.
+ */
+class SpatialIndexTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    /// Queries match a brute force search.
+    void query();
+
+    /// Queries on empty indexes and ranges outside the boundary.
+    void queryEmpty();
+
+    /// Erased payloads are no longer found, the others still are.
+    void erase();
+
+    /// Moved payloads are found at their new location only.
+    void update();
+
+    /// Clearing removes all payloads.
+    void clear();
+};
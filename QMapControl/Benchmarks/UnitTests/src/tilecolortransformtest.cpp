@@ -0,0 +1,211 @@
+#include "tilecolortransformtest.h"
+
+// Qt includes.
+#include <QtGui/QColor>
+#include <QtGui/QImage>
+#include <QtTest/QtTest>
+
+// STL includes.
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// QMapControl includes.
+#include <QMapControl/TileColorTransform.h>
+
+using namespace qmapcontrol;
+
+Q_DECLARE_METATYPE(qmapcontrol::TileColorTransform::Matrix)
+
+namespace
+{
+    /// The image width (not a multiple of the SIMD width, so the scalar tail is run too).
+    const int kWidth = 67;
+
+    /// The image height.
+    const int kHeight = 8;
+
+    /*!
+     * Create an image of random pixels, including the extreme channel values.
+     * @param seed The random seed.
+     * @return the image (ARGB32).
+     */
+    QImage randomImage(const unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_int_distribution<int> channel(0, 255);
+        QImage image(kWidth, kHeight, QImage::Format_ARGB32);
+        for (int y = 0; y < kHeight; ++y)
+        {
+            QRgb* pixels = reinterpret_cast<QRgb*>(image.scanLine(y));
+            for (int x = 0; x < kWidth; ++x)
+            {
+                pixels[x] = qRgba(channel(generator), channel(generator), channel(generator), channel(generator));
+            }
+        }
+        reinterpret_cast<QRgb*>(image.scanLine(0))[0] = qRgba(0, 0, 0, 0);
+        reinterpret_cast<QRgb*>(image.scanLine(0))[1] = qRgba(255, 255, 255, 255);
+        reinterpret_cast<QRgb*>(image.scanLine(0))[2] = qRgba(255, 0, 255, 128);
+        reinterpret_cast<QRgb*>(image.scanLine(0))[3] = qRgba(0, 255, 0, 1);
+        return image;
+    }
+
+    /*!
+     * Transform a pixel on its own (a row of 1 pixel is never vectorised).
+     * @param transform The transform.
+     * @param pixel The pixel.
+     * @return the transformed pixel.
+     */
+    QRgb transformAlone(const TileColorTransform& transform, const QRgb pixel)
+    {
+        QImage image(1, 1, QImage::Format_ARGB32);
+        *reinterpret_cast<QRgb*>(image.scanLine(0)) = pixel;
+        transform.apply(image);
+        return *reinterpret_cast<const QRgb*>(image.constScanLine(0));
+    }
+
+    /*!
+     * Transform a channel in double precision.
+     * @param m The colour matrix.
+     * @param row The row of the channel.
+     * @param pixel The pixel.
+     * @return the channel value (0-255).
+     */
+    int referenceChannel(const TileColorTransform::Matrix& m, const int row, const QRgb pixel)
+    {
+        const double value = double(m[std::size_t(row * 4)]) * qRed(pixel) + double(m[std::size_t(row * 4 + 1)]) * qGreen(pixel)
+                           + double(m[std::size_t(row * 4 + 2)]) * qBlue(pixel) + double(m[std::size_t(row * 4 + 3)]);
+        return std::min(255, std::max(0, int(std::floor(value + 0.5))));
+    }
+}
+
+void TileColorTransformTest::matrixKernels_data()
+{
+    QTest::addColumn<TileColorTransform::Matrix>("matrix");
+
+    QTest::newRow("identity") << TileColorTransform::Matrix{{ 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f }};
+    QTest::newRow("grayscale") << TileColorTransform::Matrix{{ 0.2126f, 0.7152f, 0.0722f, 0.0f, 0.2126f, 0.7152f, 0.0722f, 0.0f, 0.2126f, 0.7152f, 0.0722f, 0.0f }};
+    QTest::newRow("sepia") << TileColorTransform::Matrix{{ 0.393f, 0.769f, 0.189f, 0.0f, 0.349f, 0.686f, 0.168f, 0.0f, 0.272f, 0.534f, 0.131f, 0.0f }};
+    QTest::newRow("night") << TileColorTransform::Matrix{{ -0.3f, -0.6f, -0.1f, 200.0f, -0.3f, -0.6f, -0.1f, 180.0f, -0.2f, -0.4f, -0.1f, 160.0f }};
+    QTest::newRow("halves") << TileColorTransform::Matrix{{ 0.5f, 0.0f, 0.0f, 0.0f, 0.0f, 0.5f, 0.0f, 0.5f, 0.25f, 0.25f, 0.0f, 0.0f }};
+    QTest::newRow("out of range") << TileColorTransform::Matrix{{ 2.0f, 1.0f, 0.0f, -100.0f, -1.5f, 0.0f, 0.3f, 50.0f, 0.0f, 0.0f, 3.0f, 10.0f }};
+}
+
+void TileColorTransformTest::matrixKernels()
+{
+    QFETCH(TileColorTransform::Matrix, matrix);
+    const TileColorTransform transform = TileColorTransform::matrix(matrix);
+
+    for (unsigned seed = 1; seed <= 4; ++seed)
+    {
+        const QImage source = randomImage(seed);
+        QImage image = source;
+        transform.apply(image);
+        QCOMPARE(image.format(), QImage::Format_ARGB32);
+        for (int y = 0; y < kHeight; ++y)
+        {
+            const QRgb* before = reinterpret_cast<const QRgb*>(source.constScanLine(y));
+            const QRgb* after = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+            for (int x = 0; x < kWidth; ++x)
+            {
+                // The same as the scalar kernel, bit for bit.
+                QCOMPARE(after[x], transformAlone(transform, before[x]));
+
+                // The same as a double precision evaluation, give or take float rounding.
+                QVERIFY(std::abs(qRed(after[x]) - referenceChannel(matrix, 0, before[x])) <= 1);
+                QVERIFY(std::abs(qGreen(after[x]) - referenceChannel(matrix, 1, before[x])) <= 1);
+                QVERIFY(std::abs(qBlue(after[x]) - referenceChannel(matrix, 2, before[x])) <= 1);
+                QCOMPARE(qAlpha(after[x]), qAlpha(before[x]));
+            }
+        }
+    }
+}
+
+void TileColorTransformTest::rounding()
+{
+    // Halving an odd value gives an exact half, which rounds up in both kernels (1.5 -> 2, 2.5 -> 3).
+    const TileColorTransform half = TileColorTransform::matrix({{ 0.5f, 0.0f, 0.0f, 0.0f, 0.0f, 0.5f, 0.0f, 0.0f, 0.0f, 0.0f, 0.5f, 0.0f }});
+    QImage image(8, 1, QImage::Format_RGB32);
+    QRgb* pixels = reinterpret_cast<QRgb*>(image.scanLine(0));
+    for (int x = 0; x < 8; ++x)
+    {
+        pixels[x] = qRgb(2 * x + 1, 2 * x + 3, 255);
+    }
+    half.apply(image);
+    pixels = reinterpret_cast<QRgb*>(image.scanLine(0));
+    for (int x = 0; x < 8; ++x)
+    {
+        QCOMPARE(qRed(pixels[x]), x + 1);
+        QCOMPARE(qGreen(pixels[x]), x + 2);
+        QCOMPARE(qBlue(pixels[x]), 128);
+    }
+    QCOMPARE(qRed(transformAlone(half, qRgb(3, 5, 7))), 2);
+    QCOMPARE(qGreen(transformAlone(half, qRgb(3, 5, 7))), 3);
+    QCOMPARE(qBlue(transformAlone(half, qRgb(3, 5, 7))), 4);
+
+    // Out of range results are clamped.
+    const TileColorTransform out_of_range = TileColorTransform::matrix({{ 4.0f, 0.0f, 0.0f, 0.0f, -4.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 300.0f }});
+    image = QImage(5, 1, QImage::Format_RGB32);
+    image.fill(qRgb(200, 0, 0));
+    out_of_range.apply(image);
+    pixels = reinterpret_cast<QRgb*>(image.scanLine(0));
+    for (int x = 0; x < 5; ++x)
+    {
+        QCOMPARE(pixels[x], qRgb(255, 0, 255));
+    }
+}
+
+void TileColorTransformTest::luts()
+{
+    // The identity changes nothing and has no cache key.
+    const TileColorTransform identity;
+    QVERIFY(identity.isIdentity());
+    QVERIFY(identity.cacheKey().isEmpty());
+    QImage source = randomImage(5);
+    QImage image = source;
+    identity.apply(image);
+    QCOMPARE(image, source);
+
+    // Inverting twice folds into the identity table.
+    const TileColorTransform invert = TileColorTransform::invert();
+    QVERIFY(invert.cacheKey().isEmpty() == false);
+    image = source;
+    invert.apply(image);
+    for (int y = 0; y < kHeight; ++y)
+    {
+        const QRgb* before = reinterpret_cast<const QRgb*>(source.constScanLine(y));
+        const QRgb* after = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        for (int x = 0; x < kWidth; ++x)
+        {
+            QCOMPARE(after[x], qRgba(255 - qRed(before[x]), 255 - qGreen(before[x]), 255 - qBlue(before[x]), qAlpha(before[x])));
+        }
+    }
+    image = source;
+    invert.then(invert).apply(image);
+    QCOMPARE(image, source);
+
+    // Dimming lowers every channel by the offset.
+    const TileColorTransform dim = TileColorTransform::brightnessContrast(-0.2);
+    QCOMPARE(qRed(transformAlone(dim, qRgb(100, 200, 30))), 49);
+    QCOMPARE(qGreen(transformAlone(dim, qRgb(100, 200, 30))), 149);
+    QCOMPARE(qBlue(transformAlone(dim, qRgb(100, 200, 30))), 0);
+}
+
+void TileColorTransformTest::formats()
+{
+    const TileColorTransform invert = TileColorTransform::invert();
+
+    // Opaque formats become RGB32.
+    QImage rgb(6, 2, QImage::Format_RGB888);
+    rgb.fill(QColor(10, 20, 30));
+    invert.apply(rgb);
+    QCOMPARE(rgb.format(), QImage::Format_RGB32);
+    QCOMPARE(rgb.pixel(5, 1), qRgb(245, 235, 225));
+
+    // Premultiplied pixels are unpremultiplied first (alpha is kept).
+    QImage premultiplied(6, 2, QImage::Format_ARGB32_Premultiplied);
+    premultiplied.fill(QColor(255, 0, 0, 255));
+    invert.apply(premultiplied);
+    QCOMPARE(premultiplied.format(), QImage::Format_ARGB32);
+    QCOMPARE(premultiplied.pixel(5, 1), qRgba(0, 255, 255, 255));
+}
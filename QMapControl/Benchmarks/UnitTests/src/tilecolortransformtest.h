@@ -0,0 +1,27 @@
+#pragma once
+
+// Qt includes.
+#include <QtCore/QObject>
+
+/*!
+ * Tests for TileColorTransform: the vectorised colour matrix kernel matches the scalar one pixel for pixel,
+ * and the transforms round, clamp and keep alpha as documented.
+ */
+class TileColorTransformTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    /// The vectorised pixels (rows of 4) match the scalar pixels (rows of 1), and a reference evaluation.
+    void matrixKernels_data();
+    void matrixKernels();
+
+    /// Halves round up (not to even) and the results are clamped.
+    void rounding();
+
+    /// Lookup table transforms (invert, brightness/contrast) and the identity.
+    void luts();
+
+    /// Other formats are converted, alpha is kept.
+    void formats();
+};
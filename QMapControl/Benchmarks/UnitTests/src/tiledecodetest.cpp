@@ -0,0 +1,91 @@
+#include "tiledecodetest.h"
+
+// Qt includes.
+#include <QtTest/QtTest>
+
+// STL includes.
+#include <algorithm>
+
+// QMapControl includes.
+#include <QMapControl/TileDecode.h>
+
+using namespace qmapcontrol;
+
+Q_DECLARE_METATYPE(qmapcontrol::TileOpacity)
+
+namespace
+{
+    /// The tile size (pixels).
+    const int kTileSizePx = 256;
+}
+
+void TileDecodeTest::classifyFormats()
+{
+    QVERIFY(tiledecode::classify(QImage()) == TileOpacity::Mixed);
+
+    // Formats without an alpha channel are opaque whatever their pixels.
+    QImage rgb(kTileSizePx, kTileSizePx, QImage::Format_RGB32);
+    rgb.fill(Qt::black);
+    QVERIFY(tiledecode::classify(rgb) == TileOpacity::Opaque);
+    QImage rgb888(kTileSizePx, kTileSizePx, QImage::Format_RGB888);
+    rgb888.fill(Qt::white);
+    QVERIFY(tiledecode::classify(rgb888) == TileOpacity::Opaque);
+
+    // Other formats with an alpha channel are converted first.
+    QImage indexed(kTileSizePx, kTileSizePx, QImage::Format_Indexed8);
+    indexed.setColorTable({ qRgba(0, 0, 0, 0), qRgba(255, 0, 0, 255) });
+    indexed.fill(0);
+    QVERIFY(tiledecode::classify(indexed) == TileOpacity::Transparent);
+    indexed.setPixel(10, 10, 1);
+    QVERIFY(tiledecode::classify(indexed) == TileOpacity::Mixed);
+    indexed.fill(1);
+    QVERIFY(tiledecode::classify(indexed) == TileOpacity::Opaque);
+}
+
+void TileDecodeTest::classifyAlpha_data()
+{
+    QTest::addColumn<int>("format");
+    QTest::addColumn<QRgb>("fill");
+    QTest::addColumn<QPoint>("pixel");
+    QTest::addColumn<QRgb>("pixel_value");
+    QTest::addColumn<TileOpacity>("expected");
+
+    // Uniform tiles (the pixel is set to the fill).
+    const QPoint origin(0, 0);
+    QTest::newRow("opaque") << int(QImage::Format_ARGB32) << qRgba(10, 20, 30, 255) << origin << qRgba(10, 20, 30, 255) << TileOpacity::Opaque;
+    QTest::newRow("transparent") << int(QImage::Format_ARGB32) << qRgba(0, 0, 0, 0) << origin << qRgba(0, 0, 0, 0) << TileOpacity::Transparent;
+    QTest::newRow("transparent colour") << int(QImage::Format_ARGB32) << qRgba(255, 255, 255, 0) << origin << qRgba(255, 255, 255, 0) << TileOpacity::Transparent;
+    QTest::newRow("translucent") << int(QImage::Format_ARGB32) << qRgba(10, 20, 30, 128) << origin << qRgba(10, 20, 30, 128) << TileOpacity::Mixed;
+    QTest::newRow("premultiplied opaque") << int(QImage::Format_ARGB32_Premultiplied) << qRgba(10, 20, 30, 255) << origin << qRgba(10, 20, 30, 255) << TileOpacity::Opaque;
+    QTest::newRow("premultiplied transparent") << int(QImage::Format_ARGB32_Premultiplied) << qRgba(0, 0, 0, 0) << origin << qRgba(0, 0, 0, 0) << TileOpacity::Transparent;
+
+    // A single different pixel (first, last and in the middle of the tile).
+    const QPoint last(kTileSizePx - 1, kTileSizePx - 1);
+    const QPoint middle(kTileSizePx / 2, kTileSizePx / 3);
+    QTest::newRow("opaque, first transparent") << int(QImage::Format_ARGB32) << qRgba(10, 20, 30, 255) << origin << qRgba(0, 0, 0, 0) << TileOpacity::Mixed;
+    QTest::newRow("opaque, last translucent") << int(QImage::Format_ARGB32) << qRgba(10, 20, 30, 255) << last << qRgba(10, 20, 30, 254) << TileOpacity::Mixed;
+    QTest::newRow("transparent, last opaque") << int(QImage::Format_ARGB32) << qRgba(0, 0, 0, 0) << last << qRgba(10, 20, 30, 255) << TileOpacity::Mixed;
+    QTest::newRow("transparent, middle translucent") << int(QImage::Format_ARGB32) << qRgba(0, 0, 0, 0) << middle << qRgba(0, 0, 0, 1) << TileOpacity::Mixed;
+    QTest::newRow("premultiplied opaque, middle transparent") << int(QImage::Format_ARGB32_Premultiplied) << qRgba(10, 20, 30, 255) << middle << qRgba(0, 0, 0, 0) << TileOpacity::Mixed;
+
+    // Alpha values whose bits AND to 0 and OR to 255 (neither fully opaque nor fully transparent).
+    QTest::newRow("complementary alpha") << int(QImage::Format_ARGB32) << qRgba(0, 0, 0, 0xF0) << middle << qRgba(0, 0, 0, 0x0F) << TileOpacity::Mixed;
+}
+
+void TileDecodeTest::classifyAlpha()
+{
+    QFETCH(int, format);
+    QFETCH(QRgb, fill);
+    QFETCH(QPoint, pixel);
+    QFETCH(QRgb, pixel_value);
+    QFETCH(TileOpacity, expected);
+
+    QImage image(kTileSizePx, kTileSizePx, QImage::Format(format));
+    for (int y = 0; y < image.height(); ++y)
+    {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        std::fill(line, line + image.width(), fill);
+    }
+    reinterpret_cast<QRgb*>(image.scanLine(pixel.y()))[pixel.x()] = pixel_value;
+    QVERIFY(tiledecode::classify(image) == expected);
+}
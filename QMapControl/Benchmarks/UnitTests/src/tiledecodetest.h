@@ -0,0 +1,20 @@
+#pragma once
+
+// Qt includes.
+#include <QtCore/QObject>
+
+/*!
+ * Tests for tiledecode::classify(): how opaque a decoded tile is.
+ */
+class TileDecodeTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    /// Null tiles are mixed, tiles without an alpha channel are opaque.
+    void classifyFormats();
+
+    /// Tiles with an alpha channel are classified by their pixels.
+    void classifyAlpha_data();
+    void classifyAlpha();
+};
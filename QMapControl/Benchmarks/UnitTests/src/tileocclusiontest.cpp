@@ -0,0 +1,145 @@
+#include "tileocclusiontest.h"
+
+// Qt includes.
+#include <QtTest/QtTest>
+
+// QMapControl includes.
+#include <QMapControl/TileOcclusion.h>
+
+using namespace qmapcontrol;
+
+namespace
+{
+    /// The tile size (pixels).
+    const int kTileSizePx = 256;
+
+    /// The number of layers.
+    const int kLayerCount = 3;
+
+    /// A backbuffer over tiles -1 to 2 (x) and 0 to 1 (y).
+    const RectWorldPx kBackbufferRectPx(PointWorldPx(-100.0, 10.0), PointWorldPx(700.0, 500.0));
+}
+
+void TileOcclusionTest::reset()
+{
+    TileOcclusion occlusion;
+    QVERIFY(occlusion.isEmpty());
+    occlusion.reset(kBackbufferRectPx, kTileSizePx, kLayerCount);
+    QVERIFY(occlusion.isEmpty());
+    for (int depth = 0; depth < kLayerCount; ++depth)
+    {
+        occlusion.setDepth(depth);
+        for (int x = -1; x <= 2; ++x)
+        {
+            for (int y = 0; y <= 1; ++y)
+            {
+                QVERIFY(occlusion.isOccluded(x, y) == false);
+            }
+        }
+    }
+
+    // A reset uncovers the tiles.
+    occlusion.setDepth(2);
+    occlusion.occlude(0, 0);
+    QVERIFY(occlusion.isEmpty() == false);
+    occlusion.reset(kBackbufferRectPx, kTileSizePx, kLayerCount);
+    QVERIFY(occlusion.isEmpty());
+    QVERIFY(occlusion.isOccluded(0, 0) == false);
+}
+
+void TileOcclusionTest::occlude()
+{
+    TileOcclusion occlusion;
+    occlusion.reset(kBackbufferRectPx, kTileSizePx, kLayerCount);
+
+    // The layers are walked from the top: the top layer covers (0, 0) and the middle layer (0, 0) and (1, 1).
+    occlusion.setDepth(2);
+    occlusion.occlude(0, 0);
+    occlusion.setDepth(1);
+    occlusion.occlude(0, 0);
+    occlusion.occlude(1, 1);
+
+    // The top layer draws everything.
+    occlusion.setDepth(2);
+    QVERIFY(occlusion.isOccluded(0, 0) == false);
+    QVERIFY(occlusion.isOccluded(1, 1) == false);
+
+    // The middle layer skips the tile covered by the top layer only.
+    occlusion.setDepth(1);
+    QVERIFY(occlusion.isOccluded(0, 0));
+    QVERIFY(occlusion.isOccluded(1, 1) == false);
+
+    // The bottom layer skips both.
+    occlusion.setDepth(0);
+    QVERIFY(occlusion.isOccluded(0, 0));
+    QVERIFY(occlusion.isOccluded(1, 1));
+    QVERIFY(occlusion.isOccluded(2, 1) == false);
+    QVERIFY(occlusion.isOccluded(-1, 0) == false);
+}
+
+void TileOcclusionTest::outsideBackbuffer()
+{
+    TileOcclusion occlusion;
+    occlusion.reset(kBackbufferRectPx, kTileSizePx, kLayerCount);
+    occlusion.setDepth(2);
+    occlusion.occlude(-2, 0);
+    occlusion.occlude(3, 0);
+    occlusion.occlude(0, -1);
+    occlusion.occlude(0, 2);
+    QVERIFY(occlusion.isEmpty());
+    occlusion.setDepth(0);
+    QVERIFY(occlusion.isOccluded(-2, 0) == false);
+    QVERIFY(occlusion.isOccluded(3, 0) == false);
+    QVERIFY(occlusion.isOccluded(0, -1) == false);
+    QVERIFY(occlusion.isOccluded(0, 2) == false);
+
+    // The edge tiles are inside.
+    occlusion.setDepth(2);
+    occlusion.occlude(-1, 0);
+    occlusion.occlude(2, 1);
+    occlusion.setDepth(0);
+    QVERIFY(occlusion.isOccluded(-1, 0));
+    QVERIFY(occlusion.isOccluded(2, 1));
+}
+
+void TileOcclusionTest::tiles()
+{
+    TileOcclusion occlusion;
+    occlusion.reset(kBackbufferRectPx, kTileSizePx, kLayerCount);
+
+    // Keep a tile for the top and the bottom layers.
+    TileOcclusion::Tile top_tile;
+    top_tile.url = QUrl("http://tiles.example/2/0/0.png");
+    top_tile.opacity = TileOpacity::Opaque;
+    occlusion.setDepth(2);
+    occlusion.setTile(0, 0, top_tile);
+    TileOcclusion::Tile bottom_tile;
+    bottom_tile.url = QUrl("http://tiles.example/0/0/0.png");
+    occlusion.setDepth(0);
+    occlusion.setTile(0, 0, bottom_tile);
+
+    // Each layer finds its own tile.
+    occlusion.setDepth(2);
+    QVERIFY(occlusion.findTile(0, 0) != nullptr);
+    QCOMPARE(occlusion.findTile(0, 0)->url, top_tile.url);
+    QVERIFY(occlusion.findTile(0, 0)->opacity == TileOpacity::Opaque);
+    QVERIFY(occlusion.findTile(1, 0) == nullptr);
+    occlusion.setDepth(1);
+    QVERIFY(occlusion.findTile(0, 0) == nullptr);
+    occlusion.setDepth(0);
+    QVERIFY(occlusion.findTile(0, 0) != nullptr);
+    QCOMPARE(occlusion.findTile(0, 0)->url, bottom_tile.url);
+    QVERIFY(occlusion.findTile(0, 0)->opacity == TileOpacity::Mixed);
+
+    // Tiles outside the backbuffer or the layers are not kept.
+    occlusion.setTile(3, 0, bottom_tile);
+    QVERIFY(occlusion.findTile(3, 0) == nullptr);
+    occlusion.setDepth(kLayerCount);
+    occlusion.setTile(0, 0, bottom_tile);
+    QVERIFY(occlusion.findTile(0, 0) == nullptr);
+
+    // A reset forgets the tiles.
+    occlusion.reset(kBackbufferRectPx, kTileSizePx, kLayerCount);
+    occlusion.setDepth(2);
+    QVERIFY(occlusion.findTile(0, 0) == nullptr);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+// Qt includes.
+#include <QtCore/QObject>
+
+/*!
+ * Tests for TileOcclusion: which tiles each layer skips, and the tiles kept for each layer's draw.
+ */
+class TileOcclusionTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    /// A reset backbuffer covers nothing.
+    void reset();
+
+    /// Opaque tiles hide the tiles of the layers below them only.
+    void occlude();
+
+    /// Tiles outside the backbuffer are never covered.
+    void outsideBackbuffer();
+
+    /// The tiles looked up by a layer are found at its depth only, until the next reset.
+    void tiles();
+};
@@ -29,5 +29,6 @@ DESTDIR = lib
 
 # Add Qt modules.
 QT +=                               \
+    concurrent                      \
     network                         \
     widgets                         \
@@ -8,3 +8,4 @@ CONFIG += ordered
 SUBDIRS +=                  \
     src                     \
     Samples                 \
+    Benchmarks              \
@@ -0,0 +1,241 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "CacheRefresher.h"
+
+// Qt includes.
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtCore/QDateTime>
+#include <QtCore/QStringList>
+#include <QtNetwork/QNetworkCacheMetaData>
+
+// STL includes.
+#include <algorithm>
+
+// Local includes.
+#include "ImageManager.h"
+#include "QMapControl.h"
+
+namespace qmapcontrol
+{
+    namespace
+    {
+        /// Interval between refresh steps.
+        const std::chrono::milliseconds kRefreshInterval(1000);
+
+        /// The number of disk cache files read per refresh step.
+        const int kScanFiles = 64;
+
+        /// The maximum number of tiles queued for revalidation.
+        const std::size_t kMaxDueTiles = 256;
+
+        /// The minimum age of an expired tile before it is revalidated (again).
+        const std::chrono::seconds kMinRevalidateAge(3600);
+    }
+
+    CacheRefresher::CacheRefresher(QMapControl* map_control, QObject* parent)
+        : QObject(parent),
+          m_map_control(map_control),
+          m_max_age(7 * 24 * 3600),
+          m_pass_interval(3600),
+          m_batch_size(4),
+          m_idle_delay(5000),
+          m_refresh_count(0)
+    {
+        // Connect signal/slot for the periodic refreshing.
+        m_refresh_timer.setInterval(int(kRefreshInterval.count()));
+        connect(&m_refresh_timer, &QTimer::timeout, this, &CacheRefresher::refresh);
+
+        // Connect signal/slot to queue the tiles found by a walk.
+        connect(&m_scan_watcher, &QFutureWatcher<std::vector<QUrl>>::finished, this, &CacheRefresher::scanFinished);
+
+        // Start the clock.
+        m_view_clock.start();
+    }
+
+    CacheRefresher::~CacheRefresher()
+    {
+        // Stop refreshing.
+        stop();
+        m_scan_watcher.waitForFinished();
+    }
+
+    void CacheRefresher::setMaxAge(const std::chrono::seconds& age)
+    {
+        // Set the maximum age.
+        m_max_age = age;
+    }
+
+    void CacheRefresher::setPassInterval(const std::chrono::seconds& interval)
+    {
+        // Set the pass interval.
+        m_pass_interval = interval;
+    }
+
+    void CacheRefresher::setBatchSize(const int count)
+    {
+        // Set the batch size.
+        m_batch_size = std::max(1, count);
+    }
+
+    void CacheRefresher::setIdleDelay(const std::chrono::milliseconds& delay)
+    {
+        // Set the idle delay.
+        m_idle_delay = delay;
+    }
+
+    void CacheRefresher::start()
+    {
+        // Follow the view changes.
+        if (m_map_control != nullptr && isRunning() == false)
+        {
+            connect(m_map_control.data(), &QMapControl::mapFocusPointChanged, this, &CacheRefresher::viewChanged);
+            connect(m_map_control.data(), &QMapControl::zoomChanged, this, &CacheRefresher::viewChanged);
+            m_refresh_timer.start();
+
+            // Wait for the idle delay.
+            viewChanged();
+        }
+    }
+
+    void CacheRefresher::stop()
+    {
+        // Stop following the view changes.
+        if (m_map_control != nullptr)
+        {
+            disconnect(m_map_control.data(), nullptr, this, nullptr);
+        }
+        m_refresh_timer.stop();
+    }
+
+    bool CacheRefresher::isRunning() const
+    {
+        // Return whether the periodic refreshing is running.
+        return m_refresh_timer.isActive();
+    }
+
+    int CacheRefresher::refreshCount() const
+    {
+        // Return the number of tiles revalidated.
+        return m_refresh_count;
+    }
+
+    void CacheRefresher::refresh()
+    {
+        // Back off completely while the user interacts or the foreground tiles are loading.
+        ImageManager& image_manager = ImageManager::get();
+        if (m_view_clock.elapsed() < m_idle_delay.count() || image_manager.downloadQueueSize() > 0 || image_manager.providerQueueSize() > 0)
+        {
+            return;
+        }
+
+        // Only refresh a disk cache that may be updated from the network.
+        if (image_manager.cachePolicy() != ImageManager::CachePolicy::PreferNetwork && image_manager.cachePolicy() != ImageManager::CachePolicy::PreferCache)
+        {
+            return;
+        }
+
+        // Find more tiles due for revalidation (in the background).
+        if (m_due.size() < std::size_t(m_batch_size) && m_scan_watcher.isRunning() == false)
+        {
+            m_scan_watcher.setFuture(QtConcurrent::run(this, &CacheRefresher::scan, m_max_age, m_pass_interval));
+        }
+
+        // Revalidate a batch (the next batch waits for the download queue to drain).
+        for (int i = 0; i < m_batch_size && m_due.empty() == false; ++i)
+        {
+            const QUrl url = m_due.front();
+            m_due.pop_front();
+            m_due_urls.remove(url);
+            if (image_manager.refreshImage(url))
+            {
+                ++m_refresh_count;
+            }
+        }
+    }
+
+    void CacheRefresher::viewChanged()
+    {
+        // Restart the idle delay.
+        m_view_clock.restart();
+    }
+
+    void CacheRefresher::scanFinished()
+    {
+        // Queue the tiles found (once).
+        for (const auto& url : m_scan_watcher.result())
+        {
+            if (m_due.size() < kMaxDueTiles && m_due_urls.contains(url) == false)
+            {
+                m_due.push_back(url);
+                m_due_urls.insert(url);
+            }
+        }
+    }
+
+    std::vector<QUrl> CacheRefresher::scan(const std::chrono::seconds& max_age, const std::chrono::seconds& pass_interval)
+    {
+        ImageManager& image_manager = ImageManager::get();
+        std::vector<QUrl> due;
+
+        // Start a new pass once the pass interval has elapsed.
+        if (m_walk == nullptr)
+        {
+            const QString cache_dir = image_manager.getCacheDir();
+            if (cache_dir.isEmpty() || (m_pass_clock.isValid() && m_pass_clock.elapsed() < qint64(pass_interval.count()) * 1000))
+            {
+                return due;
+            }
+            m_walk.reset(new QDirIterator(cache_dir, QStringList() << "*.d", QDir::Files, QDirIterator::Subdirectories));
+        }
+
+        // Find the tiles past their maximum age, or expired for a while.
+        const QDateTime now = QDateTime::currentDateTimeUtc();
+        for (int i = 0; i < kScanFiles && m_walk->hasNext(); ++i)
+        {
+            const QNetworkCacheMetaData meta_data = image_manager.diskCacheFileMetaData(m_walk->next());
+            if (meta_data.isValid() == false)
+            {
+                continue;
+            }
+
+            // The cache file is rewritten each time the tile is downloaded or revalidated.
+            const qint64 age_s = m_walk->fileInfo().lastModified().secsTo(now);
+            const bool expired = meta_data.expirationDate().isValid() && meta_data.expirationDate() < now;
+            if (age_s > qint64(max_age.count()) || (expired && age_s > qint64(kMinRevalidateAge.count())))
+            {
+                due.push_back(meta_data.url());
+            }
+        }
+
+        // Has the pass finished?
+        if (m_walk->hasNext() == false)
+        {
+            m_walk.reset();
+            m_pass_clock.start();
+        }
+        return due;
+    }
+}
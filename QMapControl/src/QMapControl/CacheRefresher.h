@@ -0,0 +1,198 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// Qt includes.
+#include <QtCore/QDirIterator>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QObject>
+#include <QtCore/QPointer>
+#include <QtCore/QSet>
+#include <QtCore/QTimer>
+#include <QtCore/QUrl>
+
+// STL includes.
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <vector>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+
+namespace qmapcontrol
+{
+    //! Forward declaration.
+    class QMapControl;
+
+    //! Revalidates the expired tiles of the disk cache in the background.
+    /*!
+     * The refresher walks the disk cache of the Image Manager a few files at a time (in a background
+     * thread) and finds the
+     * tiles older than the maximum age, or past their expiry date (see the server's Cache-Control
+     * and Expires headers). While the user is not interacting and no visible or prefetched tile is
+     * being downloaded, they are revalidated with the server in small batches at the lowest network
+     * priority (a tile that did not change costs a 304 response). Only the PreferNetwork and
+     * PreferCache policies are refreshed.
+     *
+     * The refresher must be created in the GUI thread and is stopped until start() is called.
+     */
+    class QMAPCONTROL_EXPORT CacheRefresher : public QObject
+    {
+        Q_OBJECT
+    public:
+        //! Constructor.
+        /*!
+         * This constructs a stopped cache refresher.
+         * @param map_control The map control whose interactions pause the refreshing.
+         * @param parent QObject parent ownership.
+         */
+        explicit CacheRefresher(QMapControl* map_control, QObject* parent = nullptr);
+
+        //! Disable copy constructor.
+        CacheRefresher(const CacheRefresher&) = delete;
+
+        //! Disable copy assignment.
+        CacheRefresher& operator=(const CacheRefresher&) = delete;
+
+        //! Destructor.
+        ~CacheRefresher();
+
+        /*!
+         * Set the age after which a tile is refreshed, even if it has not expired (default: 7 days).
+         * @param age The maximum age.
+         */
+        void setMaxAge(const std::chrono::seconds& age);
+
+        /*!
+         * Set the time between the passes over the disk cache (default: 1 hour).
+         * @param interval The pass interval.
+         */
+        void setPassInterval(const std::chrono::seconds& interval);
+
+        /*!
+         * Set the number of tiles revalidated at once (default: 4).
+         * @param count The batch size.
+         */
+        void setBatchSize(const int count);
+
+        /*!
+         * Set how long the view must be unchanged before refreshing (default: 5 seconds).
+         * @param delay The idle delay.
+         */
+        void setIdleDelay(const std::chrono::milliseconds& delay);
+
+        /*!
+         * Start refreshing.
+         */
+        void start();
+
+        /*!
+         * Stop refreshing (the revalidations in progress complete).
+         */
+        void stop();
+
+        /*!
+         * Whether the refresher is running.
+         * @return whether the refresher is running.
+         */
+        bool isRunning() const;
+
+        /*!
+         * Fetch the number of tiles revalidated since the refresher was created.
+         * @return the number of revalidation requests.
+         */
+        int refreshCount() const;
+
+    public slots:
+        /*!
+         * Walk the next files of the disk cache and revalidate a batch of tiles, if the network and the
+         * user are idle (also called periodically).
+         */
+        void refresh();
+
+    private slots:
+        /*!
+         * Slot to note a view change (the refreshing backs off).
+         */
+        void viewChanged();
+
+        /*!
+         * Slot to queue the tiles found by a walk of the disk cache.
+         */
+        void scanFinished();
+
+    private:
+        /*!
+         * Walk the next files of the disk cache (background thread).
+         * @param max_age The age after which a tile is refreshed.
+         * @param pass_interval The time between the passes over the disk cache.
+         * @return the tiles due for revalidation.
+         */
+        std::vector<QUrl> scan(const std::chrono::seconds& max_age, const std::chrono::seconds& pass_interval);
+
+    private:
+        /// The map control.
+        QPointer<QMapControl> m_map_control;
+
+        /// The age after which a tile is refreshed.
+        std::chrono::seconds m_max_age;
+
+        /// The time between the passes over the disk cache.
+        std::chrono::seconds m_pass_interval;
+
+        /// The number of tiles revalidated at once.
+        int m_batch_size;
+
+        /// How long the view must be unchanged before refreshing.
+        std::chrono::milliseconds m_idle_delay;
+
+        /// Measures the time since the view last changed.
+        QElapsedTimer m_view_clock;
+
+        /// Measures the time since the last pass finished (invalid before the first pass, used by the background thread).
+        QElapsedTimer m_pass_clock;
+
+        /// The walk of the current pass over the disk cache (nullptr between passes, used by the background thread).
+        std::unique_ptr<QDirIterator> m_walk;
+
+        /// Watches the walk of the next files of the disk cache.
+        QFutureWatcher<std::vector<QUrl>> m_scan_watcher;
+
+        /// The tiles due for revalidation, in the order found.
+        std::deque<QUrl> m_due;
+
+        /// The urls in m_due.
+        QSet<QUrl> m_due_urls;
+
+        /// The number of tiles revalidated.
+        int m_refresh_count;
+
+        /// The timer for the periodic refreshing.
+        QTimer m_refresh_timer;
+    };
+}
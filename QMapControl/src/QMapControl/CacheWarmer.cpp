@@ -0,0 +1,383 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "CacheWarmer.h"
+
+// Qt includes.
+#include <QtCore/QDataStream>
+#include <QtCore/QFile>
+#include <QtCore/QSaveFile>
+
+// STL includes.
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+// Local includes.
+#include "ImageManager.h"
+#include "LayerMapAdapter.h"
+#include "Projection.h"
+#include "QMapControl.h"
+
+namespace qmapcontrol
+{
+    namespace
+    {
+        /// The history file magic number ("QMCW").
+        const quint32 kHistoryMagic = 0x514D4357;
+
+        /// The history file version.
+        const quint32 kHistoryVersion = 1;
+
+        /// The weight kept from the previous sessions when the history is loaded.
+        const double kSessionDecay = 0.75;
+
+        /// The maximum number of tiles in the histogram (the least viewed half is dropped beyond).
+        const int kMaxHistogramTiles = 8192;
+
+        /// The maximum number of tiles recorded per view.
+        const int kMaxViewTiles = 256;
+
+        /// How long the view must be unchanged to be recorded.
+        const std::chrono::milliseconds kSettleDelay(1000);
+
+        /// Interval between warming passes.
+        const std::chrono::milliseconds kWarmInterval(5000);
+
+        /// The assumed tile size until the network metrics tell otherwise (bytes).
+        const double kDefaultTileBytes = 16.0 * 1024.0;
+
+        /*!
+         * Pack a tile into a histogram key.
+         * @param zoom The controller zoom.
+         * @param x The x coordinate of the tile.
+         * @param y The y coordinate of the tile.
+         * @return the key.
+         */
+        quint64 packTile(const int zoom, const int x, const int y)
+        {
+            return (quint64(zoom & 0xFF) << 56) | (quint64(x & 0xFFFFFFF) << 28) | quint64(y & 0xFFFFFFF);
+        }
+
+        /*!
+         * Unpack a histogram key.
+         * @param key The key.
+         * @param weight The weight of the tile.
+         * @return the tile.
+         */
+        HotTile unpackTile(const quint64 key, const double weight)
+        {
+            return { int(key >> 56), int((key >> 28) & 0xFFFFFFF), int(key & 0xFFFFFFF), weight };
+        }
+    }
+
+    CacheWarmer::CacheWarmer(QMapControl* map_control, QObject* parent)
+        : QObject(parent),
+          m_map_control(map_control),
+          m_hot_tile_count(32),
+          m_bandwidth_budget(2 * 1024 * 1024),
+          m_bandwidth_left(0.0),
+          m_idle_delay(3000)
+    {
+        // Connect signal/slot to record the view once it settles.
+        m_settle_timer.setSingleShot(true);
+        m_settle_timer.setInterval(int(kSettleDelay.count()));
+        connect(&m_settle_timer, &QTimer::timeout, this, &CacheWarmer::recordView);
+
+        // Connect signal/slot for the periodic warming.
+        m_warm_timer.setInterval(int(kWarmInterval.count()));
+        connect(&m_warm_timer, &QTimer::timeout, this, &CacheWarmer::warm);
+
+        // Start the clocks.
+        m_view_clock.start();
+        m_bandwidth_clock.start();
+    }
+
+    CacheWarmer::~CacheWarmer()
+    {
+        // Stop and persist the history.
+        stop();
+        if (m_history_file.isEmpty() == false)
+        {
+            saveHistory();
+        }
+    }
+
+    bool CacheWarmer::setHistoryFile(const QString& file_path)
+    {
+        // Set the history file.
+        m_history_file = file_path;
+
+        // Open the history.
+        QFile file(file_path);
+        if (file.open(QIODevice::ReadOnly) == false)
+        {
+            return false;
+        }
+        QDataStream stream(&file);
+        quint32 magic;
+        quint32 version;
+        quint32 count;
+        stream >> magic >> version >> count;
+        if (stream.status() != QDataStream::Ok || magic != kHistoryMagic || version != kHistoryVersion)
+        {
+            return false;
+        }
+
+        // Merge the history (the previous sessions weigh less).
+        for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i)
+        {
+            quint64 key;
+            double weight;
+            stream >> key >> weight;
+            if (stream.status() == QDataStream::Ok)
+            {
+                m_histogram[key] += weight * kSessionDecay;
+            }
+        }
+        return stream.status() == QDataStream::Ok;
+    }
+
+    bool CacheWarmer::saveHistory() const
+    {
+        // Write the history (replacing the file once complete).
+        QSaveFile file(m_history_file);
+        if (m_history_file.isEmpty() || file.open(QIODevice::WriteOnly) == false)
+        {
+            return false;
+        }
+        QDataStream stream(&file);
+        stream << kHistoryMagic << kHistoryVersion << quint32(m_histogram.size());
+        for (auto it = m_histogram.constBegin(); it != m_histogram.constEnd(); ++it)
+        {
+            stream << it.key() << it.value();
+        }
+        return stream.status() == QDataStream::Ok && file.commit();
+    }
+
+    void CacheWarmer::setHotTileCount(const int count)
+    {
+        // Set the number of hot tiles.
+        m_hot_tile_count = std::max(0, count);
+    }
+
+    void CacheWarmer::setBandwidthBudget(const qint64 bytes_per_minute)
+    {
+        // Set the bandwidth budget.
+        m_bandwidth_budget = std::max<qint64>(0, bytes_per_minute);
+        m_bandwidth_left = std::min(m_bandwidth_left, double(m_bandwidth_budget));
+    }
+
+    void CacheWarmer::setIdleDelay(const std::chrono::milliseconds& delay)
+    {
+        // Set the idle delay.
+        m_idle_delay = delay;
+    }
+
+    void CacheWarmer::start()
+    {
+        // Follow the view changes.
+        if (m_map_control != nullptr && isRunning() == false)
+        {
+            connect(m_map_control.data(), &QMapControl::mapFocusPointChanged, this, &CacheWarmer::viewChanged);
+            connect(m_map_control.data(), &QMapControl::zoomChanged, this, &CacheWarmer::viewChanged);
+            m_warm_timer.start();
+
+            // Record the current view.
+            viewChanged();
+        }
+    }
+
+    void CacheWarmer::stop()
+    {
+        // Stop following the view changes.
+        if (m_map_control != nullptr)
+        {
+            disconnect(m_map_control.data(), nullptr, this, nullptr);
+        }
+        m_settle_timer.stop();
+        m_warm_timer.stop();
+    }
+
+    bool CacheWarmer::isRunning() const
+    {
+        // Return whether the periodic warming is running.
+        return m_warm_timer.isActive();
+    }
+
+    std::vector<HotTile> CacheWarmer::hotTiles() const
+    {
+        // Capture the tiles.
+        std::vector<HotTile> tiles;
+        tiles.reserve(std::size_t(m_histogram.size()));
+        for (auto it = m_histogram.constBegin(); it != m_histogram.constEnd(); ++it)
+        {
+            tiles.push_back(unpackTile(it.key(), it.value()));
+        }
+
+        // Keep the most viewed.
+        const std::size_t count = std::min(tiles.size(), std::size_t(m_hot_tile_count));
+        std::partial_sort(tiles.begin(), tiles.begin() + std::ptrdiff_t(count), tiles.end(), [](const HotTile& lhs, const HotTile& rhs)
+        {
+            return lhs.weight > rhs.weight;
+        });
+        tiles.resize(count);
+
+        // Return the hot tiles.
+        return tiles;
+    }
+
+    void CacheWarmer::viewChanged()
+    {
+        // Restart the idle delay and record the view once it settles.
+        m_view_clock.restart();
+        m_settle_timer.start();
+    }
+
+    void CacheWarmer::recordView()
+    {
+        // Check the map control still exists.
+        if (m_map_control == nullptr)
+        {
+            return;
+        }
+
+        // Calculate the tiles of the view.
+        const int zoom = m_map_control->getCurrentZoom();
+        const RectWorldCoord view = m_map_control->getViewportRect();
+        const double tile_size_px = ImageManager::get().tileSizePx();
+        const PointWorldPx top_left = projection::get().toPointWorldPx(view.topLeftCoord(), zoom);
+        const PointWorldPx bottom_right = projection::get().toPointWorldPx(view.bottomRightCoord(), zoom);
+        const int left = int(std::floor(std::min(top_left.x(), bottom_right.x()) / tile_size_px));
+        const int right = int(std::floor(std::max(top_left.x(), bottom_right.x()) / tile_size_px));
+        const int top = int(std::floor(std::min(top_left.y(), bottom_right.y()) / tile_size_px));
+        const int bottom = int(std::floor(std::max(top_left.y(), bottom_right.y()) / tile_size_px));
+        if ((right - left + 1) * (bottom - top + 1) > kMaxViewTiles)
+        {
+            return;
+        }
+
+        // Count the view of each tile.
+        for (int x = left; x <= right; ++x)
+        {
+            for (int y = top; y <= bottom; ++y)
+            {
+                if (x >= 0 && y >= 0)
+                {
+                    m_histogram[packTile(zoom, x, y)] += 1.0;
+                }
+            }
+        }
+
+        // Drop the least viewed half when the histogram is full.
+        if (m_histogram.size() > kMaxHistogramTiles)
+        {
+            std::vector<std::pair<double, quint64>> tiles;
+            tiles.reserve(std::size_t(m_histogram.size()));
+            for (auto it = m_histogram.constBegin(); it != m_histogram.constEnd(); ++it)
+            {
+                tiles.emplace_back(it.value(), it.key());
+            }
+            std::nth_element(tiles.begin(), tiles.begin() + std::ptrdiff_t(tiles.size() / 2), tiles.end());
+            for (std::size_t i = 0; i < tiles.size() / 2; ++i)
+            {
+                m_histogram.remove(tiles[i].second);
+            }
+        }
+    }
+
+    void CacheWarmer::warm()
+    {
+        // Check the map control still exists.
+        if (m_map_control == nullptr)
+        {
+            return;
+        }
+
+        // Refill the bandwidth budget.
+        m_bandwidth_left = std::min(double(m_bandwidth_budget), m_bandwidth_left + double(m_bandwidth_budget) * double(m_bandwidth_clock.restart()) / 60000.0);
+
+        // Only warm while the user and the network are idle.
+        ImageManager& image_manager = ImageManager::get();
+        if (m_view_clock.elapsed() < m_idle_delay.count() || image_manager.downloadQueueSize() > 0 || image_manager.providerQueueSize() > 0)
+        {
+            return;
+        }
+
+        // Estimate the cost of a tile from the downloads so far.
+        const TileMetrics metrics = image_manager.metrics();
+        const double tile_bytes = metrics.network_requests > 0 ? double(metrics.network_bytes) / double(metrics.network_requests) : kDefaultTileBytes;
+
+        // Warm each hot tile, its parent and its children, for each map adapter layer.
+        std::vector<QUrl> pinned;
+        for (const auto& hot_tile : hotTiles())
+        {
+            std::vector<HotTile> tiles { hot_tile };
+            if (hot_tile.zoom > 0)
+            {
+                tiles.push_back({ hot_tile.zoom - 1, hot_tile.x / 2, hot_tile.y / 2, 0.0 });
+            }
+            for (int i = 0; i < 4; ++i)
+            {
+                tiles.push_back({ hot_tile.zoom + 1, hot_tile.x * 2 + i % 2, hot_tile.y * 2 + i / 2, 0.0 });
+            }
+
+            for (const auto& layer : m_map_control->getLayers())
+            {
+                const std::shared_ptr<LayerMapAdapter> map_layer = std::dynamic_pointer_cast<LayerMapAdapter>(layer);
+                const std::shared_ptr<MapAdapter> map_adapter = map_layer != nullptr ? map_layer->getMapAdapter() : nullptr;
+                if (map_adapter == nullptr)
+                {
+                    continue;
+                }
+
+                for (const auto& tile : tiles)
+                {
+                    if (map_layer->isVisible(tile.zoom) && map_adapter->isTileValid(tile.x, tile.y, tile.zoom))
+                    {
+                        // Pin the tile, and warm it (refreshed once per session) while the budget allows.
+                        const QUrl url = map_adapter->tileQuery(tile.x, tile.y, tile.zoom);
+                        pinned.push_back(url);
+                        if (m_bandwidth_left < tile_bytes)
+                        {
+                            continue;
+                        }
+
+                        // Only the network requests are charged (a downloaded tile is fresh too).
+                        const ImageManager::WarmRequest request = image_manager.warmImage(url, m_refreshed.contains(url) == false);
+                        if (request == ImageManager::WarmRequest::Download || request == ImageManager::WarmRequest::Revalidate)
+                        {
+                            m_bandwidth_left -= tile_bytes;
+                            m_refreshed.insert(url);
+                        }
+                    }
+                }
+            }
+        }
+
+        // Protect the hot tiles from eviction.
+        image_manager.setPinnedTiles(pinned);
+    }
+}
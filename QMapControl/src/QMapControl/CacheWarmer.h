@@ -0,0 +1,205 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// Qt includes.
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QObject>
+#include <QtCore/QPointer>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QTimer>
+#include <QtCore/QUrl>
+
+// STL includes.
+#include <chrono>
+#include <vector>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+
+namespace qmapcontrol
+{
+    //! Forward declaration.
+    class QMapControl;
+
+    //! A frequently viewed tile.
+    struct QMAPCONTROL_EXPORT HotTile
+    {
+        /// The controller zoom.
+        int zoom;
+
+        /// The x coordinate of the tile.
+        int x;
+
+        /// The y coordinate of the tile.
+        int y;
+
+        /// How often the tile was viewed (decayed over sessions).
+        double weight;
+    };
+
+    //! Learns the frequently viewed regions and keeps their tiles warm.
+    /*!
+     * The warmer records which tiles are viewed (once the view has settled) in a histogram per zoom,
+     * which can be persisted across sessions (older sessions weigh less). When the network is idle
+     * and the user is not interacting, the top hot tiles and their tiles at the adjacent zooms are
+     * loaded into the memory cache (and refreshed from the network once per session) for each map
+     * adapter layer, within a bandwidth budget. The hot tiles are pinned in the Image Manager so they
+     * are not evicted. ImageManager::metrics().warmUsefulness() reports how many warmed tiles were displayed.
+     *
+     * The warmer must be created in the GUI thread and is stopped until start() is called.
+     */
+    class QMAPCONTROL_EXPORT CacheWarmer : public QObject
+    {
+        Q_OBJECT
+    public:
+        //! Constructor.
+        /*!
+         * This constructs a stopped cache warmer.
+         * @param map_control The map control whose views are recorded and whose layers are warmed.
+         * @param parent QObject parent ownership.
+         */
+        explicit CacheWarmer(QMapControl* map_control, QObject* parent = nullptr);
+
+        //! Disable copy constructor.
+        CacheWarmer(const CacheWarmer&) = delete;
+
+        //! Disable copy assignment.
+        CacheWarmer& operator=(const CacheWarmer&) = delete;
+
+        //! Destructor (stops and saves the history, if a history file is set).
+        ~CacheWarmer();
+
+        /*!
+         * Set the file the view history is persisted to, and load it.
+         * @param file_path The history file path.
+         * @return whether an existing history was loaded.
+         */
+        bool setHistoryFile(const QString& file_path);
+
+        /*!
+         * Save the view history to the history file.
+         * @return whether the history was saved.
+         */
+        bool saveHistory() const;
+
+        /*!
+         * Set the number of hot tiles kept warm (default: 32).
+         * @param count The number of hot tiles.
+         */
+        void setHotTileCount(const int count);
+
+        /*!
+         * Set the bandwidth the warming may use (default: 2 MiB per minute).
+         * @param bytes_per_minute The bandwidth budget in bytes per minute.
+         */
+        void setBandwidthBudget(const qint64 bytes_per_minute);
+
+        /*!
+         * Set how long the view must be unchanged before warming (default: 3 seconds).
+         * @param delay The idle delay.
+         */
+        void setIdleDelay(const std::chrono::milliseconds& delay);
+
+        /*!
+         * Start recording the views and warming.
+         */
+        void start();
+
+        /*!
+         * Stop recording the views and warming (the tiles stay pinned).
+         */
+        void stop();
+
+        /*!
+         * Whether the warmer is running.
+         * @return whether the warmer is running.
+         */
+        bool isRunning() const;
+
+        /*!
+         * Fetch the most viewed tiles.
+         * @return the hot tiles, most viewed first.
+         */
+        std::vector<HotTile> hotTiles() const;
+
+    public slots:
+        /*!
+         * Warm the hot tiles now, if the network and the user are idle (also called periodically).
+         */
+        void warm();
+
+    private slots:
+        /*!
+         * Slot to note a view change (recorded once the view settles).
+         */
+        void viewChanged();
+
+        /*!
+         * Slot to record the tiles of the current view.
+         */
+        void recordView();
+
+    private:
+        /// The map control.
+        QPointer<QMapControl> m_map_control;
+
+        /// The history file path (empty if not persisted).
+        QString m_history_file;
+
+        /// How often each tile was viewed, by packed zoom/x/y.
+        QHash<quint64, double> m_histogram;
+
+        /// The number of hot tiles kept warm.
+        int m_hot_tile_count;
+
+        /// The bandwidth budget in bytes per minute.
+        qint64 m_bandwidth_budget;
+
+        /// The bandwidth left in the budget.
+        double m_bandwidth_left;
+
+        /// Measures the time since the bandwidth budget was last refilled.
+        QElapsedTimer m_bandwidth_clock;
+
+        /// How long the view must be unchanged before warming.
+        std::chrono::milliseconds m_idle_delay;
+
+        /// Measures the time since the view last changed.
+        QElapsedTimer m_view_clock;
+
+        /// The timer to record the view once it settles.
+        QTimer m_settle_timer;
+
+        /// The timer for the periodic warming.
+        QTimer m_warm_timer;
+
+        /// The urls refreshed from the network this session.
+        QSet<QUrl> m_refreshed;
+    };
+}
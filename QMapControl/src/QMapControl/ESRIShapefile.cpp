@@ -27,11 +27,47 @@
 
 // Local includes.
 #include "Projection.h"
+#include "Scratch.h"
+#include "Trace.h"
 
 #include <QDebug>
 
 namespace qmapcontrol
 {
+    namespace
+    {
+        /*!
+         * Adds a ring to a path (as a closed subpath), using a scratch polygon for the projected points.
+         * @param path The path to add the ring to.
+         * @param polygon_px The scratch polygon (emptied before use).
+         * @param ogr_ring The ring to add.
+         * @param controller_zoom The current controller zoom.
+         */
+        void addRing(QPainterPath& path, QPolygonF& polygon_px, const OGRLinearRing* ogr_ring, const int controller_zoom)
+        {
+            // Prepare storage for point.
+            OGRPoint ogr_point;
+
+            // Empty the polygon (keeping its capacity).
+            scratch::reset(polygon_px);
+            polygon_px.reserve(ogr_ring->getNumPoints());
+
+            // Loop through the points.
+            for(int i = 0; i < ogr_ring->getNumPoints(); ++i)
+            {
+                // Fetch the point.
+                ogr_ring->getPoint(i, &ogr_point);
+
+                // Add the point to be drawn.
+                polygon_px.append(projection::get().toPointWorldPx(PointWorldCoord(ogr_point.getX(), ogr_point.getY()), controller_zoom).rawPoint());
+            }
+
+            // Add the ring.
+            path.addPolygon(polygon_px);
+            path.closeSubpath();
+        }
+    }
+
     ESRIShapefile::ESRIShapefile(const std::string& file_path, const std::string& layer_name, const int& zoom_minimum, const int& zoom_maximum)
         : m_layer_name(layer_name), m_zoom_minimum(zoom_minimum), m_zoom_maximum(zoom_maximum)
     {
@@ -152,6 +188,9 @@ namespace qmapcontrol
 
     void ESRIShapefile::draw(QPainter& painter, const RectWorldPx& backbuffer_rect_px, const int& controller_zoom) const
     {
+        // Trace the draw (includes the OGR reads).
+        QMC_TRACE_SCOPE_ARG("render", "ESRIShapefile::draw", QString::fromStdString(m_layer_name));
+
         // Check whether the controller zoom is within range?
         if(m_zoom_minimum > controller_zoom || m_zoom_maximum < controller_zoom)
         {
@@ -248,39 +287,19 @@ namespace qmapcontrol
             }
             else
             {
-                QPainterPath path;
+                // The path and polygon to build the rings in (scratch buffers).
+                scratch::Lease<QPainterPath> path;
+                scratch::Lease<QPolygonF> polygon_px;
 
-                // Prepare storage for point.
-                OGRPoint ogr_point;
+                // Add the exterior ring.
+                addRing(*path, *polygon_px, ogr_exterior_ring, controller_zoom);
 
-                // Create a polygon of the points.
-                QPolygonF polygon_px;
-
-                // Loop through the points.
-                for(int i = 0; i < ogr_exterior_ring->getNumPoints(); ++i)
+                // Add the interior rings (the odd-even fill of the path leaves them as holes).
+                for(int i = 0; i < ogr_polygon->getNumInteriorRings(); ++i)
                 {
-                    // Fetch the point.
-                    ogr_exterior_ring->getPoint(i, &ogr_point);
-
-                    // Add the point to be drawn.
-                    polygon_px.append(projection::get().toPointWorldPx(PointWorldCoord(ogr_point.getX(), ogr_point.getY()), controller_zoom).rawPoint());
-                }
-
-                path.addPolygon(polygon_px);
-
-                QPainterPath inp;
-                for (int i = 0; i < ogr_polygon->getNumInteriorRings(); ++i) {
-                    auto inn = ogr_polygon->getInteriorRing(i);
-                    QPolygonF pf;
-                    for (int j = 0; j < inn->getNumPoints(); ++j) {
-                        inn->getPoint(j, &ogr_point);
-                        pf.append(projection::get().toPointWorldPx(PointWorldCoord(ogr_point.getX(), ogr_point.getY()), controller_zoom).rawPoint());
-                    }
-                    inp.addPolygon(pf);
+                    addRing(*path, *polygon_px, ogr_polygon->getInteriorRing(i), controller_zoom);
                 }
 
-                path = path.subtracted(inp);
-
                 // Set the pen to use.
                 painter.setPen(getPenPolygon());
 
@@ -288,7 +307,7 @@ namespace qmapcontrol
                 painter.setBrush(getBrushPolygon());
 
                 // Draw the polygon line.
-                painter.drawPath(path);
+                painter.drawPath(*path);
             }
         }
         else if(wkbFlatten(ogr_geometry->getGeometryType()) == wkbMultiPolygon)
@@ -302,7 +321,9 @@ namespace qmapcontrol
             }
             else
             {
-                QPainterPath path;
+                // The path and polygon to build the rings in (scratch buffers).
+                scratch::Lease<QPainterPath> path;
+                scratch::Lease<QPolygonF> polygon_px;
 
                 // Loop through each polygon.
                 for(int i = 0; i < ogr_multi_polygon->getNumGeometries(); ++i)
@@ -318,37 +339,14 @@ namespace qmapcontrol
                     }
                     else
                     {
-                        // Prepare storage for point.
-                        OGRPoint ogr_point;
-
-                        // Create a polygon of the points.
-                        QPolygonF polygon_px;
+                        // Add the exterior ring.
+                        addRing(*path, *polygon_px, ogr_exterior_ring, controller_zoom);
 
-                        // Loop through the points.
-                        for(int i = 0; i < ogr_exterior_ring->getNumPoints(); ++i)
+                        // Add the interior rings (the odd-even fill of the path leaves them as holes).
+                        for(int j = 0; j < ogr_polygon->getNumInteriorRings(); ++j)
                         {
-                            // Fetch the point.
-                            ogr_exterior_ring->getPoint(i, &ogr_point);
-
-                            // Add the point to be drawn.
-                            polygon_px.append(projection::get().toPointWorldPx(PointWorldCoord(ogr_point.getX(), ogr_point.getY()), controller_zoom).rawPoint());
-                        }
-
-                        path.addPolygon(polygon_px);
-
-                        QPainterPath inp;
-                        for (int i = 0; i < ogr_polygon->getNumInteriorRings(); ++i) {
-                            auto inn = ogr_polygon->getInteriorRing(i);
-                            QPolygonF pf;
-                            for (int j = 0; j < inn->getNumPoints(); ++j) {
-                                inn->getPoint(j, &ogr_point);
-                                pf.append(projection::get().toPointWorldPx(PointWorldCoord(ogr_point.getX(), ogr_point.getY()), controller_zoom).rawPoint());
-                            }
-                            inp.addPolygon(pf);
+                            addRing(*path, *polygon_px, ogr_polygon->getInteriorRing(j), controller_zoom);
                         }
-
-                        path = path.subtracted(inp);
-
                     }
                 }
 
@@ -359,8 +357,7 @@ namespace qmapcontrol
                 painter.setBrush(getBrushPolygon());
 
                 // Draw the polygon line.
-                painter.drawPath(path);
-
+                painter.drawPath(*path);
             }
         }
         else if(wkbFlatten(ogr_geometry->getGeometryType()) == wkbLineString) // wkbLineString
@@ -371,8 +368,9 @@ namespace qmapcontrol
             // Prepare storage for point.
             OGRPoint ogr_point;
 
-            // Create a polygon of the points.
-            QPolygonF polygon_line_px;
+            // Create a polygon of the points (in a scratch buffer).
+            scratch::Lease<QPolygonF> polygon_line_px;
+            polygon_line_px->reserve(ogr_line_string->getNumPoints());
 
             // Loop through the points.
             for(int i = 0; i < ogr_line_string->getNumPoints(); ++i)
@@ -381,14 +379,14 @@ namespace qmapcontrol
                 ogr_line_string->getPoint(i, &ogr_point);
 
                 // Add the point to be drawn.
-                polygon_line_px.append(projection::get().toPointWorldPx(PointWorldCoord(ogr_point.getX(), ogr_point.getY()), controller_zoom).rawPoint());
+                polygon_line_px->append(projection::get().toPointWorldPx(PointWorldCoord(ogr_point.getX(), ogr_point.getY()), controller_zoom).rawPoint());
             }
 
             // Set the pen to use.
             painter.setPen(getPenLineString());
 
             // Draw the polygon line.
-            painter.drawPolyline(polygon_line_px);
+            painter.drawPolyline(*polygon_line_px);
         }
     }
 }
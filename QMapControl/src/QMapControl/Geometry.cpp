@@ -25,8 +25,59 @@
 
 #include "Geometry.h"
 
+// STL includes.
+#include <algorithm>
+
 namespace qmapcontrol
 {
+    namespace
+    {
+        /// Whether a segment lies (partially) within a normalized rect (Liang-Barsky clipping).
+        bool segmentIntersects(const QPointF& start, const QPointF& end, const QRectF& rect)
+        {
+            const qreal dx = end.x() - start.x();
+            const qreal dy = end.y() - start.y();
+            const qreal p[4] = { -dx, dx, -dy, dy };
+            const qreal q[4] = { start.x() - rect.left(), rect.right() - start.x(), start.y() - rect.top(), rect.bottom() - start.y() };
+            qreal t_enter = 0.0;
+            qreal t_exit = 1.0;
+            for (int i = 0; i < 4; ++i)
+            {
+                if (p[i] == 0.0)
+                {
+                    // Parallel to this edge: outside if beyond it.
+                    if (q[i] < 0.0)
+                    {
+                        return false;
+                    }
+                }
+                else
+                {
+                    const qreal t = q[i] / p[i];
+                    if (p[i] < 0.0)
+                    {
+                        // Entering.
+                        if (t > t_exit)
+                        {
+                            return false;
+                        }
+                        t_enter = std::max(t_enter, t);
+                    }
+                    else
+                    {
+                        // Exiting.
+                        if (t < t_enter)
+                        {
+                            return false;
+                        }
+                        t_exit = std::min(t_exit, t);
+                    }
+                }
+            }
+            return true;
+        }
+    }
+
     Geometry::Geometry(const GeometryType geometry_type, const int zoom_minimum, const int zoom_maximum)
         : m_geometry_type(geometry_type),
           m_zoom_minimum(zoom_minimum),
@@ -42,6 +93,46 @@ namespace qmapcontrol
 
     }
 
+    bool Geometry::polylineIntersects(const QPolygonF& polyline, const QRectF& rect)
+    {
+        // A single point is a degenerate segment.
+        if (polyline.size() == 1)
+        {
+            return rect.contains(polyline.first());
+        }
+
+        // Check each segment (the bounding box is not used for a quick reject, as it may be degenerate).
+        for (int i = 1; i < polyline.size(); ++i)
+        {
+            if (segmentIntersects(polyline.at(i - 1), polyline.at(i), rect))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Geometry::polygonIntersects(const QPolygonF& polygon, const QRectF& rect)
+    {
+        // Quick reject on the bounding box.
+        if (polygon.isEmpty() || rect.intersects(polygon.boundingRect()) == false)
+        {
+            return false;
+        }
+
+        // An edge (including the closing one) within the rect.
+        for (int i = 0; i < polygon.size(); ++i)
+        {
+            if (segmentIntersects(polygon.at(i), polygon.at((i + 1) % polygon.size()), rect))
+            {
+                return true;
+            }
+        }
+
+        // Otherwise the rect can only be inside the polygon.
+        return polygon.containsPoint(rect.center(), Qt::OddEvenFill);
+    }
+
     int Geometry::zIndex() const { return m_z_index; }
 
     void Geometry::setZIndex(const int z_index) { m_z_index = z_index; }
@@ -224,4 +315,21 @@ namespace qmapcontrol
         // Return the top-left point.
         return top_left_point_px;
     }
+
+    MemoryUsage Geometry::memoryUsage() const
+    {
+        MemoryUsage usage;
+
+        // The geometry object itself.
+        usage.payload_bytes = sizeof(Geometry);
+
+        // The pen/brush (shared between the geometries using them) and meta-data.
+        usage.attribute_bytes += memory::sharedBytes(m_pen, sizeof(QPen));
+        usage.attribute_bytes += memory::sharedBytes(m_brush, sizeof(QBrush));
+        usage.attribute_bytes += memory::metadataBytes(m_metadata);
+        usage.attribute_bytes += memory::stringBytes(m_metadata_displayed_key);
+
+        // Return the memory usage.
+        return usage;
+    }
 }
@@ -39,6 +39,7 @@
 
 // Local includes.
 #include "qmapcontrol_global.h"
+#include "MemoryUsage.h"
 #include "Point.h"
 
 namespace qmapcontrol
@@ -108,6 +109,22 @@ namespace qmapcontrol
          */
         Geometry(const GeometryType geometry_type, const int zoom_minimum = 0, const int zoom_maximum = kDefaultMaxZoom);
 
+        /*!
+         * Whether any part of a polyline lies within a rect (without allocating, unlike QPolygonF::intersected()).
+         * @param polyline The polyline points.
+         * @param rect The normalized rect.
+         * @return whether the polyline is (partially) within the rect.
+         */
+        static bool polylineIntersects(const QPolygonF& polyline, const QRectF& rect);
+
+        /*!
+         * Whether a polygon and a rect overlap (without allocating, unlike QPolygonF::intersected()).
+         * @param polygon The polygon points (implicitly closed).
+         * @param rect The normalized rect.
+         * @return whether the polygon and the rect overlap.
+         */
+        static bool polygonIntersects(const QPolygonF& polygon, const QRectF& rect);
+
     public:
         //! Disable copy constructor.
         Geometry(const Geometry&) = delete;
@@ -261,6 +278,12 @@ namespace qmapcontrol
          */
         virtual void draw(QPainter& painter, const RectWorldCoord& backbuffer_rect_coord, const int controller_zoom) = 0;
 
+        /*!
+         * Estimates the memory used by the geometry (payload and attributes, see MemoryUsage.h).
+         * @return the memory usage.
+         */
+        virtual MemoryUsage memoryUsage() const;
+
     signals:
         /*!
          * Signal emitted when a geometry is clicked.
@@ -269,7 +292,7 @@ namespace qmapcontrol
         void geometryClicked(const Geometry* geometry) const;
 
         /*!
-         * Signal emitted when a geometry changes its position.
+         * Signal emitted when a geometry changes its position (or its points, for line strings and polygons).
          * @param geometry The geometry that change position.
          */
         void positionChanged(const Geometry* geometry) const;
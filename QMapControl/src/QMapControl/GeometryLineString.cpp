@@ -25,8 +25,13 @@
 
 #include "GeometryLineString.h"
 
+// STL includes.
+#include <algorithm>
+#include <utility>
+
 // Local includes.
 #include "Projection.h"
+#include "Scratch.h"
 
 namespace qmapcontrol
 {
@@ -36,6 +41,12 @@ namespace qmapcontrol
     {
     }
 
+    GeometryLineString::GeometryLineString(std::vector<PointWorldCoord>&& points, const int zoom_minimum, const int zoom_maximum)
+        : Geometry(Geometry::GeometryType::GeometryLineString, zoom_minimum, zoom_maximum),
+          m_points(std::move(points))
+    {
+    }
+
     GeometryLineString::GeometryLineString(int zoom_min, int zoom_max)
         : Geometry(Geometry::GeometryType::GeometryLineString, zoom_min, zoom_max),
           m_points()
@@ -45,7 +56,13 @@ namespace qmapcontrol
     std::vector<PointWorldCoord> GeometryLineString::points() const
     {
         // Return the points.
-        return m_points;
+        return m_points.toVector();
+    }
+
+    PointView GeometryLineString::pointsView() const
+    {
+        // Return a view of the points.
+        return m_points.view();
     }
 
     void GeometryLineString::addPoint(const PointWorldCoord& point)
@@ -55,31 +72,58 @@ namespace qmapcontrol
 
         // Emit that we need to redraw to display this change.
         emit requestRedraw();
+
+        // Emit that the position has changed.
+        emit positionChanged(this);
     }
 
     void GeometryLineString::setPoints(const std::vector<PointWorldCoord>& points)
     {
         // Set the new points.
-        m_points = points;
+        m_points.assign(points);
+
+        // Emit that we need to redraw to display this change.
+        emit requestRedraw();
+
+        // Emit that the position has changed.
+        emit positionChanged(this);
+    }
+
+    void GeometryLineString::setPoints(std::vector<PointWorldCoord>&& points)
+    {
+        // Adopt the new points.
+        m_points.assign(std::move(points));
 
         // Emit that we need to redraw to display this change.
         emit requestRedraw();
+
+        // Emit that the position has changed.
+        emit positionChanged(this);
     }
 
     RectWorldCoord GeometryLineString::boundingBox(const int /*controller_zoom*/) const
     {
-        // Create a polygon of the points.
-        QPolygonF polygon_line;
+        // Check we have points (an empty polygon has a null bounding box).
+        if(m_points.empty())
+        {
+            return RectWorldCoord::fromQRectF(QRectF());
+        }
 
-        // Loop through each point to add to the polygon.
+        // Find the extent of the points (without building a polygon).
+        qreal min_x = m_points.front().longitude();
+        qreal max_x = min_x;
+        qreal min_y = m_points.front().latitude();
+        qreal max_y = min_y;
         for(const auto& point : m_points)
         {
-            // Add the point to be drawn.
-            polygon_line.append(point.rawPoint());
+            min_x = std::min(min_x, point.longitude());
+            max_x = std::max(max_x, point.longitude());
+            min_y = std::min(min_y, point.latitude());
+            max_y = std::max(max_y, point.latitude());
         }
 
         // Return the bounding box.
-        return RectWorldCoord::fromQRectF(polygon_line.boundingRect());
+        return RectWorldCoord::fromQRectF(QRectF(QPointF(min_x, min_y), QPointF(max_x, max_y)));
     }
 
     bool GeometryLineString::touches(const Geometry* geometry, const int controller_zoom) const
@@ -128,35 +172,50 @@ namespace qmapcontrol
         // Check the geometry is visible.
         if (isVisible(controller_zoom))
         {
-            // Create a polygon of the points.
-            QPolygonF polygon_line;
+            // Create a polygon of the points (in a scratch buffer).
+            scratch::Lease<QPolygonF> polygon_line;
+            polygon_line->reserve(int(m_points.size()));
 
             // Loop through each point to add to the polygon.
             for (const auto& point : m_points)
             {
                 // Add the point to be drawn.
-                polygon_line.append(point.rawPoint());
+                polygon_line->append(point.rawPoint());
             }
 
             // Does the polygon intersect with the backbuffer rect?
-            if (QPolygonF(backbuffer_rect_coord.rawRect()).intersected(polygon_line).empty() == false)
+            if (polylineIntersects(*polygon_line, backbuffer_rect_coord.rawRect().normalized()))
             {
-                // Create a polygon of the points.
-                QPolygonF polygon_line_px;
+                // Create a polygon of the points (in a scratch buffer).
+                scratch::Lease<QPolygonF> polygon_line_px;
+                polygon_line_px->reserve(int(m_points.size()));
 
                 // Loop through each point to add to the polygon.
                 for (const auto& point : m_points)
                 {
                     // Add the point to be drawn.
-                    polygon_line_px.append(projection::get().toPointWorldPx(point, controller_zoom).rawPoint());
+                    polygon_line_px->append(projection::get().toPointWorldPx(point, controller_zoom).rawPoint());
                 }
 
                 // Set the pen to use.
                 painter.setPen(pen());
 
                 // Draw the polygon line.
-                painter.drawPolyline(polygon_line_px);
+                painter.drawPolyline(*polygon_line_px);
             }
         }
     }
+
+    MemoryUsage GeometryLineString::memoryUsage() const
+    {
+        // The base geometry, plus the members of this geometry.
+        MemoryUsage usage = Geometry::memoryUsage();
+        usage.payload_bytes += sizeof(GeometryLineString) - sizeof(Geometry);
+
+        // The points.
+        usage.payload_bytes += m_points.heapCapacity() * sizeof(PointWorldCoord);
+
+        // Return the memory usage.
+        return usage;
+    }
 }
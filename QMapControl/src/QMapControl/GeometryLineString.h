@@ -32,6 +32,7 @@
 #include "qmapcontrol_global.h"
 #include "Geometry.h"
 #include "Point.h"
+#include "PointStorage.h"
 
 namespace qmapcontrol
 {
@@ -54,8 +55,23 @@ namespace qmapcontrol
          * @param zoom_maximum The maximum zoom level to show this geometry at.
          */
         explicit GeometryLineString(const std::vector<PointWorldCoord>& points, const int zoom_minimum = 0, const int zoom_maximum = kDefaultMaxZoom);
-        explicit GeometryLineString(int zoom_min = 0, int zoom_max = kDefaultMaxZoom);
 
+        //! Constructor.
+        /*!
+         * The constructor of a LineString takes a list of points to form a line (adopted without copying).
+         * @param points The list of Geometry Points.
+         * @param zoom_minimum The minimum zoom level to show this geometry at.
+         * @param zoom_maximum The maximum zoom level to show this geometry at.
+         */
+        explicit GeometryLineString(std::vector<PointWorldCoord>&& points, const int zoom_minimum = 0, const int zoom_maximum = kDefaultMaxZoom);
+
+        //! Constructor.
+        /*!
+         * The constructor of an empty LineString.
+         * @param zoom_min The minimum zoom level to show this geometry at.
+         * @param zoom_max The maximum zoom level to show this geometry at.
+         */
+        explicit GeometryLineString(int zoom_min = 0, int zoom_max = kDefaultMaxZoom);
 
         //! Disable copy constructor.
         GeometryLineString(const GeometryLineString&) = delete;
@@ -72,6 +88,12 @@ namespace qmapcontrol
          */
         std::vector<PointWorldCoord> points() const;
 
+        /*!
+         * Fetches a view of the points that form a line, without copying them.
+         * @return the view of the points (valid until the points are changed).
+         */
+        PointView pointsView() const;
+
         /*!
          * Add a point to the end of the line.
          * @param point The point to add to the end of the line.
@@ -84,6 +106,29 @@ namespace qmapcontrol
          */
         void setPoints(const std::vector<PointWorldCoord>& points);
 
+        /*!
+         * Sets the points to use for the LineString (adopted without copying).
+         * @param points The points to use for the LineString.
+         */
+        void setPoints(std::vector<PointWorldCoord>&& points);
+
+        /*!
+         * Modifies the points in place, with a single redraw request afterwards.
+         * @param modifier Called with a MutablePointView of the points.
+         */
+        template<typename Modifier>
+        void modifyPoints(Modifier modifier)
+        {
+            // Modify the points.
+            modifier(m_points.mutableView());
+
+            // Emit that we need to redraw to display this change.
+            emit requestRedraw();
+
+            // Emit that the position has changed.
+            emit positionChanged(this);
+        }
+
     public:
         /*!
          * Fetches the bounding box (world coordinates).
@@ -108,8 +153,14 @@ namespace qmapcontrol
          */
         void draw(QPainter& painter, const RectWorldCoord& backbuffer_rect_coord, const int controller_zoom);
 
+        /*!
+         * Estimates the memory used by the geometry (payload and attributes, see MemoryUsage.h).
+         * @return the memory usage.
+         */
+        MemoryUsage memoryUsage() const override;
+
     private:
-        /// The points that the linestring is made up of.
-        std::vector<PointWorldCoord> m_points;
+        /// The points that the linestring is made up of (up to 4 are stored inline).
+        PointStorage<4> m_points;
     };
 }
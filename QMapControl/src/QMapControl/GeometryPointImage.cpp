@@ -101,4 +101,17 @@ namespace qmapcontrol
             }
         }
     }
+
+    MemoryUsage GeometryPointImage::memoryUsage() const
+    {
+        // The base geometry, plus the members of this geometry.
+        MemoryUsage usage = Geometry::memoryUsage();
+        usage.payload_bytes += sizeof(GeometryPointImage) - sizeof(Geometry);
+
+        // The image (shared between the geometries using it).
+        usage.payload_bytes += memory::sharedBytes(m_image, m_image == nullptr ? 0 : memory::pixmapBytes(*m_image));
+
+        // Return the memory usage.
+        return usage;
+    }
 }
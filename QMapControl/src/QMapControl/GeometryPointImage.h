@@ -101,6 +101,12 @@ namespace qmapcontrol
          */
         void draw(QPainter& painter, const RectWorldCoord& backbuffer_rect_coord, const int controller_zoom) final;
 
+        /*!
+         * Estimates the memory used by the geometry (payload and attributes, see MemoryUsage.h).
+         * @return the memory usage.
+         */
+        MemoryUsage memoryUsage() const override;
+
     private:
         /// The image pixmap to draw.
         std::shared_ptr<QPixmap> m_image;
@@ -72,4 +72,16 @@ namespace qmapcontrol
         painter.drawPixmap(-rect.rawRect().width() / 2.0, -rect.rawRect().height() / 2.0, image());
     }
 
+    MemoryUsage GeometryPointImageScaled::memoryUsage() const
+    {
+        // The base geometry, plus the members of this geometry.
+        MemoryUsage usage = Geometry::memoryUsage();
+        usage.payload_bytes += sizeof(GeometryPointImageScaled) - sizeof(Geometry);
+
+        // The image (shared between the geometries using it).
+        usage.payload_bytes += memory::sharedBytes(m_image, m_image == nullptr ? 0 : memory::pixmapBytes(*m_image));
+
+        // Return the memory usage.
+        return usage;
+    }
 }
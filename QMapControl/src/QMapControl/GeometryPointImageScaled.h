@@ -94,6 +94,12 @@ namespace qmapcontrol
          */
         void setImage(const QPixmap& new_image, const bool update_shape = true);
 
+        /*!
+         * Estimates the memory used by the geometry (payload and attributes, see MemoryUsage.h).
+         * @return the memory usage.
+         */
+        MemoryUsage memoryUsage() const override;
+
     protected:
         /*!
          * \brief drawShape Draws the shape in a transformed painter according to zoom/translate/rotate status
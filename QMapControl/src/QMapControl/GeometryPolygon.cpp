@@ -1,7 +1,12 @@
 #include "GeometryPolygon.h"
 
+// STL includes.
+#include <algorithm>
+#include <utility>
+
 // Local includes.
 #include "Projection.h"
+#include "Scratch.h"
 
 namespace qmapcontrol
 {
@@ -12,16 +17,45 @@ namespace qmapcontrol
 
     }
 
+    GeometryPolygon::GeometryPolygon(std::vector<PointWorldCoord>&& points, const int zoom_minimum, const int zoom_maximum)
+        : Geometry(Geometry::GeometryType::GeometryPolygon, zoom_minimum, zoom_maximum),
+          m_points(std::move(points))
+    {
+
+    }
+
     std::vector<PointWorldCoord> GeometryPolygon::points() const
     {
         // Return the points.
-        return m_points;
+        return m_points.toVector();
+    }
+
+    PointView GeometryPolygon::pointsView() const
+    {
+        // Return a view of the points.
+        return m_points.view();
     }
 
     void GeometryPolygon::setPoints(const std::vector<PointWorldCoord>& points, const bool disable_redraw)
     {
         // Set the new points.
-        m_points = points;
+        m_points.assign(points);
+
+        // Should we redraw?
+        if(disable_redraw == false)
+        {
+            // Emit to redraw to display this change.
+            emit requestRedraw();
+        }
+
+        // Emit that the position has changed (even without a redraw).
+        emit positionChanged(this);
+    }
+
+    void GeometryPolygon::setPoints(std::vector<PointWorldCoord>&& points, const bool disable_redraw)
+    {
+        // Adopt the new points.
+        m_points.assign(std::move(points));
 
         // Should we redraw?
         if(disable_redraw == false)
@@ -29,6 +63,9 @@ namespace qmapcontrol
             // Emit to redraw to display this change.
             emit requestRedraw();
         }
+
+        // Emit that the position has changed (even without a redraw).
+        emit positionChanged(this);
     }
 
     const QPolygonF GeometryPolygon::toQPolygonF() const
@@ -49,18 +86,27 @@ namespace qmapcontrol
 
     RectWorldCoord GeometryPolygon::boundingBox(const int /*controller_zoom*/) const
     {
-        // Create a polygon of the points.
-        QPolygonF polygon;
+        // Check we have points (an empty polygon has a null bounding box).
+        if(m_points.empty())
+        {
+            return RectWorldCoord::fromQRectF(QRectF());
+        }
 
-        // Loop through each point to add to the polygon.
+        // Find the extent of the points (without building a polygon).
+        qreal min_x = m_points.front().longitude();
+        qreal max_x = min_x;
+        qreal min_y = m_points.front().latitude();
+        qreal max_y = min_y;
         for(const auto& point : m_points)
         {
-            // Add the point to be drawn.
-            polygon.append(point.rawPoint());
+            min_x = std::min(min_x, point.longitude());
+            max_x = std::max(max_x, point.longitude());
+            min_y = std::min(min_y, point.latitude());
+            max_y = std::max(max_y, point.latitude());
         }
 
         // Return the bounding box.
-        return RectWorldCoord::fromQRectF(polygon.boundingRect());
+        return RectWorldCoord::fromQRectF(QRectF(QPointF(min_x, min_y), QPointF(max_x, max_y)));
     }
 
     bool GeometryPolygon::touches(const Geometry* geometry, const int controller_zoom) const
@@ -125,17 +171,29 @@ namespace qmapcontrol
         // Check the geometry is visible.
         if(isVisible(controller_zoom))
         {
+            // Create a polygon of the points (in a scratch buffer).
+            scratch::Lease<QPolygonF> polygon_coord;
+            polygon_coord->reserve(int(m_points.size()));
+
+            // Loop through each point to add to the polygon.
+            for(const auto& point : m_points)
+            {
+                // Add the point.
+                polygon_coord->append(point.rawPoint());
+            }
+
             // Does the polygon intersect with the backbuffer rect?
-            if(QPolygonF(backbuffer_rect_coord.rawRect()).intersected(toQPolygonF()).empty() == false)
+            if(polygonIntersects(*polygon_coord, backbuffer_rect_coord.rawRect().normalized()))
             {
-                // Create a polygon of the points.
-                QPolygonF polygon;
+                // Create a polygon of the points (in a scratch buffer).
+                scratch::Lease<QPolygonF> polygon;
+                polygon->reserve(int(m_points.size()));
 
                 // Loop through each point to add to the polygon.
                 for(const auto& point : m_points)
                 {
                     // Add the point to be drawn.
-                    polygon.append(projection::get().toPointWorldPx(point, controller_zoom).rawPoint());
+                    polygon->append(projection::get().toPointWorldPx(point, controller_zoom).rawPoint());
                 }
 
                 // Set the pen to use.
@@ -145,8 +203,21 @@ namespace qmapcontrol
                 painter.setBrush(brush());
 
                 // Draw the polygon line.
-                painter.drawPolygon(polygon);
+                painter.drawPolygon(*polygon);
             }
         }
     }
+
+    MemoryUsage GeometryPolygon::memoryUsage() const
+    {
+        // The base geometry, plus the members of this geometry.
+        MemoryUsage usage = Geometry::memoryUsage();
+        usage.payload_bytes += sizeof(GeometryPolygon) - sizeof(Geometry);
+
+        // The points.
+        usage.payload_bytes += m_points.heapCapacity() * sizeof(PointWorldCoord);
+
+        // Return the memory usage.
+        return usage;
+    }
 }
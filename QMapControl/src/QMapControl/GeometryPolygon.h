@@ -29,6 +29,7 @@
 #include "qmapcontrol_global.h"
 #include "Geometry.h"
 #include "Point.h"
+#include "PointStorage.h"
 
 namespace qmapcontrol
 {
@@ -52,6 +53,15 @@ namespace qmapcontrol
          */
         GeometryPolygon(const std::vector<PointWorldCoord>& points, const int zoom_minimum = 0, const int zoom_maximum = kDefaultMaxZoom);
 
+        //! Constructor.
+        /*!
+         * This constructor takes a list of points, which form a polygon, to be displayed (adopted without copying).
+         * @param points The list of points (world coordinates).
+         * @param zoom_minimum The minimum zoom level to show this geometry at.
+         * @param zoom_maximum The maximum zoom level to show this geometry at.
+         */
+        GeometryPolygon(std::vector<PointWorldCoord>&& points, const int zoom_minimum = 0, const int zoom_maximum = kDefaultMaxZoom);
+
         //! Disable copy constructor.
         GeometryPolygon(const GeometryPolygon&) = delete;
 
@@ -69,6 +79,12 @@ namespace qmapcontrol
          */
         std::vector<PointWorldCoord> points() const;
 
+        /*!
+         * Fetches a view of the points that form the polygon (world coordinates), without copying them.
+         * @return the view of the points (valid until the points are changed).
+         */
+        PointView pointsView() const;
+
         /*!
          * Sets the list of points that form the polygon (world coordinates).
          * @param points The list of points that form the polygon (world coordinates).
@@ -76,6 +92,35 @@ namespace qmapcontrol
          */
         void setPoints(const std::vector<PointWorldCoord>& points, const bool disable_redraw = false);
 
+        /*!
+         * Sets the list of points that form the polygon (world coordinates, adopted without copying).
+         * @param points The list of points that form the polygon (world coordinates).
+         * @param disable_redraw Whether to disable the redraw that is called internally.
+         */
+        void setPoints(std::vector<PointWorldCoord>&& points, const bool disable_redraw = false);
+
+        /*!
+         * Modifies the points (world coordinates) in place, with a single redraw request afterwards.
+         * @param modifier Called with a MutablePointView of the points.
+         * @param disable_redraw Whether to disable the redraw that is called internally.
+         */
+        template<typename Modifier>
+        void modifyPoints(Modifier modifier, const bool disable_redraw = false)
+        {
+            // Modify the points.
+            modifier(m_points.mutableView());
+
+            // Should we redraw?
+            if(disable_redraw == false)
+            {
+                // Emit to redraw to display this change.
+                emit requestRedraw();
+            }
+
+            // Emit that the position has changed (even without a redraw).
+            emit positionChanged(this);
+        }
+
         /*!
          * Fetches the QPolygonF representation of the polygon.
          * @return the QPolygonF representation of the polygon.
@@ -106,8 +151,14 @@ namespace qmapcontrol
          */
         virtual void draw(QPainter& painter, const RectWorldCoord& backbuffer_rect_coord, const int controller_zoom) override;
 
+        /*!
+         * Estimates the memory used by the geometry (payload and attributes, see MemoryUsage.h).
+         * @return the memory usage.
+         */
+        MemoryUsage memoryUsage() const override;
+
     private:
-        /// The points that the polygon is made up of.
-        std::vector<PointWorldCoord> m_points;
+        /// The points that the polygon is made up of (up to 4 are stored inline).
+        PointStorage<4> m_points;
     };
 }
@@ -31,4 +31,17 @@ namespace qmapcontrol
             }
         }
     }
+
+    MemoryUsage GeometryPolygonImage::memoryUsage() const
+    {
+        // The base geometry, plus the members of this geometry.
+        MemoryUsage usage = GeometryPolygon::memoryUsage();
+        usage.payload_bytes += sizeof(GeometryPolygonImage) - sizeof(GeometryPolygon);
+
+        // The image.
+        usage.payload_bytes += memory::pixmapBytes(m_image);
+
+        // Return the memory usage.
+        return usage;
+    }
 }
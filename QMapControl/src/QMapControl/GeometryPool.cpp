@@ -0,0 +1,255 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "GeometryPool.h"
+
+// Qt includes.
+#include <QtCore/QtGlobal>
+
+// STL includes.
+#include <cstdint>
+#include <cstdlib>
+#ifdef Q_OS_WIN
+#include <malloc.h>
+#endif
+
+namespace qmapcontrol
+{
+    namespace
+    {
+        /*!
+         * Allocate a page aligned to its size.
+         * @return the page (nullptr on failure).
+         */
+        void* allocateAlignedPage()
+        {
+#ifdef Q_OS_WIN
+            return _aligned_malloc(GeometryPool::kPageSize, GeometryPool::kPageSize);
+#else
+            void* page(nullptr);
+            return posix_memalign(&page, GeometryPool::kPageSize, GeometryPool::kPageSize) == 0 ? page : nullptr;
+#endif
+        }
+
+        /*!
+         * Release a page allocated by allocateAlignedPage().
+         * @param page The page.
+         */
+        void freeAlignedPage(void* page)
+        {
+#ifdef Q_OS_WIN
+            _aligned_free(page);
+#else
+            std::free(page);
+#endif
+        }
+    }
+
+    GeometryPool::GeometryPool()
+        : m_mutex("GeometryPool::m_mutex"),
+          m_pages(0),
+          m_live_blocks(0)
+    {
+        // No pages yet.
+        m_available_pages.fill(nullptr);
+    }
+
+    GeometryPool::~GeometryPool()
+    {
+        // Release the remaining pages (the blocks' allocators keep the pool alive, so these are empty).
+        for (auto page : m_available_pages)
+        {
+            while (page != nullptr)
+            {
+                Page* next = page->next;
+                freeAlignedPage(page);
+                page = next;
+            }
+        }
+    }
+
+    void* GeometryPool::allocate(const std::size_t bytes)
+    {
+        // Large blocks are not pooled.
+        if (bytes > kMaxBlockSize)
+        {
+            return ::operator new(bytes);
+        }
+
+        // Find the size class.
+        const std::size_t size_class = bytes == 0 ? 0 : (bytes - 1) / kBlockAlignment;
+        const std::size_t block_size = (size_class + 1) * kBlockAlignment;
+
+        // Gain a lock to protect the pages.
+        ProfiledMutexLocker locker(&m_mutex);
+
+        // Fetch a page with free blocks (or allocate one).
+        Page* page = m_available_pages[size_class];
+        if (page == nullptr)
+        {
+            page = allocatePage(block_size);
+            linkPage(page);
+        }
+
+        // Take a freed block, or the next never used block.
+        void* block;
+        if (page->free_blocks != nullptr)
+        {
+            block = page->free_blocks;
+            page->free_blocks = *static_cast<void**>(block);
+        }
+        else
+        {
+            block = reinterpret_cast<char*>(page) + page->bump_offset;
+            page->bump_offset += block_size;
+        }
+        ++page->live_blocks;
+        ++m_live_blocks;
+
+        // Is the page now full?
+        if (page->free_blocks == nullptr && page->bump_offset + block_size > kPageSize)
+        {
+            unlinkPage(page);
+        }
+
+        // Return the block.
+        return block;
+    }
+
+    void GeometryPool::deallocate(void* block, const std::size_t bytes)
+    {
+        // Large blocks are not pooled.
+        if (bytes > kMaxBlockSize)
+        {
+            ::operator delete(block);
+            return;
+        }
+
+        // The page header is at the start of the (size aligned) page.
+        Page* page = reinterpret_cast<Page*>(reinterpret_cast<std::uintptr_t>(block) & ~std::uintptr_t(kPageSize - 1));
+
+        // Gain a lock to protect the pages.
+        ProfiledMutexLocker locker(&m_mutex);
+
+        // Return the block to the page.
+        *static_cast<void**>(block) = page->free_blocks;
+        page->free_blocks = block;
+        --page->live_blocks;
+        --m_live_blocks;
+
+        // Is the page now empty?
+        if (page->live_blocks == 0)
+        {
+            // Keep the last page of the size class (to avoid thrashing), otherwise release it.
+            if (page->available && m_available_pages[page->block_size / kBlockAlignment - 1] == page && page->next == nullptr)
+            {
+                page->free_blocks = nullptr;
+                page->bump_offset = (sizeof(Page) + kBlockAlignment - 1) / kBlockAlignment * kBlockAlignment;
+            }
+            else
+            {
+                if (page->available)
+                {
+                    unlinkPage(page);
+                }
+                freeAlignedPage(page);
+                --m_pages;
+            }
+        }
+        // Did the page have no free blocks?
+        else if (page->available == false)
+        {
+            linkPage(page);
+        }
+    }
+
+    GeometryPoolStats GeometryPool::stats() const
+    {
+        // Gain a lock to protect the pages.
+        ProfiledMutexLocker locker(&m_mutex);
+
+        // Return the statistics.
+        return { m_pages, m_live_blocks, m_pages * kPageSize };
+    }
+
+    GeometryPool::Page* GeometryPool::allocatePage(const std::size_t block_size)
+    {
+        // Allocate the page.
+        void* memory = allocateAlignedPage();
+        if (memory == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        ++m_pages;
+
+        // Initialise the header (the blocks start after it).
+        Page* page = static_cast<Page*>(memory);
+        page->block_size = block_size;
+        page->live_blocks = 0;
+        page->bump_offset = (sizeof(Page) + kBlockAlignment - 1) / kBlockAlignment * kBlockAlignment;
+        page->free_blocks = nullptr;
+        page->previous = nullptr;
+        page->next = nullptr;
+        page->available = false;
+
+        // Return the page.
+        return page;
+    }
+
+    void GeometryPool::linkPage(Page* page)
+    {
+        // Add the page to the front of its size class's list.
+        Page*& head = m_available_pages[page->block_size / kBlockAlignment - 1];
+        page->previous = nullptr;
+        page->next = head;
+        if (head != nullptr)
+        {
+            head->previous = page;
+        }
+        head = page;
+        page->available = true;
+    }
+
+    void GeometryPool::unlinkPage(Page* page)
+    {
+        // Remove the page from its size class's list.
+        Page*& head = m_available_pages[page->block_size / kBlockAlignment - 1];
+        if (page->previous != nullptr)
+        {
+            page->previous->next = page->next;
+        }
+        else
+        {
+            head = page->next;
+        }
+        if (page->next != nullptr)
+        {
+            page->next->previous = page->previous;
+        }
+        page->previous = nullptr;
+        page->next = nullptr;
+        page->available = false;
+    }
+}
@@ -0,0 +1,261 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// STL includes.
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+#include "ProfiledLock.h"
+
+namespace qmapcontrol
+{
+    //! Statistics of a geometry pool.
+    struct QMAPCONTROL_EXPORT GeometryPoolStats
+    {
+        /// The number of pages allocated.
+        std::size_t pages;
+
+        /// The number of blocks in use.
+        std::size_t live_blocks;
+
+        /// The bytes reserved by the pages.
+        std::size_t reserved_bytes;
+    };
+
+    //! Slab allocator for geometries (objects and their shared_ptr control blocks).
+    /*!
+     * Blocks are carved from aligned pages, one size class per page, so that a geometry and its
+     * control block are one allocation (std::allocate_shared) that sits next to the other geometries
+     * of the layer. A page is released as soon as its last block is freed: clearing a layer returns
+     * its memory page by page rather than with one heap free per object.
+     *
+     * Blocks larger than kMaxBlockSize fall back to the global heap. The pool is thread-safe, as
+     * geometries may be released by any thread holding the last reference.
+     *
+     * Use create() (or LayerGeometry::createGeometry()) to allocate a geometry from a pool.
+     */
+    class QMAPCONTROL_EXPORT GeometryPool
+    {
+    public:
+        /// The size (and alignment) of a page.
+        static const std::size_t kPageSize = 64 * 1024;
+
+        /// The granularity (and alignment) of the blocks.
+        static const std::size_t kBlockAlignment = 16;
+
+        /// The largest block served from the pages.
+        static const std::size_t kMaxBlockSize = 512;
+
+        //! Standard allocator that allocates from a geometry pool (or the global heap without one).
+        template<typename T>
+        class Allocator
+        {
+        public:
+            /// The allocated type.
+            using value_type = T;
+
+            //! Constructor (allocates from the global heap).
+            Allocator() = default;
+
+            /*!
+             * Constructor.
+             * @param pool The pool to allocate from.
+             */
+            explicit Allocator(const std::shared_ptr<GeometryPool>& pool) : m_pool(pool) { }
+
+            /*!
+             * Converting constructor (shares the pool).
+             * @param other The allocator to share the pool of.
+             */
+            template<typename U>
+            Allocator(const Allocator<U>& other) : m_pool(other.pool()) { }
+
+            /*!
+             * Allocate storage.
+             * @param count The number of objects.
+             * @return the storage.
+             */
+            T* allocate(const std::size_t count)
+            {
+                static_assert(alignof(T) <= kBlockAlignment, "GeometryPool blocks are only 16-byte aligned");
+                return static_cast<T*>(m_pool == nullptr ? ::operator new(count * sizeof(T)) : m_pool->allocate(count * sizeof(T)));
+            }
+
+            /*!
+             * Release storage.
+             * @param pointer The storage.
+             * @param count The number of objects.
+             */
+            void deallocate(T* pointer, const std::size_t count)
+            {
+                if (m_pool == nullptr)
+                {
+                    ::operator delete(pointer);
+                }
+                else
+                {
+                    m_pool->deallocate(pointer, count * sizeof(T));
+                }
+            }
+
+            /*!
+             * Fetch the pool.
+             * @return the pool (nullptr for the global heap).
+             */
+            const std::shared_ptr<GeometryPool>& pool() const { return m_pool; }
+
+        private:
+            /// The pool (which outlives the blocks it allocated).
+            std::shared_ptr<GeometryPool> m_pool;
+        };
+
+    public:
+        //! Constructor.
+        GeometryPool();
+
+        //! Disable copy constructor.
+        GeometryPool(const GeometryPool&) = delete;
+
+        //! Disable copy assignment.
+        GeometryPool& operator=(const GeometryPool&) = delete;
+
+        //! Destructor.
+        ~GeometryPool();
+
+        /*!
+         * Create an object (usually a geometry) with its control block in a single block of the pool.
+         * @param pool The pool to allocate from.
+         * @param args The constructor arguments.
+         * @return the object.
+         */
+        template<typename T, typename... Args>
+        static std::shared_ptr<T> create(const std::shared_ptr<GeometryPool>& pool, Args&&... args)
+        {
+            return std::allocate_shared<T>(Allocator<T>(pool), std::forward<Args>(args)...);
+        }
+
+        /*!
+         * Allocate a block.
+         * @param bytes The size of the block.
+         * @return the block.
+         */
+        void* allocate(const std::size_t bytes);
+
+        /*!
+         * Release a block.
+         * @param block The block.
+         * @param bytes The size of the block (as allocated).
+         */
+        void deallocate(void* block, const std::size_t bytes);
+
+        /*!
+         * Fetch the statistics of the pool.
+         * @return the statistics.
+         */
+        GeometryPoolStats stats() const;
+
+    private:
+        /// The number of size classes.
+        static const std::size_t kSizeClasses = kMaxBlockSize / kBlockAlignment;
+
+        //! The header at the start of each page.
+        struct Page
+        {
+            /// The size of the page's blocks.
+            std::size_t block_size;
+
+            /// The number of blocks in use.
+            std::size_t live_blocks;
+
+            /// The offset of the first never used block.
+            std::size_t bump_offset;
+
+            /// The freed blocks (linked through their first word).
+            void* free_blocks;
+
+            /// The previous page with free blocks of the same size class.
+            Page* previous;
+
+            /// The next page with free blocks of the same size class.
+            Page* next;
+
+            /// Whether the page is in the list of pages with free blocks.
+            bool available;
+        };
+
+        /*!
+         * Allocate a new page.
+         * @param block_size The size of the page's blocks.
+         * @return the page.
+         */
+        Page* allocatePage(const std::size_t block_size);
+
+        /*!
+         * Link a page into the list of pages with free blocks.
+         * @param page The page.
+         */
+        void linkPage(Page* page);
+
+        /*!
+         * Unlink a page from the list of pages with free blocks.
+         * @param page The page.
+         */
+        void unlinkPage(Page* page);
+
+    private:
+        /// Mutex to protect the pages.
+        mutable ProfiledMutex m_mutex;
+
+        /// The pages with free blocks, per size class.
+        std::array<Page*, kSizeClasses> m_available_pages;
+
+        /// The number of pages allocated.
+        std::size_t m_pages;
+
+        /// The number of blocks in use.
+        std::size_t m_live_blocks;
+    };
+
+    /*!
+     * Compare allocators.
+     * @return whether the allocators share the same pool.
+     */
+    template<typename T, typename U>
+    inline bool operator==(const GeometryPool::Allocator<T>& lhs, const GeometryPool::Allocator<U>& rhs) { return lhs.pool() == rhs.pool(); }
+
+    /*!
+     * Compare allocators.
+     * @return whether the allocators use different pools.
+     */
+    template<typename T, typename U>
+    inline bool operator!=(const GeometryPool::Allocator<T>& lhs, const GeometryPool::Allocator<U>& rhs) { return lhs.pool() != rhs.pool(); }
+}
@@ -0,0 +1,275 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "Hillshade.h"
+
+// STL includes.
+#include <algorithm>
+#include <cmath>
+
+// SIMD includes.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QMC_HILLSHADE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace qmapcontrol
+{
+    namespace
+    {
+        //! The constants of the shading kernel.
+        struct Kernel
+        {
+            /// The gradient factor (vertical exaggeration / (8 * cell size)).
+            float gradient_factor;
+
+            /// The light direction (x and y), relative to its height.
+            float light_x;
+            float light_y;
+
+            /// The opacity of the darkest shade (0 to 255).
+            float scale;
+
+            /// Whether the slope is shaded (otherwise the hillshade).
+            bool slope;
+        };
+
+        /*!
+         * Shade a pixel.
+         * @param top The row above (at the pixel to the left).
+         * @param middle The row (at the pixel to the left).
+         * @param bottom The row below (at the pixel to the left).
+         * @param kernel The kernel constants.
+         * @return the shaded pixel.
+         */
+        inline quint32 shadePixel(const float* top, const float* middle, const float* bottom, const Kernel& kernel)
+        {
+            // Horn's gradient (y points south).
+            const float dx = ((top[2] + 2.0f * middle[2] + bottom[2]) - (top[0] + 2.0f * middle[0] + bottom[0])) * kernel.gradient_factor;
+            const float dy = ((bottom[0] + 2.0f * bottom[1] + bottom[2]) - (top[0] + 2.0f * top[1] + top[2])) * kernel.gradient_factor;
+            const float norm = 1.0f / std::sqrt(1.0f + dx * dx + dy * dy);
+
+            // Shade relative to flat terrain, or by the sine of the slope.
+            float value;
+            if (kernel.slope)
+            {
+                value = std::sqrt(dx * dx + dy * dy) * norm;
+            }
+            else
+            {
+                value = 1.0f - (1.0f - dx * kernel.light_x - dy * kernel.light_y) * norm;
+            }
+            const int alpha = int(std::min(1.0f, std::max(0.0f, value)) * kernel.scale + 0.5f);
+            return quint32(alpha) << 24;
+        }
+
+        /*!
+         * Shade a row of pixels.
+         * @param top The row above (including the left border).
+         * @param middle The row (including the left border).
+         * @param bottom The row below (including the left border).
+         * @param width The number of pixels.
+         * @param kernel The kernel constants.
+         * @param output The shaded pixels.
+         */
+        void shadeRow(const float* top, const float* middle, const float* bottom, const int width, const Kernel& kernel, quint32* output)
+        {
+            int x = 0;
+#ifdef QMC_HILLSHADE_SSE2
+            // Shade 4 pixels at a time.
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 two = _mm_set1_ps(2.0f);
+            const __m128 gradient_factor = _mm_set1_ps(kernel.gradient_factor);
+            const __m128 light_x = _mm_set1_ps(kernel.light_x);
+            const __m128 light_y = _mm_set1_ps(kernel.light_y);
+            const __m128 scale = _mm_set1_ps(kernel.scale);
+            for (; x + 4 <= width; x += 4)
+            {
+                // Load the 3x3 neighbourhoods.
+                const __m128 a = _mm_loadu_ps(top + x);
+                const __m128 b = _mm_loadu_ps(top + x + 1);
+                const __m128 c = _mm_loadu_ps(top + x + 2);
+                const __m128 d = _mm_loadu_ps(middle + x);
+                const __m128 f = _mm_loadu_ps(middle + x + 2);
+                const __m128 g = _mm_loadu_ps(bottom + x);
+                const __m128 h = _mm_loadu_ps(bottom + x + 1);
+                const __m128 i = _mm_loadu_ps(bottom + x + 2);
+
+                // Horn's gradient (y points south).
+                const __m128 dx = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_add_ps(c, _mm_mul_ps(two, f)), i),
+                                                        _mm_add_ps(_mm_add_ps(a, _mm_mul_ps(two, d)), g)), gradient_factor);
+                const __m128 dy = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_add_ps(g, _mm_mul_ps(two, h)), i),
+                                                        _mm_add_ps(_mm_add_ps(a, _mm_mul_ps(two, b)), c)), gradient_factor);
+                const __m128 gradient_squared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+                const __m128 norm = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(one, gradient_squared)));
+
+                // Shade relative to flat terrain, or by the sine of the slope.
+                __m128 value;
+                if (kernel.slope)
+                {
+                    value = _mm_mul_ps(_mm_sqrt_ps(gradient_squared), norm);
+                }
+                else
+                {
+                    const __m128 lit = _mm_sub_ps(_mm_sub_ps(one, _mm_mul_ps(dx, light_x)), _mm_mul_ps(dy, light_y));
+                    value = _mm_sub_ps(one, _mm_mul_ps(lit, norm));
+                }
+                value = _mm_mul_ps(_mm_min_ps(one, _mm_max_ps(zero, value)), scale);
+
+                // Store the shade as the alpha of premultiplied black.
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output + x), _mm_slli_epi32(_mm_cvtps_epi32(value), 24));
+            }
+#endif
+            // Shade the remaining pixels.
+            for (; x < width; ++x)
+            {
+                output[x] = shadePixel(top + x, middle + x, bottom + x, kernel);
+            }
+        }
+    }
+
+    HillshadeOptions::HillshadeOptions()
+        : mode(Mode::Hillshade),
+          azimuth(315.0),
+          altitude(45.0),
+          z_factor(1.0),
+          strength(0.6)
+    {
+
+    }
+
+    namespace hillshade
+    {
+        HeightTile decodeHeights(const QImage& image, const DemEncoding encoding)
+        {
+            // The channels must be read unpremultiplied.
+            const QImage rgb = (image.format() == QImage::Format_RGB32 || image.format() == QImage::Format_ARGB32) ? image : image.convertToFormat(QImage::Format_RGB32);
+
+            HeightTile tile;
+            tile.width = rgb.width();
+            tile.height = rgb.height();
+            tile.heights.resize(std::size_t(tile.width) * std::size_t(tile.height));
+
+            // Decode each row.
+            float* heights = tile.heights.data();
+            for (int y = 0; y < tile.height; ++y)
+            {
+                const QRgb* pixels = reinterpret_cast<const QRgb*>(rgb.constScanLine(y));
+                switch(encoding)
+                {
+                    case DemEncoding::TerrainRGB:
+                    {
+                        for (int x = 0; x < tile.width; ++x)
+                        {
+                            *heights++ = -10000.0f + float((qRed(pixels[x]) << 16) | (qGreen(pixels[x]) << 8) | qBlue(pixels[x])) * 0.1f;
+                        }
+                        break;
+                    }
+                    case DemEncoding::Terrarium:
+                    {
+                        for (int x = 0; x < tile.width; ++x)
+                        {
+                            *heights++ = float(qRed(pixels[x]) * 256 + qGreen(pixels[x])) + float(qBlue(pixels[x])) / 256.0f - 32768.0f;
+                        }
+                        break;
+                    }
+                }
+            }
+
+            // Return the heights.
+            return tile;
+        }
+
+        QImage shade(const std::array<const HeightTile*, 9>& tiles, const double cell_size, const HillshadeOptions& options)
+        {
+            // The centre tile is required.
+            const HeightTile* centre = tiles[4];
+            if (centre == nullptr || centre->width <= 0 || centre->height <= 0)
+            {
+                return QImage();
+            }
+            const int width = centre->width;
+            const int height = centre->height;
+            const float* heights = centre->heights.data();
+
+            // Neighbours of another size are ignored.
+            std::array<const float*, 9> neighbours;
+            for (std::size_t i = 0; i < tiles.size(); ++i)
+            {
+                neighbours[i] = (tiles[i] != nullptr && tiles[i]->width == width && tiles[i]->height == height) ? tiles[i]->heights.data() : nullptr;
+            }
+
+            // Surround the heights with a 1 pixel border from the neighbours (or the repeated edge).
+            const int stride = width + 2;
+            std::vector<float> grid(std::size_t(stride) * std::size_t(height + 2));
+            for (int y = 0; y < height; ++y)
+            {
+                float* row = &grid[std::size_t(y + 1) * stride];
+                std::copy(heights + y * width, heights + (y + 1) * width, row + 1);
+                row[0] = neighbours[3] != nullptr ? neighbours[3][y * width + width - 1] : heights[y * width];
+                row[width + 1] = neighbours[5] != nullptr ? neighbours[5][y * width] : heights[y * width + width - 1];
+            }
+            float* top = &grid[0];
+            float* bottom = &grid[std::size_t(height + 1) * stride];
+            for (int x = 0; x < width; ++x)
+            {
+                top[x + 1] = neighbours[1] != nullptr ? neighbours[1][(height - 1) * width + x] : heights[x];
+                bottom[x + 1] = neighbours[7] != nullptr ? neighbours[7][x] : heights[(height - 1) * width + x];
+            }
+            top[0] = neighbours[0] != nullptr ? neighbours[0][height * width - 1] : top[1];
+            top[width + 1] = neighbours[2] != nullptr ? neighbours[2][(height - 1) * width] : top[width];
+            bottom[0] = neighbours[6] != nullptr ? neighbours[6][width - 1] : bottom[1];
+            bottom[width + 1] = neighbours[8] != nullptr ? neighbours[8][0] : bottom[width];
+
+            // Set up the kernel (the light points towards the azimuth, with y pointing south).
+            const double pi = std::acos(-1.0);
+            const double azimuth = options.azimuth * pi / 180.0;
+            const double altitude = options.altitude * pi / 180.0;
+            const double light_z = std::max(std::sin(altitude), 1e-3);
+            Kernel kernel;
+            kernel.gradient_factor = float(options.z_factor / (8.0 * std::max(cell_size, 1e-6)));
+            kernel.light_x = float(std::cos(altitude) * std::sin(azimuth) / light_z);
+            kernel.light_y = float(-std::cos(altitude) * std::cos(azimuth) / light_z);
+            kernel.scale = float(std::min(1.0, std::max(0.0, options.strength)) * 255.0);
+            kernel.slope = options.mode == HillshadeOptions::Mode::Slope;
+
+            // Shade each row.
+            QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+            for (int y = 0; y < height; ++y)
+            {
+                shadeRow(&grid[std::size_t(y) * stride],
+                         &grid[std::size_t(y + 1) * stride],
+                         &grid[std::size_t(y + 2) * stride],
+                         width,
+                         kernel,
+                         reinterpret_cast<quint32*>(image.scanLine(y)));
+            }
+
+            // Return the shade.
+            return image;
+        }
+    }
+}
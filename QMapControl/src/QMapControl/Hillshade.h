@@ -0,0 +1,113 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// Qt includes.
+#include <QtGui/QImage>
+
+// STL includes.
+#include <array>
+#include <vector>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+
+namespace qmapcontrol
+{
+    //! The encoding of elevation (DEM) tiles.
+    enum class DemEncoding
+    {
+        /// Mapbox Terrain-RGB: height = -10000 + (R * 65536 + G * 256 + B) * 0.1 metres.
+        TerrainRGB,
+        /// Terrarium: height = R * 256 + G + B / 256 - 32768 metres.
+        Terrarium
+    };
+
+    //! How the terrain is shaded (see LayerHillshade).
+    struct QMAPCONTROL_EXPORT HillshadeOptions
+    {
+        //! What is shaded.
+        enum class Mode
+        {
+            /// Shadows of the slopes facing away from the light (flat terrain is left clear).
+            Hillshade,
+            /// The steepness of the slopes.
+            Slope
+        };
+
+        /// What is shaded.
+        Mode mode;
+
+        /// The direction of the light, in degrees clockwise from north.
+        double azimuth;
+
+        /// The height of the light above the horizon, in degrees.
+        double altitude;
+
+        /// The vertical exaggeration.
+        double z_factor;
+
+        /// The opacity of the darkest shade (0 to 1).
+        double strength;
+
+        //! Constructor (light from the north-west, 45 degrees high).
+        HillshadeOptions();
+    };
+
+    //! Heights of an elevation tile.
+    struct QMAPCONTROL_EXPORT HeightTile
+    {
+        /// The width in pixels.
+        int width;
+
+        /// The height in pixels.
+        int height;
+
+        /// The heights in metres (row by row).
+        std::vector<float> heights;
+    };
+
+    namespace hillshade
+    {
+        /*!
+         * Decode the heights of an elevation tile.
+         * @param image The elevation tile.
+         * @param encoding The encoding of the elevation tile.
+         * @return the heights.
+         */
+        QMAPCONTROL_EXPORT HeightTile decodeHeights(const QImage& image, const DemEncoding encoding);
+
+        /*!
+         * Shade an elevation tile.
+         * @param tiles The elevation tile (index 4) and its 8 neighbours (row by row, nullptr when not
+         *              available, the edge of the tile is repeated instead).
+         * @param cell_size The ground size of a pixel in metres.
+         * @param options The shading options.
+         * @return the shade (premultiplied black with the shade as alpha).
+         */
+        QMAPCONTROL_EXPORT QImage shade(const std::array<const HeightTile*, 9>& tiles, const double cell_size, const HillshadeOptions& options);
+    }
+}
@@ -26,14 +26,21 @@
 #include "ImageManager.h"
 
 // Qt includes.
+#include <QtConcurrent/QtConcurrentRun>
 #include <QCryptographicHash>
 #include <QDateTime>
 #include <QPainter>
 #include <QImageReader>
 #include <QBuffer>
+#include <QElapsedTimer>
+
+// STL includes.
+#include <algorithm>
 
 // Local includes.
+#include "Phase.h"
 #include "Projection.h"
+#include "Trace.h"
 
 
 namespace qmapcontrol
@@ -45,6 +52,9 @@ namespace qmapcontrol
     {
         /// Singleton instance of Image Manager.
         std::unique_ptr<ImageManager> m_instance = nullptr;
+
+        /// The number of tiles missing from the tile provider that are remembered.
+        const int kProviderMissingCapacity = 4096;
     }
 
     ImageManager& ImageManager::get()
@@ -71,21 +81,72 @@ namespace qmapcontrol
     ImageManager::ImageManager(const int tile_size_px, QObject* parent)
         : QObject(parent),
           m_tile_size_px(tile_size_px),
+          m_tileCacheLock("ImageManager::m_tileCacheLock"),
+          m_memoryCacheClock(0),
+          m_memoryCacheCapacity(0),
+          m_preloadAborted(false),
           m_diskCache(nullptr),
+          m_diskProcessing(false),
+          m_diskQueueLock("ImageManager::m_diskQueueLock"),
           m_cachePolicy(CachePolicy::AlwaysCache),
-          m_tileProvider(nullptr)
+          m_prefetchUrlsLock("ImageManager::m_prefetchUrlsLock"),
+          m_prefetchEnabled(true),
+          m_tileProvider(nullptr),
+          m_tileProviderLock("ImageManager::m_tileProviderLock"),
+          m_asyncTileProvider(nullptr),
+          m_providerMissingUrls(kProviderMissingCapacity),
+          m_sharedCacheLock("ImageManager::m_sharedCacheLock")
     {
         setMemoryCacheCapacity(kDefaultPixmapCacheSizeMiB);
+
+        // Read the disk cache from a single thread.
+        m_diskThread.setMaxThreadCount(1);
         // Setup a loading/empty pixmaps
         setupPlaceholderPixmaps();
 
+        // Let the network manager record its metrics.
+        m_networkManager.setMetrics(&m_metrics);
+
         // Connect signal/slot for image downloads.
         connect(this, &ImageManager::downloadImage, &m_networkManager, &NetworkManager::downloadImage);
+        connect(this, &ImageManager::revalidateImage, &m_networkManager, &NetworkManager::refreshImage);
         connect(&m_networkManager, &NetworkManager::imageDownloaded, this, &ImageManager::handleImageDownloaded);
+        connect(&m_networkManager, &NetworkManager::imagePartiallyDownloaded, this, &ImageManager::handleImagePartiallyDownloaded);
         connect(&m_networkManager, &NetworkManager::imageCached, this, &ImageManager::handleImageCached);
+        connect(&m_networkManager, &NetworkManager::imageRefreshed, this, &ImageManager::handleImageRefreshed);
         connect(&m_networkManager, &NetworkManager::imageDownloadFailed, this, &ImageManager::imageDownloadFailed);
+        connect(&m_networkManager, &NetworkManager::imageDownloadFailed, this, &ImageManager::handleImageDownloadFailed);
+        connect(&m_networkManager, &NetworkManager::imageDataDownloaded, this, &ImageManager::handleImageDataDownloaded);
         connect(&m_networkManager, &NetworkManager::downloadingInProgress, this, &ImageManager::downloadingInProgress);
         connect(&m_networkManager, &NetworkManager::downloadingFinished, this, &ImageManager::downloadingFinished);
+
+        // Connect signal/slot to check the shared cache (started when the shared cache is enabled).
+        m_sharedPollTimer.setInterval(100);
+        connect(&m_sharedPollTimer, &QTimer::timeout, this, &ImageManager::pollSharedCache);
+    }
+
+    ImageManager::~ImageManager()
+    {
+        // Stop reading the disk cache (after the request in progress).
+        {
+            ProfiledMutexLocker locker(&m_diskQueueLock);
+            m_diskQueue.clear();
+            m_diskQueueKeys.clear();
+        }
+        m_diskThread.waitForDone();
+
+        // Stop inserting warm start tiles.
+        m_preloadAborted.store(true);
+        m_preloadFuture.waitForFinished();
+
+        // Release the shared cache claims.
+        disableSharedCache();
+
+        // Drop the completions of the asynchronous tile provider still in progress.
+        if (m_providerLink != nullptr) {
+            ProfiledWriteLocker locker(&m_providerLink->lock);
+            m_providerLink->manager = nullptr;
+        }
     }
 
     int ImageManager::tileSizePx() const
@@ -118,10 +179,16 @@ namespace qmapcontrol
         if (success)
         {
             if (m_diskCache == nullptr) {
-                m_diskCache = new QNetworkDiskCache(this);
+                m_diskCache = new WriteBehindDiskCache(this);
+            } else {
+                // Write the pending tiles to the previous directory.
+                m_diskCache->flush();
             }
-            m_diskCache->setCacheDirectory(dir.absolutePath());
-            m_diskCache->setMaximumCacheSize(static_cast<qint64>(capacityMiB) * 1024 * 1024);
+            m_diskCache->setCacheDirectory(dir.absolutePath(), static_cast<qint64>(capacityMiB) * 1024 * 1024);
+
+            // Look the missing tiles up again.
+            ProfiledMutexLocker locker(&m_diskQueueLock);
+            m_diskMissingUrls.clear();
         }
         else
         {
@@ -138,12 +205,218 @@ namespace qmapcontrol
         }
     }
 
+    void ImageManager::queueDiskRequest(const QUrl& url, const TileDecodeOptions& options, const DiskRequest request)
+    {
+        // Each tile, options and request is queued once.
+        const QByteArray key = hashTileUrl(url, options) + '/' + QByteArray::number(int(request));
+        ProfiledMutexLocker locker(&m_diskQueueLock);
+        if (m_diskQueueKeys.contains(key)) {
+            return;
+        }
+        m_diskQueueKeys.insert(key);
+        m_diskQueue.push_back({ url, options, request, key });
+
+        // Start the disk thread, if it is not already processing the queue.
+        if (!m_diskProcessing) {
+            m_diskProcessing = true;
+            QtConcurrent::run(&m_diskThread, this, &ImageManager::processDiskRequests);
+        }
+    }
+
+    void ImageManager::processDiskRequests()
+    {
+        // Mark the phase (for the stall detector).
+        QMC_PHASE("ImageManager::processDiskRequests");
+
+        while (true) {
+            // Take the next request.
+            PendingDiskRequest pending;
+            {
+                ProfiledMutexLocker locker(&m_diskQueueLock);
+                if (m_diskQueue.empty()) {
+                    m_diskProcessing = false;
+                    return;
+                }
+                pending = m_diskQueue.front();
+                m_diskQueue.pop_front();
+            }
+
+            switch(pending.request)
+            {
+                case DiskRequest::Decode:
+                {
+                    // Read the encoded tile.
+                    QByteArray bytes;
+                    QIODevice* data = m_diskCache->data(pending.url);
+                    const bool found = data != nullptr;
+                    if (found) {
+                        bytes = data->readAll();
+                        data->close();
+                        delete data;
+                    }
+
+                    if (found) {
+                        m_metrics.disk_cache_hits.fetch_add(1, std::memory_order_relaxed);
+                        QBuffer buffer(&bytes);
+                        if (pending.options.isDefault()) {
+                            // Share the encoded tile with the other processes.
+                            if (hasSharedCache()) {
+                                offerSharedTile(pending.url, bytes);
+                            }
+
+                            // Decode it into the memory cache (prefetched tiles are not redrawn).
+                            const bool prefetched = isPrefetchUrl(pending.url);
+                            getImageFromDevice(pending.url, &buffer);
+                            if (!prefetched) {
+                                emit imageUpdated(pending.url);
+                            }
+                        } else {
+                            getImageFromDevice(hashTileUrl(pending.url, pending.options), &buffer, pending.options);
+                            emit imageUpdated(pending.url);
+                        }
+                    } else {
+                        m_metrics.disk_cache_misses.fetch_add(1, std::memory_order_relaxed);
+                        {
+                            ProfiledMutexLocker locker(&m_diskQueueLock);
+                            m_diskMissingUrls.insert(pending.url);
+                        }
+
+                        // Download the full size tile, or redraw (with the empty tile, or from the full size tile).
+                        if (pending.options.isDefault() && m_cachePolicy == CachePolicy::PreferCache) {
+                            emit downloadImage(pending.url, false);
+                        } else {
+                            if (pending.options.isDefault()) {
+                                abandonSharedTile(pending.url);
+                            }
+                            emit imageUpdated(pending.url);
+                        }
+                    }
+                    break;
+                }
+                case DiskRequest::Revalidate:
+                {
+                    // Mark a copy still considered fresh as expired, so the network manager revalidates it (If-None-Match/If-Modified-Since).
+                    QNetworkCacheMetaData metaData = m_diskCache->metaData(pending.url);
+                    if (metaData.isValid()) {
+                        const QDateTime now = QDateTime::currentDateTimeUtc();
+                        if (!metaData.expirationDate().isValid() || metaData.expirationDate() > now) {
+                            metaData.setExpirationDate(now.addSecs(-1));
+                            m_diskCache->updateMetaData(metaData);
+                        }
+                    }
+
+                    // Emit that we need to revalidate the image using the network manager.
+                    emit revalidateImage(pending.url);
+                    break;
+                }
+                case DiskRequest::Probe:
+                {
+                    // Look the tile up in the tile provider, or in the disk cache (its metadata only, the tile is not read).
+                    bool found = false;
+                    bool provider = false;
+                    {
+                        ProfiledMutexLocker locker(&m_tileProviderLock);
+                        if (m_syncTileProviderAdapter) {
+                            QByteArray data;
+                            found = m_syncTileProviderAdapter->getTileData(pending.url, data) && data.isEmpty() == false;
+                            provider = true;
+                        }
+                    }
+                    if (!provider && m_diskCache != nullptr) {
+                        found = m_diskCache->metaData(pending.url).isValid();
+                        if (!found) {
+                            ProfiledMutexLocker locker(&m_diskQueueLock);
+                            m_diskMissingUrls.insert(pending.url);
+                        }
+                    }
+
+                    // Report it, or download it (offline, there is nothing to wait for).
+                    if (found) {
+                        QMetaObject::invokeMethod(this, "handleImageCached", Qt::QueuedConnection, Q_ARG(QUrl, pending.url));
+                    } else if (m_cachePolicy != CachePolicy::AlwaysCache) {
+                        emit downloadImage(pending.url, true);
+                    }
+                    break;
+                }
+            }
+
+            // The tile may be queued again.
+            ProfiledMutexLocker locker(&m_diskQueueLock);
+            m_diskQueueKeys.remove(pending.key);
+        }
+    }
+
+    bool ImageManager::isMissingFromDisk(const QUrl& url) const
+    {
+        ProfiledMutexLocker locker(&m_diskQueueLock);
+        return m_diskMissingUrls.contains(url);
+    }
+
+    bool ImageManager::isPrefetchUrl(const QUrl& url) const
+    {
+        ProfiledMutexLocker locker(&m_prefetchUrlsLock);
+        return m_prefetchUrls.contains(url);
+    }
+
+    void ImageManager::addPrefetchUrl(const QUrl& url)
+    {
+        ProfiledMutexLocker locker(&m_prefetchUrlsLock);
+        m_prefetchUrls.insert(url);
+    }
+
+    bool ImageManager::takePrefetchUrl(const QUrl& url)
+    {
+        ProfiledMutexLocker locker(&m_prefetchUrlsLock);
+        return m_prefetchUrls.remove(url);
+    }
+
     void ImageManager::abortLoading()
     {
         // Abort any remaining network manager downloads.
         m_networkManager.abortDownloads();
 
-        m_prefetchUrls.clear();
+        {
+            ProfiledMutexLocker prefetchLocker(&m_prefetchUrlsLock);
+            m_prefetchUrls.clear();
+        }
+        {
+            ProfiledWriteLocker tileCacheLocker(&m_tileCacheLock);
+            m_warmKeys.clear();
+            m_partialTiles.clear();
+        }
+
+        // Drop the queued disk cache decodes (revalidations still complete).
+        {
+            ProfiledMutexLocker diskQueueLocker(&m_diskQueueLock);
+            for (auto it = m_diskQueue.begin(); it != m_diskQueue.end(); ) {
+                if (it->request == DiskRequest::Decode) {
+                    m_diskQueueKeys.remove(it->key);
+                    it = m_diskQueue.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        // Release the shared cache claims of the aborted downloads and stop waiting for the other processes.
+        ProfiledMutexLocker locker(&m_sharedCacheLock);
+        if (m_sharedCache != nullptr) {
+            for (const auto& url : m_sharedClaimedUrls) {
+                m_sharedCache->abandon(hashTileUrl(url));
+            }
+        }
+        m_sharedClaimedUrls.clear();
+        m_sharedWaitingUrls.clear();
+        locker.unlock();
+
+        // Cancel the requests of the asynchronous tile provider (and retry the missing tiles later).
+        ProfiledMutexLocker tileProviderLock(&m_tileProviderLock);
+        if (m_asyncTileProvider != nullptr) {
+            m_asyncTileProvider->cancelRequests();
+        }
+        m_providerQueue.clear();
+        m_providerPendingUrls.clear();
+        m_providerMissingUrls.clear();
     }
 
     int ImageManager::downloadQueueSize() const
@@ -152,25 +425,251 @@ namespace qmapcontrol
         return m_networkManager.downloadQueueSize();
     }
 
+    TileMetrics ImageManager::metrics() const
+    {
+        // Capture the counters.
+        TileMetrics metrics = m_metrics.snapshot();
+
+        // Add the lock contention (empty unless built with QMC_LOCK_PROFILE).
+        metrics.locks = lockprofile::snapshot();
+
+        // Return the metrics.
+        return metrics;
+    }
+
+    void ImageManager::resetMetrics()
+    {
+        // Reset the counters.
+        m_metrics.reset();
+        lockprofile::reset();
+    }
+
+    TileCacheUsage ImageManager::memoryUsage() const
+    {
+        TileCacheUsage usage;
+
+        // The memory cache, and the pinned tiles kept aside.
+        {
+            ProfiledReadLocker locker(&m_tileCacheLock);
+            usage.memory_cache_bytes = std::size_t(m_memoryCache.totalCost());
+            usage.memory_cache_capacity_bytes = std::size_t(m_memoryCacheCapacity);
+            usage.memory_cache_tiles = std::size_t(m_memoryCache.count());
+            usage.pinned_bytes = pinnedBytes();
+        }
+
+        // The placeholder pixmaps.
+        usage.placeholder_bytes = memory::pixmapBytes(m_pixmapLoading) + memory::pixmapBytes(m_pixmapEmpty);
+
+        // The disk cache.
+        if (m_diskCache != nullptr)
+        {
+            usage.disk_cache_bytes = std::size_t(std::max<qint64>(0, m_diskCache->cacheSize()));
+        }
+
+        // Return the usage.
+        return usage;
+    }
+
     QPixmap ImageManager::getImage(const QUrl& url)
     {
+        // Trace the lookup.
+        QMC_TRACE_SCOPE("tiles", "ImageManager::getImage");
+
         QPixmap pixmap;
-        if (findTileInMemoryCache(url, pixmap))
+        if (findTileInMemoryCache(url, pixmap, true))
         {
             Q_ASSERT(!pixmap.isNull());
             // Image found in memory cache, use it
+            m_metrics.memory_cache_hits.fetch_add(1, std::memory_order_relaxed);
+            return pixmap;
+        }
+        m_metrics.memory_cache_misses.fetch_add(1, std::memory_order_relaxed);
+        pixmap = getImageInternal(url);
+
+        // Show what has arrived of a tile that is still downloading.
+        if (pixmap.cacheKey() == m_pixmapLoading.cacheKey())
+        {
+            findPartialTile(url, pixmap);
+        }
+        return pixmap;
+    }
+
+    QPixmap ImageManager::getImage(const QUrl& url, const TileDecodeOptions& options)
+    {
+        // Full size tiles have the plain entries.
+        if (options.isDefault())
+        {
+            return getImage(url);
+        }
+
+        // Trace the lookup.
+        QMC_TRACE_SCOPE("tiles", "ImageManager::getImage");
+
+        // Look for the tile at the reduced size.
+        const QByteArray key = hashTileUrl(url, options);
+        QPixmap pixmap;
+        if (findTileInMemoryCache(key, pixmap, true))
+        {
+            m_metrics.memory_cache_hits.fetch_add(1, std::memory_order_relaxed);
+            return pixmap;
+        }
+        m_metrics.memory_cache_misses.fetch_add(1, std::memory_order_relaxed);
+
+        // Downscale/transform the full size tile in the background if it is already decoded (drawn until then).
+        if (findTileInMemoryCache(url, pixmap, true))
+        {
+            queueDerivedTile({ url, options, key });
+            return pixmap;
+        }
+
+        // Decode the tile from the disk cache directly with the options (JPEG scales in the DCT domain), in the disk thread.
+        if ((m_cachePolicy == CachePolicy::AlwaysCache || m_cachePolicy == CachePolicy::PreferCache) && m_diskCache != nullptr && !isMissingFromDisk(url))
+        {
+            queueDiskRequest(url, options, DiskRequest::Decode);
+            return m_pixmapLoading;
+        }
+
+        // Fetch the full size tile (downloads, providers...), and apply the options once it is complete (partial tiles are drawn as they are).
+        pixmap = getImage(url);
+        if (isPlaceholder(pixmap))
+        {
+            return pixmap;
+        }
+        QPixmap partial;
+        if (!findPartialTile(url, partial) || partial.cacheKey() != pixmap.cacheKey())
+        {
+            queueDerivedTile({ url, options, key });
+        }
+        return pixmap;
+    }
+
+    QPixmap ImageManager::getImage(const QUrl& url, const TileDecodeOptions& options, TileOpacity& opacity)
+    {
+        // Look for the tile in the memory cache, with its opacity.
+        QPixmap pixmap;
+        if (findTileInMemoryCache(options.isDefault() ? hashTileUrl(url) : hashTileUrl(url, options), pixmap, true, &opacity))
+        {
+            m_metrics.memory_cache_hits.fetch_add(1, std::memory_order_relaxed);
             return pixmap;
         }
-        return getImageInternal(url);
+
+        // Fetch the tile (it is classified once decoded, the empty placeholder has nothing to draw).
+        pixmap = getImage(url, options);
+        opacity = isPlaceholder(pixmap) && !isLoading(pixmap) ? TileOpacity::Transparent : TileOpacity::Mixed;
+        return pixmap;
+    }
+
+    QFuture<void> ImageManager::prepareImages(const std::vector<QUrl>& urls, const TileDecodeOptions& options)
+    {
+        // Derive the tiles from the full size tiles in the memory cache, request the others.
+        std::vector<DerivedTile> tiles;
+        for (const auto& url : urls)
+        {
+            const QByteArray key = hashTileUrl(url, options);
+            QPixmap pixmap;
+            if (options.isDefault() || findTileInMemoryCache(key, pixmap, false))
+            {
+                continue;
+            }
+            if (findTileInMemoryCache(url, pixmap, false))
+            {
+                tiles.push_back({ url, options, key });
+            }
+            else
+            {
+                (void)getImage(url, options);
+            }
+        }
+        return deriveTiles(tiles, false);
+    }
+
+    QFuture<void> ImageManager::deriveTiles(const std::vector<DerivedTile>& tiles, const bool redraw)
+    {
+        // Take the full size tiles as images here (pixmaps are only used in the GUI thread).
+        std::vector<std::pair<DerivedTile, QImage>> sources;
+        for (const auto& tile : tiles)
+        {
+            QPixmap pixmap;
+            if (findTileInMemoryCache(tile.url, pixmap, false))
+            {
+                sources.push_back(std::make_pair(tile, pixmap.toImage()));
+            }
+            else
+            {
+                // The tile may be queued again.
+                ProfiledWriteLocker locker(&m_tileCacheLock);
+                m_deriveKeys.remove(tile.key);
+            }
+        }
+        if (sources.empty())
+        {
+            return QFuture<void>();
+        }
+
+        // Downscale/transform them in a background thread, they are inserted back in this thread.
+        return QtConcurrent::run([this, sources, redraw]()
+        {
+            // Trace the derivation.
+            QMC_TRACE_SCOPE("tiles", "ImageManager::deriveTiles");
+
+            for (const auto& source : sources)
+            {
+                const QImage image = tiledecode::apply(source.second, source.first.options);
+                QMetaObject::invokeMethod(this, "insertDecodedTile", Qt::QueuedConnection,
+                                          Q_ARG(QByteArray, source.first.key), Q_ARG(QImage, image), Q_ARG(int, int(tiledecode::classify(image))),
+                                          Q_ARG(bool, false), Q_ARG(bool, true), Q_ARG(QUrl, redraw ? source.first.url : QUrl()));
+            }
+        });
+    }
+
+    void ImageManager::queueDerivedTile(const DerivedTile& tile)
+    {
+        // Each tile is queued once, the queue is derived as one batch (see flushDerivedTiles()).
+        ProfiledWriteLocker locker(&m_tileCacheLock);
+        if (m_deriveKeys.contains(tile.key))
+        {
+            return;
+        }
+        m_deriveKeys.insert(tile.key);
+        if (m_deriveQueue.empty())
+        {
+            QMetaObject::invokeMethod(this, "flushDerivedTiles", Qt::QueuedConnection);
+        }
+        m_deriveQueue.push_back(tile);
+    }
+
+    void ImageManager::flushDerivedTiles()
+    {
+        // Take the queued tiles.
+        std::vector<DerivedTile> tiles;
+        {
+            ProfiledWriteLocker locker(&m_tileCacheLock);
+            tiles.swap(m_deriveQueue);
+        }
+
+        // Derive them in the background, and redraw them once inserted.
+        (void)deriveTiles(tiles, true);
+    }
+
+    bool ImageManager::isPlaceholder(const QPixmap& pixmap) const
+    {
+        // Copies of a pixmap share its cache key.
+        return pixmap.cacheKey() == m_pixmapLoading.cacheKey() || pixmap.cacheKey() == m_pixmapEmpty.cacheKey();
+    }
+
+    bool ImageManager::isLoading(const QPixmap& pixmap) const
+    {
+        // Copies of a pixmap share its cache key.
+        return pixmap.cacheKey() == m_pixmapLoading.cacheKey();
     }
 
     QByteArray ImageManager::rawImageFromDiskCache(const QUrl& url) const {
         {
-            QMutexLocker locked(&m_tileProviderLock);
-            if (m_tileProvider)
+            ProfiledMutexLocker locked(&m_tileProviderLock);
+            if (m_syncTileProviderAdapter)
             {
                 QByteArray data;
-                (void)m_tileProvider->getTileData(url, data);
+                (void)m_syncTileProviderAdapter->getTileData(url, data);
                 return data;
             }
         }
@@ -188,38 +687,83 @@ namespace qmapcontrol
         return QByteArray();
     }
 
-    QPixmap ImageManager::getImageInternal(const QUrl& url)
+    QPixmap ImageManager::getImageInternal(const QUrl& url, const int priority)
     {
         {
-            QMutexLocker locked(&m_tileProviderLock);
-            if (m_tileProvider) {
-                QByteArray data;
-                if (m_tileProvider->getTileData(url, data)) {
-                    QBuffer buffer(&data);
-                    return getImageFromDevice(url, &buffer);
-                } else {
+            ProfiledMutexLocker locked(&m_tileProviderLock);
+            if (m_asyncTileProvider) {
+                // A synchronous provider is asked by the draw for the displayed tiles, as when it was called from here.
+                if (m_syncTileProviderAdapter && priority != kTilePriorityPrefetch) {
+                    QByteArray data;
+                    const bool found = m_syncTileProviderAdapter->getTileData(url, data);
+                    locked.unlock();
+                    if (found) {
+                        m_metrics.provider_hits.fetch_add(1, std::memory_order_relaxed);
+                        QBuffer buffer(&data);
+                        return getImageFromDevice(url, &buffer);
+                    }
+                    m_metrics.provider_misses.fetch_add(1, std::memory_order_relaxed);
                     return m_pixmapEmpty;
                 }
+
+                // The provider does not have it.
+                const bool missing = m_providerMissingUrls.contains(url);
+                if (missing) {
+                    return m_pixmapEmpty;
+                }
+
+                // Queue the request, the queue is passed to the provider as one batch (see flushProviderRequests()).
+                if (!m_providerPendingUrls.contains(url)) {
+                    m_providerPendingUrls.insert(url);
+                    if (m_providerQueue.empty()) {
+                        QMetaObject::invokeMethod(this, "flushProviderRequests", Qt::QueuedConnection);
+                    }
+                    m_providerQueue.push_back({ url, priority });
+                }
+                return m_pixmapLoading;
+            }
+        }
+
+        // Look in the cache shared with the other processes (or claim the fetch).
+        QByteArray sharedData;
+        switch(acquireSharedTile(url, sharedData))
+        {
+            case SharedTileCache::Acquire::Hit:
+            {
+                m_metrics.shared_cache_hits.fetch_add(1, std::memory_order_relaxed);
+                QBuffer buffer(&sharedData);
+                return getImageFromDevice(url, &buffer);
+            }
+            case SharedTileCache::Acquire::InFlight:
+            {
+                // Another process is fetching it, wait for it (see pollSharedCache()).
+                m_metrics.shared_cache_waits.fetch_add(1, std::memory_order_relaxed);
+                return m_pixmapLoading;
+            }
+            case SharedTileCache::Acquire::Elected:
+            case SharedTileCache::Acquire::Miss:
+            {
+                break;
             }
         }
 
-        // in offline mode, ask cache directly or return empty tile
+        return fetchImage(url);
+    }
+
+    QPixmap ImageManager::fetchImage(const QUrl& url)
+    {
+        // in offline mode, ask cache (in the disk thread) or return empty tile
         if (m_cachePolicy == CachePolicy::AlwaysCache || m_cachePolicy == CachePolicy::PreferCache)
         {
-            if (m_diskCache != nullptr)
+            if (m_diskCache != nullptr && !isMissingFromDisk(url))
             {
-                auto data = m_diskCache->data(url);
-                if (data != nullptr)
-                {
-                    QPixmap pixmap = getImageFromDevice(url, data);
-                    data->close();
-                    delete data;
-                    return pixmap;
-                }
+                queueDiskRequest(url, TileDecodeOptions(), DiskRequest::Decode);
+                return m_pixmapLoading;
             }
 
             // In offline mode just look in the caches, no downloads
             if (m_cachePolicy == CachePolicy::AlwaysCache) {
+                abandonSharedTile(url);
                 return m_pixmapEmpty;
             }
         }
@@ -234,34 +778,180 @@ namespace qmapcontrol
 
     QPixmap ImageManager::getImageFromDevice(const QUrl& url, QIODevice* device)
     {
+        // Trace/mark the decode.
+        QMC_TRACE_SCOPE_ARG("tiles", "ImageManager::getImageFromDevice", url.toString());
+        QMC_PHASE("ImageManager::getImageFromDevice");
+
+        QElapsedTimer decode_timer;
+        decode_timer.start();
         QImageReader imageReader(device);
         QPixmap pixmap = QPixmap::fromImageReader(&imageReader);
+        m_metrics.decode_time_us.record(quint64(decode_timer.nsecsElapsed() / 1000));
+
+        insertTileToMemoryCache(url, pixmap, takePrefetchUrl(url));
+
+        return pixmap;
+    }
+
+    QPixmap ImageManager::getImageFromDevice(const QByteArray& key, QIODevice* device, const TileDecodeOptions& options)
+    {
+        // Trace/mark the decode.
+        QMC_TRACE_SCOPE("tiles", "ImageManager::getImageFromDevice");
+        QMC_PHASE("ImageManager::getImageFromDevice");
+
+        QElapsedTimer decode_timer;
+        decode_timer.start();
+        QPixmap pixmap = QPixmap::fromImage(tiledecode::decode(device, options));
+        m_metrics.decode_time_us.record(quint64(decode_timer.nsecsElapsed() / 1000));
 
-        insertTileToMemoryCache(url, pixmap);
-        m_prefetchUrls.remove(url);
+        insertTileToMemoryCache(key, pixmap, false, true);
 
         return pixmap;
     }
 
     void ImageManager::prefetchImage(const QUrl& url)
     {
+        // Prefetching disabled (eg: under memory pressure)?
+        if (!m_prefetchEnabled.load(std::memory_order_relaxed)) {
+            return;
+        }
+
         QPixmap pixmap;
 
         // Only if image is not already available
         if (!findTileInMemoryCache(url, pixmap)) {
             // Add the url to the prefetch list.
-            m_prefetchUrls.insert(url);
+            addPrefetchUrl(url);
+            m_metrics.prefetch_requests.fetch_add(1, std::memory_order_relaxed);
             // Request the image
-            (void)getImageInternal(url);
+            (void)getImageInternal(url, kTilePriorityPrefetch);
+        }
+    }
+
+    void ImageManager::setPrefetchEnabled(const bool enabled)
+    {
+        m_prefetchEnabled.store(enabled, std::memory_order_relaxed);
+
+        // Release the pinned tiles (they are pinned again once enabled, see setPinnedTiles()).
+        if (!enabled) {
+            ProfiledWriteLocker locker(&m_tileCacheLock);
+            m_pinnedKeys.clear();
+            m_pinnedTiles.clear();
+            applyMemoryCacheCapacity();
+        }
+    }
+
+    bool ImageManager::isPrefetchEnabled() const
+    {
+        return m_prefetchEnabled.load(std::memory_order_relaxed);
+    }
+
+    ImageManager::WarmRequest ImageManager::warmImage(const QUrl& url, const bool refresh)
+    {
+        // Warming is disabled with prefetching (eg: under memory pressure).
+        if (!m_prefetchEnabled.load(std::memory_order_relaxed)) {
+            return WarmRequest::None;
+        }
+
+        QPixmap pixmap;
+        if (findTileInMemoryCache(url, pixmap)) {
+            // Revalidate the disk cache copy (stored to the disk cache only, no redraw, not reported by imageCached).
+            if (refresh && m_diskCache != nullptr && m_cachePolicy != CachePolicy::AlwaysCache) {
+                emit revalidateImage(url);
+                return WarmRequest::Revalidate;
+            }
+            return WarmRequest::None;
+        }
+
+        // Will the tile come from the disk cache or the tile provider (rather than the network)?
+        bool local = m_cachePolicy == CachePolicy::AlwaysCache
+                || ((m_cachePolicy == CachePolicy::PreferCache) && m_diskCache != nullptr && !isMissingFromDisk(url));
+        {
+            ProfiledMutexLocker tileProviderLock(&m_tileProviderLock);
+            local = local || m_asyncTileProvider != nullptr;
+        }
+
+        // Mark the tile as warmed (counted when displayed).
+        {
+            ProfiledWriteLocker locker(&m_tileCacheLock);
+            m_warmKeys.insert(hashTileUrl(url));
+        }
+        m_metrics.warm_requests.fetch_add(1, std::memory_order_relaxed);
+
+        // Request the image like a prefetch (no redraw once received).
+        addPrefetchUrl(url);
+        (void)getImageInternal(url, kTilePriorityPrefetch);
+        return local ? WarmRequest::Load : WarmRequest::Download;
+    }
+
+    void ImageManager::setPinnedTiles(const std::vector<QUrl>& urls)
+    {
+        // Hash the urls (nothing is pinned while prefetching is disabled, eg: under memory pressure).
+        QSet<QByteArray> keys;
+        if (m_prefetchEnabled.load(std::memory_order_relaxed)) {
+            for (const auto& url : urls) {
+                keys.insert(hashTileUrl(url));
+            }
+        }
+
+        ProfiledWriteLocker locker(&m_tileCacheLock);
+
+        // Release the tiles no longer pinned.
+        for (auto it = m_pinnedTiles.begin(); it != m_pinnedTiles.end(); ) {
+            if (keys.contains(it.key())) {
+                ++it;
+            } else {
+                it = m_pinnedTiles.erase(it);
+            }
         }
+
+        // Keep aside the newly pinned tiles already in the memory cache.
+        for (const auto& key : keys) {
+            if (!m_pinnedTiles.contains(key)) {
+                const QPixmap* entry = m_memoryCache.object(key);
+                if (entry != nullptr) {
+                    m_pinnedTiles.insert(key, *entry);
+                }
+            }
+        }
+        m_pinnedKeys = keys;
+
+        // Count the pinned tiles kept aside against the memory cache capacity.
+        applyMemoryCacheCapacity();
+    }
+
+    bool ImageManager::refreshImage(const QUrl& url)
+    {
+        // Only with a disk cache, and when the network may be used.
+        if (m_diskCache == nullptr || (m_cachePolicy != CachePolicy::PreferNetwork && m_cachePolicy != CachePolicy::PreferCache)) {
+            return false;
+        }
+
+        // Expire and revalidate the copy in the disk thread.
+        queueDiskRequest(url, TileDecodeOptions(), DiskRequest::Revalidate);
+        return true;
+    }
+
+    QNetworkCacheMetaData ImageManager::diskCacheFileMetaData(const QString& file_path) const
+    {
+        if (m_diskCache == nullptr) {
+            return QNetworkCacheMetaData();
+        }
+        return m_diskCache->fileMetaData(file_path);
     }
 
     bool ImageManager::cacheImageToDisk(const QUrl& url)
     {
         if (m_cachePolicy == CachePolicy::AlwaysCache || m_cachePolicy == CachePolicy::PreferCache) {
-            if (rawImageFromDiskCache(url).size() > 0) {
-                handleImageCached(url);
-                return true;
+            // Look the tile up in the tile provider or the disk cache (in the disk thread).
+            bool provider = false;
+            {
+                ProfiledMutexLocker locked(&m_tileProviderLock);
+                provider = m_syncTileProviderAdapter != nullptr;
+            }
+            if (provider || (m_diskCache != nullptr && !isMissingFromDisk(url))) {
+                queueDiskRequest(url, TileDecodeOptions(), DiskRequest::Probe);
+                return m_cachePolicy == CachePolicy::AlwaysCache;
             }
             if (m_cachePolicy == CachePolicy::AlwaysCache) {
                 return true;
@@ -276,6 +966,12 @@ namespace qmapcontrol
     {
         m_cachePolicy = policy;
 
+        // Look the missing tiles up again.
+        {
+            ProfiledMutexLocker locker(&m_diskQueueLock);
+            m_diskMissingUrls.clear();
+        }
+
         if (m_cachePolicy == CachePolicy::AlwaysCache)
         {
             abortLoading();
@@ -303,34 +999,131 @@ namespace qmapcontrol
 
     void ImageManager::handleImageDownloaded(const QUrl& url, const QPixmap& pixmap)
     {
+        // Mark the phase (for the stall detector).
+        QMC_PHASE("ImageManager::handleImageDownloaded");
+
 #ifdef QMAP_DEBUG
         qDebug() << "ImageManager::handleImageDownloaded '" << url << "'";
 #endif
-        // Is this a prefetch request?
-        if (m_prefetchUrls.contains(url))
-        {
-            // Remove the url from the prefetch list.
-            m_prefetchUrls.remove(url);
-        }
-        else
+        // Is this a prefetch request (removed from the prefetch list)?
+        const bool prefetched = takePrefetchUrl(url);
+        if (prefetched == false)
         {
             // Let the world know we have received an updated image.
             emit imageUpdated(url);
         }
 
-        // Add it to the pixmap cache
-        insertTileToMemoryCache(url, pixmap);
+        // Add it to the pixmap cache (replacing the partial image).
+        insertTileToMemoryCache(url, pixmap, prefetched);
+        {
+            ProfiledWriteLocker locker(&m_tileCacheLock);
+            m_partialTiles.remove(hashTileUrl(url));
+        }
+
+        // The tile is in the disk cache now.
+        ProfiledMutexLocker locker(&m_diskQueueLock);
+        m_diskMissingUrls.remove(url);
+    }
+
+    void ImageManager::handleImagePartiallyDownloaded(const QUrl& url, const QPixmap& pixmap)
+    {
+        // Prefetched tiles are not displayed yet.
+        if (isPrefetchUrl(url))
+        {
+            return;
+        }
+
+        // Keep the partial image until the full tile replaces it.
+        {
+            ProfiledWriteLocker locker(&m_tileCacheLock);
+            m_partialTiles.insert(hashTileUrl(url), pixmap);
+        }
+
+        // Let the world know we have received a better image.
+        emit imageUpdated(url);
     }
 
     void ImageManager::handleImageCached(const QUrl& url)
     {
-        Q_UNUSED(url);
 #ifdef QMAP_DEBUG
         qDebug() << "ImageManager::handleImageCached '" << url << "'";
 #endif
+        // The tile is in the disk cache now.
+        {
+            ProfiledMutexLocker locker(&m_diskQueueLock);
+            m_diskMissingUrls.remove(url);
+        }
         emit imageCached();
     }
 
+    void ImageManager::handleImageRefreshed(const QUrl& url)
+    {
+        // The tile is in the disk cache now.
+        ProfiledMutexLocker locker(&m_diskQueueLock);
+        m_diskMissingUrls.remove(url);
+    }
+
+    void ImageManager::handleImageDataDownloaded(const QUrl& url, const QByteArray& data)
+    {
+        // Store the tile for the other processes (or release the claim if it could not be decoded).
+        offerSharedTile(url, data);
+    }
+
+    void ImageManager::handleImageDownloadFailed(const QUrl& url)
+    {
+        // Let the other processes try.
+        abandonSharedTile(url);
+
+        // Drop the partial image.
+        ProfiledWriteLocker locker(&m_tileCacheLock);
+        m_partialTiles.remove(hashTileUrl(url));
+    }
+
+    void ImageManager::pollSharedCache()
+    {
+        // Take the urls other processes were fetching.
+        QSet<QUrl> urls;
+        {
+            ProfiledMutexLocker locker(&m_sharedCacheLock);
+            urls.swap(m_sharedWaitingUrls);
+        }
+
+        for (const auto& url : urls)
+        {
+            QByteArray data;
+            const bool prefetched = isPrefetchUrl(url);
+            switch(acquireSharedTile(url, data))
+            {
+                case SharedTileCache::Acquire::Hit:
+                {
+                    // The other process has fetched it.
+                    m_metrics.shared_cache_hits.fetch_add(1, std::memory_order_relaxed);
+                    QBuffer buffer(&data);
+                    getImageFromDevice(url, &buffer);
+                    break;
+                }
+                case SharedTileCache::Acquire::InFlight:
+                {
+                    // Still being fetched (acquireSharedTile() keeps waiting for it).
+                    continue;
+                }
+                case SharedTileCache::Acquire::Elected:
+                case SharedTileCache::Acquire::Miss:
+                {
+                    // The other process gave up, fetch it ourselves.
+                    fetchImage(url);
+                    break;
+                }
+            }
+
+            // Let the world know we have received an updated image.
+            if (!prefetched)
+            {
+                emit imageUpdated(url);
+            }
+        }
+    }
+
     void ImageManager::setupPlaceholderPixmaps()
     {
         // Create a new pixmap.
@@ -361,58 +1154,483 @@ namespace qmapcontrol
                                         QCryptographicHash::Md5).toHex();
     }
 
+    QByteArray ImageManager::hashTileUrl(const QUrl& url, const TileDecodeOptions& options) const
+    {
+        // Return the md5 hex value of the given url at a specific projection, tile size and decode options.
+        return QCryptographicHash::hash((url.toString()
+                                           + QString::number(projection::get().epsg())
+                                           + QString::number(m_tile_size_px)).toUtf8()
+                                           + options.cacheKeySuffix(),
+                                        QCryptographicHash::Md5).toHex();
+    }
+
     void ImageManager::setMemoryCacheCapacity(int capacityMiB)
     {
-        m_memoryCache.setMaxCost(capacityMiB * 1024 * 1024);
+        // Shrinking evicts tiles, so this needs the write lock.
+        ProfiledWriteLocker locker(&m_tileCacheLock);
+        m_memoryCacheCapacity = capacityMiB * 1024 * 1024;
+        applyMemoryCacheCapacity();
+    }
+
+    int ImageManager::memoryCacheCapacity() const
+    {
+        ProfiledReadLocker locker(&m_tileCacheLock);
+        return m_memoryCacheCapacity / (1024 * 1024);
+    }
+
+    std::size_t ImageManager::pinnedBytes() const
+    {
+        // Pinned tiles still in the memory cache share its pixmaps.
+        std::size_t bytes = 0;
+        for (auto it = m_pinnedTiles.constBegin(); it != m_pinnedTiles.constEnd(); ++it) {
+            if (!m_memoryCache.contains(it.key())) {
+                bytes += memory::pixmapBytes(it.value());
+            }
+        }
+        return bytes;
+    }
+
+    void ImageManager::applyMemoryCacheCapacity()
+    {
+        // The pinned tiles kept aside use part of the capacity (the tiles that no longer fit are evicted).
+        const int count = m_memoryCache.count();
+        m_memoryCache.setMaxCost(std::max(1, m_memoryCacheCapacity - int(pinnedBytes())));
+        m_metrics.memory_cache_evictions.fetch_add(quint64(count - m_memoryCache.count()), std::memory_order_relaxed);
     }
 
     class QPixmapCacheEntry : public QPixmap
     {
     public:
-        QPixmapCacheEntry(const QPixmap &pixmap) : QPixmap(pixmap) { }
+        QPixmapCacheEntry(const QPixmap &pixmap, const TileOpacity opacity, const bool prefetched, const bool warmed, const quint64 lastUsed)
+            : QPixmap(pixmap), m_opacity(opacity), m_prefetched(prefetched), m_warmed(warmed), m_lastUsed(lastUsed) { }
+
+        /// How opaque the tile is (classified when inserted).
+        const TileOpacity m_opacity;
+
+        /// Whether the tile was prefetched and has not been displayed yet (cleared on display).
+        mutable std::atomic<bool> m_prefetched;
+
+        /// Whether the tile was warmed and has not been displayed yet (cleared on display).
+        mutable std::atomic<bool> m_warmed;
+
+        /// Memory cache use counter when the tile was last used.
+        mutable std::atomic<quint64> m_lastUsed;
     };
 
-    void ImageManager::insertTileToMemoryCache(const QUrl& url, const QPixmap& pixmap)
+    void ImageManager::insertTileToMemoryCache(const QUrl& url, const QPixmap& pixmap, const bool prefetched)
+    {
+        insertTileToMemoryCache(hashTileUrl(url), pixmap, prefetched, true);
+
+#ifdef QMAP_DEBUG
+        qDebug() << "ImageManager: pixmap cache -> total size KiB: " << m_memoryCache.totalCost() / 1024
+                 << ", now inserted: " << url.toString();
+#endif
+    }
+
+    void ImageManager::insertTileToMemoryCache(const QByteArray& key, const QPixmap& pixmap, const bool prefetched, const bool replace)
     {
-        QWriteLocker locker(&m_tileCacheLock);
+        // Classify the tile before taking the lock (the renderer skips transparent tiles and the tiles under opaque ones).
+        insertTileToMemoryCache(key, pixmap, pixmap.isNull() ? TileOpacity::Mixed : tiledecode::classify(pixmap.toImage()), prefetched, replace);
+    }
+
+    void ImageManager::insertTileToMemoryCache(const QByteArray& key, const QPixmap& pixmap, const TileOpacity opacity, const bool prefetched, const bool replace)
+    {
+        ProfiledWriteLocker locker(&m_tileCacheLock);
 
         if (!pixmap.isNull()) {
             int cost = pixmap.width() * pixmap.height() * pixmap.depth() / 8;
-            m_memoryCache.insert(hashTileUrl(url), new QPixmapCacheEntry(pixmap), cost);
+            const bool inserted = !m_memoryCache.contains(key);
+            if (!inserted && !replace) {
+                return;
+            }
+            // Warmed tiles are counted separately from the prefetched tiles.
+            const bool warmed = m_warmKeys.remove(key);
+            const int count = m_memoryCache.count() + (inserted ? 1 : 0);
+            m_memoryCache.insert(key, new QPixmapCacheEntry(pixmap, opacity, prefetched && !warmed, warmed, ++m_memoryCacheClock), cost);
+
+            // Count the tiles evicted to make room (a tile larger than the memory cache is dropped).
+            m_metrics.memory_cache_evictions.fetch_add(quint64(count - m_memoryCache.count()), std::memory_order_relaxed);
+
+            // Keep pinned tiles aside (in case they are evicted).
+            if (m_pinnedKeys.contains(key)) {
+                m_pinnedTiles.insert(key, pixmap);
+            }
         }
+    }
 
+    bool ImageManager::findTileInMemoryCache(const QUrl& url, QPixmap& pixmap, const bool display) const
+    {
+        if (findTileInMemoryCache(hashTileUrl(url), pixmap, display)) {
 #ifdef QMAP_DEBUG
-        qDebug() << "ImageManager: pixmap cache -> total size KiB: " << m_memoryCache.totalCost() / 1024
-                 << ", now inserted: " << url.toString();
+        qDebug() << "ImageManager: found in pixmap cache: " << url.toString();
 #endif
+
+            return true;
+        }
+
+        return false;
     }
 
-    bool ImageManager::findTileInMemoryCache(const QUrl& url, QPixmap& pixmap) const
+    bool ImageManager::findTileInMemoryCache(const QByteArray& key, QPixmap& pixmap, const bool display, TileOpacity* opacity) const
     {
-        QReadLocker locker(&m_tileCacheLock);
+        // object() moves the entry to the front of the LRU list, so it needs the write lock.
+        ProfiledWriteLocker locker(&m_tileCacheLock);
 
-        QPixmap *entry = m_memoryCache.object(hashTileUrl(url));
+        QPixmap *entry = m_memoryCache.object(key);
         if (entry != nullptr) {
             pixmap = *entry;
+            if (opacity != nullptr) {
+                *opacity = static_cast<QPixmapCacheEntry*>(entry)->m_opacity;
+            }
 
-#ifdef QMAP_DEBUG
-        qDebug() << "ImageManager: found in pixmap cache: " << url.toString();
-#endif
+            // Stamp the use (to find the hot tiles).
+            static_cast<QPixmapCacheEntry*>(entry)->m_lastUsed.store(++m_memoryCacheClock, std::memory_order_relaxed);
+
+            // Count the first display of a prefetched tile.
+            if (display && static_cast<QPixmapCacheEntry*>(entry)->m_prefetched.exchange(false, std::memory_order_relaxed)) {
+                m_metrics.prefetch_used.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // Count the first display of a warmed tile.
+            if (display && static_cast<QPixmapCacheEntry*>(entry)->m_warmed.exchange(false, std::memory_order_relaxed)) {
+                m_metrics.warm_used.fetch_add(1, std::memory_order_relaxed);
+            }
 
             return true;
         }
 
+        // Pinned tiles evicted from the memory cache.
+        const auto pinned = m_pinnedTiles.constFind(key);
+        if (pinned != m_pinnedTiles.constEnd()) {
+            pixmap = pinned.value();
+            if (opacity != nullptr) {
+                *opacity = TileOpacity::Mixed;
+            }
+            return true;
+        }
+
         return false;
     }
 
+    TileOpacity ImageManager::tileOpacity(const QUrl& url, const TileDecodeOptions& options) const
+    {
+        const QByteArray key = options.isDefault() ? hashTileUrl(url) : hashTileUrl(url, options);
+
+        // object() moves the entry to the front of the LRU list, so it needs the write lock.
+        ProfiledWriteLocker locker(&m_tileCacheLock);
+
+        // Only the tiles in the memory cache are classified.
+        const QPixmapCacheEntry* entry = static_cast<QPixmapCacheEntry*>(m_memoryCache.object(key));
+        return entry != nullptr ? entry->m_opacity : TileOpacity::Mixed;
+    }
+
+    bool ImageManager::findImage(const QUrl& url, const TileDecodeOptions& options, QPixmap& pixmap, TileOpacity& opacity)
+    {
+        // Look for the tile in the memory cache, with its opacity.
+        if (findTileInMemoryCache(options.isDefault() ? hashTileUrl(url) : hashTileUrl(url, options), pixmap, true, &opacity))
+        {
+            m_metrics.memory_cache_hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    bool ImageManager::findPartialTile(const QUrl& url, QPixmap& pixmap) const
+    {
+        ProfiledReadLocker locker(&m_tileCacheLock);
+
+        const auto partial = m_partialTiles.constFind(hashTileUrl(url));
+        if (partial != m_partialTiles.constEnd()) {
+            pixmap = partial.value();
+            return true;
+        }
+        return false;
+    }
+
+    std::vector<WarmStartTile> ImageManager::hotTiles(const std::size_t max_bytes) const
+    {
+        // Capture the entries (object() moves an entry to the front of the LRU list, so it needs the write lock).
+        std::vector<std::pair<quint64, std::pair<QByteArray, QPixmap>>> entries;
+        {
+            ProfiledWriteLocker locker(&m_tileCacheLock);
+            for (const auto& key : m_memoryCache.keys())
+            {
+                const QPixmapCacheEntry* entry = static_cast<QPixmapCacheEntry*>(m_memoryCache.object(key));
+                entries.push_back(std::make_pair(entry->m_lastUsed.load(std::memory_order_relaxed), std::make_pair(key, QPixmap(*entry))));
+            }
+
+            // Restore the LRU order by touching the entries again, least recently used first.
+            std::sort(entries.begin(), entries.end(), [](const std::pair<quint64, std::pair<QByteArray, QPixmap>>& lhs,
+                                                         const std::pair<quint64, std::pair<QByteArray, QPixmap>>& rhs)
+            {
+                return lhs.first < rhs.first;
+            });
+            for (const auto& entry : entries)
+            {
+                m_memoryCache.object(entry.second.first);
+            }
+        }
+
+        // Take the most recently used tiles, up to the size requested.
+        std::vector<WarmStartTile> tiles;
+        std::size_t bytes = 0;
+        for (auto itr = entries.rbegin(); itr != entries.rend(); ++itr)
+        {
+            const std::size_t tile_bytes = memory::pixmapBytes(itr->second.second);
+            if (bytes + tile_bytes > max_bytes)
+            {
+                break;
+            }
+            bytes += tile_bytes;
+            tiles.push_back({ itr->second.first, itr->second.second.toImage() });
+        }
+
+        // Return the tiles.
+        return tiles;
+    }
+
+    void ImageManager::preloadTiles(const std::shared_ptr<const WarmStartFile>& snapshot)
+    {
+        // Wait for any previous preload.
+        m_preloadAborted.store(true);
+        m_preloadFuture.waitForFinished();
+        m_preloadAborted.store(false);
+
+        // Insert the tiles in a background thread, least recently used first (so the hot tiles are evicted last).
+        m_preloadFuture = QtConcurrent::run([this, snapshot]()
+        {
+            // Trace the preload.
+            QMC_TRACE_SCOPE("tiles", "ImageManager::preloadTiles");
+
+            // The pixmaps are created in the image manager's thread (the images are copied out of the snapshot, which may be closed by then).
+            for (std::size_t i = snapshot->tileCount(); i > 0 && m_preloadAborted.load() == false; --i)
+            {
+                const WarmStartTile tile = snapshot->tile(i - 1);
+                const QImage image = tile.image.copy();
+                QMetaObject::invokeMethod(this, "insertDecodedTile", Qt::QueuedConnection,
+                                          Q_ARG(QByteArray, tile.key), Q_ARG(QImage, image), Q_ARG(int, int(tiledecode::classify(image))),
+                                          Q_ARG(bool, false), Q_ARG(bool, false), Q_ARG(QUrl, QUrl()));
+            }
+
+            // Queued after the tiles, so emitted once they are inserted.
+            QMetaObject::invokeMethod(this, "tilesPreloaded", Qt::QueuedConnection);
+        });
+    }
+
+    bool ImageManager::enableSharedCache(const QString& key, int capacityMiB)
+    {
+        // Attach to (or create) the shared segment.
+        std::unique_ptr<SharedTileCache> sharedCache(new SharedTileCache(key, static_cast<std::size_t>(capacityMiB) * 1024 * 1024));
+        if (!sharedCache->isAttached()) {
+            return false;
+        }
+
+        // Swap it in (releasing the claims made in any previous segment).
+        disableSharedCache();
+        {
+            ProfiledMutexLocker locker(&m_sharedCacheLock);
+            m_sharedCache = std::move(sharedCache);
+        }
+        m_sharedPollTimer.start();
+        return true;
+    }
+
+    void ImageManager::disableSharedCache()
+    {
+        m_sharedPollTimer.stop();
+
+        // Release the claims, so the other processes do not wait for them.
+        ProfiledMutexLocker locker(&m_sharedCacheLock);
+        if (m_sharedCache != nullptr) {
+            for (const auto& url : m_sharedClaimedUrls) {
+                m_sharedCache->abandon(hashTileUrl(url));
+            }
+        }
+        m_sharedClaimedUrls.clear();
+        m_sharedWaitingUrls.clear();
+        m_sharedCache.reset();
+    }
+
+    SharedTileCache::Acquire ImageManager::acquireSharedTile(const QUrl& url, QByteArray& data)
+    {
+        ProfiledMutexLocker locker(&m_sharedCacheLock);
+        if (m_sharedCache == nullptr) {
+            return SharedTileCache::Acquire::Miss;
+        }
+
+        // Keep track of the claims and of the tiles to wait for.
+        const SharedTileCache::Acquire result = m_sharedCache->acquire(hashTileUrl(url), data);
+        if (result == SharedTileCache::Acquire::InFlight) {
+            m_sharedWaitingUrls.insert(url);
+        } else if (result == SharedTileCache::Acquire::Elected) {
+            m_metrics.shared_cache_misses.fetch_add(1, std::memory_order_relaxed);
+            m_sharedClaimedUrls.insert(url);
+        } else if (result == SharedTileCache::Acquire::Miss) {
+            m_metrics.shared_cache_misses.fetch_add(1, std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    bool ImageManager::hasSharedCache() const
+    {
+        ProfiledMutexLocker locker(&m_sharedCacheLock);
+        return m_sharedCache != nullptr;
+    }
+
+    void ImageManager::offerSharedTile(const QUrl& url, const QByteArray& data)
+    {
+        ProfiledMutexLocker locker(&m_sharedCacheLock);
+        if (m_sharedCache != nullptr) {
+            // Store the tile (an empty tile releases the claim).
+            m_sharedCache->insert(hashTileUrl(url), data);
+            m_sharedClaimedUrls.remove(url);
+        }
+    }
+
+    void ImageManager::abandonSharedTile(const QUrl& url)
+    {
+        ProfiledMutexLocker locker(&m_sharedCacheLock);
+        if (m_sharedCache != nullptr && m_sharedClaimedUrls.remove(url)) {
+            m_sharedCache->abandon(hashTileUrl(url));
+        }
+    }
+
     void ImageManager::setCustomTileProvider(ITileProvider *provider) {
         // weakness: does not stop pending redrawing,
         // therefore custom provider might still receive requests made by current redrawing
         // with urls for different source (there is no "abortRedrawing")
         qDebug() << "ImageManager: request set provider " << provider;
-        QMutexLocker tileProviderLock(&m_tileProviderLock);
-        abortLoading();
+
+        // Call the provider in the background, through an adapter.
+        std::unique_ptr<SyncTileProviderAdapter> adapter;
+        if (provider != nullptr) {
+            adapter.reset(new SyncTileProviderAdapter(provider));
+        }
+        setAsyncTileProvider(adapter.get());
+
+        // Replace the provider (the previous adapter waits for its batch in progress).
+        ProfiledMutexLocker tileProviderLock(&m_tileProviderLock);
         m_tileProvider = provider;
+        m_syncTileProviderAdapter.swap(adapter);
+        tileProviderLock.unlock();
+        adapter.reset();
+    }
+
+    void ImageManager::setAsyncTileProvider(IAsyncTileProvider *provider) {
+        // Stop the requests of the previous provider.
+        abortLoading();
+
+        // Cut the previous provider's completions off (they may still arrive from its threads).
+        if (m_providerLink != nullptr) {
+            ProfiledWriteLocker locker(&m_providerLink->lock);
+            m_providerLink->manager = nullptr;
+        }
+
+        // Set the new provider.
+        ProfiledMutexLocker tileProviderLock(&m_tileProviderLock);
+        m_asyncTileProvider = provider;
+        m_providerLink = provider != nullptr ? std::make_shared<ProviderLink>(this) : nullptr;
+    }
+
+    int ImageManager::providerQueueSize() const {
+        ProfiledMutexLocker tileProviderLock(&m_tileProviderLock);
+        return m_providerPendingUrls.size();
+    }
+
+    void ImageManager::retryMissingTiles() {
+        ProfiledMutexLocker tileProviderLock(&m_tileProviderLock);
+        m_providerMissingUrls.clear();
+    }
+
+    void ImageManager::flushProviderRequests() {
+        // Take the queued requests.
+        std::vector<TileRequest> requests;
+        std::shared_ptr<ProviderLink> link;
+        IAsyncTileProvider* provider;
+        {
+            ProfiledMutexLocker tileProviderLock(&m_tileProviderLock);
+            requests.swap(m_providerQueue);
+            link = m_providerLink;
+            provider = m_asyncTileProvider;
+        }
+        if (requests.empty() || provider == nullptr) {
+            return;
+        }
+
+        // Pass them to the provider as one batch, its completions are forwarded while the link is intact.
+        provider->requestTiles(requests, [link](const TileResult& result) {
+            ProfiledReadLocker locker(&link->lock);
+            if (link->manager != nullptr) {
+                link->manager->completeProviderTile(result);
+            }
+        });
+    }
+
+    void ImageManager::completeProviderTile(const TileResult& result) {
+        // Decode the tile in the provider's thread (pixmaps are created in the image manager's thread).
+        QImage image;
+        if (result.found) {
+            QMC_TRACE_SCOPE_ARG("tiles", "ImageManager::completeProviderTile", result.url.toString());
+            QElapsedTimer decode_timer;
+            decode_timer.start();
+            QBuffer buffer;
+            buffer.setData(result.data);
+            QImageReader imageReader(&buffer);
+            image = imageReader.read();
+            m_metrics.decode_time_us.record(quint64(decode_timer.nsecsElapsed() / 1000));
+        }
+
+        // Display it from the image manager's thread.
+        QMetaObject::invokeMethod(this, "handleProviderTile", Qt::QueuedConnection, Q_ARG(QUrl, result.url), Q_ARG(bool, result.found), Q_ARG(QImage, image));
+    }
+
+    void ImageManager::insertDecodedTile(const QByteArray& key, const QImage& image, const int opacity, const bool prefetched, const bool replace, const QUrl& url)
+    {
+        // Create the pixmap in this thread and cache it.
+        insertTileToMemoryCache(key, QPixmap::fromImage(image), TileOpacity(opacity), prefetched, replace);
+
+        // A derived tile may be queued again (eg: once evicted).
+        {
+            ProfiledWriteLocker locker(&m_tileCacheLock);
+            m_deriveKeys.remove(key);
+        }
+
+        // Let the world know we have received an updated image.
+        if (!url.isEmpty())
+        {
+            emit imageUpdated(url);
+        }
+    }
+
+    void ImageManager::handleProviderTile(const QUrl& url, const bool found, const QImage& image) {
+        // Was the request cancelled?
+        bool displayedEmpty;
+        {
+            ProfiledMutexLocker tileProviderLock(&m_tileProviderLock);
+            if (!m_providerPendingUrls.remove(url)) {
+                return;
+            }
+
+            // Remember the missing tile (it is displayed empty already if it was missing before).
+            displayedEmpty = m_providerMissingUrls.contains(url);
+            if (found) {
+                m_providerMissingUrls.remove(url);
+            } else if (!displayedEmpty) {
+                m_providerMissingUrls.insert(url, new bool(true));
+            }
+        }
+
+        if (found) {
+            // Display and cache the tile.
+            m_metrics.provider_hits.fetch_add(1, std::memory_order_relaxed);
+            handleImageDownloaded(url, QPixmap::fromImage(image));
+        } else {
+            // Display the empty tile instead of the loading one.
+            m_metrics.provider_misses.fetch_add(1, std::memory_order_relaxed);
+            if (!takePrefetchUrl(url) && !displayedEmpty) {
+                emit imageUpdated(url);
+            }
+        }
     }
 }
 
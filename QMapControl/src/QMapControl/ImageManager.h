@@ -27,23 +27,39 @@
 
 // Qt includes.
 #include <QtCore/QDir>
+#include <QtCore/QFuture>
+#include <QtCore/QHash>
 #include <QtCore/QObject>
 #include <QtCore/QList>
+#include <QtCore/QSet>
+#include <QtCore/QThreadPool>
 #include <QtCore/QUrl>
 #include <QtGui/QPixmap>
 #include <QtNetwork/QNetworkProxy>
 #include <QCache>
 #include <QNetworkDiskCache>
 #include <QReadWriteLock>
+#include <QTimer>
 #include <QWaitCondition>
 
 // STL includes.
+#include <atomic>
 #include <chrono>
+#include <deque>
 #include <memory>
+#include <vector>
 
 // Local includes.
 #include "qmapcontrol_global.h"
+#include "MemoryUsage.h"
+#include "Metrics.h"
 #include "NetworkManager.h"
+#include "ProfiledLock.h"
+#include "SharedTileCache.h"
+#include "TileDecode.h"
+#include "TileProvider.h"
+#include "WarmStart.h"
+#include "WriteBehindDiskCache.h"
 
 /*!
  * @author Kai Winter <kaiwinter@gmx.de>
@@ -51,12 +67,6 @@
  */
 namespace qmapcontrol
 {
-    class ITileProvider {
-    public:
-        virtual bool getTileData(const QUrl& url, QByteArray& data) = 0;
-        virtual ~ITileProvider() { }
-    };
-
     class QMAPCONTROL_EXPORT ImageManager : public QObject
     {
         Q_OBJECT
@@ -68,6 +78,18 @@ namespace qmapcontrol
             AlwaysCache,
         };
 
+        //! The request issued by warmImage().
+        enum class WarmRequest {
+            /// Nothing (warming is disabled, or the tile is in the memory cache and not refreshed).
+            None,
+            /// The tile is loaded from the disk cache or the tile provider.
+            Load,
+            /// The tile is downloaded.
+            Download,
+            /// The disk cache copy of the tile is revalidated with the server.
+            Revalidate,
+        };
+
     public:
         /*!
          * Get the singleton instance of the Image Manager.
@@ -86,7 +108,7 @@ namespace qmapcontrol
         ImageManager& operator=(const ImageManager&) = delete;
 
         //! Destructor.
-        ~ImageManager() = default;
+        ~ImageManager();
 
         /*!
          * Fetch the tile size in pixels.
@@ -118,6 +140,39 @@ namespace qmapcontrol
          */
         int downloadQueueSize() const;
 
+        /*!
+         * Fetch the tile pipeline metrics (memory/disk cache and provider hits, network requests,
+         * bytes, latencies per host, retries, cancellations, decode times, prefetch usefulness and
+         * memory cache evictions) since construction or the last resetMetrics().
+         * @return a snapshot of the metrics.
+         */
+        TileMetrics metrics() const;
+
+        /*!
+         * Reset the tile pipeline metrics (eg: to measure a single scenario).
+         */
+        void resetMetrics();
+
+        /*!
+         * Fetch the memory used by each tier (memory cache, placeholders and disk cache).
+         * @return the tile cache usage.
+         */
+        TileCacheUsage memoryUsage() const;
+
+        /*!
+         * Fetch the most recently used tiles of the memory cache (eg: for a warm start snapshot).
+         * @param max_bytes The maximum size of the decoded tiles to return.
+         * @return the tiles, most recently used first.
+         */
+        std::vector<WarmStartTile> hotTiles(const std::size_t max_bytes) const;
+
+        /*!
+         * Insert the tiles of a warm start snapshot into the memory cache, in a background thread.
+         * Tiles already in the memory cache are kept. Emits tilesPreloaded() once done.
+         * @param snapshot The warm start snapshot (kept open until the tiles are inserted).
+         */
+        void preloadTiles(const std::shared_ptr<const WarmStartFile>& snapshot);
+
         /*!
          * If this component doesn't have the image a network query gets started to load it.
          * Fetch the requested image either from an in-memory cache or persistent file cache (if
@@ -131,7 +186,71 @@ namespace qmapcontrol
         QPixmap getImage(const QUrl& url);
 
         /*!
-         * \brief Obtains binary content for a cached url.
+         * Fetch the requested image decoded with the options (eg: at a reduced size for previews and
+         * low-detail layers, or colour transformed for night mode). Each set of options has its own memory
+         * cache entries; the tile is decoded with the options from the disk cache, or the options are
+         * applied to the full size tile in a background thread once it is available (the full size tile
+         * is returned until then).
+         * @param url The image url to fetch.
+         * @param options The decode options.
+         * @return the pixmap of the image ("loading"/empty placeholder while not available).
+         */
+        QPixmap getImage(const QUrl& url, const TileDecodeOptions& options);
+
+        /*!
+         * Fetch the requested image decoded with the options (see getImage()) and how opaque it is.
+         * @param url The image url to fetch.
+         * @param options The decode options.
+         * @param opacity How opaque the image is (the empty placeholder is transparent, the "loading" one mixed).
+         * @return the pixmap of the image ("loading"/empty placeholder while not available).
+         */
+        QPixmap getImage(const QUrl& url, const TileDecodeOptions& options, TileOpacity& opacity);
+
+        /*!
+         * Prepare the tiles decoded with the options from the full size tiles in the memory cache, in a
+         * background thread (eg: before a layer switches to new options). The other tiles are requested.
+         * Call from the GUI thread.
+         * @param urls The image urls.
+         * @param options The decode options.
+         * @return the preparation (the tiles are in the memory cache once its watcher reports it finished).
+         */
+        QFuture<void> prepareImages(const std::vector<QUrl>& urls, const TileDecodeOptions& options);
+
+        /*!
+         * Fetch how opaque a tile in the memory cache is (classified when it was decoded), without requesting it.
+         * @param url The image url.
+         * @param options The decode options.
+         * @return how opaque the tile is (mixed if it is not in the memory cache).
+         */
+        TileOpacity tileOpacity(const QUrl& url, const TileDecodeOptions& options) const;
+
+        /*!
+         * Look a tile to display up in the memory cache, without requesting it (eg: to find the opaque
+         * tiles before drawing them). Counted as a memory cache hit when found.
+         * @param url The image url.
+         * @param options The decode options.
+         * @param pixmap The tile.
+         * @param opacity How opaque the tile is.
+         * @return whether the tile is in the memory cache.
+         */
+        bool findImage(const QUrl& url, const TileDecodeOptions& options, QPixmap& pixmap, TileOpacity& opacity);
+
+        /*!
+         * Whether a pixmap returned by getImage() is the "loading" or empty placeholder (rather than the tile).
+         * @param pixmap The pixmap returned by getImage().
+         * @return whether the pixmap is a placeholder.
+         */
+        bool isPlaceholder(const QPixmap& pixmap) const;
+
+        /*!
+         * Whether a pixmap returned by getImage() is the "loading" placeholder (the tile is still being fetched).
+         * @param pixmap The pixmap returned by getImage().
+         * @return whether the tile is loading.
+         */
+        bool isLoading(const QPixmap& pixmap) const;
+
+        /*!
+         * \brief Obtains binary content for a cached url (reads the disk in the calling thread).
          * \param url The image url.
          * \return binary content of the url response. Empty if it is not present locally.
          */
@@ -144,13 +263,63 @@ namespace qmapcontrol
          */
         void prefetchImage(const QUrl& url);
 
+        /*!
+         * Set whether prefetchImage() and warmImage() request tiles (eg: disabled under memory pressure).
+         * Disabling it also releases the pinned tiles (see setPinnedTiles()).
+         * @param enabled Whether prefetching is enabled (default: true).
+         */
+        void setPrefetchEnabled(const bool enabled);
+
+        /*!
+         * Whether prefetchImage() requests tiles.
+         * @return whether prefetching is enabled.
+         */
+        bool isPrefetchEnabled() const;
+
+        /*!
+         * Warm a tile that is likely to be viewed soon (see CacheWarmer): the tile is loaded into the
+         * memory cache from the disk cache or the network at prefetch priority, without a redraw.
+         * Warmed tiles are counted by the warm_requests/warm_used metrics.
+         * @param url The image url to warm.
+         * @param refresh Whether to revalidate the disk cache copy with the server if the tile is already in memory (at the lowest network priority, not reported by imageCached()).
+         * @return the request issued (only downloads and revalidations use the network).
+         */
+        WarmRequest warmImage(const QUrl& url, const bool refresh = false);
+
+        /*!
+         * Protect tiles from memory cache eviction (eg: the hot tiles of a CacheWarmer). Pinned tiles
+         * evicted from the memory cache are kept aside and still returned by getImage(); they count
+         * against the memory cache capacity (see memoryUsage()). Nothing is pinned while prefetching is
+         * disabled (eg: under memory pressure).
+         * @param urls The urls to pin (replaces the previously pinned urls).
+         */
+        void setPinnedTiles(const std::vector<QUrl>& urls);
+
+        /*!
+         * Revalidate the disk cache copy of a tile with the server at the lowest network priority (see
+         * CacheRefresher): a copy still considered fresh is marked as expired first, so that the server
+         * answers with the tile only if it changed. The memory cache is not updated.
+         * @param url The image url to refresh.
+         * @return whether a request was issued (needs a disk cache and the PreferNetwork or PreferCache policy).
+         */
+        bool refreshImage(const QUrl& url);
+
+        /*!
+         * Read the metadata of a file of the disk cache directory (see getCacheDir()).
+         * @param file_path The path of the disk cache file.
+         * @return the metadata (invalid if there is no disk cache or the file is not a cache entry).
+         */
+        QNetworkCacheMetaData diskCacheFileMetaData(const QString& file_path) const;
+
         /*!
          * Downloads tile image from network and places it in disk cache (if enabled). Useful
          * for caching some area for later offline use. Cached tiles do not trigger
          * map redraws when received from network nor they are stored in memory cache.
+         * The tile provider or the disk cache is looked up in the disk thread, the
+         * "imageCached" signal is emitted once the tile is found there or downloaded.
          * \param url
-         * \return true if tile is already in cache, false if network request has spawned and
-         *         caller should wait for "imageCached" signal.
+         * \return true if there is nothing to wait for (offline mode, the "imageCached" signal is
+         *         still emitted if the tile is found), false if caller should wait for "imageCached" signal.
          */
         bool cacheImageToDisk(const QUrl& url);
 
@@ -180,13 +349,19 @@ namespace qmapcontrol
          */
         bool configureDiskCache(const QDir& dir, int capacityMiB);
 
-        QString getCacheDir() const { return m_diskCache->cacheDirectory(); }
+        QString getCacheDir() const { return m_diskCache != nullptr ? m_diskCache->cacheDirectory() : QString(); }
         /*!
          * Sets capacity of memory cache for decoded tile images.
          * @param capacityMiB Max cache capacity in MiB, when full LRU images are deleted
          */
         void setMemoryCacheCapacity(int capacityMiB);
 
+        /*!
+         * Returns capacity of memory cache for decoded tile images.
+         * @return max cache capacity in MiB
+         */
+        int memoryCacheCapacity() const;
+
         /*!
          * Sets cache policy (default: AlwaysCache or simply "offline")
          * AlwaysNetwork: always pulls tiles from network, cache is not activated.
@@ -206,10 +381,48 @@ namespace qmapcontrol
          * Custom tile provider can be used to bypass internal tile downloads
          * and provide tiles from user source e.g. database. Memory caching of tiles is
          * still applied with custom provider.
+         * The displayed tiles are fetched from the provider by the draw that requests them (as the
+         * provider is not asynchronous), the prefetched tiles in a background thread, with batches of
+         * the requested tiles (see SyncTileProviderAdapter).
          * \param provider New tile provider or null to reset and use internal
          */
         void setCustomTileProvider(ITileProvider *provider);
 
+        /*!
+         * Asynchronous custom tile provider, which receives batches of the requested tiles (with their
+         * priorities) and completes them from any thread. Memory caching of tiles is still applied.
+         * \param provider New tile provider (not owned) or null to reset and use internal
+         */
+        void setAsyncTileProvider(IAsyncTileProvider *provider);
+
+        /*!
+         * Number of tiles requested from the custom tile provider and not completed yet.
+         * @return the number of tiles pending from the tile provider.
+         */
+        int providerQueueSize() const;
+
+        /*!
+         * Forget the tiles the asynchronous tile provider did not have (they are displayed empty until then),
+         * so that they are requested again by the next redraw (eg: the provider has received new tiles).
+         * @note The tiles missing from a custom (synchronous) tile provider are requested again by each redraw.
+         */
+        void retryMissingTiles();
+
+        /*!
+         * Share the tiles with the other processes of the host through a shared memory cache. Tiles
+         * are looked up there before the disk cache and the network, tiles read or downloaded are
+         * stored there, and a tile another process is fetching is waited for instead of fetched again.
+         * \param key The shared segment key (processes using the same key share the cache).
+         * \param capacityMiB Capacity of the shared cache in MiB (if this process creates it).
+         * \return whether the shared cache is available.
+         */
+        bool enableSharedCache(const QString& key, int capacityMiB);
+
+        /*!
+         * Stop using the shared cache (it is destroyed with the last process using it).
+         */
+        void disableSharedCache();
+
     signals:
         /*!
          * Signal emitted to schedule an image resource to be downloaded.
@@ -218,6 +431,12 @@ namespace qmapcontrol
          */
         void downloadImage(const QUrl& url, bool cacheOnly);
 
+        /*!
+         * Signal emitted to schedule the disk cache copy of an image resource to be revalidated.
+         * @param url The image url to revalidate.
+         */
+        void revalidateImage(const QUrl& url);
+
         /*!
          * Signal emitted when a new image has been queued for download.
          * @param count The current size of the download queue.
@@ -244,6 +463,11 @@ namespace qmapcontrol
           */
         void imageDownloadFailed();
 
+        /*!
+         * Signal emitted when the tiles passed to preloadTiles() have been inserted into the memory cache.
+         */
+        void tilesPreloaded();
+
     private slots:
         /*!
          * Slot to handle an image that has been downloaded.
@@ -252,8 +476,69 @@ namespace qmapcontrol
          */
         void handleImageDownloaded(const QUrl& url, const QPixmap& pixmap);
 
+        /*!
+         * Slot to handle the partial image of a tile that is still downloading.
+         * @param url The url that the image is being downloaded from.
+         * @param pixmap The partial image.
+         */
+        void handleImagePartiallyDownloaded(const QUrl& url, const QPixmap& pixmap);
+
         void handleImageCached(const QUrl& url);
 
+        /*!
+         * Slot to handle the disk cache copy of an image that was revalidated (not reported by imageCached).
+         * @param url The image url.
+         */
+        void handleImageRefreshed(const QUrl& url);
+
+        /*!
+         * Slot to store a downloaded image in the shared cache.
+         * @param url The url that the image was downloaded from.
+         * @param data The encoded image (empty if it could not be decoded).
+         */
+        void handleImageDataDownloaded(const QUrl& url, const QByteArray& data);
+
+        /*!
+         * Slot to release the shared cache claim of an image that failed to download.
+         * @param url The url that the image failed to download from.
+         */
+        void handleImageDownloadFailed(const QUrl& url);
+
+        /*!
+         * Slot to check the shared cache for the images other processes were fetching.
+         */
+        void pollSharedCache();
+
+        /*!
+         * Slot to pass the queued tile requests to the asynchronous tile provider (as one batch).
+         */
+        void flushProviderRequests();
+
+        /*!
+         * Slot to derive the queued tiles from their full size tiles (see queueDerivedTile()).
+         */
+        void flushDerivedTiles();
+
+        /*!
+         * Slot to handle a tile completed by the asynchronous tile provider.
+         * @param url The tile url.
+         * @param found Whether the provider had the tile.
+         * @param image The decoded tile (converted to a pixmap in this thread).
+         */
+        void handleProviderTile(const QUrl& url, const bool found, const QImage& image);
+
+        /*!
+         * Slot to insert a tile decoded in a background thread into the memory cache (the pixmap is
+         * created in the image manager's thread).
+         * @param key The memory cache key.
+         * @param image The decoded tile.
+         * @param opacity How opaque the tile is (see TileOpacity).
+         * @param prefetched Whether the tile was prefetched.
+         * @param replace Whether to replace the tile if it is already in the memory cache.
+         * @param url The image url to emit imageUpdated() for (empty to not redraw).
+         */
+        void insertDecodedTile(const QByteArray& key, const QImage& image, const int opacity, const bool prefetched, const bool replace, const QUrl& url);
+
     private:
         //! Constructor.
         /*!
@@ -274,17 +559,140 @@ namespace qmapcontrol
          */
         QByteArray hashTileUrl(const QUrl& url) const;
 
-        void insertTileToMemoryCache(const QUrl& url, const QPixmap& pixmap);
-        bool findTileInMemoryCache(const QUrl& url, QPixmap& pixmap) const;
+        /*!
+         * Generate a md5 hex for the given url decoded with the options.
+         * @param url The url to generate a md5 hex for.
+         * @param options The decode options.
+         * @return the md5 hex of the url and options.
+         */
+        QByteArray hashTileUrl(const QUrl& url, const TileDecodeOptions& options) const;
+
+        void insertTileToMemoryCache(const QUrl& url, const QPixmap& pixmap, const bool prefetched = false);
+        void insertTileToMemoryCache(const QByteArray& key, const QPixmap& pixmap, const bool prefetched, const bool replace);
+        void insertTileToMemoryCache(const QByteArray& key, const QPixmap& pixmap, const TileOpacity opacity, const bool prefetched, const bool replace);
+        bool findTileInMemoryCache(const QUrl& url, QPixmap& pixmap, const bool display = false) const;
+        bool findTileInMemoryCache(const QByteArray& key, QPixmap& pixmap, const bool display, TileOpacity* opacity = nullptr) const;
+
+        /*!
+         * Find the partial image of a tile that is still downloading.
+         * @param url The image url.
+         * @param pixmap The partial image.
+         * @return whether there is a partial image.
+         */
+        bool findPartialTile(const QUrl& url, QPixmap& pixmap) const;
+
+        /*!
+         * Fetch the size of the pinned tiles kept aside (evicted from the memory cache), with m_tileCacheLock held.
+         * @return the size in bytes.
+         */
+        std::size_t pinnedBytes() const;
+
+        /*!
+         * Set the memory cache capacity left once the pinned tiles kept aside are counted, with m_tileCacheLock held for writing.
+         */
+        void applyMemoryCacheCapacity();
+
+        QPixmap getImageInternal(const QUrl& url, const int priority = kTilePriorityVisible);
+
+        void completeProviderTile(const TileResult& result);
+
+        QPixmap fetchImage(const QUrl& url);
+
+        //! What a disk cache request does with the tile.
+        enum class DiskRequest
+        {
+            /// Decode the tile into the memory cache (and redraw).
+            Decode,
+            /// Revalidate the tile with the server (see refreshImage()).
+            Revalidate,
+            /// Look the tile up in the tile provider or the disk cache, download it if missing (see cacheImageToDisk()).
+            Probe
+        };
+
+        /*!
+         * Queue a disk cache request for the disk thread (the same tile and options are queued once).
+         * @param url The image url.
+         * @param options The decode options (Decode requests).
+         * @param request What to do with the tile.
+         */
+        void queueDiskRequest(const QUrl& url, const TileDecodeOptions& options, const DiskRequest request);
+
+        /*!
+         * Process the queued disk cache requests until there are none left (disk thread).
+         */
+        void processDiskRequests();
+
+        /*!
+         * Whether a tile was found missing from the disk cache.
+         * @param url The image url.
+         * @return whether the tile is missing (until it is downloaded).
+         */
+        bool isMissingFromDisk(const QUrl& url) const;
+
+        /*!
+         * Whether a tile is being prefetched (any thread).
+         * @param url The image url.
+         * @return whether the tile is being prefetched.
+         */
+        bool isPrefetchUrl(const QUrl& url) const;
+
+        /*!
+         * Mark a tile as being prefetched (any thread).
+         * @param url The image url.
+         */
+        void addPrefetchUrl(const QUrl& url);
+
+        /*!
+         * Unmark a tile as being prefetched (any thread).
+         * @param url The image url.
+         * @return whether the tile was being prefetched.
+         */
+        bool takePrefetchUrl(const QUrl& url);
 
-        QPixmap getImageInternal(const QUrl& url);
+        SharedTileCache::Acquire acquireSharedTile(const QUrl& url, QByteArray& data);
+        bool hasSharedCache() const;
+        void offerSharedTile(const QUrl& url, const QByteArray& data);
+        void abandonSharedTile(const QUrl& url);
 
         QPixmap getImageFromDevice(const QUrl& url, QIODevice* device);
+        QPixmap getImageFromDevice(const QByteArray& key, QIODevice* device, const TileDecodeOptions& options);
+
+        //! A tile to derive from its full size tile (see deriveTiles()).
+        struct DerivedTile
+        {
+            /// The image url.
+            QUrl url;
+
+            /// The decode options.
+            TileDecodeOptions options;
+
+            /// The memory cache key of the tile decoded with the options.
+            QByteArray key;
+        };
+
+        /*!
+         * Apply the options to the full size tiles in the memory cache, in a background thread (tiles
+         * whose full size tile is not in the memory cache are skipped). Call from the GUI thread.
+         * @param tiles The tiles to derive.
+         * @param redraw Whether to emit imageUpdated() for the tiles once inserted.
+         * @return the background derivation.
+         */
+        QFuture<void> deriveTiles(const std::vector<DerivedTile>& tiles, const bool redraw);
+
+        /*!
+         * Queue a tile to derive from its full size tile in the memory cache (from any thread, each tile is
+         * queued once until it is inserted). The tile is redrawn once derived.
+         * @param tile The tile to derive.
+         */
+        void queueDerivedTile(const DerivedTile& tile);
 
     private:
         /// The tile size in pixels.
         int m_tile_size_px;
 
+        /// Tile pipeline metrics (declared before the network manager, which records into it).
+        mutable TileMetricsRecorder m_metrics;
+
         /// Network manager.
         NetworkManager m_networkManager;
 
@@ -292,13 +700,77 @@ namespace qmapcontrol
         QCache<QByteArray, QPixmap> m_memoryCache;
 
         /// Lock for accessing memory tile cache
-        mutable QReadWriteLock m_tileCacheLock;
+        mutable ProfiledReadWriteLock m_tileCacheLock;
+
+        /// Use counter of the memory cache, stamped on its entries when used (to find the hot tiles).
+        mutable std::atomic<quint64> m_memoryCacheClock;
+
+        /// Memory cache keys of the tiles being warmed (protected by m_tileCacheLock).
+        QSet<QByteArray> m_warmKeys;
+
+        /// Memory cache keys of the pinned tiles (protected by m_tileCacheLock).
+        QSet<QByteArray> m_pinnedKeys;
+
+        /// The pinned tiles, kept when evicted from the memory cache (protected by m_tileCacheLock).
+        QHash<QByteArray, QPixmap> m_pinnedTiles;
+
+        /// Capacity of the memory cache in bytes, including the pinned tiles kept aside (protected by m_tileCacheLock).
+        int m_memoryCacheCapacity;
+
+        /// The partial images of the tiles still downloading, until replaced by the full tiles (protected by m_tileCacheLock).
+        QHash<QByteArray, QPixmap> m_partialTiles;
+
+        /// The tiles queued to derive from their full size tiles (protected by m_tileCacheLock).
+        std::vector<DerivedTile> m_deriveQueue;
+
+        /// Memory cache keys of the tiles queued or being derived (protected by m_tileCacheLock).
+        QSet<QByteArray> m_deriveKeys;
+
+        /// The background insertion of warm start tiles.
+        QFuture<void> m_preloadFuture;
+
+        /// Whether the background insertion of warm start tiles should stop.
+        std::atomic<bool> m_preloadAborted;
 
         /// Local disk cache for tile image files
-        QNetworkDiskCache* m_diskCache;
+        WriteBehindDiskCache* m_diskCache;
+
+        //! A queued disk cache request.
+        struct PendingDiskRequest
+        {
+            /// The image url.
+            QUrl url;
 
-        /// Active cache policy
-        CachePolicy m_cachePolicy;
+            /// The decode options.
+            TileDecodeOptions options;
+
+            /// What to do with the tile.
+            DiskRequest request;
+
+            /// The key of the request (see m_diskQueueKeys).
+            QByteArray key;
+        };
+
+        /// The disk cache requests waiting for the disk thread.
+        std::deque<PendingDiskRequest> m_diskQueue;
+
+        /// Keys of the queued disk cache requests (tile, options and request).
+        QSet<QByteArray> m_diskQueueKeys;
+
+        /// Urls found missing from the disk cache (until downloaded).
+        QSet<QUrl> m_diskMissingUrls;
+
+        /// Whether the disk thread is processing the queue.
+        bool m_diskProcessing;
+
+        /// Lock for accessing the disk cache request queue and the missing urls.
+        mutable ProfiledMutex m_diskQueueLock;
+
+        /// The thread the disk cache is read from.
+        QThreadPool m_diskThread;
+
+        /// Active cache policy (read by the disk thread).
+        std::atomic<CachePolicy> m_cachePolicy;
 
         /// Placeholder pixmap for tile being downloaded.
         QPixmap m_pixmapLoading;
@@ -306,12 +778,64 @@ namespace qmapcontrol
         /// Placeholder pixmap for empty tiles (e.g. out of bounds of offline map)
         QPixmap m_pixmapEmpty;
 
-        /// A set of image urls being prefetched.
+        /// A set of image urls being prefetched (protected by m_prefetchUrlsLock).
         QSet<QUrl> m_prefetchUrls;
 
+        /// Lock for accessing the prefetched urls (the disk thread, the render threads and the GUI thread use them).
+        mutable ProfiledMutex m_prefetchUrlsLock;
+
+        /// Whether prefetchImage() requests tiles.
+        std::atomic<bool> m_prefetchEnabled;
+
         /// Custom tile provider
         ITileProvider *m_tileProvider;
 
-        mutable QMutex m_tileProviderLock;
+        mutable ProfiledMutex m_tileProviderLock;
+
+        //! The image manager completions of an asynchronous tile provider are forwarded to.
+        struct ProviderLink
+        {
+            /// Lock to protect the image manager (written when the link is cut).
+            ProfiledReadWriteLock lock;
+
+            /// The image manager (nullptr once the provider is replaced).
+            ImageManager* manager;
+
+            //! Constructor.
+            explicit ProviderLink(ImageManager* image_manager) : lock("ImageManager::ProviderLink::lock"), manager(image_manager) { }
+        };
+
+        /// Asynchronous tile provider (the adapter of the custom tile provider, or a user provider).
+        IAsyncTileProvider *m_asyncTileProvider;
+
+        /// Adapter that calls the custom tile provider in the background.
+        std::unique_ptr<SyncTileProviderAdapter> m_syncTileProviderAdapter;
+
+        /// Link of the asynchronous tile provider's completions to this image manager.
+        std::shared_ptr<ProviderLink> m_providerLink;
+
+        /// Tile requests queued for the asynchronous tile provider.
+        std::vector<TileRequest> m_providerQueue;
+
+        /// Urls requested from the asynchronous tile provider and not completed yet.
+        QSet<QUrl> m_providerPendingUrls;
+
+        /// Urls the asynchronous tile provider does not have (the most recent ones, displayed empty).
+        QCache<QUrl, bool> m_providerMissingUrls;
+
+        /// Tile cache shared with the other processes of the host (optional).
+        std::unique_ptr<SharedTileCache> m_sharedCache;
+
+        /// Urls this process claimed in the shared cache (it is fetching them).
+        QSet<QUrl> m_sharedClaimedUrls;
+
+        /// Urls other processes are fetching (checked by pollSharedCache()).
+        QSet<QUrl> m_sharedWaitingUrls;
+
+        /// Lock for accessing the shared cache and its url sets
+        mutable ProfiledMutex m_sharedCacheLock;
+
+        /// Timer to check the shared cache for the urls other processes are fetching.
+        QTimer m_sharedPollTimer;
     };
 }
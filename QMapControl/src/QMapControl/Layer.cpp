@@ -115,4 +115,26 @@ namespace qmapcontrol
         // Set whether to enable mouse events.
         m_mouse_events_enabled = enable;
     }
+
+    void Layer::occludeTiles(const RectWorldPx& /*backbuffer_rect_px*/, const int /*controller_zoom*/, TileOcclusion& /*occlusion*/) const
+    {
+        // Do nothing.
+    }
+
+    void Layer::drawUnoccluded(QPainter& painter, const RectWorldPx& backbuffer_rect_px, const int controller_zoom, const TileOcclusion& /*occlusion*/) const
+    {
+        // Draw the whole layer.
+        draw(painter, backbuffer_rect_px, controller_zoom);
+    }
+
+    MemoryUsage Layer::memoryUsage() const
+    {
+        MemoryUsage usage;
+
+        // The layer object, name and meta-data.
+        usage.attribute_bytes = sizeof(Layer) + memory::stringBytes(m_name) + memory::metadataBytes(m_metadata);
+
+        // Return the memory usage.
+        return usage;
+    }
 }
@@ -37,7 +37,9 @@
 
 // Local includes.
 #include "qmapcontrol_global.h"
+#include "MemoryUsage.h"
 #include "Point.h"
+#include "TileOcclusion.h"
 
 namespace qmapcontrol
 {
@@ -61,7 +63,11 @@ namespace qmapcontrol
             /// Layer that draws Geometries.
             LayerGeometry,
             /// Layer that draws ESRI Shapefiles.
-            LayerESRIShapefile
+            LayerESRIShapefile,
+            /// Layer that draws the hillshade of elevation tiles.
+            LayerHillshade,
+            /// Layer that draws raster layers flattened into composite tiles.
+            LayerComposite
         };
 
     protected:
@@ -164,6 +170,32 @@ namespace qmapcontrol
          */
         virtual void draw(QPainter& painter, const RectWorldPx& backbuffer_rect_px, const int controller_zoom) const = 0;
 
+        /*!
+         * Marks the tiles this layer covers with opaque tiles, for the layers below it to skip (see drawUnoccluded()).
+         * The layers are walked front to back; the base implementation covers nothing.
+         * @param backbuffer_rect_px The backbuffer rect (pixels).
+         * @param controller_zoom The current controller zoom.
+         * @param occlusion The tiles covered by the layers above (at the layer's depth), to cover this layer's opaque tiles in.
+         */
+        virtual void occludeTiles(const RectWorldPx& backbuffer_rect_px, const int controller_zoom, TileOcclusion& occlusion) const;
+
+        /*!
+         * Draws the layer, skipping the tiles covered by opaque tiles of the layers above.
+         * The base implementation draws the whole layer (see draw()).
+         * @param painter The painter that will draw to the pixmap.
+         * @param backbuffer_rect_px Only draw map tiles/geometries that are contained in the backbuffer rect (pixels).
+         * @param controller_zoom The current controller zoom.
+         * @param occlusion The tiles covered by the layers above (at the layer's depth).
+         */
+        virtual void drawUnoccluded(QPainter& painter, const RectWorldPx& backbuffer_rect_px, const int controller_zoom, const TileOcclusion& occlusion) const;
+
+        /*!
+         * Estimates the memory used by the layer (see MemoryUsage.h).
+         * The base implementation accounts for the layer's own attributes (name, meta-data).
+         * @return the memory usage.
+         */
+        virtual MemoryUsage memoryUsage() const;
+
     signals:
         /*!
          * Signal emitted when a change has occurred that requires the layer to be redrawn.
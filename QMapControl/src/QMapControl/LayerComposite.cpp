@@ -0,0 +1,413 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "LayerComposite.h"
+
+// Qt includes.
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtGui/QPainter>
+
+// STL includes.
+#include <algorithm>
+#include <cmath>
+
+// Local includes.
+#include "ImageManager.h"
+#include "LayerHillshade.h"
+#include "LayerMapAdapter.h"
+#include "MapAdapter.h"
+#include "Scratch.h"
+
+namespace qmapcontrol
+{
+    namespace
+    {
+        /// The default capacity of the composite tiles cache (bytes).
+        const int kCompositeCacheCapacity = 64 * 1024 * 1024;
+
+        /// The number of tiles to prefetch around the drawn tiles.
+        const int kPrefetchTileExtent = 1;
+
+        //! An input layer, as drawn.
+        struct InputLayer
+        {
+            /// The layer.
+            const Layer* layer;
+
+            /// The map adapter of the layer (nullptr if the layer is not drawn).
+            std::shared_ptr<MapAdapter> mapadapter;
+
+            /// How the tiles of a map adapter layer are decoded.
+            TileDecodeOptions options;
+        };
+
+        /*!
+         * Pack the zoom and coordinates of a tile into a cache key.
+         * @param x The x coordinate of the tile.
+         * @param y The y coordinate of the tile.
+         * @param controller_zoom The zoom of the tile.
+         * @return the key.
+         */
+        quint64 tileKey(const int x, const int y, const int controller_zoom)
+        {
+            return (quint64(controller_zoom) << 56) | (quint64(quint32(x) & 0xFFFFFFF) << 28) | quint64(quint32(y) & 0xFFFFFFF);
+        }
+
+        /*!
+         * Prefetch the tiles of a map adapter around the drawn tiles (ready for when the user starts panning).
+         * @param mapadapter The map adapter.
+         * @param furthest_tile_left The left most tile drawn.
+         * @param furthest_tile_top The top most tile drawn.
+         * @param furthest_tile_right The right most tile drawn.
+         * @param furthest_tile_bottom The bottom most tile drawn.
+         * @param controller_zoom The current controller zoom.
+         */
+        void prefetchTiles(const MapAdapter& mapadapter, const int furthest_tile_left, const int furthest_tile_top, const int furthest_tile_right, const int furthest_tile_bottom, const int controller_zoom)
+        {
+            const int prefetch_tile_left = furthest_tile_left - kPrefetchTileExtent;
+            const int prefetch_tile_top = furthest_tile_top - kPrefetchTileExtent;
+            const int prefetch_tile_right = furthest_tile_right + kPrefetchTileExtent;
+            const int prefetch_tile_bottom = furthest_tile_bottom + kPrefetchTileExtent;
+
+            // Loop through the ring of tiles around the drawn tiles.
+            for (int i = prefetch_tile_left; i <= prefetch_tile_right; ++i)
+            {
+                for (int j = prefetch_tile_top; j <= prefetch_tile_bottom; ++j)
+                {
+                    // Prefetch the tile (if valid).
+                    const bool ring = i == prefetch_tile_left || i == prefetch_tile_right || j == prefetch_tile_top || j == prefetch_tile_bottom;
+                    if (ring && mapadapter.isTileValid(i, j, controller_zoom))
+                    {
+                        ImageManager::get().prefetchImage(mapadapter.tileQuery(i, j, controller_zoom));
+                    }
+                }
+            }
+        }
+    }
+
+    LayerComposite::LayerComposite(const std::string& name, const std::vector<std::shared_ptr<Layer>>& layers, const int zoom_minimum, const int zoom_maximum, QObject* parent)
+        : Layer(LayerType::LayerComposite, name, zoom_minimum, zoom_maximum, parent),
+          m_layers(layers),
+          m_mutex("LayerComposite::m_mutex"),
+          m_composite_tiles(kCompositeCacheCapacity)
+    {
+        // Redraw when an input layer changes (eg: a hillshade tile is shaded, a layer is shown/hidden).
+        for (const auto& layer : m_layers)
+        {
+            QObject::connect(layer.get(), &Layer::requestRedraw, this, &Layer::requestRedraw);
+        }
+    }
+
+    LayerComposite::~LayerComposite()
+    {
+        // Wait for the tiles being flattened.
+        m_thread_pool.waitForDone();
+    }
+
+    const std::vector<std::shared_ptr<Layer>>& LayerComposite::getLayers() const
+    {
+        // Return the layers.
+        return m_layers;
+    }
+
+    void LayerComposite::setCompositeCacheCapacity(const int capacityMiB)
+    {
+        // Gain a lock to protect the cache.
+        ProfiledMutexLocker locker(&m_mutex);
+
+        // Set the capacity.
+        m_composite_tiles.setMaxCost(capacityMiB * 1024 * 1024);
+    }
+
+    bool LayerComposite::mousePressEvent(const QMouseEvent* /*mouse_event*/, const PointWorldCoord& /*mouse_point_coord*/, const int /*controller_zoom*/) const
+    {
+        // Do nothing.
+        return false;
+    }
+
+    void LayerComposite::draw(QPainter& painter, const RectWorldPx& backbuffer_rect_px, const int controller_zoom) const
+    {
+        // Check the layer is visible.
+        if (isVisible(controller_zoom))
+        {
+            // Fetch the map adapters of the visible input layers.
+            std::vector<InputLayer> layers;
+            layers.reserve(m_layers.size());
+            for (const auto& layer : m_layers)
+            {
+                InputLayer input{ layer.get(), nullptr, TileDecodeOptions() };
+                if (layer->isVisible(controller_zoom))
+                {
+                    switch(layer->getLayerType())
+                    {
+                        case LayerType::LayerMapAdapter:
+                        {
+                            const LayerMapAdapter* map_layer = static_cast<const LayerMapAdapter*>(layer.get());
+                            input.mapadapter = map_layer->getMapAdapter();
+                            input.options = map_layer->getTileDecodeOptions();
+                            break;
+                        }
+                        case LayerType::LayerHillshade:
+                        {
+                            input.mapadapter = static_cast<const LayerHillshade*>(layer.get())->getMapAdapter();
+                            break;
+                        }
+                        default:
+                        {
+                            // Not a raster layer.
+                            break;
+                        }
+                    }
+                }
+                layers.push_back(input);
+            }
+
+            // The current tile size.
+            const QSizeF tile_size_px(ImageManager::get().tileSizePx(), ImageManager::get().tileSizePx());
+
+            // Calculate the tiles to draw.
+            const int furthest_tile_left = int(std::floor(backbuffer_rect_px.leftPx() / tile_size_px.width()));
+            const int furthest_tile_top = int(std::floor(backbuffer_rect_px.topPx() / tile_size_px.height()));
+            const int furthest_tile_right = int(std::floor(backbuffer_rect_px.rightPx() / tile_size_px.width()));
+            const int furthest_tile_bottom = int(std::floor(backbuffer_rect_px.bottomPx() / tile_size_px.height()));
+
+            // The input tiles of a tile.
+            scratch::Lease<std::vector<InputTile>> tiles;
+            tiles->resize(layers.size());
+
+            // Loop through the tiles to draw (left to right).
+            for (int i = furthest_tile_left; i <= furthest_tile_right; ++i)
+            {
+                // Loop through the tiles to draw (top to bottom).
+                for (int j = furthest_tile_top; j <= furthest_tile_bottom; ++j)
+                {
+                    // Fetch the input tiles (requests them if needed).
+                    bool loading = false;
+                    bool drawn = false;
+                    for (std::size_t k = 0; k < layers.size(); ++k)
+                    {
+                        const InputLayer& input = layers[k];
+                        InputTile& tile = (*tiles)[k];
+                        tile = InputTile{ QPixmap(), QImage(), 0, TileOpacity::Mixed };
+                        if (input.mapadapter != nullptr && input.mapadapter->isTileValid(i, j, controller_zoom))
+                        {
+                            if (input.layer->getLayerType() == LayerType::LayerMapAdapter)
+                            {
+                                const QUrl url = input.mapadapter->tileQuery(i, j, controller_zoom);
+                                tile.pixmap = ImageManager::get().getImage(url, input.options, tile.opacity);
+                                tile.key = tile.pixmap.cacheKey();
+                                loading = loading || ImageManager::get().isLoading(tile.pixmap);
+                            }
+                            else
+                            {
+                                loading = static_cast<const LayerHillshade*>(input.layer)->shadedTile(i, j, controller_zoom, tile.image) || loading;
+                                tile.key = tile.image.cacheKey();
+                            }
+                            drawn = drawn || tile.key != 0;
+                        }
+                    }
+
+                    // Nothing to draw?
+                    if (drawn == false)
+                    {
+                        continue;
+                    }
+
+                    // Fetch the composite tile (if flattened from the same input tiles).
+                    const quint64 key = tileKey(i, j, controller_zoom);
+                    QImage composite;
+                    bool pending;
+                    {
+                        ProfiledMutexLocker locker(&m_mutex);
+                        const CompositeTile* flattened = m_composite_tiles.object(key);
+                        if (flattened != nullptr)
+                        {
+                            bool same_inputs = flattened->input_keys.size() == tiles->size();
+                            for (std::size_t k = 0; same_inputs && k < tiles->size(); ++k)
+                            {
+                                same_inputs = flattened->input_keys[k] == (*tiles)[k].key;
+                            }
+                            if (same_inputs)
+                            {
+                                composite = flattened->image;
+                            }
+                        }
+                        pending = m_pending.contains(key);
+                    }
+
+                    // Draw the composite tile with a single blit.
+                    const PointWorldPx top_left_px(i * tile_size_px.width(), j * tile_size_px.height());
+                    const QRectF tile_rect(top_left_px.rawPoint(), tile_size_px);
+                    if (composite.isNull() == false)
+                    {
+                        painter.drawImage(tile_rect, composite);
+                    }
+                    else
+                    {
+                        // Draw the input tiles layer by layer meanwhile.
+                        drawInputs(painter, tile_rect, *tiles);
+
+                        // Flatten the tile once its inputs are loaded.
+                        if (loading == false && pending == false)
+                        {
+                            queueFlatten(key, *tiles);
+                        }
+                    }
+                }
+            }
+
+            // Prefetch the tiles of the map adapter layers.
+            for (const InputLayer& input : layers)
+            {
+                if (input.mapadapter != nullptr && input.layer->getLayerType() == LayerType::LayerMapAdapter)
+                {
+                    prefetchTiles(*input.mapadapter, furthest_tile_left, furthest_tile_top, furthest_tile_right, furthest_tile_bottom, controller_zoom);
+                }
+            }
+        }
+    }
+
+    MemoryUsage LayerComposite::memoryUsage() const
+    {
+        // The layer object, name and meta-data.
+        MemoryUsage usage = Layer::memoryUsage();
+        usage.attribute_bytes += sizeof(LayerComposite) - sizeof(Layer);
+
+        // The composite tiles.
+        {
+            ProfiledMutexLocker locker(&m_mutex);
+            usage.payload_bytes += std::size_t(m_composite_tiles.totalCost());
+        }
+
+        // The input layers (not added to the map control themselves).
+        for (const auto& layer : m_layers)
+        {
+            usage += layer->memoryUsage();
+        }
+
+        // Return the memory usage.
+        return usage;
+    }
+
+    void LayerComposite::queueFlatten(const quint64 key, const std::vector<InputTile>& tiles) const
+    {
+        // Mark the tile as being flattened, and queue it for the GUI thread.
+        ProfiledMutexLocker locker(&m_mutex);
+        m_pending.insert(key);
+        if (m_flatten_queue.empty())
+        {
+            QMetaObject::invokeMethod(const_cast<LayerComposite*>(this), "flushFlattenRequests", Qt::QueuedConnection);
+        }
+        m_flatten_queue.push_back(std::make_pair(key, tiles));
+    }
+
+    void LayerComposite::flushFlattenRequests()
+    {
+        // Take the queued tiles.
+        std::vector<std::pair<quint64, std::vector<InputTile>>> requests;
+        {
+            ProfiledMutexLocker locker(&m_mutex);
+            requests.swap(m_flatten_queue);
+        }
+
+        const int tile_size_px = ImageManager::get().tileSizePx();
+        for (auto& request : requests)
+        {
+            // Convert the map adapter tiles to images here.
+            const quint64 key = request.first;
+            std::vector<InputTile> tiles = std::move(request.second);
+            for (InputTile& tile : tiles)
+            {
+                if (tile.pixmap.isNull() == false)
+                {
+                    tile.image = tile.pixmap.toImage();
+                    tile.pixmap = QPixmap();
+                }
+            }
+
+            // Flatten the tile in a worker thread.
+            QtConcurrent::run(&m_thread_pool, [this, key, tiles, tile_size_px]()
+            {
+                // Blend the input tiles in order.
+                QImage image(tile_size_px, tile_size_px, QImage::Format_ARGB32_Premultiplied);
+                image.fill(Qt::transparent);
+                {
+                    QPainter painter(&image);
+                    drawInputs(painter, QRectF(0.0, 0.0, tile_size_px, tile_size_px), tiles);
+                }
+
+                // The input tiles flattened.
+                std::vector<qint64> input_keys;
+                input_keys.reserve(tiles.size());
+                for (const InputTile& tile : tiles)
+                {
+                    input_keys.push_back(tile.key);
+                }
+
+                // Store the composite tile.
+                {
+                    ProfiledMutexLocker locker(&m_mutex);
+                    m_pending.remove(key);
+                    m_composite_tiles.insert(key, new CompositeTile{ image, std::move(input_keys) }, std::max(1, image.bytesPerLine() * image.height()));
+                }
+
+                // Emit to redraw layer.
+                emit requestRedraw();
+            });
+        }
+    }
+
+    void LayerComposite::drawInputs(QPainter& painter, const QRectF& rect, const std::vector<InputTile>& tiles)
+    {
+        // Find the top most opaque tile (the tiles below it are hidden).
+        std::size_t bottom = 0;
+        for (std::size_t k = tiles.size(); k-- > 0; )
+        {
+            if (tiles[k].key != 0 && tiles[k].opacity == TileOpacity::Opaque)
+            {
+                bottom = k;
+                break;
+            }
+        }
+
+        // Draw the input tiles in order (stretching reduced tiles to the tile size, skipping transparent tiles).
+        for (std::size_t k = bottom; k < tiles.size(); ++k)
+        {
+            const InputTile& tile = tiles[k];
+            if (tile.opacity == TileOpacity::Transparent)
+            {
+                continue;
+            }
+            if (tile.pixmap.isNull() == false)
+            {
+                painter.drawPixmap(rect, tile.pixmap, QRectF(tile.pixmap.rect()));
+            }
+            else if (tile.image.isNull() == false)
+            {
+                painter.drawImage(rect, tile.image);
+            }
+        }
+    }
+}
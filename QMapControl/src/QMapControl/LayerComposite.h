@@ -0,0 +1,191 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// Qt includes.
+#include <QtCore/QCache>
+#include <QtCore/QSet>
+#include <QtCore/QThreadPool>
+#include <QtGui/QImage>
+#include <QtGui/QPixmap>
+
+// STL includes.
+#include <memory>
+#include <vector>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+#include "Layer.h"
+#include "ProfiledLock.h"
+#include "TileDecode.h"
+
+namespace qmapcontrol
+{
+    //! Layer class
+    /*!
+     * Layer that draws a stack of static raster layers (eg: base map, hillshade, sea marks and labels) flattened into one.
+     *
+     * Each tile of the stack is blended once in a worker thread into a composite tile, which is cached
+     * and drawn with a single blit: drawing costs one blit per tile rather than one per tile and layer.
+     * A composite tile is flattened again only when one of its input tiles changes (downloaded again,
+     * shaded again, decoded with other options, or its layer shown/hidden). Tiles with inputs that are
+     * still loading are drawn layer by layer meanwhile.
+     *
+     * The inputs can be LayerMapAdapter and LayerHillshade layers (other layers are not drawn), drawn
+     * in order (the first at the bottom). They are drawn through this layer only: do not also add
+     * them to the map control.
+     */
+    class QMAPCONTROL_EXPORT LayerComposite : public Layer
+    {
+        Q_OBJECT
+    public:
+        //! Layer constructor
+        /*!
+         * This is used to construct a layer.
+         * @param name The name of the layer.
+         * @param layers The layers to flatten (the first at the bottom).
+         * @param zoom_minimum The minimum zoom level to show this layer at.
+         * @param zoom_maximum The maximum zoom level to show this layer at.
+         * @param parent QObject parent ownership.
+         */
+        LayerComposite(const std::string& name,
+                       const std::vector<std::shared_ptr<Layer>>& layers,
+                       const int zoom_minimum = 0,
+                       const int zoom_maximum = kDefaultMaxZoom,
+                       QObject* parent = nullptr);
+
+        //! Disable copy constructor.
+        LayerComposite(const LayerComposite&) = delete;
+
+        //! Disable copy assignment.
+        LayerComposite& operator=(const LayerComposite&) = delete;
+
+        //! Destructor (waits for the tiles being flattened).
+        ~LayerComposite();
+
+        /*!
+         * Fetch the layers that are flattened.
+         * @return the layers (the first at the bottom).
+         */
+        const std::vector<std::shared_ptr<Layer>>& getLayers() const;
+
+        /*!
+         * Set the capacity of the composite tiles cache.
+         * @param capacityMiB The capacity in MiB.
+         */
+        void setCompositeCacheCapacity(const int capacityMiB);
+
+        /*!
+         * Handles mouse press events (such as left-clicking an item on the layer).
+         * @param mouse_event The mouse event.
+         * @param mouse_point_coord The mouse point on the map in coord.
+         * @param controller_zoom The current controller zoom.
+         */
+        bool mousePressEvent(const QMouseEvent* mouse_event, const PointWorldCoord& mouse_point_coord, const int controller_zoom) const final;
+
+        /*!
+         * Draws the composite tiles (and queues the changed ones to be flattened) using the provided painter.
+         * @param painter The painter that will draw to the pixmap.
+         * @param backbuffer_rect_px Only draw tiles that are contained in the backbuffer rect (pixels).
+         * @param controller_zoom The current controller zoom.
+         */
+        void draw(QPainter& painter, const RectWorldPx& backbuffer_rect_px, const int controller_zoom) const final;
+
+        /*!
+         * Estimates the memory used by the layer: the composite tiles and the input layers.
+         * @return the memory usage.
+         */
+        MemoryUsage memoryUsage() const final;
+
+    private slots:
+        /*!
+         * Pass the tiles queued to be flattened to the worker threads, with their input tiles converted
+         * to images (pixmaps are only used in the GUI thread).
+         */
+        void flushFlattenRequests();
+
+    private:
+        //! An input tile.
+        struct InputTile
+        {
+            /// The tile of a map adapter layer.
+            QPixmap pixmap;
+
+            /// The tile of a hillshade layer.
+            QImage image;
+
+            /// The cache key of the tile (0 if its layer does not draw it).
+            qint64 key;
+
+            /// How opaque the tile is.
+            TileOpacity opacity;
+        };
+
+        //! A composite tile.
+        struct CompositeTile
+        {
+            /// The flattened tiles.
+            QImage image;
+
+            /// The cache keys of the input tiles flattened.
+            std::vector<qint64> input_keys;
+        };
+
+        /*!
+         * Queue a tile to be flattened (see flushFlattenRequests()).
+         * @param key The key of the composite tile.
+         * @param tiles The input tiles.
+         */
+        void queueFlatten(const quint64 key, const std::vector<InputTile>& tiles) const;
+
+        /*!
+         * Draw the input tiles (stretched to the tile rect), from the top most opaque one up.
+         * @param painter The painter to draw with.
+         * @param rect The tile rect.
+         * @param tiles The input tiles.
+         */
+        static void drawInputs(QPainter& painter, const QRectF& rect, const std::vector<InputTile>& tiles);
+
+    private:
+        /// The layers to flatten.
+        const std::vector<std::shared_ptr<Layer>> m_layers;
+
+        /// Mutex to protect the caches.
+        mutable ProfiledMutex m_mutex;
+
+        /// The composite tiles, by zoom and tile coordinates.
+        mutable QCache<quint64, CompositeTile> m_composite_tiles;
+
+        /// The tiles being flattened.
+        mutable QSet<quint64> m_pending;
+
+        /// The tiles queued to be flattened, with their input tiles.
+        mutable std::vector<std::pair<quint64, std::vector<InputTile>>> m_flatten_queue;
+
+        /// The worker threads.
+        mutable QThreadPool m_thread_pool;
+    };
+}
@@ -28,7 +28,8 @@
 namespace qmapcontrol
 {
     LayerESRIShapefile::LayerESRIShapefile(const std::string& name, const int& zoom_minimum, const int& zoom_maximum, QObject* parent)
-        : Layer(LayerType::LayerESRIShapefile, name, zoom_minimum, zoom_maximum, parent)
+        : Layer(LayerType::LayerESRIShapefile, name, zoom_minimum, zoom_maximum, parent),
+          m_esri_shapefiles_mutex("LayerESRIShapefile::m_esri_shapefiles_mutex")
     {
         /// @todo set colours for polygon/linestring/point?!?!
     }
@@ -39,7 +40,7 @@ namespace qmapcontrol
         if(esri_shapefile != nullptr)
         {
             // Gain a write lock to protect the ESRI Shapefiles.
-            QWriteLocker locker(&m_esri_shapefiles_mutex);
+            ProfiledWriteLocker locker(&m_esri_shapefiles_mutex);
 
             // Find the object in the container.
             const auto itr_find(std::find(m_esri_shapefiles.begin(), m_esri_shapefiles.end(), esri_shapefile));
@@ -72,7 +73,7 @@ namespace qmapcontrol
         if(esri_shapefile != nullptr)
         {
             // Gain a write lock to protect the ESRI Shapefiles.
-            QWriteLocker locker(&m_esri_shapefiles_mutex);
+            ProfiledWriteLocker locker(&m_esri_shapefiles_mutex);
 
             // Disconnect any signals that were previously connected.
             QObject::disconnect(esri_shapefile.get(), 0, this, 0);
@@ -101,7 +102,7 @@ namespace qmapcontrol
     void LayerESRIShapefile::clearESRIShapefiles(const bool& disable_redraw)
     {
         // Gain a write lock to protect the ESRI Shapefiles.
-        QWriteLocker locker(&m_esri_shapefiles_mutex);
+        ProfiledWriteLocker locker(&m_esri_shapefiles_mutex);
 
         // Remove all ESRI Shapefiles from the list.
         m_esri_shapefiles.clear();
@@ -123,7 +124,7 @@ namespace qmapcontrol
     void LayerESRIShapefile::draw(QPainter& painter, const RectWorldPx& backbuffer_rect_px, const int& controller_zoom) const
     {
         // Gain a read lock to protect the ESRI Shapefiles.
-        QReadLocker locker(&m_esri_shapefiles_mutex);
+        ProfiledReadLocker locker(&m_esri_shapefiles_mutex);
 
         // Check the layer is visible.
         if(isVisible(controller_zoom))
@@ -145,7 +146,7 @@ namespace qmapcontrol
 
     std::shared_ptr<ESRIShapefile> LayerESRIShapefile::getShapefile(int idx) const
     {
-        QReadLocker lock(&m_esri_shapefiles_mutex);
+        ProfiledReadLocker lock(&m_esri_shapefiles_mutex);
         return m_esri_shapefiles[idx];
     }
 }
@@ -36,6 +36,7 @@
 #include "qmapcontrol_global.h"
 #include "ESRIShapefile.h"
 #include "Layer.h"
+#include "ProfiledLock.h"
 
 namespace qmapcontrol
 {
@@ -113,6 +114,6 @@ namespace qmapcontrol
         std::vector<std::shared_ptr<ESRIShapefile>> m_esri_shapefiles;
 
         /// Mutex to protect ESRI Shapefiles.
-        mutable QReadWriteLock m_esri_shapefiles_mutex;
+        mutable ProfiledReadWriteLock m_esri_shapefiles_mutex;
     };
 }
@@ -26,17 +26,23 @@
 #include "LayerGeometry.h"
 
 // Local includes.
-#include "GeometryPoint.h"
 #include "GeometryLineString.h"
+#include "GeometryPoint.h"
 #include "GeometryPolygon.h"
+#include "Phase.h"
 #include "Projection.h"
+#include "Scratch.h"
+#include "Trace.h"
 
 #include <algorithm>
 namespace qmapcontrol
 {
     LayerGeometry::LayerGeometry(const std::string& name, const int zoom_minimum, const int zoom_maximum, QObject* parent)
         : Layer(LayerType::LayerGeometry, name, zoom_minimum, zoom_maximum, parent),
-          m_geometries(50, RectWorldCoord(PointWorldCoord(-180.0, 90.0), PointWorldCoord(180.0, -90.0))),
+          m_geometry_pool(std::make_shared<GeometryPool>()),
+          m_geometries(spatial::Box<double>{ -180.0, -90.0, 180.0, 90.0 }, 50),
+          m_geometries_mutex("LayerGeometry::m_geometries_mutex"),
+          m_geometry_widgets_mutex("LayerGeometry::m_geometry_widgets_mutex"),
           mFuzzyFactorPx(5.0)
     {
 
@@ -44,30 +50,43 @@ namespace qmapcontrol
 
     const std::vector<std::shared_ptr<Geometry>> LayerGeometry::getGeometries(const RectWorldCoord& range_coord) const
     {
+        // The geometries container to return.
+        std::vector<std::shared_ptr<Geometry>> return_geometries;
+        getGeometries(return_geometries, range_coord);
+
+        // Return the list of geometries.
+        return return_geometries;
+    }
+
+    void LayerGeometry::getGeometries(std::vector<std::shared_ptr<Geometry>>& return_geometries, const RectWorldCoord& range_coord) const
+    {
+        // Clear the previous geometries.
+        return_geometries.clear();
+
         // Gain a read lock to protect the geometries container.
-        QReadLocker locker(&m_geometries_mutex);
+        ProfiledReadLocker locker(&m_geometries_mutex);
 
         // Populate the geometries container.
-        std::set<std::shared_ptr<Geometry>> queried_geometries;
-        m_geometries.query(queried_geometries, range_coord);
-
-        // The geometries container to return.
-        std::vector<std::shared_ptr<Geometry>> return_geometries(queried_geometries.begin(), queried_geometries.end());
+        {
+            QMC_TRACE_SCOPE("render", "spatial::QuadTree::query");
+            const QRectF range_rect(range_coord.rawRect().normalized());
+            m_geometries.query(return_geometries, spatial::Box<double>{ range_rect.left(), range_rect.top(), range_rect.right(), range_rect.bottom() });
+        }
 
-        // Sort by z-index
+        // Sort by z-index (then by address, to keep a stable draw order).
         std::sort(return_geometries.begin(), return_geometries.end(),
-                  [](std::shared_ptr<Geometry> a, std::shared_ptr<Geometry> b) {
-                      return a->zIndex() < b->zIndex();
+                  [](const std::shared_ptr<Geometry>& a, const std::shared_ptr<Geometry>& b) {
+                      return a->zIndex() < b->zIndex() || (a->zIndex() == b->zIndex() && a < b);
                   });
 
-        // Return the list of geometries.
-        return return_geometries;
+        // Remove the duplicates (a geometry added more than once).
+        return_geometries.erase(std::unique(return_geometries.begin(), return_geometries.end()), return_geometries.end());
     }
 
     const std::set<std::shared_ptr<GeometryWidget>> LayerGeometry::getGeometryWidgets() const
     {
         // Gain a read lock to protect the geometry widgets container.
-        QReadLocker locker(&m_geometry_widgets_mutex);
+        ProfiledReadLocker locker(&m_geometry_widgets_mutex);
 
         // Return the list of geometry widgets.
         return m_geometry_widgets;
@@ -107,6 +126,9 @@ namespace qmapcontrol
 
     void LayerGeometry::addGeometry(const std::shared_ptr<Geometry>& geometry, const bool disable_redraw)
     {
+        // Mark the phase (for the stall detector).
+        QMC_PHASE("LayerGeometry::addGeometry");
+
         // Check the geometry is valid.
         if (geometry != nullptr)
         {
@@ -118,10 +140,10 @@ namespace qmapcontrol
                 case Geometry::GeometryType::GeometryPoint:
                 {
                     // Gain a write lock to protect the geometries container.
-                    QWriteLocker locker(&m_geometries_mutex);
+                    ProfiledWriteLocker locker(&m_geometries_mutex);
 
-                    // Add the geometry.
-                    m_geometries.insert(std::static_pointer_cast<GeometryPoint>(geometry)->coord(), geometry);
+                    // Add the geometry (by its coordinate).
+                    indexGeometry(geometry);
 
                     // Finished.
                     break;
@@ -131,7 +153,7 @@ namespace qmapcontrol
                 case Geometry::GeometryType::GeometryWidget:
                 {
                     // Gain a write lock to protect the geometry widget container.
-                    QWriteLocker locker(&m_geometry_widgets_mutex);
+                    ProfiledWriteLocker locker(&m_geometry_widgets_mutex);
 
                     // Add the geometry widget.
                     m_geometry_widgets.insert(std::static_pointer_cast<GeometryWidget>(geometry));
@@ -140,19 +162,14 @@ namespace qmapcontrol
                     break;
                 }
 
-                /// @todo move linestring and polygon into different container type.
                 // Is it a GeometryLineString.
                 case Geometry::GeometryType::GeometryLineString:
                 {
                     // Gain a write lock to protect the geometries container.
-                    QWriteLocker locker(&m_geometries_mutex);
+                    ProfiledWriteLocker locker(&m_geometries_mutex);
 
-                    // Loop through each GeometryLineString point and add it to the container.
-                    for (const auto& point : std::static_pointer_cast<GeometryLineString>(geometry)->points())
-                    {
-                        // Add the geometry.
-                        m_geometries.insert(point, geometry);
-                    }
+                    // Add the geometry (by its bounding box).
+                    indexGeometry(geometry);
 
                     // Finished.
                     break;
@@ -162,14 +179,10 @@ namespace qmapcontrol
                 case Geometry::GeometryType::GeometryPolygon:
                 {
                     // Gain a write lock to protect the geometries container.
-                    QWriteLocker locker(&m_geometries_mutex);
+                    ProfiledWriteLocker locker(&m_geometries_mutex);
 
-                    // Loop through each GeometryPolygon point and add it to the container.
-                    for (const auto& point : std::static_pointer_cast<GeometryPolygon>(geometry)->points())
-                    {
-                        // Add the geometry.
-                        m_geometries.insert(point, geometry);
-                    }
+                    // Add the geometry (by its bounding box).
+                    indexGeometry(geometry);
 
                     // Finished.
                     break;
@@ -193,6 +206,9 @@ namespace qmapcontrol
 
     void LayerGeometry::removeGeometry(const std::shared_ptr<Geometry>& geometry, const bool disable_redraw)
     {
+        // Mark the phase (for the stall detector).
+        QMC_PHASE("LayerGeometry::removeGeometry");
+
         // Check the geometry is valid.
         if (geometry != nullptr)
         {
@@ -203,13 +219,13 @@ namespace qmapcontrol
                 case Geometry::GeometryType::GeometryPoint:
                 {
                     // Gain a write lock to protect the geometries container.
-                    QWriteLocker locker(&m_geometries_mutex);
+                    ProfiledWriteLocker locker(&m_geometries_mutex);
 
                     // Disconnect any signals that were previously connected.
                     QObject::disconnect(geometry.get(), 0, this, 0);
 
                     // Remove the geometry from the list.
-                    m_geometries.erase(std::static_pointer_cast<GeometryPoint>(geometry)->coord(), geometry);
+                    unindexGeometry(geometry);
 
                     // Finished
                     break;
@@ -219,7 +235,7 @@ namespace qmapcontrol
                 case Geometry::GeometryType::GeometryWidget:
                 {
                     // Gain a write lock to protect the geometry widgets container.
-                    QWriteLocker locker(&m_geometry_widgets_mutex);
+                    ProfiledWriteLocker locker(&m_geometry_widgets_mutex);
 
                     // Disconnect any signals that were previously connected.
                     QObject::disconnect(geometry.get(), 0, this, 0);
@@ -236,22 +252,17 @@ namespace qmapcontrol
                     break;
                 }
 
-                /// @todo move linestring and polygon into different container type.
                 // Is it a GeometryLineString.
                 case Geometry::GeometryType::GeometryLineString:
                 {
                     // Gain a write lock to protect the geometries container.
-                    QWriteLocker locker(&m_geometries_mutex);
+                    ProfiledWriteLocker locker(&m_geometries_mutex);
 
                     // Disconnect any signals that were previously connected.
                     QObject::disconnect(geometry.get(), 0, this, 0);
 
-                    // Loop through each GeometryLineString point and remove it to the container.
-                    for (const auto& point : std::static_pointer_cast<GeometryLineString>(geometry)->points())
-                    {
-                        // Remove the geometry.
-                        m_geometries.erase(point, geometry);
-                    }
+                    // Remove the geometry.
+                    unindexGeometry(geometry);
 
                     // Finished.
                     break;
@@ -261,17 +272,13 @@ namespace qmapcontrol
                 case Geometry::GeometryType::GeometryPolygon:
                 {
                     // Gain a write lock to protect the geometries container.
-                    QWriteLocker locker(&m_geometries_mutex);
+                    ProfiledWriteLocker locker(&m_geometries_mutex);
 
                     // Disconnect any signals that were previously connected.
                     QObject::disconnect(geometry.get(), 0, this, 0);
 
-                    // Loop through each GeometryPolygon point and remove it to the container.
-                    for (const auto& point : std::static_pointer_cast<GeometryPolygon>(geometry)->points())
-                    {
-                        // Remove the geometry.
-                        m_geometries.erase(point, geometry);
-                    }
+                    // Remove the geometry.
+                    unindexGeometry(geometry);
 
                     // Finished.
                     break;
@@ -289,14 +296,22 @@ namespace qmapcontrol
         }
     }
 
+    GeometryPoolStats LayerGeometry::geometryPoolStats() const
+    {
+        // Return the pool statistics.
+        return m_geometry_pool->stats();
+    }
+
     void LayerGeometry::clearGeometries()
     {
         // Gain a write lock to protect the geometries and geometry widgets container.
-        QWriteLocker locker(&m_geometries_mutex);
-        QWriteLocker locker_widgets(&m_geometry_widgets_mutex);
+        ProfiledWriteLocker locker(&m_geometries_mutex);
+        ProfiledWriteLocker locker_widgets(&m_geometry_widgets_mutex);
 
         // Remove all geometries from the list.
         m_geometries.clear();
+        m_indexed_geometries.clear();
+        m_geometries_usage = MemoryUsage();
         m_geometry_widgets.clear();
     }
 
@@ -348,8 +363,12 @@ namespace qmapcontrol
             // Save the current painter's state.
             painter.save();
 
+            // Fetch the geometries to draw (in a scratch buffer).
+            scratch::Lease<std::vector<std::shared_ptr<Geometry>>> geometries;
+            getGeometries(*geometries, backbuffer_rect_coord);
+
             // Loop through each geometry and draw it.
-            for (const auto& geometry : getGeometries(backbuffer_rect_coord))
+            for (const auto& geometry : *geometries)
             {
                 // Draw the geometry (this will not move widgets).
                 geometry->draw(painter, backbuffer_rect_coord, controller_zoom);
@@ -360,8 +379,41 @@ namespace qmapcontrol
         }
     }
 
+    MemoryUsage LayerGeometry::memoryUsage() const
+    {
+        // The layer attributes and members (the quad tree itself is counted with the index).
+        MemoryUsage usage = Layer::memoryUsage();
+        usage.attribute_bytes += sizeof(LayerGeometry) - sizeof(Layer) - sizeof(m_geometries);
+
+        // Add the geometries (kept up to date as they are indexed) and the quad tree index size.
+        {
+            // Gain a read lock to protect the geometries container.
+            ProfiledReadLocker locker(&m_geometries_mutex);
+            usage.index_bytes += m_geometries.memoryUsage();
+            usage.index_bytes += std::size_t(m_indexed_geometries.size()) * (sizeof(const Geometry*) + sizeof(IndexedGeometry) + 2 * sizeof(void*));
+            usage += m_geometries_usage;
+        }
+
+        // Add the geometry widgets.
+        {
+            // Gain a read lock to protect the geometry widgets container.
+            ProfiledReadLocker locker(&m_geometry_widgets_mutex);
+            usage.index_bytes += m_geometry_widgets.size() * (sizeof(std::shared_ptr<GeometryWidget>) + 4 * sizeof(void*));
+            for (const auto& geometry_widget : m_geometry_widgets)
+            {
+                usage += geometry_widget->memoryUsage();
+            }
+        }
+
+        // Return the memory usage.
+        return usage;
+    }
+
     void LayerGeometry::moveGeometryWidgets(const PointPx& offset_px, const int controller_zoom) const
     {
+        // Mark the phase (for the stall detector).
+        QMC_PHASE("LayerGeometry::moveGeometryWidgets");
+
         // Check the layer is visible.
         if (isVisible(controller_zoom))
         {
@@ -382,4 +434,67 @@ namespace qmapcontrol
     {
         mFuzzyFactorPx = value;
     }
+
+    void LayerGeometry::indexGeometry(const std::shared_ptr<Geometry>& geometry)
+    {
+        // Each geometry is indexed once.
+        if (m_indexed_geometries.contains(geometry.get()))
+        {
+            return;
+        }
+
+        // Add the geometry, and remember the bounding box it is indexed by and its memory usage.
+        m_geometries.insert(geometry);
+        const IndexedGeometry indexed{ geometry, GeometryBounds()(geometry), geometry->memoryUsage() };
+        m_indexed_geometries.insert(geometry.get(), indexed);
+        m_geometries_usage += indexed.usage;
+
+        // Index the geometry again when it moves (from the thread that moves it, disconnected by removeGeometry()).
+        QObject::connect(geometry.get(), &Geometry::positionChanged, this, [this](const Geometry* moved) { reindexGeometry(moved); }, Qt::DirectConnection);
+    }
+
+    void LayerGeometry::unindexGeometry(const std::shared_ptr<Geometry>& geometry)
+    {
+        // Remove the geometry from where it was indexed (even if it has moved since).
+        const auto itr_find = m_indexed_geometries.find(geometry.get());
+        if (itr_find != m_indexed_geometries.end())
+        {
+            m_geometries.erase(geometry, itr_find->bounds);
+            m_geometries_usage -= itr_find->usage;
+            m_indexed_geometries.erase(itr_find);
+        }
+    }
+
+    void LayerGeometry::reindexGeometry(const Geometry* geometry)
+    {
+        // Gain a write lock to protect the geometries container.
+        ProfiledWriteLocker locker(&m_geometries_mutex);
+
+        // Move the geometry from its previous bounding box to its current one.
+        const auto itr_find = m_indexed_geometries.find(geometry);
+        if (itr_find != m_indexed_geometries.end())
+        {
+            m_geometries.update(itr_find->geometry, itr_find->bounds);
+            itr_find->bounds = GeometryBounds()(itr_find->geometry);
+
+            // Its points may have changed too.
+            m_geometries_usage -= itr_find->usage;
+            itr_find->usage = itr_find->geometry->memoryUsage();
+            m_geometries_usage += itr_find->usage;
+        }
+    }
+
+    spatial::Box<double> LayerGeometry::GeometryBounds::operator()(const std::shared_ptr<Geometry>& geometry) const
+    {
+        // Index points by their coordinate.
+        if (geometry->geometryType() == Geometry::GeometryType::GeometryPoint)
+        {
+            const PointWorldCoord coord(std::static_pointer_cast<GeometryPoint>(geometry)->coord());
+            return spatial::Box<double>{ coord.longitude(), coord.latitude(), coord.longitude(), coord.latitude() };
+        }
+
+        // Index the others by their bounding box (independent of the zoom for line strings and polygons).
+        const QRectF bounds(geometry->boundingBox(0).rawRect().normalized());
+        return spatial::Box<double>{ bounds.left(), bounds.top(), bounds.right(), bounds.bottom() };
+    }
 }
@@ -26,19 +26,23 @@
 #pragma once
 
 // Qt includes.
+#include <QtCore/QHash>
 #include <QtCore/QObject>
 #include <QtCore/QReadWriteLock>
 
 // STL includes.
 #include <memory>
 #include <set>
+#include <utility>
 
 // Local includes.
 #include "qmapcontrol_global.h"
 #include "Geometry.h"
+#include "GeometryPool.h"
 #include "GeometryWidget.h"
 #include "Layer.h"
-#include "QuadTreeContainer.h"
+#include "ProfiledLock.h"
+#include "SpatialIndex.h"
 
 namespace qmapcontrol
 {
@@ -79,6 +83,13 @@ namespace qmapcontrol
          */
         const std::vector<std::shared_ptr<Geometry>> getGeometries(const RectWorldCoord& range_coord) const;
 
+        /*!
+         * Fetches the Geometry objects from this Layer into a container (Use this instead of the member variable for thread-safety).
+         * @param return_geometries The container to fill (cleared first, its capacity is reused).
+         * @param range_coord The bounding box range to limit the geometries that are fetched in coordinates.
+         */
+        void getGeometries(std::vector<std::shared_ptr<Geometry>>& return_geometries, const RectWorldCoord& range_coord) const;
+
         /*!
          * Returns the Geometry QWidgets from this Layer (Use this instead of the member variable for thread-safety).
          * @return a list of geometry widgets that are on this Layer.
@@ -107,6 +118,24 @@ namespace qmapcontrol
          */
         void removeGeometry(const std::shared_ptr<Geometry>& geometry, const bool disable_redraw = false);
 
+        /*!
+         * Creates a Geometry object from this Layer's pool (the object and its control block are one pooled allocation).
+         * @note The geometry is not added to the layer, use addGeometry() (it may also be added to other layers).
+         * @param args The geometry's constructor arguments.
+         * @return the geometry.
+         */
+        template<typename T, typename... Args>
+        std::shared_ptr<T> createGeometry(Args&&... args) const
+        {
+            return GeometryPool::create<T>(m_geometry_pool, std::forward<Args>(args)...);
+        }
+
+        /*!
+         * Fetches the statistics of this Layer's geometry pool.
+         * @return the pool statistics.
+         */
+        GeometryPoolStats geometryPoolStats() const;
+
         /*!
          * Removes all Geometry objects from this Layer.
          */
@@ -128,6 +157,12 @@ namespace qmapcontrol
          */
         void draw(QPainter& painter, const RectWorldPx& backbuffer_rect_px, const int controller_zoom) const final;
 
+        /*!
+         * Estimates the memory used by the layer: geometry payload, quad tree index and attributes.
+         * @return the memory usage.
+         */
+        MemoryUsage memoryUsage() const final;
+
         /*!
          * Moves any geometries that represent a widget, as these are not drawn to the actually pixmap.
          * @param offset_px The offset in pixels to remove from the coordinate pixel point.
@@ -146,17 +181,69 @@ namespace qmapcontrol
         void geometryClicked(const Geometry* geometry) const;
 
     private:
-        /// List of geometries drawn by this layer.
-        QuadTreeContainer m_geometries;
+        //! The bounding box of a geometry in coordinates (the location it is indexed by).
+        struct GeometryBounds
+        {
+            /*!
+             * Fetch the bounding box of a geometry.
+             * @param geometry The geometry.
+             * @return the bounding box (the coordinate of a point).
+             */
+            spatial::Box<double> operator()(const std::shared_ptr<Geometry>& geometry) const;
+        };
+
+        //! An indexed geometry.
+        struct IndexedGeometry
+        {
+            /// The geometry.
+            std::shared_ptr<Geometry> geometry;
+
+            /// The bounding box it is indexed by (its bounding box when it was last indexed).
+            spatial::Box<double> bounds;
+
+            /// Its memory usage when it was last indexed (counted in m_geometries_usage).
+            MemoryUsage usage;
+        };
+
+        /*!
+         * Adds a geometry to the quad tree (once), and indexes it again whenever it moves (m_geometries_mutex is held).
+         * @param geometry The geometry to add.
+         */
+        void indexGeometry(const std::shared_ptr<Geometry>& geometry);
+
+        /*!
+         * Removes a geometry from the quad tree, from where it was indexed (m_geometries_mutex is held).
+         * @param geometry The geometry to remove.
+         */
+        void unindexGeometry(const std::shared_ptr<Geometry>& geometry);
+
+        /*!
+         * Moves a geometry that has moved (or changed its points) to its current bounding box in the quad tree.
+         * @param geometry The geometry that has moved.
+         */
+        void reindexGeometry(const Geometry* geometry);
+
+    private:
+        /// The pool that createGeometry() allocates from (shared with the geometries it allocated).
+        const std::shared_ptr<GeometryPool> m_geometry_pool;
+
+        /// List of geometries drawn by this layer (each indexed once by its bounding box).
+        spatial::QuadTree<std::shared_ptr<Geometry>, double, GeometryBounds> m_geometries;
+
+        /// The geometries in the quad tree, with the bounding box each is indexed by.
+        QHash<const Geometry*, IndexedGeometry> m_indexed_geometries;
+
+        /// The memory usage of the geometries in the quad tree (kept up to date as they are indexed).
+        MemoryUsage m_geometries_usage;
 
         /// Mutex to protect geometries.
-        mutable QReadWriteLock m_geometries_mutex;
+        mutable ProfiledReadWriteLock m_geometries_mutex;
 
         /// List of geometry widgets drawn by this layer.
         std::set<std::shared_ptr<GeometryWidget>> m_geometry_widgets;
 
         /// Mutex to protect geometry widgets.
-        mutable QReadWriteLock m_geometry_widgets_mutex;
+        mutable ProfiledReadWriteLock m_geometry_widgets_mutex;
 
         qreal mFuzzyFactorPx;
     };
@@ -0,0 +1,391 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "LayerHillshade.h"
+
+// Qt includes.
+#include <QtConcurrent/QtConcurrentRun>
+
+// STL includes.
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+// Local includes.
+#include "ImageManager.h"
+#include "Projection.h"
+
+namespace qmapcontrol
+{
+    namespace
+    {
+        /// The default capacity of the shaded tiles cache (bytes).
+        const int kShadedCacheCapacity = 32 * 1024 * 1024;
+
+        /// The capacity of the decoded heights cache (bytes).
+        const int kHeightsCacheCapacity = 64 * 1024 * 1024;
+
+        /// The number of missing elevation tiles remembered before the entries of evicted tiles are dropped.
+        const int kMaxWaitingTiles = 16384;
+
+        /*!
+         * Calculate the ground distance between two points (haversine).
+         * @param from The first point.
+         * @param to The second point.
+         * @return the distance in metres.
+         */
+        double groundDistance(const PointWorldCoord& from, const PointWorldCoord& to)
+        {
+            const double degrees_to_radians = std::acos(-1.0) / 180.0;
+            const double latitude_from = from.latitude() * degrees_to_radians;
+            const double latitude_to = to.latitude() * degrees_to_radians;
+            const double sin_latitude = std::sin((latitude_to - latitude_from) / 2.0);
+            const double sin_longitude = std::sin((to.longitude() - from.longitude()) * degrees_to_radians / 2.0);
+            const double a = sin_latitude * sin_latitude + std::cos(latitude_from) * std::cos(latitude_to) * sin_longitude * sin_longitude;
+            return 2.0 * 6371008.8 * std::asin(std::min(1.0, std::sqrt(a)));
+        }
+    }
+
+    LayerHillshade::LayerHillshade(const std::string& name, const std::shared_ptr<MapAdapter>& mapadapter, const DemEncoding encoding, const int zoom_minimum, const int zoom_maximum, QObject* parent)
+        : Layer(LayerType::LayerHillshade, name, zoom_minimum, zoom_maximum, parent),
+          m_mapAdapter(mapadapter),
+          m_encoding(encoding),
+          m_mutex("LayerHillshade::m_mutex"),
+          m_generation(0),
+          m_shaded_tiles(kShadedCacheCapacity),
+          m_heights(kHeightsCacheCapacity)
+    {
+        // Shade the tiles again when the elevation tiles they were shaded without arrive.
+        QObject::connect(&ImageManager::get(), &ImageManager::imageUpdated, this, &LayerHillshade::elevationTileUpdated);
+    }
+
+    LayerHillshade::~LayerHillshade()
+    {
+        // Wait for the tiles being shaded.
+        m_thread_pool.waitForDone();
+    }
+
+    const std::shared_ptr<MapAdapter> LayerHillshade::getMapAdapter() const
+    {
+        // Return the map adapter.
+        return m_mapAdapter;
+    }
+
+    HillshadeOptions LayerHillshade::getHillshadeOptions() const
+    {
+        // Gain a lock to protect the options.
+        ProfiledMutexLocker locker(&m_mutex);
+
+        // Return the options.
+        return m_options;
+    }
+
+    void LayerHillshade::setHillshadeOptions(const HillshadeOptions& options)
+    {
+        // Scope the locker to ensure the mutex is release as soon as possible.
+        {
+            // Gain a lock to protect the options.
+            ProfiledMutexLocker locker(&m_mutex);
+
+            // Set the options and discard the tiles shaded with the previous ones.
+            m_options = options;
+            ++m_generation;
+            m_shaded_tiles.clear();
+            m_pending.clear();
+            m_waiting.clear();
+            m_stale.clear();
+        }
+
+        // Emit to redraw layer.
+        emit requestRedraw();
+    }
+
+    void LayerHillshade::setShadedCacheCapacity(const int capacityMiB)
+    {
+        // Gain a lock to protect the cache.
+        ProfiledMutexLocker locker(&m_mutex);
+
+        // Set the capacity.
+        m_shaded_tiles.setMaxCost(capacityMiB * 1024 * 1024);
+    }
+
+    bool LayerHillshade::mousePressEvent(const QMouseEvent* /*mouse_event*/, const PointWorldCoord& /*mouse_point_coord*/, const int /*controller_zoom*/) const
+    {
+        // Do nothing.
+        return false;
+    }
+
+    void LayerHillshade::draw(QPainter& painter, const RectWorldPx& backbuffer_rect_px, const int controller_zoom) const
+    {
+        // Check the layer is visible and a map adapter is set.
+        if (isVisible(controller_zoom) && m_mapAdapter != nullptr)
+        {
+            // The current tile size.
+            const QSizeF tile_size_px(ImageManager::get().tileSizePx(), ImageManager::get().tileSizePx());
+
+            // Calculate the tiles to draw.
+            const int furthest_tile_left = int(std::floor(backbuffer_rect_px.leftPx() / tile_size_px.width()));
+            const int furthest_tile_top = int(std::floor(backbuffer_rect_px.topPx() / tile_size_px.height()));
+            const int furthest_tile_right = int(std::floor(backbuffer_rect_px.rightPx() / tile_size_px.width()));
+            const int furthest_tile_bottom = int(std::floor(backbuffer_rect_px.bottomPx() / tile_size_px.height()));
+
+            // Loop through the tiles to draw (left to right).
+            for (int i = furthest_tile_left; i <= furthest_tile_right; ++i)
+            {
+                // Loop through the tiles to draw (top to bottom).
+                for (int j = furthest_tile_top; j <= furthest_tile_bottom; ++j)
+                {
+                    // Check the tile is valid.
+                    if (m_mapAdapter->isTileValid(i, j, controller_zoom))
+                    {
+                        // Fetch the shaded tile.
+                        QImage image;
+                        shadedTile(i, j, controller_zoom, image);
+
+                        // Draw the shaded tile (stretched to the tile size).
+                        if (image.isNull() == false)
+                        {
+                            const PointWorldPx top_left_px(i * tile_size_px.width(), j * tile_size_px.height());
+                            painter.drawImage(QRectF(top_left_px.rawPoint(), tile_size_px), image);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    bool LayerHillshade::shadedTile(const int x, const int y, const int controller_zoom, QImage& image) const
+    {
+        // Fetch the shaded tile.
+        const QUrl url = m_mapAdapter->tileQuery(x, y, controller_zoom);
+        ProfiledMutexLocker locker(&m_mutex);
+        const ShadedTile* shaded = m_shaded_tiles.object(url);
+        if (shaded != nullptr)
+        {
+            image = shaded->image;
+        }
+
+        // Shade the tile (again, if an elevation tile it was shaded without has arrived) from the GUI thread.
+        if ((shaded == nullptr || m_stale.contains(url)) && m_pending.contains(url) == false)
+        {
+            m_pending.insert(url);
+            QMetaObject::invokeMethod(const_cast<LayerHillshade*>(this), "queueShade", Qt::QueuedConnection,
+                                      Q_ARG(int, x), Q_ARG(int, y), Q_ARG(int, controller_zoom), Q_ARG(QUrl, url));
+        }
+
+        // Return whether the tile is still being fetched or shaded.
+        return m_pending.contains(url);
+    }
+
+    void LayerHillshade::queueShade(const int x, const int y, const int controller_zoom, const QUrl& url)
+    {
+        // Take the tile's previous shade (to tell whether more neighbours are available now).
+        int missing_neighbours = -1;
+        {
+            ProfiledMutexLocker locker(&m_mutex);
+            m_stale.remove(url);
+            const ShadedTile* shaded = m_shaded_tiles.object(url);
+            if (shaded != nullptr && shaded->image.isNull() == false)
+            {
+                missing_neighbours = shaded->missing_neighbours;
+            }
+        }
+
+        // Fetch the elevation tile and its neighbours (requests them if needed).
+        std::array<QUrl, 9> urls;
+        std::array<QPixmap, 9> pixmaps;
+        std::vector<QUrl> missing_urls;
+        int missing = 0;
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                const std::size_t index = std::size_t((dy + 1) * 3 + dx + 1);
+                if (index == 4 || m_mapAdapter->isTileValid(x + dx, y + dy, controller_zoom))
+                {
+                    urls[index] = index == 4 ? url : m_mapAdapter->tileQuery(x + dx, y + dy, controller_zoom);
+                    pixmaps[index] = ImageManager::get().getImage(urls[index]);
+                    if (ImageManager::get().isPlaceholder(pixmaps[index]))
+                    {
+                        missing_urls.push_back(urls[index]);
+                        if (index != 4)
+                        {
+                            pixmaps[index] = QPixmap();
+                            ++missing;
+                        }
+                    }
+                }
+            }
+        }
+
+        // Remember the missing elevation tiles (the tile is shaded again when they arrive).
+        const bool loading = ImageManager::get().isLoading(pixmaps[4]);
+        const bool empty = ImageManager::get().isPlaceholder(pixmaps[4]) && loading == false;
+        {
+            ProfiledMutexLocker locker(&m_mutex);
+            if (m_waiting.size() > kMaxWaitingTiles)
+            {
+                for (auto itr = m_waiting.begin(); itr != m_waiting.end(); )
+                {
+                    if (m_shaded_tiles.contains(itr.value()))
+                    {
+                        ++itr;
+                    }
+                    else
+                    {
+                        itr = m_waiting.erase(itr);
+                    }
+                }
+            }
+            for (const auto& missing_url : missing_urls)
+            {
+                if (m_waiting.contains(missing_url, url) == false)
+                {
+                    m_waiting.insert(missing_url, url);
+                }
+            }
+
+            // Nothing to shade yet (an empty elevation tile is remembered as an empty shade).
+            if (loading || empty || (missing_neighbours >= 0 && missing >= missing_neighbours))
+            {
+                if (empty)
+                {
+                    m_shaded_tiles.insert(url, new ShadedTile{ QImage(), 0 }, 1);
+                }
+                m_pending.remove(url);
+                return;
+            }
+        }
+
+        // Take the decoded heights, convert the other elevation tiles here (pixmaps are only used in the GUI thread).
+        std::array<std::shared_ptr<const HeightTile>, 9> cached_heights;
+        std::array<QImage, 9> images;
+        for (std::size_t i = 0; i < pixmaps.size(); ++i)
+        {
+            if (pixmaps[i].isNull() == false)
+            {
+                cached_heights[i] = cachedHeights(urls[i]);
+                if (cached_heights[i] == nullptr)
+                {
+                    images[i] = pixmaps[i].toImage();
+                }
+            }
+        }
+
+        // Calculate the ground width of the tile (across its middle).
+        const double tile_size_px = ImageManager::get().tileSizePx();
+        const PointWorldCoord left = projection::get().toPointWorldCoord(PointWorldPx(x * tile_size_px, (y + 0.5) * tile_size_px), controller_zoom);
+        const PointWorldCoord right = projection::get().toPointWorldCoord(PointWorldPx((x + 1) * tile_size_px, (y + 0.5) * tile_size_px), controller_zoom);
+        const double tile_width_m = groundDistance(left, right);
+
+        // Take the options the tile is shaded with.
+        HillshadeOptions options;
+        quint64 generation;
+        {
+            ProfiledMutexLocker locker(&m_mutex);
+            options = m_options;
+            generation = m_generation;
+        }
+
+        // Shade the tile in a worker thread.
+        QtConcurrent::run(&m_thread_pool, [this, urls, images, cached_heights, missing, tile_width_m, options, generation]()
+        {
+            // Decode the heights.
+            std::array<std::shared_ptr<const HeightTile>, 9> decoded = cached_heights;
+            std::array<const HeightTile*, 9> tiles;
+            for (std::size_t i = 0; i < tiles.size(); ++i)
+            {
+                if (decoded[i] == nullptr && images[i].isNull() == false)
+                {
+                    decoded[i] = this->heights(urls[i], images[i]);
+                }
+                tiles[i] = decoded[i].get();
+            }
+
+            // Shade the tile.
+            const QImage image = hillshade::shade(tiles, tile_width_m / std::max(1, tiles[4]->width), options);
+
+            // Store the shaded tile (unless the options changed meanwhile).
+            {
+                ProfiledMutexLocker locker(&m_mutex);
+                if (generation != m_generation)
+                {
+                    return;
+                }
+                m_pending.remove(urls[4]);
+                m_shaded_tiles.insert(urls[4], new ShadedTile{ image, missing }, std::max(1, image.bytesPerLine() * image.height()));
+            }
+
+            // Emit to redraw layer.
+            emit requestRedraw();
+        });
+    }
+
+    void LayerHillshade::elevationTileUpdated(const QUrl& url)
+    {
+        // Shade the tiles that were shaded without it again (when next drawn).
+        ProfiledMutexLocker locker(&m_mutex);
+        const QList<QUrl> tiles = m_waiting.values(url);
+        if (tiles.isEmpty() == false)
+        {
+            m_waiting.remove(url);
+            for (const auto& tile : tiles)
+            {
+                m_stale.insert(tile);
+            }
+        }
+    }
+
+    std::shared_ptr<const HeightTile> LayerHillshade::cachedHeights(const QUrl& url) const
+    {
+        // Already decoded?
+        ProfiledMutexLocker locker(&m_mutex);
+        const std::shared_ptr<const HeightTile>* cached = m_heights.object(url);
+        return cached != nullptr ? *cached : nullptr;
+    }
+
+    std::shared_ptr<const HeightTile> LayerHillshade::heights(const QUrl& url, const QImage& image) const
+    {
+        // Already decoded?
+        std::shared_ptr<const HeightTile> tile = cachedHeights(url);
+        if (tile != nullptr)
+        {
+            return tile;
+        }
+
+        // Decode the heights.
+        tile = std::make_shared<HeightTile>(hillshade::decodeHeights(image, m_encoding));
+
+        // Cache the heights.
+        {
+            ProfiledMutexLocker locker(&m_mutex);
+            m_heights.insert(url, new std::shared_ptr<const HeightTile>(tile), std::max<int>(1, int(tile->heights.size() * sizeof(float))));
+        }
+
+        // Return the heights.
+        return tile;
+    }
+}
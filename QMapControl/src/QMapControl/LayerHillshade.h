@@ -0,0 +1,217 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// Qt includes.
+#include <QtCore/QCache>
+#include <QtCore/QMultiHash>
+#include <QtCore/QObject>
+#include <QtCore/QSet>
+#include <QtCore/QThreadPool>
+#include <QtCore/QUrl>
+#include <QtGui/QImage>
+
+// STL includes.
+#include <memory>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+#include "Hillshade.h"
+#include "Layer.h"
+#include "MapAdapter.h"
+#include "ProfiledLock.h"
+
+namespace qmapcontrol
+{
+    //! Layer class
+    /*!
+     * Layer that shades the terrain from elevation (DEM) tiles, drawn over the layers below it.
+     *
+     * The elevation tiles (Terrain-RGB or Terrarium PNGs) are fetched through the map adapter and
+     * the image manager like any other tiles, so they can come from a tile server or a local
+     * directory (eg: MapAdapterTile(QUrl("file:///data/dem/%zoom/%x/%y.png"), ...)). Each tile is
+     * shaded with its neighbours' edges (so there are no seams) in a worker thread, and the shaded
+     * tiles are cached. A tile shaded before its neighbours were available is shaded again once they
+     * arrive (see ImageManager::imageUpdated()).
+     */
+    class QMAPCONTROL_EXPORT LayerHillshade : public Layer
+    {
+        Q_OBJECT
+    public:
+        //! Layer constructor
+        /*!
+         * This is used to construct a layer.
+         * @param name The name of the layer.
+         * @param mapadapter The Map Adapter of the elevation tiles.
+         * @param encoding The encoding of the elevation tiles.
+         * @param zoom_minimum The minimum zoom level to show this layer at.
+         * @param zoom_maximum The maximum zoom level to show this layer at.
+         * @param parent QObject parent ownership.
+         */
+        LayerHillshade(const std::string& name,
+                       const std::shared_ptr<MapAdapter>& mapadapter,
+                       const DemEncoding encoding = DemEncoding::TerrainRGB,
+                       const int zoom_minimum = 0,
+                       const int zoom_maximum = kDefaultMaxZoom,
+                       QObject* parent = nullptr);
+
+        //! Disable copy constructor.
+        LayerHillshade(const LayerHillshade&) = delete;
+
+        //! Disable copy assignment.
+        LayerHillshade& operator=(const LayerHillshade&) = delete;
+
+        //! Destructor (waits for the tiles being shaded).
+        ~LayerHillshade();
+
+        /*!
+         * Returns the Map Adapter of the elevation tiles.
+         * @return the map adapter.
+         */
+        const std::shared_ptr<MapAdapter> getMapAdapter() const;
+
+        /*!
+         * Fetch how the terrain is shaded.
+         * @return the shading options.
+         */
+        HillshadeOptions getHillshadeOptions() const;
+
+        /*!
+         * Set how the terrain is shaded (the shaded tiles are discarded).
+         * @param options The shading options.
+         */
+        void setHillshadeOptions(const HillshadeOptions& options);
+
+        /*!
+         * Set the capacity of the shaded tiles cache.
+         * @param capacityMiB The capacity in MiB.
+         */
+        void setShadedCacheCapacity(const int capacityMiB);
+
+        /*!
+         * Fetch a shaded tile (and queue it to be shaded if needed).
+         * @param x The x coordinate of the tile.
+         * @param y The y coordinate of the tile.
+         * @param controller_zoom The current controller zoom.
+         * @param image The shaded tile (null if not shaded yet).
+         * @return whether the tile is still being fetched or shaded.
+         */
+        bool shadedTile(const int x, const int y, const int controller_zoom, QImage& image) const;
+
+        /*!
+         * Handles mouse press events (such as left-clicking an item on the layer).
+         * @param mouse_event The mouse event.
+         * @param mouse_point_coord The mouse point on the map in coord.
+         * @param controller_zoom The current controller zoom.
+         */
+        bool mousePressEvent(const QMouseEvent* mouse_event, const PointWorldCoord& mouse_point_coord, const int controller_zoom) const final;
+
+        /*!
+         * Draws the shaded tiles (and queues the missing ones to be shaded) using the provided painter.
+         * @param painter The painter that will draw to the pixmap.
+         * @param backbuffer_rect_px Only draw tiles that are contained in the backbuffer rect (pixels).
+         * @param controller_zoom The current controller zoom.
+         */
+        void draw(QPainter& painter, const RectWorldPx& backbuffer_rect_px, const int controller_zoom) const final;
+
+    private slots:
+        /*!
+         * Queue a tile to be shaded, if its elevation tile is available (and more neighbours are than
+         * when it was last shaded). The elevation tiles are fetched and converted here, in the GUI thread.
+         * @param x The x coordinate of the tile.
+         * @param y The y coordinate of the tile.
+         * @param controller_zoom The current controller zoom.
+         * @param url The url of the elevation tile.
+         */
+        void queueShade(const int x, const int y, const int controller_zoom, const QUrl& url);
+
+        /*!
+         * Mark the tiles shaded without an elevation tile to be shaded again, now that it has arrived.
+         * @param url The url of the elevation tile.
+         */
+        void elevationTileUpdated(const QUrl& url);
+
+    private:
+        //! A shaded tile.
+        struct ShadedTile
+        {
+            /// The shade (null if the elevation tile is empty).
+            QImage image;
+
+            /// The number of neighbours that were not available when shaded.
+            int missing_neighbours;
+        };
+
+        /*!
+         * Fetch the heights of an elevation tile, if already decoded.
+         * @param url The url of the elevation tile.
+         * @return the heights (nullptr if not decoded yet).
+         */
+        std::shared_ptr<const HeightTile> cachedHeights(const QUrl& url) const;
+
+        /*!
+         * Fetch the heights of an elevation tile (decoded and cached if needed).
+         * @param url The url of the elevation tile.
+         * @param image The elevation tile.
+         * @return the heights.
+         */
+        std::shared_ptr<const HeightTile> heights(const QUrl& url, const QImage& image) const;
+
+    private:
+        /// The map adapter of the elevation tiles.
+        const std::shared_ptr<MapAdapter> m_mapAdapter;
+
+        /// The encoding of the elevation tiles.
+        const DemEncoding m_encoding;
+
+        /// Mutex to protect the options and caches.
+        mutable ProfiledMutex m_mutex;
+
+        /// How the terrain is shaded.
+        HillshadeOptions m_options;
+
+        /// The generation of the options (to discard tiles shaded with previous options).
+        quint64 m_generation;
+
+        /// The shaded tiles, by elevation tile url.
+        mutable QCache<QUrl, ShadedTile> m_shaded_tiles;
+
+        /// The decoded heights, by elevation tile url.
+        mutable QCache<QUrl, std::shared_ptr<const HeightTile>> m_heights;
+
+        /// The tiles being shaded.
+        mutable QSet<QUrl> m_pending;
+
+        /// The tiles shaded without an elevation tile, by the url of the missing elevation tile.
+        QMultiHash<QUrl, QUrl> m_waiting;
+
+        /// The tiles to shade again (an elevation tile they were shaded without has arrived).
+        QSet<QUrl> m_stale;
+
+        /// The worker threads.
+        mutable QThreadPool m_thread_pool;
+    };
+}
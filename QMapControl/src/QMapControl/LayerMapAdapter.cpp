@@ -30,6 +30,7 @@
 
 // Local includes.
 #include "ImageManager.h"
+#include "Scratch.h"
 
 namespace qmapcontrol
 {
@@ -37,15 +38,18 @@ namespace qmapcontrol
 
     LayerMapAdapter::LayerMapAdapter(const std::string& name, const std::shared_ptr<MapAdapter>& mapadapter, const int zoom_minimum, const int zoom_maximum, QObject* parent)
         : Layer(LayerType::LayerMapAdapter, name, zoom_minimum, zoom_maximum, parent),
-          m_mapAdapter(mapadapter)
+          m_mapAdapter(mapadapter),
+          m_mapadapter_mutex("LayerMapAdapter::m_mapadapter_mutex"),
+          m_visible_tiles_mutex("LayerMapAdapter::m_visible_tiles_mutex")
     {
-
+        // Draw with the new tile decode options once the visible tiles are prepared.
+        QObject::connect(&m_tile_decode_watcher, &QFutureWatcher<void>::finished, this, &LayerMapAdapter::tileDecodeOptionsPrepared);
     }
 
     const std::shared_ptr<MapAdapter> LayerMapAdapter::getMapAdapter() const
     {
         // Gain a read lock to protect the map adapter.
-        QReadLocker locker(&m_mapadapter_mutex);
+        ProfiledReadLocker locker(&m_mapadapter_mutex);
 
         // Return the map adapter.
         return m_mapAdapter;
@@ -56,7 +60,7 @@ namespace qmapcontrol
         // Scope the locker to ensure the mutex is release as soon as possible.
         {
             // Gain a write lock to protect the map adapter.
-            QWriteLocker locker(&m_mapadapter_mutex);
+            ProfiledWriteLocker locker(&m_mapadapter_mutex);
 
             // Set the map adapter.
             m_mapAdapter = mapadapter;
@@ -66,6 +70,52 @@ namespace qmapcontrol
         emit requestRedraw();
     }
 
+    TileDecodeOptions LayerMapAdapter::getTileDecodeOptions() const
+    {
+        // Gain a read lock to protect the tile decode options.
+        ProfiledReadLocker locker(&m_mapadapter_mutex);
+
+        // Return the tile decode options.
+        return m_pending_tile_decode_options;
+    }
+
+    void LayerMapAdapter::setTileDecodeOptions(const TileDecodeOptions& options)
+    {
+        // Scope the locker to ensure the mutex is release as soon as possible.
+        {
+            // Gain a write lock to protect the tile decode options.
+            ProfiledWriteLocker locker(&m_mapadapter_mutex);
+
+            // Set the tile decode options to draw with once the visible tiles are prepared.
+            m_pending_tile_decode_options = options;
+        }
+
+        // Fetch the visible tiles.
+        std::vector<QUrl> visible_tiles;
+        {
+            ProfiledMutexLocker locker(&m_visible_tiles_mutex);
+            visible_tiles = m_visible_tiles;
+        }
+
+        // Prepare the visible tiles in a background thread (the other tiles are prepared when first drawn).
+        m_tile_decode_watcher.setFuture(ImageManager::get().prepareImages(visible_tiles, options));
+    }
+
+    void LayerMapAdapter::tileDecodeOptionsPrepared()
+    {
+        // Scope the locker to ensure the mutex is release as soon as possible.
+        {
+            // Gain a write lock to protect the tile decode options.
+            ProfiledWriteLocker locker(&m_mapadapter_mutex);
+
+            // Draw with the new tile decode options.
+            m_tile_decode_options = m_pending_tile_decode_options;
+        }
+
+        // Emit to redraw layer.
+        emit requestRedraw();
+    }
+
     bool LayerMapAdapter::mousePressEvent(const QMouseEvent* /*mouse_event*/, const PointWorldCoord& /*mouse_point_coord*/, const int /*controller_zoom*/) const
     {
         // Do nothing.
@@ -73,9 +123,63 @@ namespace qmapcontrol
     }
 
     void LayerMapAdapter::draw(QPainter& painter, const RectWorldPx& backbuffer_rect_px, const int controller_zoom) const
+    {
+        // Draw all the tiles.
+        drawTiles(painter, backbuffer_rect_px, controller_zoom, nullptr);
+    }
+
+    void LayerMapAdapter::occludeTiles(const RectWorldPx& backbuffer_rect_px, const int controller_zoom, TileOcclusion& occlusion) const
+    {
+        // Gain a read lock to protect the map adapter.
+        ProfiledReadLocker locker(&m_mapadapter_mutex);
+
+        // Check the layer is visible and a map adapter is set.
+        if (isVisible(controller_zoom) && m_mapAdapter != nullptr)
+        {
+            // The current tile size.
+            const QSizeF tile_size_px(ImageManager::get().tileSizePx(), ImageManager::get().tileSizePx());
+
+            // Calculate the tiles to draw.
+            const int furthest_tile_left = int(std::floor(backbuffer_rect_px.leftPx() / tile_size_px.width()));
+            const int furthest_tile_top = int(std::floor(backbuffer_rect_px.topPx() / tile_size_px.height()));
+            const int furthest_tile_right = int(std::floor(backbuffer_rect_px.rightPx() / tile_size_px.width()));
+            const int furthest_tile_bottom = int(std::floor(backbuffer_rect_px.bottomPx() / tile_size_px.height()));
+
+            // Loop through the tiles to draw.
+            for (int i = furthest_tile_left; i <= furthest_tile_right; ++i)
+            {
+                for (int j = furthest_tile_top; j <= furthest_tile_bottom; ++j)
+                {
+                    // Look the tiles this layer draws up (unless a layer above covers them already).
+                    if (occlusion.isOccluded(i, j) == false && m_mapAdapter->isTileValid(i, j, controller_zoom))
+                    {
+                        // Keep the tile for the draw (it may be evicted by the layers below meanwhile).
+                        TileOcclusion::Tile tile;
+                        tile.url = m_mapAdapter->tileQuery(i, j, controller_zoom);
+                        (void)ImageManager::get().findImage(tile.url, m_tile_decode_options, tile.pixmap, tile.opacity);
+                        occlusion.setTile(i, j, tile);
+
+                        // Cover the tiles that are opaque.
+                        if (tile.opacity == TileOpacity::Opaque)
+                        {
+                            occlusion.occlude(i, j);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void LayerMapAdapter::drawUnoccluded(QPainter& painter, const RectWorldPx& backbuffer_rect_px, const int controller_zoom, const TileOcclusion& occlusion) const
+    {
+        // Draw the tiles that are not covered.
+        drawTiles(painter, backbuffer_rect_px, controller_zoom, &occlusion);
+    }
+
+    void LayerMapAdapter::drawTiles(QPainter& painter, const RectWorldPx& backbuffer_rect_px, const int controller_zoom, const TileOcclusion* occlusion) const
     {
         // Gain a read lock to protect the map adapter.
-        QReadLocker locker(&m_mapadapter_mutex);
+        ProfiledReadLocker locker(&m_mapadapter_mutex);
 
         // Check the layer is visible and a map adapter is set.
         if (isVisible(controller_zoom) && m_mapAdapter != nullptr)
@@ -89,24 +193,60 @@ namespace qmapcontrol
             const int furthest_tile_right = int(std::floor(backbuffer_rect_px.rightPx() / tile_size_px.width()));
             const int furthest_tile_bottom = int(std::floor(backbuffer_rect_px.bottomPx() / tile_size_px.height()));
 
+            // The tiles drawn.
+            scratch::Lease<std::vector<QUrl>> visible_tiles;
+
             // Loop through the tiles to draw (left to right).
             for (int i = furthest_tile_left; i <= furthest_tile_right; ++i)
             {
                 // Loop through the tiles to draw (top to bottom).
                 for (int j = furthest_tile_top; j <= furthest_tile_bottom; ++j)
                 {
-                    // Check the tile is valid.
-                    if (m_mapAdapter->isTileValid(i, j, controller_zoom))
+                    // Check the tile is valid (and not covered by an opaque tile of a layer above).
+                    if (m_mapAdapter->isTileValid(i, j, controller_zoom) && (occlusion == nullptr || occlusion->isOccluded(i, j) == false))
                     {
                         // Calculate the top left point.
                         const PointWorldPx top_left_px(i * tile_size_px.width(), j * tile_size_px.height());
 
-                        // Draw the tile.
-                        painter.drawPixmap(top_left_px.rawPoint(), ImageManager::get().getImage(m_mapAdapter->tileQuery(i, j, controller_zoom)));
+                        // Fetch the tile (unless it was found while the occlusion was walked).
+                        const TileOcclusion::Tile* tile = occlusion != nullptr ? occlusion->findTile(i, j) : nullptr;
+                        const QUrl url = tile != nullptr ? tile->url : m_mapAdapter->tileQuery(i, j, controller_zoom);
+                        TileOpacity opacity;
+                        QPixmap pixmap;
+                        if (tile != nullptr && tile->pixmap.isNull() == false)
+                        {
+                            pixmap = tile->pixmap;
+                            opacity = tile->opacity;
+                        }
+                        else
+                        {
+                            pixmap = ImageManager::get().getImage(url, m_tile_decode_options, opacity);
+                        }
+
+                        // Draw the tile (transparent tiles have nothing to draw).
+                        if (opacity != TileOpacity::Transparent)
+                        {
+                            if (m_tile_decode_options.isDefault())
+                            {
+                                painter.drawPixmap(top_left_px.rawPoint(), pixmap);
+                            }
+                            else
+                            {
+                                // Stretch the reduced tile to the tile size.
+                                painter.drawPixmap(QRectF(top_left_px.rawPoint(), tile_size_px), pixmap, QRectF(pixmap.rect()));
+                            }
+                        }
+                        visible_tiles->push_back(url);
                     }
                 }
             }
 
+            // Remember the tiles drawn (to prepare them when the tile decode options change).
+            {
+                ProfiledMutexLocker visible_tiles_locker(&m_visible_tiles_mutex);
+                m_visible_tiles.swap(*visible_tiles);
+            }
+
             prefetchTiles(furthest_tile_left, furthest_tile_top, furthest_tile_right, furthest_tile_bottom, controller_zoom);
         }
     }
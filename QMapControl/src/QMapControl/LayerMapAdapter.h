@@ -26,16 +26,21 @@
 #pragma once
 
 // Qt includes.
+#include <QtCore/QFutureWatcher>
 #include <QtCore/QObject>
 #include <QtCore/QReadWriteLock>
+#include <QtCore/QUrl>
 
 // STL includes.
 #include <memory>
+#include <vector>
 
 // Local includes.
 #include "qmapcontrol_global.h"
 #include "Layer.h"
 #include "MapAdapter.h"
+#include "ProfiledLock.h"
+#include "TileDecode.h"
 
 namespace qmapcontrol
 {
@@ -86,6 +91,21 @@ namespace qmapcontrol
          */
         void setMapAdapter(const std::shared_ptr<MapAdapter>& mapadapter);
 
+        /*!
+         * Fetch how the tiles are decoded.
+         * @return the tile decode options (the latest set, even if the tiles are still being prepared).
+         */
+        TileDecodeOptions getTileDecodeOptions() const;
+
+        /*!
+         * Set how the tiles are decoded, eg: at 1/2 or 1/4 size for a low-detail (overview, preview) layer,
+         * or with a colour transform for night mode. The reduced tiles are stretched to the tile size when drawn.
+         * The visible tiles are prepared with the new options in a background thread while the layer keeps
+         * drawing the current ones, then the layer is redrawn (call from the GUI thread).
+         * @param options The tile decode options.
+         */
+        void setTileDecodeOptions(const TileDecodeOptions& options);
+
         /*!
          * Handles mouse press events (such as left-clicking an item on the layer).
          * @param mouse_event The mouse event.
@@ -102,12 +122,60 @@ namespace qmapcontrol
          */
         void draw(QPainter& painter, const RectWorldPx& backbuffer_rect_px, const int controller_zoom) const final;
 
+        /*!
+         * Marks the tiles this layer covers with opaque tiles (as classified when decoded), for the layers below it to skip.
+         * The tiles found in the memory cache are kept in the occlusion for drawUnoccluded().
+         * @param backbuffer_rect_px The backbuffer rect (pixels).
+         * @param controller_zoom The current controller zoom.
+         * @param occlusion The tiles covered by the layers above, to cover this layer's opaque tiles in.
+         */
+        void occludeTiles(const RectWorldPx& backbuffer_rect_px, const int controller_zoom, TileOcclusion& occlusion) const final;
+
+        /*!
+         * Draws the map adapter, skipping the tiles covered by opaque tiles of the layers above (with the tiles kept by occludeTiles()).
+         * @param painter The painter that will draw to the pixmap.
+         * @param backbuffer_rect_px Only draw map tiles that are contained in the backbuffer rect (pixels).
+         * @param controller_zoom The current controller zoom.
+         * @param occlusion The tiles covered by the layers above.
+         */
+        void drawUnoccluded(QPainter& painter, const RectWorldPx& backbuffer_rect_px, const int controller_zoom, const TileOcclusion& occlusion) const final;
+
+    private slots:
+        /*!
+         * Draw with the tile decode options once the visible tiles are prepared.
+         */
+        void tileDecodeOptionsPrepared();
+
     private:
         /// The map adapter drawn by this layer.
         std::shared_ptr<MapAdapter> m_mapAdapter;
 
+        /// How the tiles are decoded (as drawn).
+        TileDecodeOptions m_tile_decode_options;
+
+        /// How the tiles are to be decoded (once the visible tiles are prepared).
+        TileDecodeOptions m_pending_tile_decode_options;
+
+        /// Watches the preparation of the visible tiles.
+        QFutureWatcher<void> m_tile_decode_watcher;
+
+        /// Mutex to protect the visible tiles.
+        mutable ProfiledMutex m_visible_tiles_mutex;
+
+        /// The tiles drawn by the last draw.
+        mutable std::vector<QUrl> m_visible_tiles;
+
         /// Mutex to protect map adapter.
-        mutable QReadWriteLock m_mapadapter_mutex;
+        mutable ProfiledReadWriteLock m_mapadapter_mutex;
+
+        /*!
+         * Draws the tiles (skipping the transparent ones, and the covered ones if an occlusion is given).
+         * @param painter The painter that will draw to the pixmap.
+         * @param backbuffer_rect_px Only draw map tiles that are contained in the backbuffer rect (pixels).
+         * @param controller_zoom The current controller zoom.
+         * @param occlusion The tiles covered by the layers above (nullptr to draw them all).
+         */
+        void drawTiles(QPainter& painter, const RectWorldPx& backbuffer_rect_px, const int controller_zoom, const TileOcclusion* occlusion) const;
 
         /// Issues prefetch requests for tiles around current view
         void prefetchTiles(int furthest_tile_left, int furthest_tile_top, int furthest_tile_right, int furthest_tile_bottom, int controller_zoom) const;
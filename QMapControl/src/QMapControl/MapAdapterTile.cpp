@@ -38,9 +38,11 @@ namespace qmapcontrol
                                    const bool invert_y,
                                    QObject* parent)
             : MapAdapter(base_url, epsg_projections, adapter_zoom_minimum, adapter_zoom_maximum, adapter_minimum_offset, parent),
-              m_invert_y(invert_y)
+              m_invert_y(invert_y),
+              m_url_literal_length(0)
     {
-
+        // Split the base url around its placeholders.
+        splitBaseUrl();
     }
 
     QUrl MapAdapterTile::tileQuery(const int x, const int y, const int zoom_controller) const
@@ -55,11 +57,113 @@ namespace qmapcontrol
             y_axis = projection::get().tilesY(zoom_controller - 1) - 1 - y;
         }
 
-        // Return a modified url with the %x, %y and %zoom values replaced.
-        /// @note QUrl converts % into %25, so we replace %25x, %25y and %25zoom instead.
-        return QUrl(getBaseUrl().toString()
-                    .replace("%25x", QString::number(x))
-                    .replace("%25y", QString::number(y_axis))
-                    .replace("%25zoom", QString::number(toAdapterZoom(zoom_controller))));
+        // Build the url with the %x, %y and %zoom values in place (into a reserved string, to avoid temporaries).
+        QString url;
+        url.reserve(m_url_literal_length + int(m_url_parts.size()) * 11);
+        for (const auto& part : m_url_parts)
+        {
+            // Add the literal text.
+            url.append(part.literal);
+
+            // Add the placeholder's value.
+            int value(0);
+            switch(part.placeholder)
+            {
+                case UrlPlaceholder::None:
+                {
+                    // Nothing to add.
+                    continue;
+                }
+                case UrlPlaceholder::X:
+                {
+                    value = x;
+                    break;
+                }
+                case UrlPlaceholder::Y:
+                {
+                    value = y_axis;
+                    break;
+                }
+                case UrlPlaceholder::Zoom:
+                {
+                    value = toAdapterZoom(zoom_controller);
+                    break;
+                }
+            }
+            char number[16];
+            qsnprintf(number, sizeof(number), "%d", value);
+            url.append(QLatin1String(number));
+        }
+
+        // Return the generated url.
+        return QUrl(url);
+    }
+
+    void MapAdapterTile::setBaseUrl(const QUrl& base_url)
+    {
+        // Set the base url.
+        MapAdapter::setBaseUrl(base_url);
+
+        // Split the new base url around its placeholders.
+        splitBaseUrl();
+    }
+
+    void MapAdapterTile::splitBaseUrl()
+    {
+        /// @note QUrl converts % into %25, so we search for %25x, %25y and %25zoom instead.
+        const QString base_url(getBaseUrl().toString());
+        const QString placeholder_prefix(QStringLiteral("%25"));
+
+        // Reset the parts.
+        m_url_parts.clear();
+        m_url_literal_length = 0;
+
+        // Loop through the base url.
+        QString literal;
+        int position(0);
+        while (position < base_url.size())
+        {
+            // Is there a placeholder at this position?
+            UrlPlaceholder placeholder(UrlPlaceholder::None);
+            int placeholder_length(0);
+            if (base_url.midRef(position).startsWith(placeholder_prefix))
+            {
+                const QStringRef name(base_url.midRef(position + placeholder_prefix.size()));
+                if (name.startsWith(QLatin1String("zoom")))
+                {
+                    placeholder = UrlPlaceholder::Zoom;
+                    placeholder_length = placeholder_prefix.size() + 4;
+                }
+                else if (name.startsWith(QLatin1Char('x')))
+                {
+                    placeholder = UrlPlaceholder::X;
+                    placeholder_length = placeholder_prefix.size() + 1;
+                }
+                else if (name.startsWith(QLatin1Char('y')))
+                {
+                    placeholder = UrlPlaceholder::Y;
+                    placeholder_length = placeholder_prefix.size() + 1;
+                }
+            }
+
+            if (placeholder == UrlPlaceholder::None)
+            {
+                // Literal text.
+                literal.append(base_url.at(position));
+                ++position;
+            }
+            else
+            {
+                // End the current part with the placeholder.
+                m_url_literal_length += literal.size();
+                m_url_parts.push_back({ literal, placeholder });
+                literal.clear();
+                position += placeholder_length;
+            }
+        }
+
+        // Add the remaining literal text.
+        m_url_literal_length += literal.size();
+        m_url_parts.push_back({ literal, UrlPlaceholder::None });
     }
 }
@@ -25,6 +25,12 @@
 
 #pragma once
 
+// Qt includes.
+#include <QtCore/QString>
+
+// STL includes.
+#include <vector>
+
 // Local includes.
 #include "qmapcontrol_global.h"
 #include "MapAdapter.h"
@@ -82,8 +88,49 @@ namespace qmapcontrol
          */
         virtual QUrl tileQuery(const int x, const int y, const int controller_zoom) const override;
 
+        /*!
+         * Change the base url post-initialisation.
+         * @param base_url The new base url to set.
+         */
+        void setBaseUrl(const QUrl& base_url) override;
+
+    private:
+        //! The placeholders of the base url.
+        enum class UrlPlaceholder
+        {
+            /// No placeholder (end of the url).
+            None,
+            /// The x coordinate (%x).
+            X,
+            /// The y coordinate (%y).
+            Y,
+            /// The adapter zoom (%zoom).
+            Zoom
+        };
+
+        //! A literal part of the base url, followed by a placeholder.
+        struct UrlPart
+        {
+            /// The literal text.
+            QString literal;
+
+            /// The placeholder that follows the literal text.
+            UrlPlaceholder placeholder;
+        };
+
+        /*!
+         * Splits the base url around its placeholders, so that tile urls are built without searching/replacing.
+         */
+        void splitBaseUrl();
+
     private:
         /// Whether the y-axis tile needs to be inverted (ie: y-axis tiles start at bottom-left, instead of top-left).
         const bool m_invert_y;
+
+        /// The base url split around its placeholders.
+        std::vector<UrlPart> m_url_parts;
+
+        /// The length of the literal parts of the base url.
+        int m_url_literal_length;
     };
 }
@@ -0,0 +1,361 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "MemoryPressure.h"
+
+// Qt includes.
+#include <QFile>
+#include <QStringList>
+
+// STL includes.
+#include <algorithm>
+
+// Local includes.
+#include "ImageManager.h"
+#include "QMapControl.h"
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+namespace qmapcontrol
+{
+    namespace
+    {
+        /// Default interval between checks.
+        const std::chrono::milliseconds kDefaultCheckInterval(1000);
+
+        /// Default PSI "some avg10" threshold percentage.
+        const double kDefaultPsiThresholdPct = 10.0;
+
+        /// Number of consecutive relaxed checks before a step is undone.
+        const int kRelaxedChecks = 3;
+
+        /// Split behaviour that drops the empty parts (QString::SkipEmptyParts is deprecated since Qt 5.14).
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        const Qt::SplitBehavior kSkipEmptyParts = Qt::SkipEmptyParts;
+#else
+        const QString::SplitBehavior kSkipEmptyParts = QString::SkipEmptyParts;
+#endif
+
+        /// Read a small (procfs/sysfs) text file.
+        QString readText(const QString& file_path)
+        {
+            QFile file(file_path);
+            if (file.open(QIODevice::ReadOnly | QIODevice::Text) == false)
+            {
+                return QString();
+            }
+            return QString::fromLatin1(file.readAll());
+        }
+
+#ifdef Q_OS_LINUX
+        /// Find the cgroup v2 directory of the process (empty if unavailable).
+        QString cgroupDirectory()
+        {
+            // The unified hierarchy entry is "0::/path".
+            for (const auto& line : readText("/proc/self/cgroup").split('\n', kSkipEmptyParts))
+            {
+                if (line.startsWith("0::"))
+                {
+                    const QString directory = "/sys/fs/cgroup" + line.mid(3).trimmed();
+                    return QFile::exists(directory + "/memory.events") ? directory : QString();
+                }
+            }
+            return QString();
+        }
+#endif
+    }
+
+    MemoryPressureController::MemoryPressureController(QMapControl* map_control, QObject* parent)
+        : QObject(parent),
+          m_map_control(map_control),
+          m_rss_budget_bytes(0),
+          m_psi_threshold_pct(kDefaultPsiThresholdPct),
+          m_level(MemoryPressureLevel::None),
+          m_degradation(0),
+          m_relaxed_checks(0),
+          m_cgroup_events(sample().cgroup_events),
+          m_memory_cache_capacity_mib(0),
+          m_scaled_background_enabled(false)
+    {
+        // Connect signal/slot for the periodic checks.
+        m_check_timer.setInterval(int(kDefaultCheckInterval.count()));
+        connect(&m_check_timer, &QTimer::timeout, this, &MemoryPressureController::check);
+    }
+
+    MemoryPressureController::~MemoryPressureController()
+    {
+        // Stop the periodic checks.
+        stop();
+    }
+
+    void MemoryPressureController::setRssBudget(const std::size_t budget_bytes)
+    {
+        // Set the RSS budget.
+        m_rss_budget_bytes = budget_bytes;
+    }
+
+    void MemoryPressureController::setPsiThreshold(const double some_avg10_pct)
+    {
+        // Set the PSI threshold.
+        m_psi_threshold_pct = some_avg10_pct;
+    }
+
+    void MemoryPressureController::setCheckInterval(const std::chrono::milliseconds& interval)
+    {
+        // Set the timer interval (restarts the timer if active).
+        m_check_timer.setInterval(int(interval.count()));
+    }
+
+    void MemoryPressureController::start()
+    {
+        // Start the periodic checks.
+        m_check_timer.start();
+    }
+
+    void MemoryPressureController::stop()
+    {
+        // Stop the periodic checks.
+        m_check_timer.stop();
+    }
+
+    bool MemoryPressureController::isRunning() const
+    {
+        // Return whether the periodic checks are running.
+        return m_check_timer.isActive();
+    }
+
+    void MemoryPressureController::restore()
+    {
+        // Undo the steps, last applied first.
+        const bool changed = m_degradation > 0;
+        while (m_degradation > 0)
+        {
+            applyStep(m_degradation--, false);
+        }
+        m_relaxed_checks = 0;
+
+        // Inform about the change.
+        if (changed)
+        {
+            emit degradationChanged(m_level, m_degradation);
+        }
+    }
+
+    MemoryPressureLevel MemoryPressureController::level() const
+    {
+        // Return the pressure level.
+        return m_level;
+    }
+
+    int MemoryPressureController::degradation() const
+    {
+        // Return the number of steps applied.
+        return m_degradation;
+    }
+
+    MemoryPressureSample MemoryPressureController::sample()
+    {
+        MemoryPressureSample sample;
+
+#ifdef Q_OS_LINUX
+        // The resident set size is the second field of statm (in pages).
+        const QStringList statm = readText("/proc/self/statm").split(' ', kSkipEmptyParts);
+        if (statm.size() >= 2)
+        {
+            sample.rss_bytes = std::size_t(statm.at(1).toULongLong()) * std::size_t(sysconf(_SC_PAGESIZE));
+        }
+
+        // The PSI line is "some avg10=X avg60=Y avg300=Z total=T".
+        for (const auto& line : readText("/proc/pressure/memory").split('\n', kSkipEmptyParts))
+        {
+            if (line.startsWith("some "))
+            {
+                for (const auto& field : line.split(' ', kSkipEmptyParts))
+                {
+                    if (field.startsWith("avg10="))
+                    {
+                        sample.psi_some_avg10 = field.mid(6).toDouble();
+                    }
+                }
+            }
+        }
+
+        // The cgroup (v2) memory events, usage and limit.
+        static const QString cgroup_directory = cgroupDirectory();
+        if (cgroup_directory.isEmpty() == false)
+        {
+            for (const auto& line : readText(cgroup_directory + "/memory.events").split('\n', kSkipEmptyParts))
+            {
+                const QStringList fields = line.split(' ', kSkipEmptyParts);
+                if (fields.size() == 2 && (fields.at(0) == "high" || fields.at(0) == "max" || fields.at(0) == "oom"))
+                {
+                    sample.cgroup_events += fields.at(1).toULongLong();
+                }
+            }
+            sample.cgroup_current_bytes = std::size_t(readText(cgroup_directory + "/memory.current").trimmed().toULongLong());
+            sample.cgroup_max_bytes = std::size_t(readText(cgroup_directory + "/memory.max").trimmed().toULongLong());
+        }
+#endif
+
+        // Return the sample.
+        return sample;
+    }
+
+    void MemoryPressureController::check()
+    {
+        // Sample and classify the memory state.
+        const MemoryPressureSample current = sample();
+        const MemoryPressureLevel level = classify(current);
+        const bool relaxed = isRelaxed(current);
+        m_cgroup_events = current.cgroup_events;
+        m_level = level;
+
+        const int previous_degradation = m_degradation;
+        if (level == MemoryPressureLevel::Critical)
+        {
+            // Apply all the remaining steps.
+            while (m_degradation < kSteps)
+            {
+                applyStep(++m_degradation, true);
+            }
+            m_relaxed_checks = 0;
+        }
+        else if (level == MemoryPressureLevel::Moderate)
+        {
+            // Apply the next step.
+            if (m_degradation < kSteps)
+            {
+                applyStep(++m_degradation, true);
+            }
+            m_relaxed_checks = 0;
+        }
+        else if (relaxed == false)
+        {
+            // Within budget, but not comfortably: hold.
+            m_relaxed_checks = 0;
+        }
+        else if (m_degradation > 0 && ++m_relaxed_checks >= kRelaxedChecks)
+        {
+            // Undo the last step applied.
+            applyStep(m_degradation--, false);
+            m_relaxed_checks = 0;
+        }
+
+        // Inform about the change.
+        if (m_degradation != previous_degradation)
+        {
+            emit degradationChanged(m_level, m_degradation);
+        }
+    }
+
+    MemoryPressureLevel MemoryPressureController::classify(const MemoryPressureSample& sample) const
+    {
+        // New cgroup events mean the kernel is already reclaiming (or killing) in our cgroup.
+        if (sample.cgroup_events > m_cgroup_events)
+        {
+            return MemoryPressureLevel::Critical;
+        }
+
+        // Far above the RSS budget, the PSI threshold or close to the cgroup limit.
+        if ((m_rss_budget_bytes > 0 && sample.rss_bytes > m_rss_budget_bytes + m_rss_budget_bytes / 4)
+                || (sample.psi_some_avg10 >= 2.0 * m_psi_threshold_pct)
+                || (sample.cgroup_max_bytes > 0 && sample.cgroup_current_bytes > sample.cgroup_max_bytes / 20 * 19))
+        {
+            return MemoryPressureLevel::Critical;
+        }
+
+        // Above the RSS budget, the PSI threshold or nearing the cgroup limit.
+        if ((m_rss_budget_bytes > 0 && sample.rss_bytes > m_rss_budget_bytes)
+                || (sample.psi_some_avg10 >= m_psi_threshold_pct)
+                || (sample.cgroup_max_bytes > 0 && sample.cgroup_current_bytes > sample.cgroup_max_bytes / 20 * 17))
+        {
+            return MemoryPressureLevel::Moderate;
+        }
+
+        // Within budget.
+        return MemoryPressureLevel::None;
+    }
+
+    bool MemoryPressureController::isRelaxed(const MemoryPressureSample& sample) const
+    {
+        // Comfortably below every threshold (hysteresis, so steps are not undone and reapplied in a loop).
+        return sample.cgroup_events == m_cgroup_events
+                && (m_rss_budget_bytes == 0 || sample.rss_bytes < m_rss_budget_bytes / 5 * 4)
+                && (sample.psi_some_avg10 < m_psi_threshold_pct / 2.0)
+                && (sample.cgroup_max_bytes == 0 || sample.cgroup_current_bytes < sample.cgroup_max_bytes / 10 * 7);
+    }
+
+    void MemoryPressureController::applyStep(const int step, const bool apply)
+    {
+        switch(step)
+        {
+            case 1:
+            {
+                // Halve the memory cache capacity.
+                if (apply)
+                {
+                    m_memory_cache_capacity_mib = ImageManager::get().memoryCacheCapacity();
+                    ImageManager::get().setMemoryCacheCapacity(std::max(1, m_memory_cache_capacity_mib / 2));
+                }
+                else
+                {
+                    ImageManager::get().setMemoryCacheCapacity(m_memory_cache_capacity_mib);
+                }
+                break;
+            }
+            case 2:
+            {
+                // Disable tile prefetching and warming (releases the pinned tiles).
+                ImageManager::get().setPrefetchEnabled(apply == false);
+                break;
+            }
+            case 3:
+            {
+                // Release the scaled background screen.
+                if (m_map_control != nullptr)
+                {
+                    if (apply)
+                    {
+                        m_scaled_background_enabled = m_map_control->isScaledBackgroundEnabled();
+                        m_map_control->enableScaledBackground(false);
+                    }
+                    else if (m_scaled_background_enabled)
+                    {
+                        m_map_control->enableScaledBackground(true);
+                    }
+                }
+                break;
+            }
+            case 4:
+            {
+                // Reduce the memory cache capacity to an eighth (from half).
+                ImageManager::get().setMemoryCacheCapacity(std::max(1, apply ? m_memory_cache_capacity_mib / 8 : m_memory_cache_capacity_mib / 2));
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,236 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// Qt includes.
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QTimer>
+
+// STL includes.
+#include <chrono>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+
+namespace qmapcontrol
+{
+    //! Forward declaration.
+    class QMapControl;
+
+    //! The memory pressure seen by the MemoryPressureController.
+    enum class MemoryPressureLevel
+    {
+        /// Within budget.
+        None,
+        /// Above budget: degrade one step per check.
+        Moderate,
+        /// Far above budget or the kernel is reclaiming/out of memory: degrade all steps at once.
+        Critical
+    };
+
+    //! A sample of the process and system memory state (Linux only, other platforms report unknown).
+    struct QMAPCONTROL_EXPORT MemoryPressureSample
+    {
+        /// The process resident set size in bytes (0 if unknown).
+        std::size_t rss_bytes = 0;
+
+        /// Percentage of time some tasks stalled on memory over the last 10 s, from PSI (-1 if unavailable).
+        double psi_some_avg10 = -1.0;
+
+        /// Number of cgroup "high", "max" and "oom" memory events so far (0 if unavailable).
+        quint64 cgroup_events = 0;
+
+        /// The cgroup memory usage in bytes (0 if unavailable).
+        std::size_t cgroup_current_bytes = 0;
+
+        /// The cgroup memory limit in bytes (0 if unavailable or unlimited).
+        std::size_t cgroup_max_bytes = 0;
+    };
+
+    //! Degrades the caches and buffers under memory pressure, and restores them once it subsides.
+    /*!
+     * The controller periodically samples the process RSS against a budget, Linux PSI and the cgroup
+     * memory events/limit. Under pressure it applies the degradation steps in priority order:
+     *  1. halve the Image Manager's memory cache capacity.
+     *  2. disable tile prefetching and warming (releasing the pinned tiles).
+     *  3. release the map control's scaled background screen.
+     *  4. reduce the memory cache capacity to an eighth.
+     * When the pressure has subsided for a few checks, the steps are undone one at a time.
+     *
+     * The controller must be created in the GUI thread and is stopped until start() is called.
+     */
+    class QMAPCONTROL_EXPORT MemoryPressureController : public QObject
+    {
+        Q_OBJECT
+    public:
+        /// Number of degradation steps.
+        static const int kSteps = 4;
+
+    public:
+        //! Constructor.
+        /*!
+         * This constructs a stopped memory pressure controller.
+         * @param map_control The map control whose scaled background may be released (optional).
+         * @param parent QObject parent ownership.
+         */
+        explicit MemoryPressureController(QMapControl* map_control = nullptr, QObject* parent = nullptr);
+
+        //! Disable copy constructor.
+        MemoryPressureController(const MemoryPressureController&) = delete;
+
+        //! Disable copy assignment.
+        MemoryPressureController& operator=(const MemoryPressureController&) = delete;
+
+        //! Destructor (stops the periodic checks, degradation steps already applied are kept).
+        ~MemoryPressureController();
+
+        /*!
+         * Set the process RSS budget.
+         * @param budget_bytes The budget in bytes (0 to only rely on PSI and cgroup events).
+         */
+        void setRssBudget(const std::size_t budget_bytes);
+
+        /*!
+         * Set the PSI threshold (Linux only).
+         * @param some_avg10_pct The "some avg10" percentage considered pressure (default: 10).
+         */
+        void setPsiThreshold(const double some_avg10_pct);
+
+        /*!
+         * Set how often the memory is sampled (default: 1 second).
+         * @param interval The interval between checks.
+         */
+        void setCheckInterval(const std::chrono::milliseconds& interval);
+
+        /*!
+         * Start the periodic checks.
+         */
+        void start();
+
+        /*!
+         * Stop the periodic checks (degradation steps already applied are kept).
+         */
+        void stop();
+
+        /*!
+         * Whether the periodic checks are running.
+         * @return whether the controller is running.
+         */
+        bool isRunning() const;
+
+        /*!
+         * Undo all degradation steps applied.
+         */
+        void restore();
+
+        /*!
+         * Fetch the pressure seen by the last check.
+         * @return the pressure level.
+         */
+        MemoryPressureLevel level() const;
+
+        /*!
+         * Fetch the number of degradation steps applied.
+         * @return the number of steps applied (0 to kSteps).
+         */
+        int degradation() const;
+
+        /*!
+         * Sample the process and system memory state.
+         * @return the sample.
+         */
+        static MemoryPressureSample sample();
+
+    public slots:
+        /*!
+         * Check the memory pressure now and degrade/restore as required (also called periodically).
+         */
+        void check();
+
+    signals:
+        /*!
+         * Signal emitted when the degradation changes.
+         * @param level The pressure level.
+         * @param degradation The number of degradation steps applied.
+         */
+        void degradationChanged(const MemoryPressureLevel level, const int degradation);
+
+    private:
+        /*!
+         * Classify a sample.
+         * @param sample The sample.
+         * @return the pressure level.
+         */
+        MemoryPressureLevel classify(const MemoryPressureSample& sample) const;
+
+        /*!
+         * Whether a sample is comfortably within budget (to restore a step).
+         * @param sample The sample.
+         * @return whether the pressure has subsided.
+         */
+        bool isRelaxed(const MemoryPressureSample& sample) const;
+
+        /*!
+         * Apply or undo a degradation step.
+         * @param step The step (1 to kSteps).
+         * @param apply Whether to apply (or undo) the step.
+         */
+        void applyStep(const int step, const bool apply);
+
+    private:
+        /// The map control whose scaled background may be released.
+        QPointer<QMapControl> m_map_control;
+
+        /// The process RSS budget in bytes (0 for none).
+        std::size_t m_rss_budget_bytes;
+
+        /// The PSI "some avg10" threshold percentage.
+        double m_psi_threshold_pct;
+
+        /// The timer for the periodic checks.
+        QTimer m_check_timer;
+
+        /// The pressure seen by the last check.
+        MemoryPressureLevel m_level;
+
+        /// The number of degradation steps applied.
+        int m_degradation;
+
+        /// Number of consecutive relaxed checks.
+        int m_relaxed_checks;
+
+        /// The cgroup memory events seen by the last check.
+        quint64 m_cgroup_events;
+
+        /// The memory cache capacity before the first step was applied (MiB).
+        int m_memory_cache_capacity_mib;
+
+        /// Whether the scaled background was enabled before it was released.
+        bool m_scaled_background_enabled;
+    };
+}
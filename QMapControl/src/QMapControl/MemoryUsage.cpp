@@ -0,0 +1,132 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "MemoryUsage.h"
+
+namespace qmapcontrol
+{
+    std::size_t MemoryUsage::total() const
+    {
+        // Return the sum of all parts.
+        return payload_bytes + index_bytes + attribute_bytes;
+    }
+
+    MemoryUsage& MemoryUsage::operator+=(const MemoryUsage& other)
+    {
+        // Add each part.
+        payload_bytes += other.payload_bytes;
+        index_bytes += other.index_bytes;
+        attribute_bytes += other.attribute_bytes;
+
+        // Return this memory usage.
+        return *this;
+    }
+
+    MemoryUsage& MemoryUsage::operator-=(const MemoryUsage& other)
+    {
+        // Subtract each part.
+        payload_bytes -= other.payload_bytes;
+        index_bytes -= other.index_bytes;
+        attribute_bytes -= other.attribute_bytes;
+
+        // Return this memory usage.
+        return *this;
+    }
+
+    std::size_t TileCacheUsage::total() const
+    {
+        // Return the memory tiers (the disk cache is not memory).
+        return memory_cache_bytes + placeholder_bytes + pinned_bytes;
+    }
+
+    std::size_t MemoryReport::layersTotal() const
+    {
+        // Sum the layers.
+        std::size_t total(0);
+        for (const auto& layer : layers)
+        {
+            total += layer.second.total();
+        }
+
+        // Return the total.
+        return total;
+    }
+
+    std::size_t MemoryReport::buffersTotal() const
+    {
+        // Return the sum of the buffers.
+        return primary_screen_bytes + scaled_screen_bytes + backbuffer_bytes;
+    }
+
+    std::size_t MemoryReport::total() const
+    {
+        // Return the sum of all parts.
+        return layersTotal() + tiles.total() + buffersTotal();
+    }
+
+    namespace memory
+    {
+        std::size_t pixmapBytes(const QPixmap& pixmap)
+        {
+            // Return the pixel data size.
+            return pixmap.isNull() ? 0 : std::size_t(pixmap.width()) * std::size_t(pixmap.height()) * std::size_t(pixmap.depth()) / 8;
+        }
+
+        std::size_t stringBytes(const std::string& string)
+        {
+            // Short strings are stored inline (small string optimisation).
+            return string.capacity() < sizeof(std::string) ? 0 : string.capacity() + 1;
+        }
+
+        std::size_t metadataBytes(const std::map<std::string, QVariant>& metadata)
+        {
+            // Estimate the map nodes (key, value and tree links).
+            std::size_t bytes = metadata.size() * (sizeof(std::pair<const std::string, QVariant>) + 4 * sizeof(void*));
+
+            // Add the keys and values.
+            for (const auto& entry : metadata)
+            {
+                bytes += stringBytes(entry.first);
+                switch (entry.second.type())
+                {
+                    case QVariant::String:
+                        bytes += std::size_t(entry.second.toString().capacity()) * sizeof(QChar);
+                        break;
+                    case QVariant::ByteArray:
+                        bytes += std::size_t(entry.second.toByteArray().capacity());
+                        break;
+                    case QVariant::Pixmap:
+                        bytes += pixmapBytes(entry.second.value<QPixmap>());
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            // Return the estimate.
+            return bytes;
+        }
+    }
+}
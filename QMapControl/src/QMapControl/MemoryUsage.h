@@ -0,0 +1,201 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// Qt includes.
+#include <QPixmap>
+#include <QVariant>
+
+// STL includes.
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+
+/*!
+ * Memory accounting of layers, tile caches and buffers (see QMapControl::memoryReport()).
+ *
+ * The values are estimates of the heap memory owned by each object (container capacities, pixel
+ * data, object sizes), not allocator-exact figures. Resources shared between several owners (eg:
+ * a pen or an image used by many geometries) are split evenly between them.
+ */
+namespace qmapcontrol
+{
+    //! Memory used by a layer (or a geometry), in bytes.
+    struct QMAPCONTROL_EXPORT MemoryUsage
+    {
+        /// Geometry payload (objects, points, images).
+        std::size_t payload_bytes = 0;
+
+        /// Spatial index (quad tree nodes and entries).
+        std::size_t index_bytes = 0;
+
+        /// Attributes (pens, brushes, meta-data, names).
+        std::size_t attribute_bytes = 0;
+
+        /*!
+         * Fetch the total memory used.
+         * @return the total in bytes.
+         */
+        std::size_t total() const;
+
+        /*!
+         * Add another memory usage to this one.
+         * @param other The memory usage to add.
+         * @return this memory usage.
+         */
+        MemoryUsage& operator+=(const MemoryUsage& other);
+
+        /*!
+         * Subtract another memory usage (previously added) from this one.
+         * @param other The memory usage to subtract.
+         * @return this memory usage.
+         */
+        MemoryUsage& operator-=(const MemoryUsage& other);
+    };
+
+    //! Memory used by the ImageManager tiers, in bytes.
+    struct QMAPCONTROL_EXPORT TileCacheUsage
+    {
+        /// Decoded tiles in the memory cache.
+        std::size_t memory_cache_bytes = 0;
+
+        /// Capacity of the memory cache.
+        std::size_t memory_cache_capacity_bytes = 0;
+
+        /// Number of tiles in the memory cache.
+        std::size_t memory_cache_tiles = 0;
+
+        /// Placeholder (loading/empty) pixmaps.
+        std::size_t placeholder_bytes = 0;
+
+        /// Pinned tiles kept aside after their eviction from the memory cache (counted against its capacity).
+        std::size_t pinned_bytes = 0;
+
+        /// Tile files in the disk cache (disk space, not included in the memory totals).
+        std::size_t disk_cache_bytes = 0;
+
+        /*!
+         * Fetch the total memory used (excluding the disk cache).
+         * @return the total in bytes.
+         */
+        std::size_t total() const;
+    };
+
+    //! Memory used by a QMapControl and its layers, and by the shared ImageManager.
+    struct QMAPCONTROL_EXPORT MemoryReport
+    {
+        /// Memory used by each layer (in draw order).
+        std::vector<std::pair<std::string, MemoryUsage>> layers;
+
+        /// Memory used by the ImageManager tiers.
+        TileCacheUsage tiles;
+
+        /// Primary screen pixmap.
+        std::size_t primary_screen_bytes = 0;
+
+        /// Primary screen scaled pixmap (zoom in/out).
+        std::size_t scaled_screen_bytes = 0;
+
+        /// Backbuffer pixmap (allocated while a redraw is in progress, same size as the primary screen).
+        std::size_t backbuffer_bytes = 0;
+
+        /*!
+         * Fetch the memory used by all layers.
+         * @return the total in bytes.
+         */
+        std::size_t layersTotal() const;
+
+        /*!
+         * Fetch the memory used by the screen buffers.
+         * @return the total in bytes.
+         */
+        std::size_t buffersTotal() const;
+
+        /*!
+         * Fetch the total memory used (layers, tile memory cache and buffers).
+         * @return the total in bytes.
+         */
+        std::size_t total() const;
+    };
+
+    //! Scopes of the memory budgets (see QMapControl::setMemoryBudget()).
+    enum class MemoryBudgetScope
+    {
+        /// Everything in the memory report.
+        Total,
+        /// All layers.
+        Layers,
+        /// A single layer (by name).
+        Layer,
+        /// The ImageManager memory tiers.
+        TileCache,
+        /// The screen buffers.
+        Buffers
+    };
+
+    namespace memory
+    {
+        /*!
+         * Estimate the pixel data of a pixmap.
+         * @param pixmap The pixmap.
+         * @return the size in bytes.
+         */
+        QMAPCONTROL_EXPORT std::size_t pixmapBytes(const QPixmap& pixmap);
+
+        /*!
+         * Estimate the heap memory of a string.
+         * @param string The string.
+         * @return the size in bytes.
+         */
+        QMAPCONTROL_EXPORT std::size_t stringBytes(const std::string& string);
+
+        /*!
+         * Estimate the heap memory of a meta-data container.
+         * @param metadata The meta-data container.
+         * @return the size in bytes.
+         */
+        QMAPCONTROL_EXPORT std::size_t metadataBytes(const std::map<std::string, QVariant>& metadata);
+
+        /*!
+         * Estimate the share of a shared resource (split evenly between its owners).
+         * @param resource The shared resource.
+         * @param resource_bytes The size of the resource.
+         * @return the share in bytes.
+         */
+        template<typename T>
+        std::size_t sharedBytes(const std::shared_ptr<T>& resource, const std::size_t resource_bytes)
+        {
+            return resource == nullptr ? 0 : resource_bytes / std::size_t(std::max(1L, resource.use_count()));
+        }
+    }
+}
@@ -0,0 +1,251 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "Metrics.h"
+
+// STL includes.
+#include <algorithm>
+#include <cmath>
+
+namespace qmapcontrol
+{
+    namespace
+    {
+        /// Fetch the bucket of a value (the number of significant bits, capped at the last bucket).
+        int bucketOf(quint64 value)
+        {
+            int bucket = 0;
+            while (value != 0 && bucket < kHistogramBuckets - 1)
+            {
+                value >>= 1;
+                ++bucket;
+            }
+            return bucket;
+        }
+
+        /// Calculate a ratio (0 if the total is 0).
+        double ratio(const quint64 part, const quint64 total)
+        {
+            return total == 0 ? 0.0 : double(part) / double(total);
+        }
+    }
+
+    HistogramSnapshot::HistogramSnapshot()
+    {
+        // Clear the buckets.
+        buckets.fill(0);
+    }
+
+    double HistogramSnapshot::mean() const
+    {
+        // Return the mean value.
+        return count == 0 ? 0.0 : double(sum) / double(count);
+    }
+
+    quint64 HistogramSnapshot::percentile(const double percentile) const
+    {
+        // Calculate the rank of the value we are looking for.
+        const quint64 rank = quint64(std::ceil(double(count) * std::min(100.0, std::max(0.0, percentile)) / 100.0));
+
+        // Find the bucket containing the rank.
+        quint64 seen = 0;
+        for (int i = 0; i < kHistogramBuckets; ++i)
+        {
+            seen += buckets[std::size_t(i)];
+            if (seen >= rank && seen > 0)
+            {
+                // Return the upper bound of the bucket (values in bucket i are below 2^i).
+                const quint64 upper = i == 0 ? 0 : (quint64(1) << i) - 1;
+                return std::min(upper, max);
+            }
+        }
+
+        // Empty histogram.
+        return 0;
+    }
+
+    Histogram::Histogram()
+    {
+        // Ensure all counters start at 0.
+        reset();
+    }
+
+    void Histogram::record(const quint64 value)
+    {
+        // Update the totals.
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(value, std::memory_order_relaxed);
+        m_buckets[std::size_t(bucketOf(value))].fetch_add(1, std::memory_order_relaxed);
+
+        // Update the max value.
+        quint64 max = m_max.load(std::memory_order_relaxed);
+        while (value > max && m_max.compare_exchange_weak(max, value, std::memory_order_relaxed) == false)
+        {
+            // Retry with the latest max value.
+        }
+    }
+
+    void Histogram::reset()
+    {
+        // Clear the totals and buckets.
+        m_count.store(0, std::memory_order_relaxed);
+        m_sum.store(0, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+        for (auto& bucket : m_buckets)
+        {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    HistogramSnapshot Histogram::snapshot() const
+    {
+        // Copy the totals and buckets (each counter is read atomically, not the whole histogram).
+        HistogramSnapshot snapshot;
+        snapshot.count = m_count.load(std::memory_order_relaxed);
+        snapshot.sum = m_sum.load(std::memory_order_relaxed);
+        snapshot.max = m_max.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < m_buckets.size(); ++i)
+        {
+            snapshot.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+        }
+
+        // Return the snapshot.
+        return snapshot;
+    }
+
+    double TileMetrics::memoryCacheHitRatio() const
+    {
+        // Return the ratio of lookups found in the memory cache.
+        return ratio(memory_cache_hits, memory_cache_hits + memory_cache_misses);
+    }
+
+    double TileMetrics::diskCacheHitRatio() const
+    {
+        // Return the ratio of lookups found in the disk cache.
+        return ratio(disk_cache_hits, disk_cache_hits + disk_cache_misses);
+    }
+
+    double TileMetrics::prefetchUsefulness() const
+    {
+        // Return the ratio of prefetched tiles that were displayed.
+        return ratio(prefetch_used, prefetch_requests);
+    }
+
+    double TileMetrics::warmUsefulness() const
+    {
+        // Return the ratio of warmed tiles that were displayed.
+        return ratio(warm_used, warm_requests);
+    }
+
+    TileMetricsRecorder::TileMetricsRecorder()
+    {
+        // Ensure all counters start at 0.
+        reset();
+    }
+
+    void TileMetricsRecorder::recordRequestLatency(const QString& host, const quint64 latency_us)
+    {
+        // Record the overall latency.
+        request_latency_us.record(latency_us);
+
+        // Record the host latency.
+        QMutexLocker locker(&m_hosts_mutex);
+        std::unique_ptr<Histogram>& histogram = m_request_latency_us_per_host[host];
+        if (histogram == nullptr)
+        {
+            histogram.reset(new Histogram);
+        }
+        histogram->record(latency_us);
+    }
+
+    void TileMetricsRecorder::reset()
+    {
+        // Clear the counters.
+        memory_cache_hits.store(0, std::memory_order_relaxed);
+        memory_cache_misses.store(0, std::memory_order_relaxed);
+        memory_cache_evictions.store(0, std::memory_order_relaxed);
+        disk_cache_hits.store(0, std::memory_order_relaxed);
+        disk_cache_misses.store(0, std::memory_order_relaxed);
+        shared_cache_hits.store(0, std::memory_order_relaxed);
+        shared_cache_misses.store(0, std::memory_order_relaxed);
+        shared_cache_waits.store(0, std::memory_order_relaxed);
+        provider_hits.store(0, std::memory_order_relaxed);
+        provider_misses.store(0, std::memory_order_relaxed);
+        network_requests.store(0, std::memory_order_relaxed);
+        network_cache_replies.store(0, std::memory_order_relaxed);
+        network_failures.store(0, std::memory_order_relaxed);
+        network_retries.store(0, std::memory_order_relaxed);
+        network_cancellations.store(0, std::memory_order_relaxed);
+        network_bytes.store(0, std::memory_order_relaxed);
+        prefetch_requests.store(0, std::memory_order_relaxed);
+        prefetch_used.store(0, std::memory_order_relaxed);
+        warm_requests.store(0, std::memory_order_relaxed);
+        warm_used.store(0, std::memory_order_relaxed);
+
+        // Clear the histograms.
+        decode_time_us.reset();
+        request_latency_us.reset();
+        QMutexLocker locker(&m_hosts_mutex);
+        m_request_latency_us_per_host.clear();
+    }
+
+    TileMetrics TileMetricsRecorder::snapshot() const
+    {
+        // Copy the counters.
+        TileMetrics metrics;
+        metrics.memory_cache_hits = memory_cache_hits.load(std::memory_order_relaxed);
+        metrics.memory_cache_misses = memory_cache_misses.load(std::memory_order_relaxed);
+        metrics.memory_cache_evictions = memory_cache_evictions.load(std::memory_order_relaxed);
+        metrics.disk_cache_hits = disk_cache_hits.load(std::memory_order_relaxed);
+        metrics.disk_cache_misses = disk_cache_misses.load(std::memory_order_relaxed);
+        metrics.shared_cache_hits = shared_cache_hits.load(std::memory_order_relaxed);
+        metrics.shared_cache_misses = shared_cache_misses.load(std::memory_order_relaxed);
+        metrics.shared_cache_waits = shared_cache_waits.load(std::memory_order_relaxed);
+        metrics.provider_hits = provider_hits.load(std::memory_order_relaxed);
+        metrics.provider_misses = provider_misses.load(std::memory_order_relaxed);
+        metrics.network_requests = network_requests.load(std::memory_order_relaxed);
+        metrics.network_cache_replies = network_cache_replies.load(std::memory_order_relaxed);
+        metrics.network_failures = network_failures.load(std::memory_order_relaxed);
+        metrics.network_retries = network_retries.load(std::memory_order_relaxed);
+        metrics.network_cancellations = network_cancellations.load(std::memory_order_relaxed);
+        metrics.network_bytes = network_bytes.load(std::memory_order_relaxed);
+        metrics.prefetch_requests = prefetch_requests.load(std::memory_order_relaxed);
+        metrics.prefetch_used = prefetch_used.load(std::memory_order_relaxed);
+        metrics.warm_requests = warm_requests.load(std::memory_order_relaxed);
+        metrics.warm_used = warm_used.load(std::memory_order_relaxed);
+
+        // Copy the histograms.
+        metrics.decode_time_us = decode_time_us.snapshot();
+        metrics.request_latency_us = request_latency_us.snapshot();
+        QMutexLocker locker(&m_hosts_mutex);
+        for (const auto& host : m_request_latency_us_per_host)
+        {
+            metrics.request_latency_us_per_host[host.first] = host.second->snapshot();
+        }
+
+        // Return the snapshot.
+        return metrics;
+    }
+}
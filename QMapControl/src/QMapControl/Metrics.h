@@ -0,0 +1,351 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// Qt includes.
+#include <QMutex>
+#include <QString>
+
+// STL includes.
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+
+/*!
+ * Tile pipeline metrics: lock-free counters and log2 histograms, cheap enough to be always on.
+ */
+namespace qmapcontrol
+{
+    //! Number of buckets of a histogram (bucket i counts values in [2^(i-1), 2^i), bucket 0 counts 0).
+    constexpr int kHistogramBuckets = 40;
+
+    //! A point in time copy of a histogram.
+    struct QMAPCONTROL_EXPORT HistogramSnapshot
+    {
+        /// Number of values recorded.
+        quint64 count = 0;
+
+        /// Sum of the values recorded.
+        quint64 sum = 0;
+
+        /// Largest value recorded.
+        quint64 max = 0;
+
+        /// Number of values per bucket.
+        std::array<quint64, kHistogramBuckets> buckets;
+
+        //! Constructor.
+        HistogramSnapshot();
+
+        /*!
+         * Fetch the mean value.
+         * @return the mean value (0 if empty).
+         */
+        double mean() const;
+
+        /*!
+         * Estimate a percentile (the upper bound of the bucket the percentile falls in, capped at max).
+         * @param percentile The percentile (0 to 100).
+         * @return the estimated value.
+         */
+        quint64 percentile(const double percentile) const;
+    };
+
+    //! Lock-free histogram of positive values with power of 2 buckets.
+    class QMAPCONTROL_EXPORT Histogram
+    {
+    public:
+        //! Constructor.
+        Histogram();
+
+        //! Disable copy constructor.
+        Histogram(const Histogram&) = delete;
+
+        //! Disable copy assignment.
+        Histogram& operator=(const Histogram&) = delete;
+
+        /*!
+         * Record a value.
+         * @param value The value.
+         */
+        void record(const quint64 value);
+
+        /*!
+         * Reset all buckets.
+         */
+        void reset();
+
+        /*!
+         * Fetch a copy of the histogram.
+         * @return the histogram snapshot.
+         */
+        HistogramSnapshot snapshot() const;
+
+    private:
+        /// Number of values recorded.
+        std::atomic<quint64> m_count;
+
+        /// Sum of the values recorded.
+        std::atomic<quint64> m_sum;
+
+        /// Largest value recorded.
+        std::atomic<quint64> m_max;
+
+        /// Number of values per bucket.
+        std::array<std::atomic<quint64>, kHistogramBuckets> m_buckets;
+    };
+
+    //! A point in time copy of the contention of a lock (see ProfiledLock.h).
+    struct QMAPCONTROL_EXPORT LockMetrics
+    {
+        /// The lock name.
+        QString name;
+
+        /// Number of acquisitions.
+        quint64 acquisitions = 0;
+
+        /// Number of acquisitions that had to wait.
+        quint64 contentions = 0;
+
+        /// Wait times of the contended acquisitions (nanoseconds).
+        HistogramSnapshot wait_time_ns;
+
+        /// Hold times (nanoseconds, the max hold time is hold_time_ns.max).
+        HistogramSnapshot hold_time_ns;
+    };
+
+    //! A point in time copy of the tile pipeline metrics (see ImageManager::metrics()).
+    struct QMAPCONTROL_EXPORT TileMetrics
+    {
+        /// Tiles found in the memory cache.
+        quint64 memory_cache_hits = 0;
+
+        /// Tiles not found in the memory cache.
+        quint64 memory_cache_misses = 0;
+
+        /// Tiles removed from the memory cache to make room (or when its capacity was reduced).
+        quint64 memory_cache_evictions = 0;
+
+        /// Tiles found in the disk cache.
+        quint64 disk_cache_hits = 0;
+
+        /// Tiles not found in the disk cache.
+        quint64 disk_cache_misses = 0;
+
+        /// Tiles found in the cross-process shared cache.
+        quint64 shared_cache_hits = 0;
+
+        /// Tiles not found in the cross-process shared cache.
+        quint64 shared_cache_misses = 0;
+
+        /// Tiles waited for because another process was fetching them.
+        quint64 shared_cache_waits = 0;
+
+        /// Tiles supplied by the custom tile provider.
+        quint64 provider_hits = 0;
+
+        /// Tiles the custom tile provider did not have.
+        quint64 provider_misses = 0;
+
+        /// Network requests answered by the network (duplicate requests for a url already downloading are not sent,
+        /// cancelled and timed out requests and the replies from the network disk cache are not counted).
+        quint64 network_requests = 0;
+
+        /// Network requests answered from the network disk cache (not counted as network requests, bytes or latencies).
+        quint64 network_cache_replies = 0;
+
+        /// Network requests that failed.
+        quint64 network_failures = 0;
+
+        /// Network requests retried (timeouts and retryable errors).
+        quint64 network_retries = 0;
+
+        /// Network requests cancelled (eg: zoom changes abort the pending downloads).
+        quint64 network_cancellations = 0;
+
+        /// Bytes received from the network.
+        quint64 network_bytes = 0;
+
+        /// Tiles requested by prefetching.
+        quint64 prefetch_requests = 0;
+
+        /// Prefetched tiles that were displayed later.
+        quint64 prefetch_used = 0;
+
+        /// Tiles requested by cache warming (see CacheWarmer).
+        quint64 warm_requests = 0;
+
+        /// Warmed tiles that were displayed later.
+        quint64 warm_used = 0;
+
+        /// Tile decode times (microseconds).
+        HistogramSnapshot decode_time_us;
+
+        /// Network request latencies, request to reply finished (microseconds).
+        HistogramSnapshot request_latency_us;
+
+        /// Network request latencies per host (microseconds).
+        std::map<QString, HistogramSnapshot> request_latency_us_per_host;
+
+        /// Contention of the library's shared locks (only when built with QMC_LOCK_PROFILE).
+        std::vector<LockMetrics> locks;
+
+        /*!
+         * Fetch the memory cache hit ratio.
+         * @return the ratio of lookups found in the memory cache (0 if none).
+         */
+        double memoryCacheHitRatio() const;
+
+        /*!
+         * Fetch the disk cache hit ratio.
+         * @return the ratio of lookups found in the disk cache (0 if none).
+         */
+        double diskCacheHitRatio() const;
+
+        /*!
+         * Fetch the prefetch usefulness.
+         * @return the ratio of prefetched tiles that were displayed later (0 if none).
+         */
+        double prefetchUsefulness() const;
+
+        /*!
+         * Fetch the cache warming usefulness.
+         * @return the ratio of warmed tiles that were displayed later (0 if none).
+         */
+        double warmUsefulness() const;
+    };
+
+    //! Records the tile pipeline metrics (shared by ImageManager and NetworkManager).
+    class QMAPCONTROL_EXPORT TileMetricsRecorder
+    {
+    public:
+        //! Constructor.
+        TileMetricsRecorder();
+
+        //! Disable copy constructor.
+        TileMetricsRecorder(const TileMetricsRecorder&) = delete;
+
+        //! Disable copy assignment.
+        TileMetricsRecorder& operator=(const TileMetricsRecorder&) = delete;
+
+        /*!
+         * Record a network request latency.
+         * @param host The host the request was sent to.
+         * @param latency_us The latency in microseconds.
+         */
+        void recordRequestLatency(const QString& host, const quint64 latency_us);
+
+        /*!
+         * Reset all metrics.
+         */
+        void reset();
+
+        /*!
+         * Fetch a copy of the metrics.
+         * @return the metrics snapshot.
+         */
+        TileMetrics snapshot() const;
+
+    public:
+        /// Tiles found in the memory cache.
+        std::atomic<quint64> memory_cache_hits;
+
+        /// Tiles not found in the memory cache.
+        std::atomic<quint64> memory_cache_misses;
+
+        /// Tiles removed from the memory cache to make room (or when its capacity was reduced).
+        std::atomic<quint64> memory_cache_evictions;
+
+        /// Tiles found in the disk cache.
+        std::atomic<quint64> disk_cache_hits;
+
+        /// Tiles not found in the disk cache.
+        std::atomic<quint64> disk_cache_misses;
+
+        /// Tiles found in the cross-process shared cache.
+        std::atomic<quint64> shared_cache_hits;
+
+        /// Tiles not found in the cross-process shared cache.
+        std::atomic<quint64> shared_cache_misses;
+
+        /// Tiles waited for because another process was fetching them.
+        std::atomic<quint64> shared_cache_waits;
+
+        /// Tiles supplied by the custom tile provider.
+        std::atomic<quint64> provider_hits;
+
+        /// Tiles the custom tile provider did not have.
+        std::atomic<quint64> provider_misses;
+
+        /// Network requests answered by the network.
+        std::atomic<quint64> network_requests;
+
+        /// Network requests answered from the network disk cache.
+        std::atomic<quint64> network_cache_replies;
+
+        /// Network requests that failed.
+        std::atomic<quint64> network_failures;
+
+        /// Network requests retried.
+        std::atomic<quint64> network_retries;
+
+        /// Network requests cancelled.
+        std::atomic<quint64> network_cancellations;
+
+        /// Bytes received from the network.
+        std::atomic<quint64> network_bytes;
+
+        /// Tiles requested by prefetching.
+        std::atomic<quint64> prefetch_requests;
+
+        /// Prefetched tiles that were displayed later.
+        std::atomic<quint64> prefetch_used;
+
+        /// Tiles requested by cache warming.
+        std::atomic<quint64> warm_requests;
+
+        /// Warmed tiles that were displayed later.
+        std::atomic<quint64> warm_used;
+
+        /// Tile decode times (microseconds).
+        Histogram decode_time_us;
+
+        /// Network request latencies (microseconds).
+        Histogram request_latency_us;
+
+    private:
+        /// Mutex to protect the per host histograms container.
+        mutable QMutex m_hosts_mutex;
+
+        /// Network request latencies per host (microseconds).
+        std::map<QString, std::unique_ptr<Histogram>> m_request_latency_us_per_host;
+    };
+}
@@ -26,17 +26,39 @@
 #include "NetworkManager.h"
 
 // Qt includes.
+#include <QBuffer>
 #include <QMutexLocker>
 #include <QImageReader>
 #include <QAbstractNetworkCache>
 
+// STL includes.
+#include <algorithm>
+#include <chrono>
+
+// Local includes.
+#include "Phase.h"
+#include "TileDecode.h"
+#include "Trace.h"
+
 namespace qmapcontrol
 {
     const int kReplyTimeout_s = 30;
     const int kReplyTimeoutCheckInterval_s = 5;
+    const int kPartialDecodeInterval_ms = 250;
+
+    namespace
+    {
+        /// Fetch a monotonic timestamp for request latencies (us).
+        qint64 monotonicTimeUs()
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    }
 
     NetworkManager::NetworkManager(QObject* parent)
-        : QObject(parent)
+        : QObject(parent),
+          m_mutex_downloading_image("NetworkManager::m_mutex_downloading_image"),
+          m_metrics(nullptr)
     {
         // Connect signal/slot to handle proxy authentication.
         connect(&m_accessManager, &QNetworkAccessManager::proxyAuthenticationRequired, this, &NetworkManager::proxyAuthenticationRequired);
@@ -66,10 +88,16 @@ namespace qmapcontrol
 
     void NetworkManager::abortDownloads()
     {
-        QMutexLocker lock(&m_mutex_downloading_image);
+        ProfiledMutexLocker lock(&m_mutex_downloading_image);
         QMutableMapIterator<QNetworkReply*, QUrl> itr(m_downloadRequests);
         while (itr.hasNext())
         {
+            // Count the cancellation.
+            if (m_metrics != nullptr)
+            {
+                m_metrics->network_cancellations.fetch_add(1, std::memory_order_relaxed);
+            }
+
             // Tell the reply to abort.
             itr.next().key()->abort();
             itr.key()->deleteLater();
@@ -84,7 +112,7 @@ namespace qmapcontrol
         int return_size(0);
 
         // Return the size of the downloading image queue.
-        QMutexLocker lock(&m_mutex_downloading_image);
+        ProfiledMutexLocker lock(&m_mutex_downloading_image);
         return_size += m_downloadRequests.size();
 
         // Return the size.
@@ -99,6 +127,16 @@ namespace qmapcontrol
     }
 
     void NetworkManager::downloadImage(const QUrl& url, bool cacheOnly)
+    {
+        queueDownload(url, cacheOnly, QNetworkRequest::NormalPriority);
+    }
+
+    void NetworkManager::refreshImage(const QUrl& url)
+    {
+        queueDownload(url, true, QNetworkRequest::LowPriority, true);
+    }
+
+    void NetworkManager::queueDownload(const QUrl& url, bool cacheOnly, QNetworkRequest::Priority priority, bool refresh)
     {
         // Keep track of our success.
         bool success(false);
@@ -106,12 +144,12 @@ namespace qmapcontrol
         // Scope this as we later call "downloadQueueSize()" which also locks all download queue mutexes.
         {
             // Gain a lock to protect the downloading image container.
-            QMutexLocker lock(&m_mutex_downloading_image);
+            ProfiledMutexLocker lock(&m_mutex_downloading_image);
 
             // Check this is a new request.
             if (!isDownloading(url))
             {
-                requestDownload(url, cacheOnly);
+                requestDownload(url, cacheOnly, priority, refresh);
 
                 // Mark our success.
                 success = true;
@@ -130,11 +168,12 @@ namespace qmapcontrol
 
     }
 
-    void NetworkManager::requestDownload(const QUrl& url, bool cacheOnly)
+    void NetworkManager::requestDownload(const QUrl& url, bool cacheOnly, QNetworkRequest::Priority priority, bool refresh)
     {
         // Generate a new request.
         QNetworkRequest request(url);
         request.setRawHeader("User-Agent", "QMapControl");
+        request.setPriority(priority);
 
         // Using pipelining QNAM can put multiple requests in a single packet
         // (just a suggestion and needs server support).
@@ -152,13 +191,25 @@ namespace qmapcontrol
         QNetworkReply* reply = m_accessManager.get(request);
 
         reply->setProperty("cacheOnly", cacheOnly);
+        reply->setProperty("refresh", refresh);
         // Time when this request is considered timeouted
         QDateTime timeout = QDateTime::currentDateTime().addSecs(kReplyTimeout_s);
         reply->setProperty("timeout", timeout);
+        // Time when this request was sent (for the latency metrics)
+        reply->setProperty("requested_us", monotonicTimeUs());
 
         // Store the request into the downloading image queue.
         m_downloadRequests[reply] = url;
 
+        // Decode images for display while they arrive (see decodePartialDownload()).
+        if (!cacheOnly)
+        {
+            connect(reply, &QNetworkReply::readyRead, this, [this, reply]() { decodePartialDownload(reply); });
+        }
+
+        // Trace the request until its reply has finished.
+        QMC_TRACE_ASYNC_BEGIN("network", "NetworkManager::request", quintptr(reply), url.toString());
+
         // Log success.
 #ifdef QMAP_DEBUG
             qDebug() << "Downloading image '" << url << "', queued: " << m_downloadRequests.size();
@@ -177,10 +228,14 @@ namespace qmapcontrol
 
     void NetworkManager::downloadFinished(QNetworkReply* reply)
     {
+        // Mark the phase (for the stall detector).
+        QMC_PHASE("NetworkManager::downloadFinished");
+
         Q_ASSERT(reply);
         QNetworkReply::NetworkError error = reply->error();
 
         if (error == QNetworkReply::OperationCanceledError) {
+            QMC_TRACE_ASYNC_END("network", "NetworkManager::request", quintptr(reply), "cancelled");
 #ifdef QMAP_DEBUG
             qDebug() << "Cancelled: '" << reply->url() << "'";
 #endif
@@ -190,6 +245,13 @@ namespace qmapcontrol
         // let retry for these errors (careful...)
         if (error == QNetworkReply::UnknownContentError
                 || error == QNetworkReply::TimeoutError) {
+            QMC_TRACE_ASYNC_END("network", "NetworkManager::request", quintptr(reply), "retry");
+
+            // The reply is retried once it times out (see abortTimeoutedRequests()).
+            if (m_metrics != nullptr && reply->property("refresh").toBool() == false)
+            {
+                m_metrics->network_retries.fetch_add(1, std::memory_order_relaxed);
+            }
 #ifdef QMAP_DEBUG
             // Log error
             qDebug() << "Scheduled to retry for: '" << reply->url() << "' with error '" << reply->errorString() << "' (" << error << ")";
@@ -197,16 +259,37 @@ namespace qmapcontrol
             return;
         }
 
+        QMC_TRACE_ASYNC_END("network", "NetworkManager::request", quintptr(reply), error == QNetworkReply::NoError ? QString("ok") : reply->errorString());
+
         bool hasReply = false;
 
         {
-            QMutexLocker lock(&m_mutex_downloading_image);
+            ProfiledMutexLocker lock(&m_mutex_downloading_image);
             hasReply = m_downloadRequests.remove(reply);
             if (!hasReply) {
                 qWarning() << "Unexpected reply for: " << reply->url();
             }
         }
 
+        // Record the request outcome, latency and payload size (replies from the disk cache are not network traffic).
+        if (hasReply && m_metrics != nullptr)
+        {
+            if (reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool())
+            {
+                m_metrics->network_cache_replies.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                m_metrics->network_requests.fetch_add(1, std::memory_order_relaxed);
+                if (error != QNetworkReply::NoError)
+                {
+                    m_metrics->network_failures.fetch_add(1, std::memory_order_relaxed);
+                }
+                m_metrics->network_bytes.fetch_add(quint64(std::max<qint64>(0, reply->bytesAvailable())), std::memory_order_relaxed);
+                m_metrics->recordRequestLatency(reply->url().host(), quint64(std::max<qint64>(0, monotonicTimeUs() - reply->property("requested_us").toLongLong())));
+            }
+        }
+
         // Did the reply return errors...
         if (error != QNetworkReply::NoError)
         {
@@ -226,20 +309,40 @@ namespace qmapcontrol
             qDebug() << "Downloaded image " << reply->url() << ", payload size: " << reply->size();
 #endif
                 bool cacheOnly = reply->property("cacheOnly").toBool();
-                if (cacheOnly)
+                if (reply->property("refresh").toBool())
+                {
+                    // Revalidations are not reported as cached (see cacheImageToDisk()).
+                    emit imageRefreshed(reply->url());
+                }
+                else if (cacheOnly)
                 {
                     emit imageCached(reply->url());
                 }
                 else
                 {
+                    // Trace/mark the decode.
+                    QMC_TRACE_SCOPE_ARG("network", "NetworkManager::decode", reply->url().toString());
+                    QMC_PHASE("NetworkManager::decode");
+
+                    // Read the payload (also handed over to the shared tile cache).
+                    QBuffer payload;
+                    payload.setData(reply->readAll());
+                    payload.open(QIODevice::ReadOnly);
+
                     // Emit that we have downloaded an image.
-                    QImageReader image_reader(reply);
+                    const qint64 decode_start_us = monotonicTimeUs();
+                    QImageReader image_reader(&payload);
                     QPixmap pixmap= QPixmap::fromImageReader(&image_reader);
+                    if (m_metrics != nullptr)
+                    {
+                        m_metrics->decode_time_us.record(quint64(monotonicTimeUs() - decode_start_us));
+                    }
 
                     if (pixmap.isNull()) {
                         qWarning() << "Pixmap is empty for " << reply->url() << ", reply size: " << reply->size();
                     }
 
+                    emit imageDataDownloaded(reply->url(), pixmap.isNull() ? QByteArray() : payload.data());
                     emit imageDownloaded(reply->url(), pixmap);
                 }
             }
@@ -258,11 +361,59 @@ namespace qmapcontrol
         reply->deleteLater();
     }
 
+    void NetworkManager::decodePartialDownload(QNetworkReply* reply)
+    {
+        // Replies from the disk cache arrive at once (and are decoded in full).
+        if (reply->isFinished() || reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool())
+        {
+            return;
+        }
+
+        // Throttle the decodes of each reply.
+        const qint64 now_us = monotonicTimeUs();
+        if (now_us - reply->property("partial_us").toLongLong() < qint64(kPartialDecodeInterval_ms) * 1000)
+        {
+            return;
+        }
+
+        // Only decode once more scans have arrived (without consuming the data).
+        const QByteArray data = reply->peek(reply->bytesAvailable());
+        const int length = tiledecode::progressiveScansLength(data);
+        if (length <= reply->property("partial_length").toInt())
+        {
+            return;
+        }
+        reply->setProperty("partial_length", length);
+        reply->setProperty("partial_us", now_us);
+
+        // Trace/mark the decode.
+        QMC_TRACE_SCOPE_ARG("network", "NetworkManager::decodePartial", reply->url().toString());
+        QMC_PHASE("NetworkManager::decodePartial");
+
+        // Emit the partial image.
+        const qint64 decode_start_us = monotonicTimeUs();
+        const QImage image = tiledecode::decodeScans(data, length);
+        if (m_metrics != nullptr)
+        {
+            m_metrics->decode_time_us.record(quint64(monotonicTimeUs() - decode_start_us));
+        }
+        if (!image.isNull())
+        {
+            emit imagePartiallyDownloaded(reply->url(), QPixmap::fromImage(image));
+        }
+    }
+
     void NetworkManager::setCache(QAbstractNetworkCache* cache)
     {
         m_accessManager.setCache(cache);
     }
 
+    void NetworkManager::setMetrics(TileMetricsRecorder* metrics)
+    {
+        // Set the metrics recorder.
+        m_metrics = metrics;
+    }
+
     void NetworkManager::abortTimeoutedRequests()
     {
 #ifdef QMAP_DEBUG
@@ -271,7 +422,7 @@ namespace qmapcontrol
         {
             QVector<QPair<QUrl, bool>> retryList;
 
-            QMutexLocker lock(&m_mutex_downloading_image);
+            ProfiledMutexLocker lock(&m_mutex_downloading_image);
             QMutableMapIterator<QNetworkReply*, QUrl> itr(m_downloadRequests);
             const QDateTime currentTime = QDateTime::currentDateTime();
 
@@ -284,6 +435,8 @@ namespace qmapcontrol
                 {
                     const QUrl url = itr.value();
                     bool cacheOnly = itr.key()->property("cacheOnly").toBool();
+                    const bool refresh = itr.key()->property("refresh").toBool();
+                    const bool finished = itr.key()->isFinished();
 
                     // abort
 #ifdef QMAP_DEBUG
@@ -293,8 +446,18 @@ namespace qmapcontrol
                     itr.key()->deleteLater();
                     itr.remove();
 
-                    // schedule retry
+                    // schedule retry (background refreshes are picked up by the next refresh pass instead)
+                    if (refresh)
+                    {
+                        continue;
+                    }
                     retryList.append(QPair<QUrl, bool>(url, cacheOnly));
+
+                    // The replies finished with a retryable error are counted already (see downloadFinished()).
+                    if (m_metrics != nullptr && finished == false)
+                    {
+                        m_metrics->network_retries.fetch_add(1, std::memory_order_relaxed);
+                    }
                 }
             }
             for (const QPair<QUrl, bool>& item : retryList) {
@@ -38,6 +38,8 @@
 
 // Local includes.
 #include "qmapcontrol_global.h"
+#include "Metrics.h"
+#include "ProfiledLock.h"
 
 /*!
  * @author Kai Winter <kaiwinter@gmx.de>
@@ -99,6 +101,12 @@ namespace qmapcontrol
          */
         void setCache(QAbstractNetworkCache* cache);
 
+        /*!
+         * Set the metrics recorder to update (requests, bytes, latencies, retries and cancellations).
+         * @param metrics The metrics recorder, or nullptr to stop recording.
+         */
+        void setMetrics(TileMetricsRecorder* metrics);
+
     public slots:
         /*!
          * Downloads an image resource for the given url.
@@ -107,6 +115,13 @@ namespace qmapcontrol
          */
         void downloadImage(const QUrl& url, bool cacheOnly);
 
+        /*!
+         * Revalidates the disk cache copy of an image resource at the lowest network priority (the
+         * reply only updates the disk cache, emits imageRefreshed, and is not retried on timeout).
+         * @param url The image url to revalidate.
+         */
+        void refreshImage(const QUrl& url);
+
     signals:
         /*!
          * Signal emitted when a resource has been queued for download.
@@ -126,12 +141,33 @@ namespace qmapcontrol
          */
         void imageDownloaded(const QUrl& url, const QPixmap& pixmap);
 
+        /*!
+         * Signal emitted when more of an image downloaded for display has arrived and been decoded (a
+         * progressive JPEG at the detail of its complete scans), before imageDownloaded.
+         * @param url The url that the image is being downloaded from.
+         * @param pixmap The partial image.
+         */
+        void imagePartiallyDownloaded(const QUrl& url, const QPixmap& pixmap);
+
+        /*!
+         * Signal emitted with the encoded bytes of an image downloaded for display (before imageDownloaded).
+         * @param url The url that the image was downloaded from.
+         * @param data The encoded image (empty if it could not be decoded).
+         */
+        void imageDataDownloaded(const QUrl& url, const QByteArray& data);
+
         /*!
          * Signal emitted when an image has been downloaded to disk cache.
          * @param url The url that the image was downloaded from.
          * */
         void imageCached(const QUrl& url);
 
+        /*!
+         * Signal emitted when the disk cache copy of an image has been revalidated (see refreshImage()).
+         * @param url The url that the image was revalidated from.
+         */
+        void imageRefreshed(const QUrl& url);
+
         /*!
          * Signal emitted when image download fails for reasons other than cancellation.
          * \param The url that the image was downloaded from.
@@ -163,7 +199,7 @@ namespace qmapcontrol
         QMap<QNetworkReply*, QUrl> m_downloadRequests;
 
         /// Mutex protecting downloading image queue.
-        mutable QMutex m_mutex_downloading_image;
+        mutable ProfiledMutex m_mutex_downloading_image;
 
         QString m_proxyUserName;
         QString m_proxyPassword;
@@ -171,6 +207,25 @@ namespace qmapcontrol
         /// For periodic checks of timeouted requests
         QTimer m_timeoutTimer;
 
-        void requestDownload(const QUrl& url, bool cacheOnly);
+        /// The metrics recorder (not owned, may be nullptr).
+        TileMetricsRecorder* m_metrics;
+
+        /*!
+         * Queue a download, unless the url is already downloading.
+         * @param url The image url to download.
+         * @param cacheOnly If true image is only stored to disk cache and not for display.
+         * @param priority The network priority of the request.
+         * @param refresh Whether the request revalidates the disk cache copy (see refreshImage()).
+         */
+        void queueDownload(const QUrl& url, bool cacheOnly, QNetworkRequest::Priority priority, bool refresh = false);
+
+        /*!
+         * Decode the part of a reply received so far, if more scans of a progressive JPEG have arrived
+         * (at most once per kPartialDecodeInterval_ms for each reply).
+         * @param reply The reply that is still receiving the image.
+         */
+        void decodePartialDownload(QNetworkReply* reply);
+
+        void requestDownload(const QUrl& url, bool cacheOnly, QNetworkRequest::Priority priority = QNetworkRequest::NormalPriority, bool refresh = false);
     };
 }
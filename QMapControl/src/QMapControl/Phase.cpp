@@ -0,0 +1,60 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "Phase.h"
+
+// STL includes.
+#include <algorithm>
+
+namespace qmapcontrol
+{
+    namespace phase
+    {
+        namespace
+        {
+            /// The phase stack of the current thread (zero-initialised, as all thread storage).
+            thread_local Stack t_stack;
+        }
+
+        Stack& current()
+        {
+            return t_stack;
+        }
+
+        std::vector<const char*> read(const Stack& stack)
+        {
+            // Read the named part of the stack.
+            const int depth = std::min(stack.depth.load(std::memory_order_acquire), kMaxDepth);
+            std::vector<const char*> names;
+            for (int i = 0; i < depth; ++i)
+            {
+                names.push_back(stack.names[i].load(std::memory_order_relaxed));
+            }
+
+            // Return the phase names.
+            return names;
+        }
+    }
+}
@@ -0,0 +1,116 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// STL includes.
+#include <atomic>
+#include <vector>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+
+/*!
+ * Lightweight markers of the library phase a thread is in (eg: painting, decoding a tile), read by
+ * the StallDetector to attribute GUI thread stalls.
+ *
+ * Each thread has its own fixed-size phase stack; entering/leaving a phase is two relaxed stores,
+ * so the markers are always compiled in. Phase names must be string literals (only the pointers
+ * are stored).
+ */
+namespace qmapcontrol
+{
+    namespace phase
+    {
+        /// The maximum phase depth recorded (deeper phases are counted but not named).
+        constexpr int kMaxDepth = 16;
+
+        //! The phase stack of a thread.
+        struct Stack
+        {
+            /// The current depth.
+            std::atomic<int> depth;
+
+            /// The phase names (valid up to depth).
+            std::atomic<const char*> names[kMaxDepth];
+        };
+
+        /*!
+         * Fetch the phase stack of the current thread.
+         * @return the phase stack.
+         */
+        QMAPCONTROL_EXPORT Stack& current();
+
+        /*!
+         * Read a phase stack (safe from another thread, the phases may change while reading).
+         * @param stack The phase stack.
+         * @return the phase names, outermost first.
+         */
+        QMAPCONTROL_EXPORT std::vector<const char*> read(const Stack& stack);
+
+        //! Marks a phase from construction to destruction.
+        class ScopedPhase
+        {
+        public:
+            /*!
+             * Enter the phase.
+             * @param name The phase name.
+             */
+            explicit ScopedPhase(const char* name)
+                : m_stack(current())
+            {
+                const int depth = m_stack.depth.load(std::memory_order_relaxed);
+                if (depth < kMaxDepth)
+                {
+                    m_stack.names[depth].store(name, std::memory_order_relaxed);
+                }
+                m_stack.depth.store(depth + 1, std::memory_order_release);
+            }
+
+            //! Disable copy constructor.
+            ScopedPhase(const ScopedPhase&) = delete;
+
+            //! Disable copy assignment.
+            ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+            //! Leave the phase.
+            ~ScopedPhase()
+            {
+                m_stack.depth.store(m_stack.depth.load(std::memory_order_relaxed) - 1, std::memory_order_release);
+            }
+
+        private:
+            /// The phase stack of the thread.
+            Stack& m_stack;
+        };
+    }
+}
+
+#define QMC_PHASE_CONCAT_INNER(a, b) a##b
+#define QMC_PHASE_CONCAT(a, b) QMC_PHASE_CONCAT_INNER(a, b)
+
+/// Mark a library phase until the end of the current scope.
+#define QMC_PHASE(name) \
+    qmapcontrol::phase::ScopedPhase QMC_PHASE_CONCAT(qmc_phase_, __LINE__)(name)
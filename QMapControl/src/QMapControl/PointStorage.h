@@ -0,0 +1,285 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// STL includes.
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+#include "Point.h"
+
+namespace qmapcontrol
+{
+    //! Non-owning view of contiguous points.
+    /*!
+     * A view is only valid until the points it refers to are changed (or their owner is destroyed).
+     */
+    template<typename Point>
+    class PointSpan
+    {
+    public:
+        /*!
+         * Constructor.
+         * @param data The first point.
+         * @param size The number of points.
+         */
+        PointSpan(Point* data, const std::size_t size)
+            : m_data(data),
+              m_size(size)
+        {
+
+        }
+
+        /*!
+         * Fetch the points.
+         * @return the first point.
+         */
+        Point* data() const { return m_data; }
+
+        /*!
+         * Fetch the number of points.
+         * @return the number of points.
+         */
+        std::size_t size() const { return m_size; }
+
+        /*!
+         * Whether there are no points.
+         * @return whether there are no points.
+         */
+        bool empty() const { return m_size == 0; }
+
+        /*!
+         * Fetch the iterator to the first point.
+         * @return the first point.
+         */
+        Point* begin() const { return m_data; }
+
+        /*!
+         * Fetch the iterator past the last point.
+         * @return past the last point.
+         */
+        Point* end() const { return m_data + m_size; }
+
+        /*!
+         * Fetch a point.
+         * @param index The index of the point.
+         * @return the point.
+         */
+        Point& operator[](const std::size_t index) const { return m_data[index]; }
+
+    private:
+        /// The first point.
+        Point* m_data;
+
+        /// The number of points.
+        std::size_t m_size;
+    };
+
+    /// A read-only view of points.
+    using PointView = PointSpan<const PointWorldCoord>;
+
+    /// A modifiable view of points.
+    using MutablePointView = PointSpan<PointWorldCoord>;
+
+    //! Contiguous storage of world points, with the first few points stored inline.
+    /*!
+     * Short linestrings and polygons (the bulk of most datasets) keep their points inside the
+     * geometry object, so they need no separate heap allocation. Longer lists live in a
+     * std::vector, which is adopted without copying when moved in.
+     */
+    template<std::size_t InlineCapacity>
+    class PointStorage
+    {
+    public:
+        //! Constructor (empty).
+        PointStorage()
+            : m_inline_size(0),
+              m_inline(true)
+        {
+
+        }
+
+        /*!
+         * Constructor.
+         * @param points The points to copy.
+         */
+        explicit PointStorage(const std::vector<PointWorldCoord>& points)
+            : PointStorage()
+        {
+            assign(points);
+        }
+
+        /*!
+         * Constructor.
+         * @param points The points to adopt.
+         */
+        explicit PointStorage(std::vector<PointWorldCoord>&& points)
+            : PointStorage()
+        {
+            assign(std::move(points));
+        }
+
+        /*!
+         * Replace the points.
+         * @param points The points to copy.
+         */
+        void assign(const std::vector<PointWorldCoord>& points)
+        {
+            // Do they fit inline?
+            if (points.size() <= InlineCapacity)
+            {
+                std::copy(points.begin(), points.end(), m_inline_points);
+                m_inline_size = points.size();
+                m_inline = true;
+                std::vector<PointWorldCoord>().swap(m_heap_points);
+            }
+            else
+            {
+                m_heap_points = points;
+                m_inline = false;
+            }
+        }
+
+        /*!
+         * Replace the points.
+         * @param points The points to adopt.
+         */
+        void assign(std::vector<PointWorldCoord>&& points)
+        {
+            // Do they fit inline?
+            if (points.size() <= InlineCapacity)
+            {
+                assign(static_cast<const std::vector<PointWorldCoord>&>(points));
+            }
+            else
+            {
+                m_heap_points = std::move(points);
+                m_inline = false;
+            }
+        }
+
+        /*!
+         * Add a point.
+         * @param point The point to add.
+         */
+        void push_back(const PointWorldCoord& point)
+        {
+            // Is there space inline?
+            if (m_inline && m_inline_size < InlineCapacity)
+            {
+                m_inline_points[m_inline_size++] = point;
+            }
+            else
+            {
+                // Move the inline points to the heap first.
+                if (m_inline)
+                {
+                    m_heap_points.reserve(InlineCapacity * 2);
+                    m_heap_points.assign(m_inline_points, m_inline_points + m_inline_size);
+                    m_inline = false;
+                }
+                m_heap_points.push_back(point);
+            }
+        }
+
+        /*!
+         * Fetch the number of points.
+         * @return the number of points.
+         */
+        std::size_t size() const { return m_inline ? m_inline_size : m_heap_points.size(); }
+
+        /*!
+         * Whether there are no points.
+         * @return whether there are no points.
+         */
+        bool empty() const { return size() == 0; }
+
+        /*!
+         * Fetch the points.
+         * @return the first point.
+         */
+        const PointWorldCoord* data() const { return m_inline ? m_inline_points : m_heap_points.data(); }
+
+        /*!
+         * Fetch the points.
+         * @return the first point.
+         */
+        PointWorldCoord* data() { return m_inline ? m_inline_points : m_heap_points.data(); }
+
+        /// Iterators over the points.
+        const PointWorldCoord* begin() const { return data(); }
+        const PointWorldCoord* end() const { return data() + size(); }
+        PointWorldCoord* begin() { return data(); }
+        PointWorldCoord* end() { return data() + size(); }
+
+        /*!
+         * Fetch the first point (there must be one).
+         * @return the first point.
+         */
+        const PointWorldCoord& front() const { return *data(); }
+
+        /*!
+         * Fetch a read-only view of the points.
+         * @return the view.
+         */
+        PointView view() const { return PointView(data(), size()); }
+
+        /*!
+         * Fetch a modifiable view of the points.
+         * @return the view.
+         */
+        MutablePointView mutableView() { return MutablePointView(data(), size()); }
+
+        /*!
+         * Copy the points into a vector.
+         * @return the points.
+         */
+        std::vector<PointWorldCoord> toVector() const { return std::vector<PointWorldCoord>(begin(), end()); }
+
+        /*!
+         * Fetch the number of points allocated on the heap.
+         * @return the heap capacity (0 when the points are inline).
+         */
+        std::size_t heapCapacity() const { return m_heap_points.capacity(); }
+
+    private:
+        /// The points, when there are too many to store inline.
+        std::vector<PointWorldCoord> m_heap_points;
+
+        /// The inline points.
+        PointWorldCoord m_inline_points[InlineCapacity];
+
+        /// The number of inline points.
+        std::size_t m_inline_size;
+
+        /// Whether the points are stored inline.
+        bool m_inline;
+    };
+}
@@ -0,0 +1,162 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "ProfiledLock.h"
+
+// STL includes.
+#include <chrono>
+#include <map>
+#include <memory>
+#include <utility>
+
+namespace qmapcontrol
+{
+    namespace lockprofile
+    {
+        //! The statistics of a lock name.
+        struct Counters
+        {
+            /// The lock name.
+            QString name;
+
+            /// Number of acquisitions.
+            std::atomic<quint64> acquisitions;
+
+            /// Number of acquisitions that had to wait.
+            std::atomic<quint64> contentions;
+
+            /// Wait times of the contended acquisitions (ns).
+            Histogram wait_time_ns;
+
+            /// Hold times (ns).
+            Histogram hold_time_ns;
+        };
+
+        namespace
+        {
+            /// Mutex to protect the counters registry.
+            QMutex& registryMutex()
+            {
+                static QMutex mutex;
+                return mutex;
+            }
+
+            /// The counters of each lock name (never freed, locks keep a pointer to their counters).
+            std::map<QString, std::unique_ptr<Counters>>& registry()
+            {
+                static std::map<QString, std::unique_ptr<Counters>> counters;
+                return counters;
+            }
+
+            /// The locks held by the current thread, with when they were acquired (ns).
+            thread_local std::vector<std::pair<const void*, qint64>> t_held;
+        }
+
+        Counters* counters(const char* name)
+        {
+            // Find or create the counters.
+            QMutexLocker locker(&registryMutex());
+            std::unique_ptr<Counters>& entry = registry()[QString::fromLatin1(name)];
+            if (entry == nullptr)
+            {
+                entry.reset(new Counters);
+                entry->name = QString::fromLatin1(name);
+                entry->acquisitions.store(0);
+                entry->contentions.store(0);
+            }
+            return entry.get();
+        }
+
+        void acquired(Counters* counters, const void* lock, const qint64 wait_start_ns)
+        {
+            const qint64 acquired_ns = now();
+
+            // Count the acquisition (and its wait, if any).
+            counters->acquisitions.fetch_add(1, std::memory_order_relaxed);
+            if (wait_start_ns >= 0)
+            {
+                counters->contentions.fetch_add(1, std::memory_order_relaxed);
+                counters->wait_time_ns.record(quint64(acquired_ns - wait_start_ns));
+            }
+
+            // Start the hold time.
+            t_held.emplace_back(lock, acquired_ns);
+        }
+
+        void released(Counters* counters, const void* lock)
+        {
+            // Find the latest acquisition of the lock by this thread (read locks can be recursive).
+            for (auto itr = t_held.rbegin(); itr != t_held.rend(); ++itr)
+            {
+                if (itr->first == lock)
+                {
+                    // Record the hold time.
+                    counters->hold_time_ns.record(quint64(now() - itr->second));
+                    t_held.erase(std::next(itr).base());
+                    break;
+                }
+            }
+        }
+
+        qint64 now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        std::vector<LockMetrics> snapshot()
+        {
+            std::vector<LockMetrics> locks;
+
+            // Copy each lock name's statistics.
+            QMutexLocker locker(&registryMutex());
+            for (const auto& entry : registry())
+            {
+                LockMetrics lock;
+                lock.name = entry.first;
+                lock.acquisitions = entry.second->acquisitions.load(std::memory_order_relaxed);
+                lock.contentions = entry.second->contentions.load(std::memory_order_relaxed);
+                lock.wait_time_ns = entry.second->wait_time_ns.snapshot();
+                lock.hold_time_ns = entry.second->hold_time_ns.snapshot();
+                locks.push_back(lock);
+            }
+
+            // Return the statistics.
+            return locks;
+        }
+
+        void reset()
+        {
+            // Reset each lock name's statistics.
+            QMutexLocker locker(&registryMutex());
+            for (const auto& entry : registry())
+            {
+                entry.second->acquisitions.store(0, std::memory_order_relaxed);
+                entry.second->contentions.store(0, std::memory_order_relaxed);
+                entry.second->wait_time_ns.reset();
+                entry.second->hold_time_ns.reset();
+            }
+        }
+    }
+}
@@ -0,0 +1,420 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// Qt includes.
+#include <QMutex>
+#include <QReadWriteLock>
+
+// STL includes.
+#include <vector>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+#include "Metrics.h"
+
+/*!
+ * Lock contention profiling of the library's shared locks.
+ *
+ * When QMC_LOCK_PROFILE is defined, ProfiledMutex and ProfiledReadWriteLock record the number of
+ * acquisitions, how many had to wait, a wait time histogram and a hold time histogram per lock
+ * name (instances with the same name are aggregated, eg: the geometries lock of every layer).
+ * The results are part of ImageManager::metrics().
+ *
+ * Otherwise they are plain QMutex/QReadWriteLock and the lockers are the Qt lockers, so the
+ * wrappers cost nothing.
+ */
+namespace qmapcontrol
+{
+#ifdef QMC_LOCK_PROFILE
+    namespace lockprofile
+    {
+        struct Counters;
+
+        /*!
+         * Fetch the counters of a lock name (created on first use, never freed).
+         * @param name The lock name.
+         * @return the counters.
+         */
+        QMAPCONTROL_EXPORT Counters* counters(const char* name);
+
+        /*!
+         * Record a lock acquisition (starts the hold time of the current thread).
+         * @param counters The lock counters.
+         * @param lock The lock instance.
+         * @param wait_start_ns When the thread started waiting (-1 if it did not wait).
+         */
+        QMAPCONTROL_EXPORT void acquired(Counters* counters, const void* lock, const qint64 wait_start_ns);
+
+        /*!
+         * Record a lock release (ends the hold time of the current thread).
+         * @param counters The lock counters.
+         * @param lock The lock instance.
+         */
+        QMAPCONTROL_EXPORT void released(Counters* counters, const void* lock);
+
+        /*!
+         * Fetch the profiling clock.
+         * @return a monotonic time (ns).
+         */
+        QMAPCONTROL_EXPORT qint64 now();
+
+        /*!
+         * Fetch the statistics of each lock name.
+         * @return the lock statistics.
+         */
+        QMAPCONTROL_EXPORT std::vector<LockMetrics> snapshot();
+
+        /*!
+         * Reset the statistics of all locks.
+         */
+        QMAPCONTROL_EXPORT void reset();
+    }
+
+    //! A QMutex that records its contention (see ProfiledLock.h).
+    class QMAPCONTROL_EXPORT ProfiledMutex
+    {
+    public:
+        /*!
+         * Constructor.
+         * @param name The lock name (string literal).
+         */
+        explicit ProfiledMutex(const char* name)
+            : m_counters(lockprofile::counters(name))
+        {
+
+        }
+
+        //! Disable copy constructor.
+        ProfiledMutex(const ProfiledMutex&) = delete;
+
+        //! Disable copy assignment.
+        ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+        //! Lock the mutex (see QMutex::lock()).
+        void lock()
+        {
+            // Only time the wait when the mutex is contended.
+            if (m_mutex.tryLock())
+            {
+                lockprofile::acquired(m_counters, this, -1);
+            }
+            else
+            {
+                const qint64 wait_start_ns = lockprofile::now();
+                m_mutex.lock();
+                lockprofile::acquired(m_counters, this, wait_start_ns);
+            }
+        }
+
+        /*!
+         * Try to lock the mutex (see QMutex::tryLock()).
+         * @param timeout_ms How long to wait for the lock (ms).
+         * @return whether the mutex was locked.
+         */
+        bool tryLock(const int timeout_ms = 0)
+        {
+            const qint64 wait_start_ns = timeout_ms == 0 ? -1 : lockprofile::now();
+            const bool locked = m_mutex.tryLock(timeout_ms);
+            if (locked)
+            {
+                lockprofile::acquired(m_counters, this, wait_start_ns);
+            }
+            return locked;
+        }
+
+        //! Unlock the mutex (see QMutex::unlock()).
+        void unlock()
+        {
+            lockprofile::released(m_counters, this);
+            m_mutex.unlock();
+        }
+
+    private:
+        /// The mutex.
+        QMutex m_mutex;
+
+        /// The lock name's counters.
+        lockprofile::Counters* m_counters;
+    };
+
+    //! A QReadWriteLock that records its contention (see ProfiledLock.h).
+    class QMAPCONTROL_EXPORT ProfiledReadWriteLock
+    {
+    public:
+        /*!
+         * Constructor.
+         * @param name The lock name (string literal).
+         */
+        explicit ProfiledReadWriteLock(const char* name)
+            : m_counters(lockprofile::counters(name))
+        {
+
+        }
+
+        //! Disable copy constructor.
+        ProfiledReadWriteLock(const ProfiledReadWriteLock&) = delete;
+
+        //! Disable copy assignment.
+        ProfiledReadWriteLock& operator=(const ProfiledReadWriteLock&) = delete;
+
+        //! Lock for reading (see QReadWriteLock::lockForRead()).
+        void lockForRead()
+        {
+            // Only time the wait when the lock is contended.
+            if (m_lock.tryLockForRead())
+            {
+                lockprofile::acquired(m_counters, this, -1);
+            }
+            else
+            {
+                const qint64 wait_start_ns = lockprofile::now();
+                m_lock.lockForRead();
+                lockprofile::acquired(m_counters, this, wait_start_ns);
+            }
+        }
+
+        //! Lock for writing (see QReadWriteLock::lockForWrite()).
+        void lockForWrite()
+        {
+            // Only time the wait when the lock is contended.
+            if (m_lock.tryLockForWrite())
+            {
+                lockprofile::acquired(m_counters, this, -1);
+            }
+            else
+            {
+                const qint64 wait_start_ns = lockprofile::now();
+                m_lock.lockForWrite();
+                lockprofile::acquired(m_counters, this, wait_start_ns);
+            }
+        }
+
+        //! Unlock (see QReadWriteLock::unlock()).
+        void unlock()
+        {
+            lockprofile::released(m_counters, this);
+            m_lock.unlock();
+        }
+
+    private:
+        /// The lock.
+        QReadWriteLock m_lock;
+
+        /// The lock name's counters.
+        lockprofile::Counters* m_counters;
+    };
+
+    //! Locks a ProfiledMutex for the current scope (see QMutexLocker).
+    class ProfiledMutexLocker
+    {
+    public:
+        /*!
+         * Lock the mutex.
+         * @param mutex The mutex to lock.
+         */
+        explicit ProfiledMutexLocker(ProfiledMutex* mutex)
+            : m_mutex(mutex),
+              m_locked(false)
+        {
+            relock();
+        }
+
+        //! Disable copy constructor.
+        ProfiledMutexLocker(const ProfiledMutexLocker&) = delete;
+
+        //! Disable copy assignment.
+        ProfiledMutexLocker& operator=(const ProfiledMutexLocker&) = delete;
+
+        //! Unlock the mutex.
+        ~ProfiledMutexLocker()
+        {
+            unlock();
+        }
+
+        //! Unlock the mutex early.
+        void unlock()
+        {
+            if (m_locked)
+            {
+                m_mutex->unlock();
+                m_locked = false;
+            }
+        }
+
+        //! Lock the mutex again.
+        void relock()
+        {
+            if (m_locked == false)
+            {
+                m_mutex->lock();
+                m_locked = true;
+            }
+        }
+
+    private:
+        /// The mutex.
+        ProfiledMutex* m_mutex;
+
+        /// Whether the mutex is locked.
+        bool m_locked;
+    };
+
+    //! Locks a ProfiledReadWriteLock for reading for the current scope (see QReadLocker).
+    class ProfiledReadLocker
+    {
+    public:
+        /*!
+         * Lock for reading.
+         * @param lock The lock.
+         */
+        explicit ProfiledReadLocker(ProfiledReadWriteLock* lock)
+            : m_lock(lock),
+              m_locked(false)
+        {
+            relock();
+        }
+
+        //! Disable copy constructor.
+        ProfiledReadLocker(const ProfiledReadLocker&) = delete;
+
+        //! Disable copy assignment.
+        ProfiledReadLocker& operator=(const ProfiledReadLocker&) = delete;
+
+        //! Unlock.
+        ~ProfiledReadLocker()
+        {
+            unlock();
+        }
+
+        //! Unlock early.
+        void unlock()
+        {
+            if (m_locked)
+            {
+                m_lock->unlock();
+                m_locked = false;
+            }
+        }
+
+        //! Lock for reading again.
+        void relock()
+        {
+            if (m_locked == false)
+            {
+                m_lock->lockForRead();
+                m_locked = true;
+            }
+        }
+
+    private:
+        /// The lock.
+        ProfiledReadWriteLock* m_lock;
+
+        /// Whether the lock is held.
+        bool m_locked;
+    };
+
+    //! Locks a ProfiledReadWriteLock for writing for the current scope (see QWriteLocker).
+    class ProfiledWriteLocker
+    {
+    public:
+        /*!
+         * Lock for writing.
+         * @param lock The lock.
+         */
+        explicit ProfiledWriteLocker(ProfiledReadWriteLock* lock)
+            : m_lock(lock),
+              m_locked(false)
+        {
+            relock();
+        }
+
+        //! Disable copy constructor.
+        ProfiledWriteLocker(const ProfiledWriteLocker&) = delete;
+
+        //! Disable copy assignment.
+        ProfiledWriteLocker& operator=(const ProfiledWriteLocker&) = delete;
+
+        //! Unlock.
+        ~ProfiledWriteLocker()
+        {
+            unlock();
+        }
+
+        //! Unlock early.
+        void unlock()
+        {
+            if (m_locked)
+            {
+                m_lock->unlock();
+                m_locked = false;
+            }
+        }
+
+        //! Lock for writing again.
+        void relock()
+        {
+            if (m_locked == false)
+            {
+                m_lock->lockForWrite();
+                m_locked = true;
+            }
+        }
+
+    private:
+        /// The lock.
+        ProfiledReadWriteLock* m_lock;
+
+        /// Whether the lock is held.
+        bool m_locked;
+    };
+#else
+    namespace lockprofile
+    {
+        inline std::vector<LockMetrics> snapshot() { return std::vector<LockMetrics>(); }
+        inline void reset() { }
+    }
+
+    //! A QMutex (profiling is compiled out, see ProfiledLock.h).
+    class ProfiledMutex : public QMutex
+    {
+    public:
+        explicit ProfiledMutex(const char*) { }
+    };
+
+    //! A QReadWriteLock (profiling is compiled out, see ProfiledLock.h).
+    class ProfiledReadWriteLock : public QReadWriteLock
+    {
+    public:
+        explicit ProfiledReadWriteLock(const char*) { }
+    };
+
+    using ProfiledMutexLocker = QMutexLocker;
+    using ProfiledReadLocker = QReadLocker;
+    using ProfiledWriteLocker = QWriteLocker;
+#endif
+}
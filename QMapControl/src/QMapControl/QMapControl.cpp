@@ -39,13 +39,17 @@
 #include "GeometryPolygon.h"
 #include "ImageManager.h"
 #include "LayerGeometry.h"
+#include "Phase.h"
 #include "Projection.h"
+#include "Trace.h"
+#include "WarmStart.h"
 
 #include <QDebug>
 
 namespace qmapcontrol
 {
     static const QColor kInitialBufferColor = Qt::transparent;
+    static const std::chrono::milliseconds kDefaultMemoryBudgetCheckInterval(5000);
 
     QMapControl::QMapControl(QWidget* parent, Qt::WindowFlags window_flags)
         : QMapControl(parent->size(), parent, window_flags)
@@ -60,6 +64,7 @@ namespace qmapcontrol
         : QWidget(parent, window_flags),
           m_scalebar_enabled(false),
           m_crosshairs_enabled(true),
+          m_layers_mutex("QMapControl::m_layers_mutex"),
           m_layer_mouse_events_enabled(true),
           m_viewport_size_px(size_px),
           m_viewport_center_px(size_px.width() / 2.0, size_px.height() / 2.0),
@@ -83,6 +88,8 @@ namespace qmapcontrol
           m_primary_screen_backbuffer_rect_px(PointWorldPx(0.0, 0.0), PointWorldPx(0.0, 0.0)),
           m_primary_screen_scaled_enabled(false),
           m_primary_screen_scaled_offset(0.0, 0.0),
+          m_backbuffer_mutex("QMapControl::m_backbuffer_mutex"),
+          m_backbuffer_queued_mutex("QMapControl::m_backbuffer_queued_mutex"),
           m_progress_indicator(this),
           m_backgroundColor(Qt::transparent),
           m_redrawsEnabled(redrawsEnabled)
@@ -97,6 +104,11 @@ namespace qmapcontrol
         // Connect signals from the Image Manager.
         QObject::connect(&ImageManager::get(), &ImageManager::imageUpdated, this, &QMapControl::requestRedraw);
         QObject::connect(&ImageManager::get(), &ImageManager::downloadingFinished, this, &QMapControl::loadingFinished);
+        QObject::connect(&ImageManager::get(), &ImageManager::tilesPreloaded, this, &QMapControl::requestRedraw);
+
+        // Connect signal/slot to periodically check the memory budgets (started when a budget is set).
+        m_memory_budget_timer.setInterval(int(kDefaultMemoryBudgetCheckInterval.count()));
+        QObject::connect(&m_memory_budget_timer, &QTimer::timeout, this, &QMapControl::checkMemoryBudgets);
 
         // Default - allow the map to gain click focus.
         setFocusPolicy(Qt::ClickFocus);
@@ -125,6 +137,24 @@ namespace qmapcontrol
     {
         // Set whether the scaled primary screen should be visible as a background image.
         m_primary_screen_scaled_enabled = visible;
+
+        // Allocate the scaled primary screen only while it is used.
+        if (m_primary_screen_scaled_enabled)
+        {
+            m_primary_screen_scaled = QPixmap(m_viewport_size_px * 2);
+            m_primary_screen_scaled.fill(Qt::transparent);
+        }
+        else
+        {
+            m_primary_screen_scaled = QPixmap();
+        }
+        m_primary_screen_scaled_offset = PointPx(0.0, 0.0);
+    }
+
+    bool QMapControl::isScaledBackgroundEnabled() const
+    {
+        // Return whether the scaled primary screen is visible as a background image.
+        return m_primary_screen_scaled_enabled;
     }
 
     void QMapControl::enableScalebar(const bool visible)
@@ -153,7 +183,7 @@ namespace qmapcontrol
     const std::vector<std::shared_ptr<Layer> > &QMapControl::getLayers() const
     {
         // Gain a read lock to protect the layers container.
-        QReadLocker locker(&m_layers_mutex);
+        ProfiledReadLocker locker(&m_layers_mutex);
 
         // Return the layers.
         return m_layers;
@@ -202,7 +232,7 @@ namespace qmapcontrol
             // Scope the locker to ensure the mutex is release as soon as possible.
             {
                 // Gain a write lock to protect the layers container.
-                QWriteLocker locker(&m_layers_mutex);
+                ProfiledWriteLocker locker(&m_layers_mutex);
 
                 // Is the index == -1 or greater than current vector size.
                 if (index == -1 || index >= int(m_layers.size()))
@@ -236,7 +266,7 @@ namespace qmapcontrol
             // Scope the locker to ensure the mutex is release as soon as possible.
             {
                 // Gain a write lock to protect the layers container.
-                QWriteLocker locker(&m_layers_mutex);
+                ProfiledWriteLocker locker(&m_layers_mutex);
 
                 // Try to find the layer in question.
                 const auto itr_find = std::find(m_layers.begin(), m_layers.end(), layer);
@@ -324,8 +354,11 @@ namespace qmapcontrol
         // Create new pixmaps with the new size required (2 x viewport size to allow for panning backbuffer).
         m_primary_screen = QPixmap(m_viewport_size_px * 2);
         m_primary_screen.fill(kInitialBufferColor);
-        m_primary_screen_scaled = QPixmap(m_viewport_size_px * 2);
-        m_primary_screen_scaled.fill(Qt::transparent);
+        if (m_primary_screen_scaled_enabled)
+        {
+            m_primary_screen_scaled = QPixmap(m_viewport_size_px * 2);
+            m_primary_screen_scaled.fill(Qt::transparent);
+        }
         m_primary_screen_scaled_offset = PointPx(0.0, 0.0);
 
         // Force the primary screen to be redrawn.
@@ -890,6 +923,117 @@ namespace qmapcontrol
         return m_primary_screen.copy(QRect((m_viewport_center_px + mapFocusPointWorldPx() - m_primary_screen_map_focus_point_px).rawPoint().toPoint(), m_viewport_size_px));
     }
 
+    // Memory management.
+    MemoryReport QMapControl::memoryReport() const
+    {
+        MemoryReport report;
+
+        // Add each layer.
+        {
+            // Gain a read lock to protect the layers container.
+            ProfiledReadLocker locker(&m_layers_mutex);
+            for (const auto& layer : m_layers)
+            {
+                report.layers.emplace_back(layer->getName(), layer->memoryUsage());
+            }
+        }
+
+        // Add the Image Manager tiers.
+        report.tiles = ImageManager::get().memoryUsage();
+
+        // Add the screen buffers (the backbuffer is the same size as the primary screen).
+        report.primary_screen_bytes = memory::pixmapBytes(m_primary_screen);
+        report.scaled_screen_bytes = memory::pixmapBytes(m_primary_screen_scaled);
+        report.backbuffer_bytes = report.primary_screen_bytes;
+
+        // Return the report.
+        return report;
+    }
+
+    void QMapControl::setMemoryBudget(const MemoryBudgetScope scope, const std::size_t budget_bytes, const std::string& layer_name)
+    {
+        // The layer name only applies to layer budgets.
+        const auto key = std::make_pair(scope, scope == MemoryBudgetScope::Layer ? layer_name : std::string());
+
+        // Set or remove the budget (and allow it to be signalled again).
+        if (budget_bytes > 0)
+        {
+            m_memory_budgets[key] = budget_bytes;
+        }
+        else
+        {
+            m_memory_budgets.erase(key);
+        }
+        m_memory_budgets_exceeded.erase(key);
+
+        // Only check periodically while we have budgets.
+        if (m_memory_budgets.empty())
+        {
+            m_memory_budget_timer.stop();
+        }
+        else if (m_memory_budget_timer.isActive() == false)
+        {
+            m_memory_budget_timer.start();
+        }
+    }
+
+    void QMapControl::setMemoryBudgetCheckInterval(const std::chrono::milliseconds& interval)
+    {
+        // Set the timer interval (restarts the timer if active).
+        m_memory_budget_timer.setInterval(int(interval.count()));
+    }
+
+    // Warm start management.
+    bool QMapControl::saveWarmStart(const QString& file_path, const std::size_t hot_tiles_bytes) const
+    {
+        // Capture the view and the primary screen.
+        WarmStartView view;
+        view.epsg = projection::get().epsg();
+        view.tile_size_px = ImageManager::get().tileSizePx();
+        view.zoom = m_current_zoom;
+        view.map_focus_coord = m_map_focus_coord;
+        view.screen_map_focus_point_px = m_primary_screen_map_focus_point_px;
+        view.screen_backbuffer_rect_px = m_primary_screen_backbuffer_rect_px;
+        view.screen = m_primary_screen.toImage();
+
+        // Write the view and the hot tiles.
+        return WarmStartFile::write(file_path, view, ImageManager::get().hotTiles(hot_tiles_bytes));
+    }
+
+    bool QMapControl::loadWarmStart(const QString& file_path)
+    {
+        // Open (memory map) the snapshot.
+        const std::shared_ptr<const WarmStartFile> snapshot = WarmStartFile::open(file_path);
+        if (snapshot == nullptr)
+        {
+            return false;
+        }
+
+        // Check the snapshot was taken with the current projection and tile size.
+        const WarmStartView& view = snapshot->view();
+        if (view.epsg != projection::get().epsg() || view.tile_size_px != ImageManager::get().tileSizePx())
+        {
+            return false;
+        }
+
+        // Restore the view without scheduling a redraw (it would replace the snapshot with loading tiles).
+        const bool redraws_enabled = m_redrawsEnabled;
+        m_redrawsEnabled = false;
+        setZoom(view.zoom);
+        setMapFocusPoint(view.map_focus_coord);
+        m_redrawsEnabled = redraws_enabled;
+
+        // Present the saved primary screen straight away (unless the zoom was out of range).
+        if (view.screen.isNull() == false && m_current_zoom == view.zoom)
+        {
+            updatePrimaryScreen(QPixmap::fromImage(view.screen), view.screen_backbuffer_rect_px, view.screen_map_focus_point_px);
+        }
+
+        // Preload the saved tiles in the background (tilesPreloaded() then requests the redraw).
+        ImageManager::get().preloadTiles(snapshot);
+        return true;
+    }
+
 
     /// Public slots...
     // Zoom management.
@@ -1029,6 +1173,63 @@ namespace qmapcontrol
         redrawPrimaryScreen(true);
     }
 
+    // Memory management.
+    void QMapControl::checkMemoryBudgets()
+    {
+        // Nothing to check without budgets.
+        if (m_memory_budgets.empty())
+        {
+            return;
+        }
+
+        // Fetch the current memory usage.
+        const MemoryReport report = memoryReport();
+
+        // Check each budget.
+        for (const auto& budget : m_memory_budgets)
+        {
+            // Calculate the memory used by the budget's scope.
+            std::size_t used_bytes(0);
+            switch (budget.first.first)
+            {
+                case MemoryBudgetScope::Total:
+                    used_bytes = report.total();
+                    break;
+                case MemoryBudgetScope::Layers:
+                    used_bytes = report.layersTotal();
+                    break;
+                case MemoryBudgetScope::Layer:
+                    for (const auto& layer : report.layers)
+                    {
+                        if (layer.first == budget.first.second)
+                        {
+                            used_bytes = layer.second.total();
+                        }
+                    }
+                    break;
+                case MemoryBudgetScope::TileCache:
+                    used_bytes = report.tiles.total();
+                    break;
+                case MemoryBudgetScope::Buffers:
+                    used_bytes = report.buffersTotal();
+                    break;
+            }
+
+            // Signal once when the budget is exceeded, and re-arm once back within budget.
+            if (used_bytes > budget.second)
+            {
+                if (m_memory_budgets_exceeded.insert(budget.first).second)
+                {
+                    emit memoryBudgetExceeded(budget.first.first, budget.first.second, quint64(used_bytes), quint64(budget.second));
+                }
+            }
+            else
+            {
+                m_memory_budgets_exceeded.erase(budget.first);
+            }
+        }
+    }
+
 
     /// Private...
     // Map management.
@@ -1144,6 +1345,9 @@ namespace qmapcontrol
     // Drawing management.
     void QMapControl::paintEvent(QPaintEvent* paint_event)
     {
+        // Mark the phase (for the stall detector).
+        QMC_PHASE("QMapControl::paintEvent");
+
         // Call inherited QWidgets paint event first.
         QWidget::paintEvent(paint_event);
 
@@ -1352,6 +1556,9 @@ namespace qmapcontrol
 
     void QMapControl::redrawPrimaryScreen(const bool force_redraw)
     {
+        // Mark the phase (for the stall detector).
+        QMC_PHASE("QMapControl::redrawPrimaryScreen");
+
         if (!m_redrawsEnabled) {
             return;
         }
@@ -1384,11 +1591,14 @@ namespace qmapcontrol
         if (m_backbuffer_queued_mutex.tryLock())
         {
             // Get access to the backbuffer mutex.
-            QMutexLocker locker(&m_backbuffer_mutex);
+            ProfiledMutexLocker locker(&m_backbuffer_mutex);
 
             // Release the backbuffer queue mutex, so someone else can wait while we redraw.
             m_backbuffer_queued_mutex.unlock();
 
+            // Trace the redraw.
+            QMC_TRACE_SCOPE("render", "QMapControl::redrawBackbuffer");
+
             // Start the progress indicator as we are going to start the redrawing process
             QTimer::singleShot(0, &m_progress_indicator, &QProgressIndicator::startAnimation);
 
@@ -1414,13 +1624,27 @@ namespace qmapcontrol
             painter_back_buffer.translate(-backbuffer_rect_px.topLeftPx().rawPoint());
 
             // Gain a read lock to protect the layers container.
-            QReadLocker read_locker(&m_layers_mutex);
+            ProfiledReadLocker read_locker(&m_layers_mutex);
+
+            // Find the tiles covered by opaque tiles, front to back (the bottom layer covers nothing).
+            m_tile_occlusion.reset(backbuffer_rect_px, ImageManager::get().tileSizePx(), int(m_layers.size()));
+            for (std::size_t depth = m_layers.size(); depth-- > 1; )
+            {
+                m_tile_occlusion.setDepth(int(depth));
+                m_layers[depth]->occludeTiles(backbuffer_rect_px, m_current_zoom, m_tile_occlusion);
+            }
 
             // Loop through each layer and draw it to the backbuffer.
-            for (std::shared_ptr<Layer> layer : m_layers)
+            for (std::size_t depth = 0; depth < m_layers.size(); ++depth)
             {
-                // Draw the layer to the backbuffer.
-                layer->draw(painter_back_buffer, backbuffer_rect_px, m_current_zoom);
+                const std::shared_ptr<Layer>& layer = m_layers[depth];
+
+                // Trace the layer draw.
+                QMC_TRACE_SCOPE_ARG("render", "Layer::draw", QString::fromStdString(layer->getName()));
+
+                // Draw the layer to the backbuffer (skipping the tiles covered by the layers above, with the tiles looked up meanwhile).
+                m_tile_occlusion.setDepth(int(depth));
+                layer->drawUnoccluded(painter_back_buffer, backbuffer_rect_px, m_current_zoom, m_tile_occlusion);
             }
 
             read_locker.unlock();
@@ -1504,6 +1728,9 @@ namespace qmapcontrol
                                           const RectWorldPx& backbuffer_rect_px,
                                           const PointWorldPx& backbuffer_map_focus_px)
     {
+        // Mark the phase (for the stall detector).
+        QMC_PHASE("QMapControl::updatePrimaryScreen");
+
         // Backbuffer image is ready, save it to the primary screen.
         m_primary_screen = backbuffer_pixmap;
 
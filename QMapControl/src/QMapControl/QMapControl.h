@@ -40,14 +40,20 @@
 
 // STL includes.
 #include <chrono>
+#include <map>
+#include <set>
+#include <utility>
 
 // Local includes.
 #include "qmapcontrol_global.h"
 #include "Geometry.h"
 #include "Layer.h"
+#include "MemoryUsage.h"
 #include "Point.h"
+#include "ProfiledLock.h"
 #include "Projection.h"
 #include "QProgressIndicator.h"
+#include "TileOcclusion.h"
 
 //! QMapControl namespace
 namespace qmapcontrol
@@ -138,6 +144,12 @@ namespace qmapcontrol
          */
         void enableScaledBackground(const bool visible);
 
+        /*!
+         * Whether the scaled primary screen image is displayed during zoom changes in the background.
+         * @return whether the scaled background image is displayed.
+         */
+        bool isScaledBackgroundEnabled() const;
+
         /*!
          * Set whether the scalebar should be displayed within the widget.
          * @param visible Whether the scalebar should be displayed.
@@ -407,6 +419,47 @@ namespace qmapcontrol
          */
         QPixmap getPrimaryScreen() const;
 
+        // Memory management.
+        /*!
+         * Estimate the memory used by each layer, the Image Manager tiers and the screen buffers.
+         * @return the memory report.
+         */
+        MemoryReport memoryReport() const;
+
+        /*!
+         * Set a memory budget: memoryBudgetExceeded() is emitted when a periodic check finds the
+         * scope above its budget (once, until it is back within budget).
+         * @param scope The scope of the budget.
+         * @param budget_bytes The budget in bytes (0 to remove the budget).
+         * @param layer_name The layer name (MemoryBudgetScope::Layer only).
+         */
+        void setMemoryBudget(const MemoryBudgetScope scope, const std::size_t budget_bytes, const std::string& layer_name = std::string());
+
+        /*!
+         * Set how often the memory budgets are checked (default: 5 seconds).
+         * @param interval The interval between checks.
+         */
+        void setMemoryBudgetCheckInterval(const std::chrono::milliseconds& interval);
+
+        // Warm start management.
+        /*!
+         * Save a warm start snapshot (eg: on shutdown): the current view, the primary screen and the
+         * most recently used tiles of the Image Manager's memory cache, decoded, in a memory mappable file.
+         * @param file_path The snapshot file path.
+         * @param hot_tiles_bytes The maximum size of the decoded tiles to save.
+         * @return whether the snapshot was saved.
+         */
+        bool saveWarmStart(const QString& file_path, const std::size_t hot_tiles_bytes = 32 * 1024 * 1024) const;
+
+        /*!
+         * Load a warm start snapshot (eg: on startup): restores the view and presents the saved primary
+         * screen immediately, then preloads the saved tiles into the memory cache in a background thread
+         * and redraws once they are in.
+         * @param file_path The snapshot file path.
+         * @return whether the snapshot was loaded (it is ignored if the projection or tile size changed).
+         */
+        bool loadWarmStart(const QString& file_path);
+
     public slots:
         // Zoom management.
         /*!
@@ -431,6 +484,12 @@ namespace qmapcontrol
          */
         void requestRedraw();
 
+        // Memory management.
+        /*!
+         * Check the memory budgets now (also called periodically while budgets are set).
+         */
+        void checkMemoryBudgets();
+
     private:
         // Map management.
         /*!
@@ -627,6 +686,16 @@ namespace qmapcontrol
         /// Emitted when size is changed
         void resized(const QSize& size);
 
+        // Memory management.
+        /*!
+         * Signal emitted when a memory budget is exceeded (see setMemoryBudget()).
+         * @param scope The scope of the budget.
+         * @param layer_name The layer name (MemoryBudgetScope::Layer only).
+         * @param used_bytes The memory used in bytes.
+         * @param budget_bytes The budget in bytes.
+         */
+        void memoryBudgetExceeded(const MemoryBudgetScope scope, const std::string& layer_name, const quint64 used_bytes, const quint64 budget_bytes);
+
     private:
         /// Whether the scale should be visible.
         bool m_scalebar_enabled;
@@ -638,7 +707,7 @@ namespace qmapcontrol
         std::vector<std::shared_ptr<Layer>> m_layers;
 
         /// Mutex to protect layers.
-        mutable QReadWriteLock m_layers_mutex;
+        mutable ProfiledReadWriteLock m_layers_mutex;
 
         /// Whether layer mouse events are enabled.
         bool m_layer_mouse_events_enabled;
@@ -715,17 +784,20 @@ namespace qmapcontrol
         /// Whether the primary screen scaled is drawn in the background.
         bool m_primary_screen_scaled_enabled;
 
-        /// Primary screen scaled pixmap (zoom in/out).
+        /// Primary screen scaled pixmap (zoom in/out, only allocated while enabled).
         QPixmap m_primary_screen_scaled;
 
         /// Primary screen scaled pixmap offset (wheel events only).
         PointPx m_primary_screen_scaled_offset;
 
         /// Mutex to protect the backbuffer during the redraw process.
-        QMutex m_backbuffer_mutex;
+        ProfiledMutex m_backbuffer_mutex;
+
+        /// The backbuffer tiles covered by opaque tiles (walked front to back, protected by the backbuffer mutex).
+        TileOcclusion m_tile_occlusion;
 
         /// Mutex to only allow only one other thread to wait for the redraw process.
-        QMutex m_backbuffer_queued_mutex;
+        ProfiledMutex m_backbuffer_queued_mutex;
 
         /// Progress indicator to alert user to redrawing progress.
         QProgressIndicator m_progress_indicator;
@@ -736,5 +808,14 @@ namespace qmapcontrol
         /// Whether the redraws of map backbuffer are enabled
         bool m_redrawsEnabled;
 
+        /// Memory budgets in bytes (by scope and layer name).
+        std::map<std::pair<MemoryBudgetScope, std::string>, std::size_t> m_memory_budgets;
+
+        /// Memory budgets currently exceeded (already signalled).
+        std::set<std::pair<MemoryBudgetScope, std::string>> m_memory_budgets_exceeded;
+
+        /// Timer to periodically check the memory budgets.
+        QTimer m_memory_budget_timer;
+
     };
 }
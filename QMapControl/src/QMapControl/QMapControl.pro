@@ -23,6 +23,8 @@ DEFINES += QMAPCONTROL_LIBRARY
 # Add header files.
 HEADERS +=                                      \
     qmapcontrol_global.h                        \
+    CacheRefresher.h                            \
+    CacheWarmer.h                               \
     Geometry.h                                  \
     GeometryLineString.h                        \
     GeometryPoint.h                             \
@@ -34,11 +36,15 @@ HEADERS +=                                      \
     GeometryPointImageScaled.h                  \
     GeometryPolygon.h                           \
     GeometryPolygonImage.h                      \
+    GeometryPool.h                              \
     GeometryWidget.h                            \
     GPS_Position.h                              \
+    Hillshade.h                                 \
     ImageManager.h                              \
     Layer.h                                     \
+    LayerComposite.h                            \
     LayerGeometry.h                             \
+    LayerHillshade.h                            \
     LayerMapAdapter.h                           \
     MapAdapter.h                                \
     MapAdapterGoogle.h                          \
@@ -46,18 +52,38 @@ HEADERS +=                                      \
     MapAdapterTile.h                            \
     MapAdapterWMS.h                             \
     MapAdapterYahoo.h                           \
+    MemoryPressure.h                            \
+    MemoryUsage.h                               \
+    Metrics.h                                   \
     NetworkManager.h                            \
+    Phase.h                                     \
     Point.h                                     \
+    PointStorage.h                              \
+    ProfiledLock.h                              \
     Projection.h                                \
     ProjectionEquirectangular.h                 \
     ProjectionSphericalMercator.h               \
+    ProjectionWorldMercator.h                   \
     QMapControl.h                               \
     QuadTreeContainer.h                         \
+    Scratch.h                                   \
+    SharedTileCache.h                           \
+    SpatialIndex.h                              \
+    StallDetector.h                             \
+    TileColorTransform.h                        \
+    TileDecode.h                                \
+    TileOcclusion.h                             \
+    TileProvider.h                              \
+    Trace.h                                     \
+    WarmStart.h                                 \
+    WriteBehindDiskCache.h                      \
 # Third-party headers: QProgressIndicator
     QProgressIndicator.h                        \
 
 # Add source files.
 SOURCES +=                                      \
+    CacheRefresher.cpp                          \
+    CacheWarmer.cpp                             \
     Geometry.cpp                                \
     GeometryLineString.cpp                      \
     GeometryPoint.cpp                           \
@@ -69,11 +95,15 @@ SOURCES +=                                      \
     GeometryPointImageScaled.cpp                \
     GeometryPolygon.cpp                         \
     GeometryPolygonImage.cpp                    \
+    GeometryPool.cpp                            \
     GeometryWidget.cpp                          \
     GPS_Position.cpp                            \
+    Hillshade.cpp                               \
     ImageManager.cpp                            \
     Layer.cpp                                   \
+    LayerComposite.cpp                          \
     LayerGeometry.cpp                           \
+    LayerHillshade.cpp                          \
     LayerMapAdapter.cpp                         \
     MapAdapter.cpp                              \
     MapAdapterGoogle.cpp                        \
@@ -81,14 +111,45 @@ SOURCES +=                                      \
     MapAdapterTile.cpp                          \
     MapAdapterWMS.cpp                           \
     MapAdapterYahoo.cpp                         \
+    MemoryPressure.cpp                          \
+    MemoryUsage.cpp                             \
+    Metrics.cpp                                 \
     NetworkManager.cpp                          \
+    Phase.cpp                                   \
     Projection.cpp                              \
     ProjectionEquirectangular.cpp               \
     ProjectionSphericalMercator.cpp             \
+    ProjectionWorldMercator.cpp                 \
     QMapControl.cpp                             \
+    SharedTileCache.cpp                         \
+    StallDetector.cpp                           \
+    TileColorTransform.cpp                      \
+    TileDecode.cpp                              \
+    TileOcclusion.cpp                           \
+    TileProvider.cpp                            \
+    WarmStart.cpp                               \
+    WriteBehindDiskCache.cpp                    \
 # Third-party sources: QProgressIndicator
     QProgressIndicator.cpp                      \
 
+# Include tracing-required files.
+contains(DEFINES, QMC_TRACE) {
+    message(Building with tracing support...)
+
+    # Add source files.
+    SOURCES +=                                  \
+        Trace.cpp                               \
+}
+
+# Include lock profiling-required files.
+contains(DEFINES, QMC_LOCK_PROFILE) {
+    message(Building with lock profiling support...)
+
+    # Add source files.
+    SOURCES +=                                  \
+        ProfiledLock.cpp                        \
+}
+
 # Include GDAL-required files.
 contains(DEFINES, QMC_GDAL) {
     message(Building with GDAL support...)
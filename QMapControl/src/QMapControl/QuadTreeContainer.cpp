@@ -74,6 +74,49 @@ namespace qmapcontrol
         }
     }
 
+    void QuadTreeContainer::query(std::vector<std::shared_ptr<Geometry>>& return_points, const RectWorldCoord& range_coord) const
+    {
+        // Normalize the range once for the whole tree.
+        queryRect(return_points, range_coord.rawRect().normalized());
+    }
+
+    void QuadTreeContainer::queryRect(std::vector<std::shared_ptr<Geometry>>& return_points, const QRectF& range_rect) const
+    {
+        // Does the range intersect with our boundary.
+        if (range_rect.intersects(m_boundary_coord.rawRect()))
+        {
+            // Check whether any of our points are contained in the range.
+            for (const auto& point : m_points)
+            {
+                const auto& geometry = point.second;
+
+                // Is the point contained by the query range.
+                if (range_rect.contains(point.first.rawPoint()))
+                {
+                    // Add to the return points.
+                    return_points.push_back(geometry);
+                } else if ((geometry->geometryType() == Geometry::GeometryType::GeometryLineString)
+                           || (geometry->geometryType() == Geometry::GeometryType::GeometryPolygon)) {
+                    // For lines and polygons we also need to check whole bounds
+                    // not just individual constituent points.
+                    if (range_rect.intersects(geometry->boundingBox(0).rawRect().normalized())) {
+                        return_points.push_back(geometry);
+                    }
+                }
+            }
+
+            // Do we have any child quad tree nodes?
+            if (m_child_north_east != nullptr)
+            {
+                // Search each child and add the points they return.
+                m_child_north_east->queryRect(return_points, range_rect);
+                m_child_north_west->queryRect(return_points, range_rect);
+                m_child_south_east->queryRect(return_points, range_rect);
+                m_child_south_west->queryRect(return_points, range_rect);
+            }
+        }
+    }
+
     bool QuadTreeContainer::insert(const PointWorldCoord& point_coord, const std::shared_ptr<Geometry>& object)
     {
         // Keep track of our success.
@@ -182,6 +225,31 @@ namespace qmapcontrol
         m_child_south_west.reset(nullptr);
     }
 
+    std::size_t QuadTreeContainer::memoryUsage(std::set<std::shared_ptr<Geometry>>& return_objects) const
+    {
+        // This node and its entries.
+        std::size_t bytes = sizeof(QuadTreeContainer) + m_points.capacity() * sizeof(m_points.front());
+
+        // Add our objects to the return objects.
+        for (const auto& point : m_points)
+        {
+            return_objects.insert(point.second);
+        }
+
+        // Do we have any child quad tree nodes?
+        if (m_child_north_east != nullptr)
+        {
+            // Add each child.
+            bytes += m_child_north_east->memoryUsage(return_objects);
+            bytes += m_child_north_west->memoryUsage(return_objects);
+            bytes += m_child_south_east->memoryUsage(return_objects);
+            bytes += m_child_south_west->memoryUsage(return_objects);
+        }
+
+        // Return the memory used.
+        return bytes;
+    }
+
     void QuadTreeContainer::subdivide()
     {
         // Calculate half the size of the boundary.
@@ -43,6 +43,8 @@ namespace qmapcontrol
 
     /*!
      * Based on: http://en.wikipedia.org/wiki/Quadtree
+     *
+     * Keyed by points only; see spatial::QuadTree (SpatialIndex.h) for payloads with an extent.
      */    
     class QMAPCONTROL_EXPORT QuadTreeContainer
     {
@@ -71,6 +73,13 @@ namespace qmapcontrol
          */
         void query(std::set<std::shared_ptr<Geometry>>& return_points, const RectWorldCoord& range_coord) const;
 
+        /*!
+         * Fetches objects within the specified bounding box range, without allocating (beyond growing the container).
+         * @param return_points The objects that are within the specified range are appended to this (an object may be appended more than once).
+         * @param range_coord The bounding box range.
+         */
+        void query(std::vector<std::shared_ptr<Geometry>>& return_points, const RectWorldCoord& range_coord) const;
+
         /*!
          * Inserts an object into the quad tree container.
          * @param point_coord The objects's point in coordinates.
@@ -91,7 +100,21 @@ namespace qmapcontrol
          */
         void clear();
 
+        /*!
+         * Fetches all objects and estimates the memory used by the quad tree nodes.
+         * @param return_objects All objects in the quad tree container are added to this.
+         * @return the memory used by the quad tree nodes and entries in bytes (excluding the objects).
+         */
+        std::size_t memoryUsage(std::set<std::shared_ptr<Geometry>>& return_objects) const;
+
     private:  
+        /*!
+         * Fetches objects within the specified (normalized) range.
+         * @param return_points The objects that are within the specified range are appended to this.
+         * @param range_rect The normalized bounding box range.
+         */
+        void queryRect(std::vector<std::shared_ptr<Geometry>>& return_points, const QRectF& range_rect) const;
+
         /*!
          * Creates the child nodes.
          */
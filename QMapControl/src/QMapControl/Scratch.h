@@ -0,0 +1,170 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// Qt includes.
+#include <QtGui/QPainterPath>
+#include <QtCore/QVector>
+#include <QtCore/QtGlobal>
+
+// STL includes.
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+
+/*!
+ * Scratch buffers for the render path temporaries (geometry lists, polygons, painter paths).
+ *
+ * Each thread keeps a pool of buffers per type. A Lease borrows a buffer for a scope and returns it
+ * emptied but with its capacity kept, so once the pools are warm a frame allocates (almost) nothing.
+ * Buffers that grew beyond kMaxRetainedElements are freed instead of kept.
+ */
+namespace qmapcontrol
+{
+    namespace scratch
+    {
+        //! Number of elements a pooled buffer may keep between uses.
+        const int kMaxRetainedElements = 256 * 1024;
+
+        /*!
+         * Empty a std::vector, keeping its capacity.
+         * @param container The vector.
+         */
+        template<typename T>
+        inline void reset(std::vector<T>& container)
+        {
+            if (container.capacity() > std::size_t(kMaxRetainedElements))
+            {
+                std::vector<T>().swap(container);
+            }
+            container.clear();
+        }
+
+        /*!
+         * Empty a QVector (or QPolygonF), keeping its capacity (QVector::clear() frees it before Qt 5.7).
+         * @param container The vector.
+         */
+        template<typename T>
+        inline void reset(QVector<T>& container)
+        {
+            if (container.capacity() > kMaxRetainedElements)
+            {
+                container = QVector<T>();
+            }
+            else
+            {
+                // A reserved capacity is not shrunk by resize().
+                container.reserve(container.capacity());
+                container.resize(0);
+            }
+        }
+
+        /*!
+         * Empty a QPainterPath, keeping its capacity (QPainterPath::clear() is only available since Qt 5.13).
+         * @param path The path.
+         */
+        inline void reset(QPainterPath& path)
+        {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+            if (path.capacity() > kMaxRetainedElements)
+            {
+                path = QPainterPath();
+            }
+            path.clear();
+#else
+            path = QPainterPath();
+#endif
+        }
+
+        //! A buffer borrowed from the current thread's pool for the lifetime of the lease.
+        template<typename Container>
+        class Lease
+        {
+        public:
+            //! Constructor (borrows an empty buffer).
+            Lease() : m_container(acquire()) { }
+
+            //! Disable copy constructor.
+            Lease(const Lease&) = delete;
+
+            //! Disable copy assignment.
+            Lease& operator=(const Lease&) = delete;
+
+            //! Destructor (empties the buffer and returns it to the pool).
+            ~Lease()
+            {
+                reset(*m_container);
+                pool().push_back(std::move(m_container));
+            }
+
+            /*!
+             * Fetch the buffer.
+             * @return the buffer.
+             */
+            Container& operator*() const { return *m_container; }
+
+            /*!
+             * Fetch the buffer.
+             * @return the buffer.
+             */
+            Container* operator->() const { return m_container.get(); }
+
+        private:
+            /*!
+             * Fetch the pool of the current thread.
+             * @return the pool.
+             */
+            static std::vector<std::unique_ptr<Container>>& pool()
+            {
+                static thread_local std::vector<std::unique_ptr<Container>> t_pool;
+                return t_pool;
+            }
+
+            /*!
+             * Take a buffer from the pool (or create one).
+             * @return the buffer.
+             */
+            static std::unique_ptr<Container> acquire()
+            {
+                std::vector<std::unique_ptr<Container>>& buffers = pool();
+                if (buffers.empty())
+                {
+                    return std::unique_ptr<Container>(new Container());
+                }
+                std::unique_ptr<Container> container(std::move(buffers.back()));
+                buffers.pop_back();
+                return container;
+            }
+
+        private:
+            /// The borrowed buffer.
+            std::unique_ptr<Container> m_container;
+        };
+    }
+}
@@ -0,0 +1,482 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "SharedTileCache.h"
+
+// Qt includes.
+#include <QDateTime>
+#include <QDebug>
+#include <QThread>
+
+// STL includes.
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace qmapcontrol
+{
+    // Slots are shared between processes, so their atomics must not rely on a process-local lock.
+    static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "SharedTileCache requires lock-free atomics");
+
+    namespace
+    {
+        /// The segment magic ("QMCT").
+        const quint32 kMagic = 0x54434D51;
+
+        /// The segment layout version.
+        const quint32 kVersion = 2;
+
+        /// Number of slots a tile key may use.
+        const int kWindow = 8;
+
+        /// How long a claim is honoured before another process may fetch the tile (ms).
+        const qint64 kClaimTimeoutMs = 5000;
+
+        /// How long a slot being modified is waited for before it is skipped (ms, eg: its process crashed).
+        const qint64 kSlotLockTimeoutMs = 100;
+
+        /// Alignment of the segment sections.
+        const std::size_t kAlignment = 64;
+
+        /// The slot states.
+        enum SlotState : quint32
+        {
+            SlotEmpty = 0,
+            SlotPending = 1,
+            SlotReady = 2,
+            SlotOversize = 3
+        };
+
+        /// Round a size up to the section alignment.
+        std::size_t align(const std::size_t size)
+        {
+            return (size + kAlignment - 1) / kAlignment * kAlignment;
+        }
+
+        /// Hash a tile key (FNV-1a, stable across processes and builds).
+        quint64 hashKey(const QByteArray& key)
+        {
+            quint64 hash = 14695981039346656037ULL;
+            for (const char byte : key)
+            {
+                hash = (hash ^ quint64(quint8(byte))) * 1099511628211ULL;
+            }
+            return hash;
+        }
+    }
+
+    SharedTileCache::SharedTileCache(const QString& key, const std::size_t capacity_bytes, const std::size_t slot_bytes)
+        : m_memory(key),
+          m_slot_count(0),
+          m_slot_bytes(0),
+          m_slots(nullptr),
+          m_data(nullptr)
+    {
+        // Size a new segment.
+        const int new_slot_count = std::max(kWindow, int(capacity_bytes / std::max<std::size_t>(1, slot_bytes)));
+        const std::size_t new_size = align(sizeof(Header)) + align(new_slot_count * sizeof(Slot)) + new_slot_count * slot_bytes;
+
+        // Create and initialise the segment, or attach to the existing one.
+        if (m_memory.create(int(new_size)))
+        {
+            m_memory.lock();
+            std::memset(m_memory.data(), 0, std::size_t(m_memory.size()));
+            Slot* new_slots = reinterpret_cast<Slot*>(static_cast<char*>(m_memory.data()) + align(sizeof(Header)));
+            for (int i = 0; i < new_slot_count; ++i)
+            {
+                new (&new_slots[i]) Slot();
+            }
+            Header* header = static_cast<Header*>(m_memory.data());
+            header->version = kVersion;
+            header->slot_count = quint32(new_slot_count);
+            header->slot_bytes = quint32(slot_bytes);
+            header->magic = kMagic;
+            m_memory.unlock();
+        }
+        else if (m_memory.error() != QSharedMemory::AlreadyExists || m_memory.attach() == false)
+        {
+            qWarning() << "SharedTileCache: unable to create/attach segment" << key << ":" << m_memory.errorString();
+            return;
+        }
+
+        // Adopt the segment geometry (the creator may still be initialising it).
+        for (int attempt = 0; attempt < 50 && m_slots == nullptr; ++attempt)
+        {
+            m_memory.lock();
+            const Header* header = static_cast<const Header*>(m_memory.constData());
+            if (header->magic == kMagic && header->version == kVersion
+                    && std::size_t(m_memory.size()) >= align(sizeof(Header)) + align(header->slot_count * sizeof(Slot)) + std::size_t(header->slot_count) * header->slot_bytes)
+            {
+                m_slot_count = int(header->slot_count);
+                m_slot_bytes = int(header->slot_bytes);
+                m_slots = reinterpret_cast<Slot*>(static_cast<char*>(m_memory.data()) + align(sizeof(Header)));
+                m_data = static_cast<char*>(m_memory.data()) + align(sizeof(Header)) + align(m_slot_count * sizeof(Slot));
+            }
+            m_memory.unlock();
+            if (m_slots == nullptr)
+            {
+                QThread::msleep(10);
+            }
+        }
+        if (m_slots == nullptr)
+        {
+            qWarning() << "SharedTileCache: incompatible segment" << key;
+            m_memory.detach();
+        }
+    }
+
+    bool SharedTileCache::isAttached() const
+    {
+        // Return whether the slots are available.
+        return m_slots != nullptr;
+    }
+
+    SharedTileCache::Acquire SharedTileCache::acquire(const QByteArray& key, QByteArray& data)
+    {
+        // Without a segment every lookup misses.
+        if (isAttached() == false || key.size() > kMaxKeySize)
+        {
+            return Acquire::Miss;
+        }
+
+        const quint64 hash = hashKey(key);
+        for (int attempt = 0; attempt < kWindow; ++attempt)
+        {
+            // Look for the tile (or a claim on it) in its window.
+            for (int i = 0; i < kWindow; ++i)
+            {
+                const int index = int((hash + quint64(i)) % quint64(m_slot_count));
+                const quint32 state = readSlot(index, key, hash, &data);
+                if (state == SlotReady)
+                {
+                    slot(index).referenced.store(1, std::memory_order_relaxed);
+                    return Acquire::Hit;
+                }
+                else if (state == SlotPending)
+                {
+                    return Acquire::InFlight;
+                }
+                else if (state == SlotOversize)
+                {
+                    // The tile is not shared: every process fetches it itself.
+                    slot(index).referenced.store(1, std::memory_order_relaxed);
+                    return Acquire::Miss;
+                }
+            }
+
+            // Claim a slot, so the other processes wait for this fetch (rescan if the slot changed
+            // since it was chosen).
+            quint32 version = 0;
+            const int index = victimSlot(hash, version);
+            if (index < 0)
+            {
+                return Acquire::Miss;
+            }
+            if (lockSlot(index, version) == false)
+            {
+                continue;
+            }
+            Slot& claimed = slot(index);
+            claimed.hash.store(hash, std::memory_order_relaxed);
+            claimed.key_size.store(quint32(key.size()), std::memory_order_relaxed);
+            std::memcpy(claimed.key, key.constData(), std::size_t(key.size()));
+            claimed.size.store(0, std::memory_order_relaxed);
+            claimed.claimed_ms.store(QDateTime::currentMSecsSinceEpoch(), std::memory_order_relaxed);
+            claimed.referenced.store(1, std::memory_order_relaxed);
+            claimed.state.store(SlotPending, std::memory_order_relaxed);
+            unlockSlot(index);
+
+            // Another process may have claimed the tile meanwhile in another slot: the lowest slot
+            // wins. The fence orders the claim before the lookup, so two racing processes cannot
+            // both miss each other's claim (a claim still being written is waited for, as a slot
+            // being modified reads as empty).
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            waitForWindow(hash, index);
+            const int other = findSlot(key, hash, index);
+            if (other >= 0 && other < index)
+            {
+                if (lockSlot(index, version + 2))
+                {
+                    claimed.state.store(SlotEmpty, std::memory_order_relaxed);
+                    claimed.hash.store(0, std::memory_order_relaxed);
+                    unlockSlot(index);
+                }
+                return Acquire::InFlight;
+            }
+            return Acquire::Elected;
+        }
+
+        // The window kept changing.
+        return Acquire::Miss;
+    }
+
+    void SharedTileCache::insert(const QByteArray& key, const QByteArray& data)
+    {
+        if (isAttached() == false || key.size() > kMaxKeySize)
+        {
+            return;
+        }
+        if (data.isEmpty())
+        {
+            abandon(key);
+            return;
+        }
+
+        // Tiles that do not fit a slot are marked oversize instead, so the processes waiting for
+        // them stop waiting and fetch them themselves.
+        const bool oversize = data.size() > m_slot_bytes;
+
+        // Use the claimed (or existing) slot, else evict one (retry if the slot changed since it
+        // was chosen).
+        const quint64 hash = hashKey(key);
+        for (int attempt = 0; attempt < kWindow; ++attempt)
+        {
+            quint32 version = 0;
+            int index = findSlot(key, hash, -1, &version);
+            if (index < 0)
+            {
+                index = victimSlot(hash, version);
+            }
+            if (index < 0)
+            {
+                return;
+            }
+            if (lockSlot(index, version) == false)
+            {
+                continue;
+            }
+
+            // Store the tile.
+            Slot& stored = slot(index);
+            stored.hash.store(hash, std::memory_order_relaxed);
+            stored.key_size.store(quint32(key.size()), std::memory_order_relaxed);
+            std::memcpy(stored.key, key.constData(), std::size_t(key.size()));
+            if (oversize == false)
+            {
+                std::memcpy(slotData(index), data.constData(), std::size_t(data.size()));
+            }
+            stored.size.store(oversize ? 0 : quint32(data.size()), std::memory_order_relaxed);
+            stored.referenced.store(1, std::memory_order_relaxed);
+            stored.state.store(oversize ? SlotOversize : SlotReady, std::memory_order_relaxed);
+            unlockSlot(index);
+            return;
+        }
+    }
+
+    void SharedTileCache::abandon(const QByteArray& key)
+    {
+        if (isAttached() == false || key.size() > kMaxKeySize)
+        {
+            return;
+        }
+
+        // Empty the slot if it is still claimed for the tile.
+        const quint64 hash = hashKey(key);
+        const int index = findSlot(key, hash);
+        if (index >= 0 && lockSlot(index))
+        {
+            Slot& claimed = slot(index);
+            if (claimed.state.load(std::memory_order_relaxed) == SlotPending && claimed.hash.load(std::memory_order_relaxed) == hash)
+            {
+                claimed.state.store(SlotEmpty, std::memory_order_relaxed);
+                claimed.hash.store(0, std::memory_order_relaxed);
+            }
+            unlockSlot(index);
+        }
+    }
+
+    SharedTileCacheStats SharedTileCache::stats() const
+    {
+        SharedTileCacheStats stats;
+        stats.slot_count = std::size_t(m_slot_count);
+        stats.slot_bytes = std::size_t(m_slot_bytes);
+
+        // Count the slots (a racy but sufficient view).
+        for (int i = 0; i < m_slot_count; ++i)
+        {
+            const quint32 state = slot(i).state.load(std::memory_order_relaxed);
+            if (state == SlotReady)
+            {
+                ++stats.ready;
+                stats.bytes += slot(i).size.load(std::memory_order_relaxed);
+            }
+            else if (state == SlotPending)
+            {
+                ++stats.pending;
+            }
+        }
+
+        // Return the stats.
+        return stats;
+    }
+
+    int SharedTileCache::findSlot(const QByteArray& key, const quint64 hash, const int exclude, quint32* version) const
+    {
+        for (int i = 0; i < kWindow; ++i)
+        {
+            const int index = int((hash + quint64(i)) % quint64(m_slot_count));
+            if (index != exclude && readSlot(index, key, hash, nullptr, version) != SlotEmpty)
+            {
+                return index;
+            }
+        }
+        return -1;
+    }
+
+    void SharedTileCache::waitForWindow(const quint64 hash, const int exclude) const
+    {
+        // Slots are only locked for a few stores, so yield until they are unlocked (a process that
+        // crashed holding a lock is given up on).
+        const qint64 deadline_ms = QDateTime::currentMSecsSinceEpoch() + kSlotLockTimeoutMs;
+        for (int i = 0; i < kWindow; ++i)
+        {
+            const int index = int((hash + quint64(i)) % quint64(m_slot_count));
+            while (index != exclude && (slot(index).version.load(std::memory_order_acquire) & 1) != 0
+                   && QDateTime::currentMSecsSinceEpoch() < deadline_ms)
+            {
+                QThread::yieldCurrentThread();
+            }
+        }
+    }
+
+    int SharedTileCache::victimSlot(const quint64 hash, quint32& version) const
+    {
+        // Prefer an empty slot or an expired claim (slots being modified are skipped).
+        const qint64 now_ms = QDateTime::currentMSecsSinceEpoch();
+        for (int i = 0; i < kWindow; ++i)
+        {
+            const int index = int((hash + quint64(i)) % quint64(m_slot_count));
+            version = slot(index).version.load(std::memory_order_acquire);
+            const quint32 state = slot(index).state.load(std::memory_order_relaxed);
+            if ((version & 1) == 0
+                    && (state == SlotEmpty || (state == SlotPending && now_ms - slot(index).claimed_ms.load(std::memory_order_relaxed) > kClaimTimeoutMs)))
+            {
+                return index;
+            }
+        }
+
+        // Clock: give referenced tiles a second chance, evict the first unreferenced one.
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            for (int i = 0; i < kWindow; ++i)
+            {
+                const int index = int((hash + quint64(i)) % quint64(m_slot_count));
+                version = slot(index).version.load(std::memory_order_acquire);
+                const quint32 state = slot(index).state.load(std::memory_order_relaxed);
+                if ((version & 1) == 0 && (state == SlotReady || state == SlotOversize)
+                        && slot(index).referenced.exchange(0, std::memory_order_relaxed) == 0)
+                {
+                    return index;
+                }
+            }
+        }
+
+        // Every slot is claimed.
+        return -1;
+    }
+
+    quint32 SharedTileCache::readSlot(const int index, const QByteArray& key, const quint64 hash, QByteArray* data, quint32* version_read) const
+    {
+        const Slot& read = slot(index);
+        for (int attempt = 0; attempt < 4; ++attempt)
+        {
+            // Skip while another process modifies the slot.
+            const quint32 version = read.version.load(std::memory_order_acquire);
+            if ((version & 1) != 0)
+            {
+                continue;
+            }
+            if (read.hash.load(std::memory_order_relaxed) != hash)
+            {
+                return SlotEmpty;
+            }
+
+            // Read the slot optimistically.
+            const quint32 state = read.state.load(std::memory_order_relaxed);
+            const quint32 key_size = read.key_size.load(std::memory_order_relaxed);
+            const quint32 size = read.size.load(std::memory_order_relaxed);
+            const qint64 claimed_ms = read.claimed_ms.load(std::memory_order_relaxed);
+            const bool matches = int(key_size) == key.size() && std::memcmp(read.key, key.constData(), std::size_t(key.size())) == 0;
+            if (matches && state == SlotReady && data != nullptr && int(size) <= m_slot_bytes)
+            {
+                *data = QByteArray(slotData(index), int(size));
+            }
+
+            // Retry if the slot was modified meanwhile.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (read.version.load(std::memory_order_relaxed) != version)
+            {
+                continue;
+            }
+            if (matches == false || (state == SlotPending && QDateTime::currentMSecsSinceEpoch() - claimed_ms > kClaimTimeoutMs))
+            {
+                return SlotEmpty;
+            }
+            if (version_read != nullptr)
+            {
+                *version_read = version;
+            }
+            return state;
+        }
+
+        // The slot kept changing.
+        return SlotEmpty;
+    }
+
+    bool SharedTileCache::lockSlot(const int index) const
+    {
+        return lockSlot(index, slot(index).version.load(std::memory_order_relaxed));
+    }
+
+    bool SharedTileCache::lockSlot(const int index, quint32 version) const
+    {
+        // Never wait: a slot being modified by another process (or modified since it was read) is
+        // simply skipped.
+        if ((version & 1) != 0 || slot(index).version.compare_exchange_strong(version, version + 1, std::memory_order_acquire) == false)
+        {
+            return false;
+        }
+
+        // Readers must see the odd version before any of the modifications.
+        std::atomic_thread_fence(std::memory_order_release);
+        return true;
+    }
+
+    void SharedTileCache::unlockSlot(const int index) const
+    {
+        // Publish the modifications.
+        slot(index).version.fetch_add(1, std::memory_order_release);
+    }
+
+    SharedTileCache::Slot& SharedTileCache::slot(const int index) const
+    {
+        return m_slots[index];
+    }
+
+    char* SharedTileCache::slotData(const int index) const
+    {
+        return m_data + std::size_t(index) * std::size_t(m_slot_bytes);
+    }
+}
@@ -0,0 +1,277 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// Qt includes.
+#include <QByteArray>
+#include <QSharedMemory>
+#include <QString>
+
+// STL includes.
+#include <atomic>
+#include <cstddef>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+
+namespace qmapcontrol
+{
+    //! A point in time view of the shared tile cache (see SharedTileCache::stats()).
+    struct QMAPCONTROL_EXPORT SharedTileCacheStats
+    {
+        /// Number of slots.
+        std::size_t slot_count = 0;
+
+        /// Maximum size of a tile in bytes.
+        std::size_t slot_bytes = 0;
+
+        /// Slots holding a tile.
+        std::size_t ready = 0;
+
+        /// Slots claimed by a process that is fetching the tile.
+        std::size_t pending = 0;
+
+        /// Bytes of the tiles held.
+        std::size_t bytes = 0;
+    };
+
+    //! Tile cache shared by the processes of a host, in a shared memory segment.
+    /*!
+     * The segment holds a fixed number of slots, each with room for one encoded tile (the bytes
+     * received from the network or read from the disk cache). A tile key hashes to a small window of
+     * slots; each slot is guarded by a seqlock, so lookups never block and writers only contend for
+     * the slot they modify. Eviction is a clock (second chance) within the window, shared by all
+     * processes.
+     *
+     * A process that misses a tile claims a slot for it: it is elected to fetch the tile and the
+     * other processes see the fetch in flight and wait for it instead of fetching it again. Claims
+     * that are not fulfilled (eg: the process crashed) expire.
+     */
+    class QMAPCONTROL_EXPORT SharedTileCache
+    {
+    public:
+        //! The result of acquire().
+        enum class Acquire
+        {
+            /// The tile was found.
+            Hit,
+            /// Another process is fetching the tile.
+            InFlight,
+            /// This process has been elected to fetch the tile (then insert() or abandon() it).
+            Elected,
+            /// The tile was not found and no slot could be claimed, or it is too large to be shared (fetch it anyway).
+            Miss
+        };
+
+        /// Maximum size of a tile key (an md5 hex).
+        static const int kMaxKeySize = 32;
+
+    public:
+        //! Constructor.
+        /*!
+         * This creates or attaches to the shared segment (an existing segment keeps its geometry).
+         * @param key The segment key (processes using the same key share the cache).
+         * @param capacity_bytes The capacity of the tiles in bytes (for a new segment).
+         * @param slot_bytes The maximum size of a tile in bytes (for a new segment).
+         */
+        SharedTileCache(const QString& key, const std::size_t capacity_bytes, const std::size_t slot_bytes = 64 * 1024);
+
+        //! Disable copy constructor.
+        SharedTileCache(const SharedTileCache&) = delete;
+
+        //! Disable copy assignment.
+        SharedTileCache& operator=(const SharedTileCache&) = delete;
+
+        //! Destructor (detaches from the segment, which is destroyed with its last process).
+        ~SharedTileCache() = default;
+
+        /*!
+         * Whether the segment is attached (if not, every call misses).
+         * @return whether the segment is attached.
+         */
+        bool isAttached() const;
+
+        /*!
+         * Fetch a tile, or claim it to fetch it.
+         * @param key The tile key.
+         * @param data Set to the tile bytes on a hit.
+         * @return the lookup result.
+         */
+        Acquire acquire(const QByteArray& key, QByteArray& data);
+
+        /*!
+         * Store a tile (fulfils the claim, if any).
+         * @param key The tile key.
+         * @param data The tile bytes (if larger than a slot, the tile is marked as not shared instead).
+         */
+        void insert(const QByteArray& key, const QByteArray& data);
+
+        /*!
+         * Release the claim on a tile that could not be fetched.
+         * @param key The tile key.
+         */
+        void abandon(const QByteArray& key);
+
+        /*!
+         * Fetch the current occupancy.
+         * @return the stats.
+         */
+        SharedTileCacheStats stats() const;
+
+    private:
+        //! The segment header.
+        struct Header
+        {
+            /// The segment magic.
+            quint32 magic;
+
+            /// The segment layout version.
+            quint32 version;
+
+            /// Number of slots.
+            quint32 slot_count;
+
+            /// Maximum size of a tile in bytes.
+            quint32 slot_bytes;
+        };
+
+        //! A slot of the index.
+        struct Slot
+        {
+            /// Seqlock version (odd while a process modifies the slot).
+            std::atomic<quint32> version;
+
+            /// The slot state (see SlotState).
+            std::atomic<quint32> state;
+
+            /// Clock reference bit.
+            std::atomic<quint32> referenced;
+
+            /// Size of the tile in bytes.
+            std::atomic<quint32> size;
+
+            /// Hash of the tile key.
+            std::atomic<quint64> hash;
+
+            /// When the slot was claimed (ms since epoch).
+            std::atomic<qint64> claimed_ms;
+
+            /// Size of the tile key.
+            std::atomic<quint32> key_size;
+
+            /// The tile key.
+            char key[kMaxKeySize];
+        };
+
+        /*!
+         * Find the slot holding (or claimed for) a tile.
+         * @param key The tile key.
+         * @param hash The hash of the tile key.
+         * @param exclude A slot to skip (-1 for none).
+         * @param version Set to the slot version read, if found (nullptr to ignore).
+         * @return the slot index, or -1 if not found.
+         */
+        int findSlot(const QByteArray& key, const quint64 hash, const int exclude = -1, quint32* version = nullptr) const;
+
+        /*!
+         * Wait for the slots of a tile's window that another process is modifying (they may hold a claim
+         * on the tile that is not visible yet).
+         * @param hash The hash of the tile key.
+         * @param exclude A slot to skip (-1 for none).
+         */
+        void waitForWindow(const quint64 hash, const int exclude = -1) const;
+
+        /*!
+         * Choose a slot to (re)use for a tile: an empty or expired slot, else an unreferenced tile.
+         * @param hash The hash of the tile key.
+         * @param version Set to the slot version read (lock the slot with it, see lockSlot()).
+         * @return the slot index, or -1 if every slot of the window is busy.
+         */
+        int victimSlot(const quint64 hash, quint32& version) const;
+
+        /*!
+         * Read a slot if it holds (or is claimed for) a tile.
+         * @param index The slot index.
+         * @param key The tile key.
+         * @param hash The hash of the tile key.
+         * @param data Set to the tile bytes if the slot holds the tile (nullptr to only check).
+         * @param version_read Set to the slot version read, if not empty (nullptr to ignore).
+         * @return the slot state seen (empty if the slot holds another tile or its claim expired).
+         */
+        quint32 readSlot(const int index, const QByteArray& key, const quint64 hash, QByteArray* data, quint32* version_read = nullptr) const;
+
+        /*!
+         * Lock a slot for modification (fails if another process is modifying it).
+         * @param index The slot index.
+         * @return whether the slot was locked.
+         */
+        bool lockSlot(const int index) const;
+
+        /*!
+         * Lock a slot for modification if it is unchanged since it was read.
+         * @param index The slot index.
+         * @param version The slot version read.
+         * @return whether the slot was locked (fails if the slot was modified since).
+         */
+        bool lockSlot(const int index, quint32 version) const;
+
+        /*!
+         * Unlock a slot (publishes the modifications).
+         * @param index The slot index.
+         */
+        void unlockSlot(const int index) const;
+
+        /*!
+         * Fetch a slot.
+         * @param index The slot index.
+         * @return the slot.
+         */
+        Slot& slot(const int index) const;
+
+        /*!
+         * Fetch the tile bytes of a slot.
+         * @param index The slot index.
+         * @return the slot's tile bytes.
+         */
+        char* slotData(const int index) const;
+
+    private:
+        /// The shared memory segment.
+        QSharedMemory m_memory;
+
+        /// Number of slots.
+        int m_slot_count;
+
+        /// Maximum size of a tile in bytes.
+        int m_slot_bytes;
+
+        /// The slots.
+        Slot* m_slots;
+
+        /// The slots' tile bytes.
+        char* m_data;
+    };
+}
@@ -0,0 +1,1060 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// STL includes.
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+
+/*!
+ * Spatial indexes over any payload (geometries, track samples, sensor cells...), header-only.
+ *
+ * Each index is parameterised on the payload, the coordinate type and an accessor: a functor that returns
+ * the location of a payload, either as a spatial::Point (point-only payloads, stored and tested as points)
+ * or as a spatial::Box. For example:
+ *
+ *     struct SampleLocation { spatial::Point<double> operator()(const Sample& s) const { return { s.lon, s.lat }; } };
+ *     spatial::QuadTree<Sample, double, SampleLocation> samples(spatial::Box<double>{ -180.0, -90.0, 180.0, 90.0 });
+ *
+ * - QuadTree: dynamic (insert/erase), each payload is kept in the deepest node that contains it.
+ * - PackedRTree: built once from all the payloads (Sort-Tile-Recursive), the most compact and the fastest to query static data.
+ * - UniformGrid: dynamic, for payloads spread evenly and smaller than a cell.
+ *
+ * A payload is found by its location when erased: erase it before moving it, or pass the location it was
+ * inserted at to erase()/update() (it is otherwise searched for in the whole index). The indexes are not
+ * thread safe.
+ */
+namespace qmapcontrol
+{
+    namespace spatial
+    {
+        //! A point.
+        template<typename Coord>
+        struct Point
+        {
+            /// The x coordinate.
+            Coord x;
+
+            /// The y coordinate.
+            Coord y;
+        };
+
+        //! An axis-aligned box (its edges are included).
+        template<typename Coord>
+        struct Box
+        {
+            /// The minimum x coordinate.
+            Coord min_x;
+
+            /// The minimum y coordinate.
+            Coord min_y;
+
+            /// The maximum x coordinate.
+            Coord max_x;
+
+            /// The maximum y coordinate.
+            Coord max_y;
+
+            /*!
+             * Create the box of a point.
+             * @param point The point.
+             * @return the (empty) box at the point.
+             */
+            static Box fromPoint(const Point<Coord>& point)
+            {
+                return Box{ point.x, point.y, point.x, point.y };
+            }
+
+            /*!
+             * Whether the box contains a point.
+             * @param point The point.
+             * @return whether the point is inside the box (or on its edges).
+             */
+            bool contains(const Point<Coord>& point) const
+            {
+                return point.x >= min_x && point.x <= max_x && point.y >= min_y && point.y <= max_y;
+            }
+
+            /*!
+             * Whether the box contains another box.
+             * @param other The other box.
+             * @return whether the other box is inside this box (or on its edges).
+             */
+            bool contains(const Box& other) const
+            {
+                return other.min_x >= min_x && other.max_x <= max_x && other.min_y >= min_y && other.max_y <= max_y;
+            }
+
+            /*!
+             * Whether the box intersects another box.
+             * @param other The other box.
+             * @return whether the boxes overlap (or touch).
+             */
+            bool intersects(const Box& other) const
+            {
+                return other.min_x <= max_x && other.max_x >= min_x && other.min_y <= max_y && other.max_y >= min_y;
+            }
+
+            /*!
+             * Calculate the box that contains this box and another.
+             * @param other The other box.
+             * @return the union of the boxes.
+             */
+            Box united(const Box& other) const
+            {
+                return Box{ std::min(min_x, other.min_x), std::min(min_y, other.min_y), std::max(max_x, other.max_x), std::max(max_y, other.max_y) };
+            }
+        };
+
+        namespace detail
+        {
+            //! The location that an accessor returns for a payload.
+            template<typename Payload, typename Accessor>
+            using Location = typename std::decay<decltype(std::declval<const Accessor&>()(std::declval<const Payload&>()))>::type;
+
+            //! An indexed payload with its location.
+            template<typename Payload, typename Coord, bool kPointPayload>
+            struct Entry;
+
+            //! An indexed point-only payload (stored and tested as a point).
+            template<typename Payload, typename Coord>
+            struct Entry<Payload, Coord, true>
+            {
+                /// The location.
+                Point<Coord> point;
+
+                /// The payload.
+                Payload payload;
+
+                Entry(const Point<Coord>& location, const Payload& entry_payload) : point(location), payload(entry_payload) { }
+
+                Box<Coord> box() const { return Box<Coord>::fromPoint(point); }
+
+                bool intersects(const Box<Coord>& range) const { return range.contains(point); }
+            };
+
+            //! An indexed payload with an extent.
+            template<typename Payload, typename Coord>
+            struct Entry<Payload, Coord, false>
+            {
+                /// The location.
+                Box<Coord> bounds;
+
+                /// The payload.
+                Payload payload;
+
+                Entry(const Box<Coord>& location, const Payload& entry_payload) : bounds(location), payload(entry_payload) { }
+
+                Box<Coord> box() const { return bounds; }
+
+                bool intersects(const Box<Coord>& range) const { return range.intersects(bounds); }
+            };
+
+            /*!
+             * Remove the first entry of a payload (the order of the entries is not kept).
+             * @param entries The entries.
+             * @param payload The payload to remove.
+             * @return whether the payload was found.
+             */
+            template<typename Entry, typename Payload>
+            bool eraseEntry(std::vector<Entry>& entries, const Payload& payload)
+            {
+                for (std::size_t i = 0; i < entries.size(); ++i)
+                {
+                    if (entries[i].payload == payload)
+                    {
+                        std::swap(entries[i], entries.back());
+                        entries.pop_back();
+                        return true;
+                    }
+                }
+                return false;
+            }
+        }
+
+        //! The compile-time properties of an index's accessor.
+        template<typename Payload, typename Coord, typename Accessor>
+        struct AccessorTraits
+        {
+            /// The location of a payload (a spatial::Point or a spatial::Box).
+            using Location = detail::Location<Payload, Accessor>;
+
+            /// Whether the accessor returns points (the payloads are stored and tested as points).
+            static constexpr bool kPointPayload = std::is_same<Location, Point<Coord>>::value;
+
+            static_assert(kPointPayload || std::is_same<detail::Location<Payload, Accessor>, Box<Coord>>::value,
+                          "The accessor must return a spatial::Point<Coord> or a spatial::Box<Coord>.");
+
+            /// The indexed entry.
+            using Entry = detail::Entry<Payload, Coord, kPointPayload>;
+        };
+
+        //! A quad tree of payloads.
+        /*!
+         * A node holds up to its capacity of payloads before it is subdivided; a payload is then moved to the
+         * child that contains it, or stays in the node if it straddles the children (boxes). Payloads outside
+         * the boundary are kept aside and tested by every query.
+         */
+        template<typename Payload, typename Coord, typename Accessor>
+        class QuadTree
+        {
+        public:
+            /// The indexed entry.
+            using Entry = typename AccessorTraits<Payload, Coord, Accessor>::Entry;
+
+            /// The location of a payload.
+            using Location = typename AccessorTraits<Payload, Coord, Accessor>::Location;
+
+            //! Constructor.
+            /*!
+             * @param boundary The area that the quad tree covers.
+             * @param capacity The number of payloads a node holds before it is subdivided.
+             * @param max_depth The maximum depth of the nodes (deeper payloads stay in the deepest nodes).
+             * @param accessor The accessor of the payloads' locations.
+             */
+            explicit QuadTree(const Box<Coord>& boundary, const std::size_t capacity = 50, const int max_depth = 24, const Accessor& accessor = Accessor())
+                : m_capacity(std::max<std::size_t>(1, capacity)),
+                  m_max_depth(max_depth),
+                  m_accessor(accessor),
+                  m_size(0)
+            {
+                m_nodes.push_back(Node(boundary, 0));
+            }
+
+            /*!
+             * Inserts a payload.
+             * @param payload The payload to insert.
+             */
+            void insert(const Payload& payload)
+            {
+                const Entry entry(m_accessor(payload), payload);
+                const Box<Coord> box = entry.box();
+                ++m_size;
+
+                // Keep the payloads outside the boundary aside.
+                if (m_nodes.front().boundary.contains(box) == false)
+                {
+                    m_outside.push_back(entry);
+                    return;
+                }
+
+                // Descend to the deepest node that contains the payload.
+                std::size_t index = 0;
+                while (true)
+                {
+                    // Subdivide full leaves.
+                    if (m_nodes[index].first_child == 0)
+                    {
+                        if (m_nodes[index].entries.size() < m_capacity || m_nodes[index].depth >= m_max_depth)
+                        {
+                            m_nodes[index].entries.push_back(entry);
+                            return;
+                        }
+                        subdivide(index);
+                    }
+
+                    // Does the payload straddle the children?
+                    const std::size_t child = childContaining(index, box);
+                    if (child == 0)
+                    {
+                        m_nodes[index].entries.push_back(entry);
+                        return;
+                    }
+                    index = child;
+                }
+            }
+
+            /*!
+             * Removes a payload (one entry, if it was inserted several times).
+             * @param payload The payload to remove (compared with operator==).
+             * @return whether the payload was found.
+             */
+            bool erase(const Payload& payload)
+            {
+                return erase(payload, m_accessor(payload));
+            }
+
+            /*!
+             * Removes a payload that may have moved since it was inserted (one entry, if it was inserted several times).
+             * @param payload The payload to remove (compared with operator==).
+             * @param location The location the payload was inserted at.
+             * @return whether the payload was found.
+             */
+            bool erase(const Payload& payload, const Location& location)
+            {
+                // Look along the path to its location first.
+                const Box<Coord> box = Entry(location, payload).box();
+                if (m_nodes.front().boundary.contains(box))
+                {
+                    std::size_t index = 0;
+                    do
+                    {
+                        if (detail::eraseEntry(m_nodes[index].entries, payload))
+                        {
+                            --m_size;
+                            return true;
+                        }
+                        index = m_nodes[index].first_child == 0 ? 0 : childContaining(index, box);
+                    }
+                    while (index != 0);
+                }
+
+                // Then everywhere (it may have moved since it was inserted).
+                bool found = detail::eraseEntry(m_outside, payload);
+                for (std::size_t i = 0; found == false && i < m_nodes.size(); ++i)
+                {
+                    found = detail::eraseEntry(m_nodes[i].entries, payload);
+                }
+                if (found)
+                {
+                    --m_size;
+                }
+                return found;
+            }
+
+            /*!
+             * Moves a payload to its current location.
+             * @param payload The payload to move (compared with operator==).
+             * @param old_location The location the payload was inserted at.
+             * @return whether the payload was found (it is inserted either way).
+             */
+            bool update(const Payload& payload, const Location& old_location)
+            {
+                const bool found = erase(payload, old_location);
+                insert(payload);
+                return found;
+            }
+
+            /*!
+             * Removes all payloads.
+             */
+            void clear()
+            {
+                const Box<Coord> boundary = m_nodes.front().boundary;
+                m_nodes.clear();
+                m_nodes.push_back(Node(boundary, 0));
+                m_outside.clear();
+                m_size = 0;
+            }
+
+            /*!
+             * Fetch the number of payloads.
+             * @return the number of payloads.
+             */
+            std::size_t size() const
+            {
+                return m_size;
+            }
+
+            /*!
+             * Visits the payloads within a range (each payload once per insertion).
+             * @param range The range.
+             * @param visitor Called with each payload (const Payload&) within the range.
+             */
+            template<typename Visitor>
+            void visit(const Box<Coord>& range, Visitor&& visitor) const
+            {
+                for (const Entry& entry : m_outside)
+                {
+                    if (entry.intersects(range))
+                    {
+                        visitor(entry.payload);
+                    }
+                }
+                visitNode(0, range, visitor);
+            }
+
+            /*!
+             * Visits all payloads.
+             * @param visitor Called with each payload (const Payload&).
+             */
+            template<typename Visitor>
+            void visitAll(Visitor&& visitor) const
+            {
+                for (const Entry& entry : m_outside)
+                {
+                    visitor(entry.payload);
+                }
+                visitSubtree(0, visitor);
+            }
+
+            /*!
+             * Fetches the payloads within a range.
+             * @param return_payloads The payloads within the range are appended to this.
+             * @param range The range.
+             */
+            void query(std::vector<Payload>& return_payloads, const Box<Coord>& range) const
+            {
+                visit(range, [&return_payloads](const Payload& payload) { return_payloads.push_back(payload); });
+            }
+
+            /*!
+             * Estimates the memory used by the nodes and entries.
+             * @return the memory used in bytes (excluding what the payloads own).
+             */
+            std::size_t memoryUsage() const
+            {
+                std::size_t bytes = sizeof(QuadTree) + m_nodes.capacity() * sizeof(Node) + m_outside.capacity() * sizeof(Entry);
+                for (const Node& node : m_nodes)
+                {
+                    bytes += node.entries.capacity() * sizeof(Entry);
+                }
+                return bytes;
+            }
+
+        private:
+            //! A node (its children are consecutive, the root is never a child).
+            struct Node
+            {
+                Node(const Box<Coord>& node_boundary, const int node_depth) : boundary(node_boundary), first_child(0), depth(node_depth) { }
+
+                /// The area the node covers.
+                Box<Coord> boundary;
+
+                /// The payloads held by the node.
+                std::vector<Entry> entries;
+
+                /// The index of the first child (0 for a leaf).
+                std::size_t first_child;
+
+                /// The depth of the node.
+                int depth;
+            };
+
+            /*!
+             * Find the child of a node that contains a box.
+             * @param index The node.
+             * @param box The box.
+             * @return the index of the child (0 if the box straddles the children).
+             */
+            std::size_t childContaining(const std::size_t index, const Box<Coord>& box) const
+            {
+                const Node& node = m_nodes[index];
+                const Coord centre_x = node.boundary.min_x + (node.boundary.max_x - node.boundary.min_x) / 2;
+                const Coord centre_y = node.boundary.min_y + (node.boundary.max_y - node.boundary.min_y) / 2;
+
+                std::size_t quadrant = 0;
+                if (box.min_x >= centre_x)
+                {
+                    quadrant += 1;
+                }
+                else if (box.max_x >= centre_x)
+                {
+                    return 0;
+                }
+                if (box.min_y >= centre_y)
+                {
+                    quadrant += 2;
+                }
+                else if (box.max_y >= centre_y)
+                {
+                    return 0;
+                }
+                return node.first_child + quadrant;
+            }
+
+            /*!
+             * Creates the children of a node and moves its payloads down.
+             * @param index The node.
+             */
+            void subdivide(const std::size_t index)
+            {
+                // Create the children (west/east, then north/south of the centre).
+                const Box<Coord> boundary = m_nodes[index].boundary;
+                const Coord centre_x = boundary.min_x + (boundary.max_x - boundary.min_x) / 2;
+                const Coord centre_y = boundary.min_y + (boundary.max_y - boundary.min_y) / 2;
+                const int depth = m_nodes[index].depth + 1;
+                const std::size_t first_child = m_nodes.size();
+                m_nodes.push_back(Node(Box<Coord>{ boundary.min_x, boundary.min_y, centre_x, centre_y }, depth));
+                m_nodes.push_back(Node(Box<Coord>{ centre_x, boundary.min_y, boundary.max_x, centre_y }, depth));
+                m_nodes.push_back(Node(Box<Coord>{ boundary.min_x, centre_y, centre_x, boundary.max_y }, depth));
+                m_nodes.push_back(Node(Box<Coord>{ centre_x, centre_y, boundary.max_x, boundary.max_y }, depth));
+                m_nodes[index].first_child = first_child;
+
+                // Move the payloads that fit in a child down.
+                std::vector<Entry> entries;
+                entries.swap(m_nodes[index].entries);
+                for (Entry& entry : entries)
+                {
+                    const std::size_t child = childContaining(index, entry.box());
+                    m_nodes[child == 0 ? index : child].entries.push_back(std::move(entry));
+                }
+            }
+
+            /*!
+             * Visits the payloads of a sub-tree within a range.
+             * @param index The root of the sub-tree.
+             * @param range The range.
+             * @param visitor Called with each payload within the range.
+             */
+            template<typename Visitor>
+            void visitNode(const std::size_t index, const Box<Coord>& range, Visitor& visitor) const
+            {
+                const Node& node = m_nodes[index];
+                if (range.intersects(node.boundary) == false)
+                {
+                    return;
+                }
+
+                // The whole sub-tree is within the range.
+                if (range.contains(node.boundary))
+                {
+                    visitSubtree(index, visitor);
+                    return;
+                }
+
+                // Test the node's payloads, then its children.
+                for (const Entry& entry : node.entries)
+                {
+                    if (entry.intersects(range))
+                    {
+                        visitor(entry.payload);
+                    }
+                }
+                if (node.first_child != 0)
+                {
+                    for (std::size_t child = node.first_child; child < node.first_child + 4; ++child)
+                    {
+                        visitNode(child, range, visitor);
+                    }
+                }
+            }
+
+            /*!
+             * Visits all payloads of a sub-tree.
+             * @param index The root of the sub-tree.
+             * @param visitor Called with each payload.
+             */
+            template<typename Visitor>
+            void visitSubtree(const std::size_t index, Visitor& visitor) const
+            {
+                const Node& node = m_nodes[index];
+                for (const Entry& entry : node.entries)
+                {
+                    visitor(entry.payload);
+                }
+                if (node.first_child != 0)
+                {
+                    for (std::size_t child = node.first_child; child < node.first_child + 4; ++child)
+                    {
+                        visitSubtree(child, visitor);
+                    }
+                }
+            }
+
+        private:
+            /// The number of payloads a node holds before it is subdivided.
+            std::size_t m_capacity;
+
+            /// The maximum depth of the nodes.
+            int m_max_depth;
+
+            /// The accessor of the payloads' locations.
+            Accessor m_accessor;
+
+            /// The nodes (the root first).
+            std::vector<Node> m_nodes;
+
+            /// The payloads outside the boundary.
+            std::vector<Entry> m_outside;
+
+            /// The number of payloads.
+            std::size_t m_size;
+        };
+
+        //! A packed R-tree of payloads, built once from all of them.
+        /*!
+         * The payloads are sorted into leaves of node_size payloads with the Sort-Tile-Recursive packing
+         * (vertical slices sorted by y), and the levels above group node_size boxes each. The tree is stored in
+         * flat arrays (no pointers), so it is compact and cache friendly; build() again to change the payloads.
+         */
+        template<typename Payload, typename Coord, typename Accessor>
+        class PackedRTree
+        {
+        public:
+            /// The indexed entry.
+            using Entry = typename AccessorTraits<Payload, Coord, Accessor>::Entry;
+
+            /// The location of a payload.
+            using Location = typename AccessorTraits<Payload, Coord, Accessor>::Location;
+
+            //! Constructor.
+            /*!
+             * @param node_size The number of payloads per leaf (and children per node).
+             * @param accessor The accessor of the payloads' locations.
+             */
+            explicit PackedRTree(const std::size_t node_size = 16, const Accessor& accessor = Accessor())
+                : m_node_size(std::max<std::size_t>(2, node_size)),
+                  m_accessor(accessor)
+            {
+
+            }
+
+            /*!
+             * Builds the tree from the payloads (replaces the previous ones).
+             * @param payloads The payloads.
+             */
+            void build(const std::vector<Payload>& payloads)
+            {
+                // Fetch the locations.
+                m_entries.clear();
+                m_levels.clear();
+                m_entries.reserve(payloads.size());
+                for (const Payload& payload : payloads)
+                {
+                    m_entries.emplace_back(m_accessor(payload), payload);
+                }
+                if (m_entries.empty())
+                {
+                    return;
+                }
+
+                // Sort by x, then cut into vertical slices of whole leaves sorted by y.
+                const std::size_t leaf_count = (m_entries.size() + m_node_size - 1) / m_node_size;
+                const std::size_t slice_count = std::max<std::size_t>(1, std::size_t(std::ceil(std::sqrt(double(leaf_count)))));
+                const std::size_t slice_size = ((leaf_count + slice_count - 1) / slice_count) * m_node_size;
+                std::sort(m_entries.begin(), m_entries.end(), [](const Entry& a, const Entry& b)
+                {
+                    return a.box().min_x + a.box().max_x < b.box().min_x + b.box().max_x;
+                });
+                for (std::size_t begin = 0; begin < m_entries.size(); begin += slice_size)
+                {
+                    std::sort(m_entries.begin() + std::ptrdiff_t(begin), m_entries.begin() + std::ptrdiff_t(std::min(begin + slice_size, m_entries.size())), [](const Entry& a, const Entry& b)
+                    {
+                        return a.box().min_y + a.box().max_y < b.box().min_y + b.box().max_y;
+                    });
+                }
+
+                // Calculate the boxes of the leaves.
+                std::vector<Box<Coord>> level;
+                level.reserve(leaf_count);
+                for (std::size_t begin = 0; begin < m_entries.size(); begin += m_node_size)
+                {
+                    Box<Coord> box = m_entries[begin].box();
+                    for (std::size_t i = begin + 1; i < std::min(begin + m_node_size, m_entries.size()); ++i)
+                    {
+                        box = box.united(m_entries[i].box());
+                    }
+                    level.push_back(box);
+                }
+                m_levels.push_back(std::move(level));
+
+                // Group the boxes of each level up to the root.
+                while (m_levels.back().size() > 1)
+                {
+                    const std::vector<Box<Coord>>& below = m_levels.back();
+                    std::vector<Box<Coord>> above;
+                    above.reserve((below.size() + m_node_size - 1) / m_node_size);
+                    for (std::size_t begin = 0; begin < below.size(); begin += m_node_size)
+                    {
+                        Box<Coord> box = below[begin];
+                        for (std::size_t i = begin + 1; i < std::min(begin + m_node_size, below.size()); ++i)
+                        {
+                            box = box.united(below[i]);
+                        }
+                        above.push_back(box);
+                    }
+                    m_levels.push_back(std::move(above));
+                }
+            }
+
+            /*!
+             * Removes all payloads.
+             */
+            void clear()
+            {
+                m_entries.clear();
+                m_levels.clear();
+            }
+
+            /*!
+             * Fetch the number of payloads.
+             * @return the number of payloads.
+             */
+            std::size_t size() const
+            {
+                return m_entries.size();
+            }
+
+            /*!
+             * Visits the payloads within a range.
+             * @param range The range.
+             * @param visitor Called with each payload (const Payload&) within the range.
+             */
+            template<typename Visitor>
+            void visit(const Box<Coord>& range, Visitor&& visitor) const
+            {
+                if (m_levels.empty() == false)
+                {
+                    visitNode(m_levels.size() - 1, 0, range, visitor);
+                }
+            }
+
+            /*!
+             * Visits all payloads.
+             * @param visitor Called with each payload (const Payload&).
+             */
+            template<typename Visitor>
+            void visitAll(Visitor&& visitor) const
+            {
+                for (const Entry& entry : m_entries)
+                {
+                    visitor(entry.payload);
+                }
+            }
+
+            /*!
+             * Fetches the payloads within a range.
+             * @param return_payloads The payloads within the range are appended to this.
+             * @param range The range.
+             */
+            void query(std::vector<Payload>& return_payloads, const Box<Coord>& range) const
+            {
+                visit(range, [&return_payloads](const Payload& payload) { return_payloads.push_back(payload); });
+            }
+
+            /*!
+             * Estimates the memory used by the nodes and entries.
+             * @return the memory used in bytes (excluding what the payloads own).
+             */
+            std::size_t memoryUsage() const
+            {
+                std::size_t bytes = sizeof(PackedRTree) + m_entries.capacity() * sizeof(Entry) + m_levels.capacity() * sizeof(std::vector<Box<Coord>>);
+                for (const auto& level : m_levels)
+                {
+                    bytes += level.capacity() * sizeof(Box<Coord>);
+                }
+                return bytes;
+            }
+
+        private:
+            /*!
+             * Visits the payloads of a node within a range.
+             * @param level The level of the node (0 for a leaf).
+             * @param index The node within its level.
+             * @param range The range.
+             * @param visitor Called with each payload within the range.
+             */
+            template<typename Visitor>
+            void visitNode(const std::size_t level, const std::size_t index, const Box<Coord>& range, Visitor& visitor) const
+            {
+                if (range.intersects(m_levels[level][index]) == false)
+                {
+                    return;
+                }
+
+                // Test the payloads of a leaf, or visit the children.
+                const std::size_t begin = index * m_node_size;
+                if (level == 0)
+                {
+                    for (std::size_t i = begin; i < std::min(begin + m_node_size, m_entries.size()); ++i)
+                    {
+                        if (m_entries[i].intersects(range))
+                        {
+                            visitor(m_entries[i].payload);
+                        }
+                    }
+                }
+                else
+                {
+                    for (std::size_t i = begin; i < std::min(begin + m_node_size, m_levels[level - 1].size()); ++i)
+                    {
+                        visitNode(level - 1, i, range, visitor);
+                    }
+                }
+            }
+
+        private:
+            /// The number of payloads per leaf (and children per node).
+            std::size_t m_node_size;
+
+            /// The accessor of the payloads' locations.
+            Accessor m_accessor;
+
+            /// The payloads, in leaf order.
+            std::vector<Entry> m_entries;
+
+            /// The boxes of the nodes of each level (the leaves first, the root last).
+            std::vector<std::vector<Box<Coord>>> m_levels;
+        };
+
+        //! A uniform grid of payloads.
+        /*!
+         * Each payload is kept in the cell of its minimum corner (payloads outside the boundary in the nearest
+         * edge cell), and queries extend their range by the largest payload, so a payload is only visited once.
+         */
+        template<typename Payload, typename Coord, typename Accessor>
+        class UniformGrid
+        {
+        public:
+            /// The indexed entry.
+            using Entry = typename AccessorTraits<Payload, Coord, Accessor>::Entry;
+
+            /// The location of a payload.
+            using Location = typename AccessorTraits<Payload, Coord, Accessor>::Location;
+
+            //! Constructor.
+            /*!
+             * @param boundary The area that the grid covers.
+             * @param cell_size The width and height of a cell.
+             * @param accessor The accessor of the payloads' locations.
+             */
+            UniformGrid(const Box<Coord>& boundary, const Coord cell_size, const Accessor& accessor = Accessor())
+                : m_boundary(boundary),
+                  m_cell_size(cell_size > Coord(0) ? cell_size : Coord(1)),
+                  m_accessor(accessor),
+                  m_columns(cellCount(boundary.max_x - boundary.min_x)),
+                  m_rows(cellCount(boundary.max_y - boundary.min_y)),
+                  m_cells(m_columns * m_rows),
+                  m_max_width(0),
+                  m_max_height(0),
+                  m_size(0)
+            {
+
+            }
+
+            /*!
+             * Inserts a payload.
+             * @param payload The payload to insert.
+             */
+            void insert(const Payload& payload)
+            {
+                const Entry entry(m_accessor(payload), payload);
+                const Box<Coord> box = entry.box();
+
+                // Remember the largest payload (to extend the queries by).
+                m_max_width = std::max(m_max_width, Coord(box.max_x - box.min_x));
+                m_max_height = std::max(m_max_height, Coord(box.max_y - box.min_y));
+
+                // Add the payload to the cell of its minimum corner.
+                m_cells[column(box.min_x) + row(box.min_y) * m_columns].push_back(entry);
+                ++m_size;
+            }
+
+            /*!
+             * Removes a payload (one entry, if it was inserted several times).
+             * @param payload The payload to remove (compared with operator==).
+             * @return whether the payload was found.
+             */
+            bool erase(const Payload& payload)
+            {
+                return erase(payload, m_accessor(payload));
+            }
+
+            /*!
+             * Removes a payload that may have moved since it was inserted (one entry, if it was inserted several times).
+             * @param payload The payload to remove (compared with operator==).
+             * @param location The location the payload was inserted at.
+             * @return whether the payload was found.
+             */
+            bool erase(const Payload& payload, const Location& location)
+            {
+                // Look in the cell of its location first, then everywhere (it may have moved since it was inserted).
+                const Box<Coord> box = Entry(location, payload).box();
+                bool found = detail::eraseEntry(m_cells[column(box.min_x) + row(box.min_y) * m_columns], payload);
+                for (std::size_t i = 0; found == false && i < m_cells.size(); ++i)
+                {
+                    found = detail::eraseEntry(m_cells[i], payload);
+                }
+                if (found)
+                {
+                    --m_size;
+                }
+                return found;
+            }
+
+            /*!
+             * Moves a payload to its current location.
+             * @param payload The payload to move (compared with operator==).
+             * @param old_location The location the payload was inserted at.
+             * @return whether the payload was found (it is inserted either way).
+             */
+            bool update(const Payload& payload, const Location& old_location)
+            {
+                const bool found = erase(payload, old_location);
+                insert(payload);
+                return found;
+            }
+
+            /*!
+             * Removes all payloads.
+             */
+            void clear()
+            {
+                for (auto& cell : m_cells)
+                {
+                    std::vector<Entry>().swap(cell);
+                }
+                m_max_width = 0;
+                m_max_height = 0;
+                m_size = 0;
+            }
+
+            /*!
+             * Fetch the number of payloads.
+             * @return the number of payloads.
+             */
+            std::size_t size() const
+            {
+                return m_size;
+            }
+
+            /*!
+             * Visits the payloads within a range.
+             * @param range The range.
+             * @param visitor Called with each payload (const Payload&) within the range.
+             */
+            template<typename Visitor>
+            void visit(const Box<Coord>& range, Visitor&& visitor) const
+            {
+                // The cells of the payloads that may reach into the range.
+                const std::size_t first_column = column(range.min_x - m_max_width);
+                const std::size_t last_column = column(range.max_x);
+                const std::size_t first_row = row(range.min_y - m_max_height);
+                const std::size_t last_row = row(range.max_y);
+                for (std::size_t y = first_row; y <= last_row; ++y)
+                {
+                    for (std::size_t x = first_column; x <= last_column; ++x)
+                    {
+                        for (const Entry& entry : m_cells[x + y * m_columns])
+                        {
+                            if (entry.intersects(range))
+                            {
+                                visitor(entry.payload);
+                            }
+                        }
+                    }
+                }
+            }
+
+            /*!
+             * Visits all payloads.
+             * @param visitor Called with each payload (const Payload&).
+             */
+            template<typename Visitor>
+            void visitAll(Visitor&& visitor) const
+            {
+                for (const auto& cell : m_cells)
+                {
+                    for (const Entry& entry : cell)
+                    {
+                        visitor(entry.payload);
+                    }
+                }
+            }
+
+            /*!
+             * Fetches the payloads within a range.
+             * @param return_payloads The payloads within the range are appended to this.
+             * @param range The range.
+             */
+            void query(std::vector<Payload>& return_payloads, const Box<Coord>& range) const
+            {
+                visit(range, [&return_payloads](const Payload& payload) { return_payloads.push_back(payload); });
+            }
+
+            /*!
+             * Estimates the memory used by the cells and entries.
+             * @return the memory used in bytes (excluding what the payloads own).
+             */
+            std::size_t memoryUsage() const
+            {
+                std::size_t bytes = sizeof(UniformGrid) + m_cells.capacity() * sizeof(std::vector<Entry>);
+                for (const auto& cell : m_cells)
+                {
+                    bytes += cell.capacity() * sizeof(Entry);
+                }
+                return bytes;
+            }
+
+        private:
+            /*!
+             * Calculate the number of cells across an extent.
+             * @param extent The extent.
+             * @return the number of cells (at least 1).
+             */
+            std::size_t cellCount(const Coord extent) const
+            {
+                return extent > Coord(0) ? std::size_t(extent / m_cell_size) + 1 : 1;
+            }
+
+            /*!
+             * Find the column of an x coordinate.
+             * @param x The x coordinate.
+             * @return the column (clamped to the grid).
+             */
+            std::size_t column(const Coord x) const
+            {
+                return x <= m_boundary.min_x ? 0 : std::min(m_columns - 1, std::size_t((x - m_boundary.min_x) / m_cell_size));
+            }
+
+            /*!
+             * Find the row of a y coordinate.
+             * @param y The y coordinate.
+             * @return the row (clamped to the grid).
+             */
+            std::size_t row(const Coord y) const
+            {
+                return y <= m_boundary.min_y ? 0 : std::min(m_rows - 1, std::size_t((y - m_boundary.min_y) / m_cell_size));
+            }
+
+        private:
+            /// The area the grid covers.
+            Box<Coord> m_boundary;
+
+            /// The width and height of a cell.
+            Coord m_cell_size;
+
+            /// The accessor of the payloads' locations.
+            Accessor m_accessor;
+
+            /// The number of columns.
+            std::size_t m_columns;
+
+            /// The number of rows.
+            std::size_t m_rows;
+
+            /// The payloads of each cell (row by row).
+            std::vector<std::vector<Entry>> m_cells;
+
+            /// The width of the widest payload.
+            Coord m_max_width;
+
+            /// The height of the tallest payload.
+            Coord m_max_height;
+
+            /// The number of payloads.
+            std::size_t m_size;
+        };
+    }
+}
@@ -0,0 +1,228 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "StallDetector.h"
+
+// Qt includes.
+#include <QCoreApplication>
+#include <QDebug>
+#include <QStringList>
+
+// STL includes.
+#include <algorithm>
+
+namespace qmapcontrol
+{
+    namespace
+    {
+        /// Name of the phase stack key when no library phase is active.
+        const QString kApplicationPhase = "(application)";
+
+        /// Join phase names into a phase stack key.
+        QString phaseKey(const std::vector<QString>& phases)
+        {
+            QStringList names;
+            for (const auto& name : phases)
+            {
+                names.append(name);
+            }
+            return names.isEmpty() ? kApplicationPhase : names.join(" > ");
+        }
+    }
+
+    bool StallReport::inLibrary() const
+    {
+        // Was a library phase active?
+        return phases.empty() == false;
+    }
+
+    QString StallReport::toString() const
+    {
+        // Describe the duration and the phases.
+        QString description = QString("GUI thread stalled for %1 ms at %2 in %3").arg(duration_ms).arg(started.toString("yyyy-MM-dd hh:mm:ss.zzz")).arg(phaseKey(phases));
+
+        // Add the other phase stacks seen while stalled.
+        for (const auto& sample : phase_samples)
+        {
+            description += QString(", %1: %2 samples").arg(sample.first.isEmpty() ? kApplicationPhase : sample.first).arg(sample.second);
+        }
+
+        // Return the description.
+        return description;
+    }
+
+    StallDetector::StallDetector(const std::chrono::milliseconds& threshold, QObject* parent)
+        : QObject(parent),
+          m_threshold(threshold),
+          m_gui_phases(&phase::current()),
+          m_last_heartbeat_ns(0),
+          m_stopping(false),
+          m_stalled(false)
+    {
+        // Register meta types.
+        qRegisterMetaType<StallReport>("qmapcontrol::StallReport");
+
+        // Connect signal/slot for the heartbeat (a precise timer, so late beats are stalls).
+        m_heartbeat_timer.setTimerType(Qt::PreciseTimer);
+        connect(&m_heartbeat_timer, &QTimer::timeout, this, &StallDetector::heartbeat);
+    }
+
+    StallDetector::~StallDetector()
+    {
+        // Ensure the watchdog thread has finished.
+        stop();
+    }
+
+    void StallDetector::start()
+    {
+        // Ensure we are not already running.
+        stop();
+
+        // Reset the state.
+        m_last_heartbeat_ns.store(now());
+        m_stopping = false;
+        m_stalled = false;
+        m_stall = StallReport();
+
+        // Beat 4 times per threshold.
+        m_heartbeat_timer.start(std::max(1, int(m_threshold.count() / 4)));
+
+        // Start the watchdog.
+        m_watchdog.reset(new Watchdog(*this));
+        m_watchdog->setObjectName("QMapControl stall detector");
+        m_watchdog->start();
+    }
+
+    void StallDetector::stop()
+    {
+        // Stop the heartbeat.
+        m_heartbeat_timer.stop();
+
+        // Stop the watchdog.
+        if (m_watchdog != nullptr)
+        {
+            {
+                QMutexLocker locker(&m_mutex);
+                m_stopping = true;
+                m_stop_condition.wakeAll();
+            }
+            m_watchdog->wait();
+            m_watchdog.reset();
+        }
+    }
+
+    bool StallDetector::isRunning() const
+    {
+        // Return whether the watchdog is running.
+        return m_watchdog != nullptr;
+    }
+
+    void StallDetector::setThreshold(const std::chrono::milliseconds& threshold)
+    {
+        // Set the threshold.
+        m_threshold = threshold;
+    }
+
+    void StallDetector::heartbeat()
+    {
+        // Calculate how late this beat is.
+        const qint64 now_ns = now();
+        const qint64 gap_ns = now_ns - m_last_heartbeat_ns.exchange(now_ns);
+        const qint64 late_ns = gap_ns - qint64(m_heartbeat_timer.interval()) * 1000000;
+
+        // Fetch the stall in progress (detected by the watchdog).
+        StallReport report;
+        bool stalled(false);
+        {
+            QMutexLocker locker(&m_mutex);
+            stalled = m_stalled;
+            if (stalled)
+            {
+                report = m_stall;
+                m_stalled = false;
+            }
+        }
+
+        // Report the stall now that we have recovered.
+        if (stalled || late_ns > qint64(m_threshold.count()) * 1000000)
+        {
+            report.duration_ms = std::max<qint64>(0, late_ns / 1000000);
+            if (report.started.isValid() == false)
+            {
+                report.started = QDateTime::currentDateTime().addMSecs(-report.duration_ms);
+            }
+            emit stallDetected(report);
+        }
+    }
+
+    void StallDetector::watch()
+    {
+        const qint64 threshold_ns = qint64(m_threshold.count()) * 1000000;
+        const unsigned long check_interval_ms = std::max(1, int(m_threshold.count() / 4));
+
+        QMutexLocker locker(&m_mutex);
+        while (m_stopping == false)
+        {
+            // Wait for the next check (or the stop request).
+            m_stop_condition.wait(&m_mutex, check_interval_ms);
+            if (m_stopping)
+            {
+                break;
+            }
+
+            // Is the heartbeat late?
+            const qint64 late_ns = now() - m_last_heartbeat_ns.load();
+            if (late_ns <= threshold_ns)
+            {
+                continue;
+            }
+
+            // Read the GUI thread's phases.
+            std::vector<QString> phases;
+            for (const char* name : phase::read(*m_gui_phases))
+            {
+                phases.push_back(QString::fromLatin1(name));
+            }
+
+            // Start a new stall?
+            if (m_stalled == false)
+            {
+                m_stalled = true;
+                m_stall = StallReport();
+                m_stall.started = QDateTime::currentDateTime().addMSecs(-late_ns / 1000000);
+                m_stall.phases = phases;
+                qWarning() << "QMapControl: GUI thread not responding for" << late_ns / 1000000 << "ms in" << phaseKey(phases);
+            }
+
+            // Sample the phases while stalled.
+            ++m_stall.phase_samples[phases.empty() ? QString() : phaseKey(phases)];
+        }
+    }
+
+    qint64 StallDetector::now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
@@ -0,0 +1,207 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// Qt includes.
+#include <QDateTime>
+#include <QMetaType>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QTimer>
+#include <QWaitCondition>
+
+// STL includes.
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <vector>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+#include "Phase.h"
+
+namespace qmapcontrol
+{
+    //! A GUI thread stall (see StallDetector).
+    struct QMAPCONTROL_EXPORT StallReport
+    {
+        /// When the stall started.
+        QDateTime started;
+
+        /// How long the GUI thread did not process events (ms).
+        qint64 duration_ms = 0;
+
+        /// The library phases active when the stall was detected, outermost first (empty if none).
+        std::vector<QString> phases;
+
+        /// How often each phase stack was seen while stalled ("outer > inner", empty for none).
+        std::map<QString, int> phase_samples;
+
+        /*!
+         * Whether the stall happened in a library phase (otherwise it was in the application).
+         * @return whether a library phase was active.
+         */
+        bool inLibrary() const;
+
+        /*!
+         * Describe the stall.
+         * @return a one line description.
+         */
+        QString toString() const;
+    };
+
+    //! Watchdog that detects when the GUI thread stops processing events.
+    /*!
+     * A heartbeat timer runs in the GUI thread and a watchdog thread checks it. When the heartbeat
+     * is late by more than the threshold, the watchdog samples the GUI thread's library phases
+     * (see Phase.h) until the GUI thread recovers, then stallDetected() is emitted in the GUI thread.
+     *
+     * The detector must be created in the GUI thread and is stopped until start() is called.
+     */
+    class QMAPCONTROL_EXPORT StallDetector : public QObject
+    {
+        Q_OBJECT
+    public:
+        //! Constructor.
+        /*!
+         * This constructs a stopped stall detector.
+         * @param threshold How long the GUI thread must not process events to be a stall.
+         * @param parent QObject parent ownership.
+         */
+        explicit StallDetector(const std::chrono::milliseconds& threshold = std::chrono::milliseconds(250), QObject* parent = nullptr);
+
+        //! Disable copy constructor.
+        StallDetector(const StallDetector&) = delete;
+
+        //! Disable copy assignment.
+        StallDetector& operator=(const StallDetector&) = delete;
+
+        //! Destructor (stops the watchdog).
+        ~StallDetector();
+
+        /*!
+         * Start the heartbeat and the watchdog thread.
+         */
+        void start();
+
+        /*!
+         * Stop the heartbeat and the watchdog thread.
+         */
+        void stop();
+
+        /*!
+         * Whether the detector is running.
+         * @return whether the detector is running.
+         */
+        bool isRunning() const;
+
+        /*!
+         * Set the stall threshold (applies on the next start()).
+         * @param threshold How long the GUI thread must not process events to be a stall.
+         */
+        void setThreshold(const std::chrono::milliseconds& threshold);
+
+    signals:
+        /*!
+         * Signal emitted (in the GUI thread) when the GUI thread has recovered from a stall.
+         * @param report The stall report.
+         */
+        void stallDetected(const qmapcontrol::StallReport& report);
+
+    private slots:
+        /*!
+         * Slot called by the heartbeat timer in the GUI thread.
+         */
+        void heartbeat();
+
+    private:
+        //! The watchdog thread.
+        class Watchdog : public QThread
+        {
+        public:
+            /*!
+             * Constructor.
+             * @param detector The detector to watch for.
+             */
+            explicit Watchdog(StallDetector& detector) : m_detector(detector) { }
+
+        protected:
+            //! Check the heartbeat until stopped.
+            void run() override { m_detector.watch(); }
+
+        private:
+            /// The detector to watch for.
+            StallDetector& m_detector;
+        };
+
+        /*!
+         * Check the heartbeat until stopped (runs in the watchdog thread).
+         */
+        void watch();
+
+        /*!
+         * Fetch the detector clock.
+         * @return a monotonic time (ns).
+         */
+        static qint64 now();
+
+    private:
+        /// The stall threshold.
+        std::chrono::milliseconds m_threshold;
+
+        /// The heartbeat timer (GUI thread).
+        QTimer m_heartbeat_timer;
+
+        /// The watchdog thread.
+        std::unique_ptr<Watchdog> m_watchdog;
+
+        /// The phase stack of the GUI thread.
+        const phase::Stack* m_gui_phases;
+
+        /// When the GUI thread last processed the heartbeat (ns).
+        std::atomic<qint64> m_last_heartbeat_ns;
+
+        /// Mutex to protect the stop request and the stall in progress.
+        QMutex m_mutex;
+
+        /// Wakes the watchdog thread when stopping.
+        QWaitCondition m_stop_condition;
+
+        /// Whether the watchdog thread should stop.
+        bool m_stopping;
+
+        /// Whether the watchdog has detected a stall in progress.
+        bool m_stalled;
+
+        /// The stall in progress (phases and samples).
+        StallReport m_stall;
+    };
+}
+
+Q_DECLARE_METATYPE(qmapcontrol::StallReport)
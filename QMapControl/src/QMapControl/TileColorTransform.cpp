@@ -0,0 +1,328 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "TileColorTransform.h"
+
+// Qt includes.
+#include <QtCore/QCryptographicHash>
+
+// STL includes.
+#include <algorithm>
+#include <cmath>
+
+// SIMD includes.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QMC_COLOR_TRANSFORM_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace qmapcontrol
+{
+    namespace
+    {
+        /*!
+         * Round and clamp a channel value.
+         * @param value The channel value.
+         * @return the channel value (0-255).
+         */
+        inline int clampChannel(const float value)
+        {
+            return std::min(255, std::max(0, int(std::floor(value + 0.5f))));
+        }
+
+        /*!
+         * Create the lookup table of an affine channel transform.
+         * @param scale The scale factor.
+         * @param offset The offset (0-255).
+         * @return the lookup table.
+         */
+        TileColorTransform::Lut affineLut(const float scale, const float offset)
+        {
+            TileColorTransform::Lut lut;
+            for (int i = 0; i < 256; ++i)
+            {
+                lut[i] = quint8(clampChannel(float(i) * scale + offset));
+            }
+            return lut;
+        }
+
+#ifdef QMC_COLOR_TRANSFORM_SSE2
+        /*!
+         * Round and clamp 4 channel values (as clampChannel(): the values are offset by a half, clamped
+         * and truncated, so halves round up rather than to even).
+         * @param values The channel values.
+         * @return the channel values (0-255).
+         */
+        inline __m128i clampChannels(const __m128 values)
+        {
+            const __m128 rounded = _mm_add_ps(values, _mm_set1_ps(0.5f));
+            return _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(rounded, _mm_setzero_ps()), _mm_set1_ps(255.0f)));
+        }
+#endif
+
+        /*!
+         * Apply a colour matrix to 32-bit pixels.
+         * @param pixels The pixels.
+         * @param count The number of pixels.
+         * @param m The colour matrix.
+         */
+        void applyMatrix(QRgb* pixels, const int count, const TileColorTransform::Matrix& m)
+        {
+            int i = 0;
+#ifdef QMC_COLOR_TRANSFORM_SSE2
+            // 4 pixels at a time, a register per channel (the products are summed in the scalar order, so the results match).
+            const __m128 m0 = _mm_set1_ps(m[0]), m1 = _mm_set1_ps(m[1]), m2 = _mm_set1_ps(m[2]), m3 = _mm_set1_ps(m[3]);
+            const __m128 m4 = _mm_set1_ps(m[4]), m5 = _mm_set1_ps(m[5]), m6 = _mm_set1_ps(m[6]), m7 = _mm_set1_ps(m[7]);
+            const __m128 m8 = _mm_set1_ps(m[8]), m9 = _mm_set1_ps(m[9]), m10 = _mm_set1_ps(m[10]), m11 = _mm_set1_ps(m[11]);
+            const __m128i channel_mask = _mm_set1_epi32(0xFF);
+            const __m128i alpha_mask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+
+            for (; i + 4 <= count; i += 4)
+            {
+                // Unpack the channels of the 4 pixels to floats.
+                const __m128i pixel = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i));
+                const __m128 red = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixel, 16), channel_mask));
+                const __m128 green = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixel, 8), channel_mask));
+                const __m128 blue = _mm_cvtepi32_ps(_mm_and_si128(pixel, channel_mask));
+
+                // Multiply the channels by each row.
+                const __m128i new_red = clampChannels(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, red), _mm_mul_ps(m1, green)), _mm_mul_ps(m2, blue)), m3));
+                const __m128i new_green = clampChannels(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m4, red), _mm_mul_ps(m5, green)), _mm_mul_ps(m6, blue)), m7));
+                const __m128i new_blue = clampChannels(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m8, red), _mm_mul_ps(m9, green)), _mm_mul_ps(m10, blue)), m11));
+
+                // Pack the pixels (keeping alpha).
+                __m128i result = _mm_or_si128(_mm_and_si128(pixel, alpha_mask), _mm_slli_epi32(new_red, 16));
+                result = _mm_or_si128(result, _mm_or_si128(_mm_slli_epi32(new_green, 8), new_blue));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i), result);
+            }
+#endif
+            // The remaining pixels (all of them without SSE2).
+            for (; i < count; ++i)
+            {
+                const float red = float(qRed(pixels[i]));
+                const float green = float(qGreen(pixels[i]));
+                const float blue = float(qBlue(pixels[i]));
+                pixels[i] = qRgba(clampChannel(m[0] * red + m[1] * green + m[2] * blue + m[3]),
+                                  clampChannel(m[4] * red + m[5] * green + m[6] * blue + m[7]),
+                                  clampChannel(m[8] * red + m[9] * green + m[10] * blue + m[11]),
+                                  qAlpha(pixels[i]));
+            }
+        }
+
+        /*!
+         * Apply lookup tables to 32-bit pixels.
+         * @param pixels The pixels.
+         * @param count The number of pixels.
+         * @param luts The lookup tables (red, green then blue).
+         */
+        void applyLuts(QRgb* pixels, const int count, const std::array<TileColorTransform::Lut, 3>& luts)
+        {
+            // Table lookups do not vectorise without gathers, so this is a plain branch-free loop.
+            for (int i = 0; i < count; ++i)
+            {
+                const QRgb pixel = pixels[i];
+                pixels[i] = qRgba(luts[0][qRed(pixel)], luts[1][qGreen(pixel)], luts[2][qBlue(pixel)], qAlpha(pixel));
+            }
+        }
+    }
+
+    TileColorTransform::TileColorTransform()
+    {
+
+    }
+
+    TileColorTransform TileColorTransform::matrix(const Matrix& matrix)
+    {
+        // Create the transform.
+        TileColorTransform transform;
+        Step step;
+        step.is_matrix = true;
+        step.matrix = matrix;
+        transform.append(step);
+        transform.updateCacheKey();
+        return transform;
+    }
+
+    TileColorTransform TileColorTransform::lut(const Lut& red, const Lut& green, const Lut& blue)
+    {
+        // Create the transform.
+        TileColorTransform transform;
+        Step step;
+        step.is_matrix = false;
+        step.luts = {{ red, green, blue }};
+        transform.append(step);
+        transform.updateCacheKey();
+        return transform;
+    }
+
+    TileColorTransform TileColorTransform::lut(const Lut& lut)
+    {
+        return TileColorTransform::lut(lut, lut, lut);
+    }
+
+    TileColorTransform TileColorTransform::invert()
+    {
+        // Per channel transforms are exact as lookup tables (and fold with other tables).
+        return lut(affineLut(-1.0f, 255.0f));
+    }
+
+    TileColorTransform TileColorTransform::grayscale()
+    {
+        // Rec. 709 luminance for each channel.
+        const float r = 0.2126f;
+        const float g = 0.7152f;
+        const float b = 0.0722f;
+        return matrix({{ r, g, b, 0.0f,
+                         r, g, b, 0.0f,
+                         r, g, b, 0.0f }});
+    }
+
+    TileColorTransform TileColorTransform::brightnessContrast(const double brightness, const double contrast)
+    {
+        // Scale around mid-gray, then offset.
+        return lut(affineLut(float(contrast), float(128.0 - 128.0 * contrast + brightness * 255.0)));
+    }
+
+    TileColorTransform TileColorTransform::then(const TileColorTransform& next) const
+    {
+        // Append the next transform's steps.
+        TileColorTransform transform(*this);
+        for (const auto& step : next.m_steps)
+        {
+            transform.append(step);
+        }
+        transform.updateCacheKey();
+        return transform;
+    }
+
+    bool TileColorTransform::isIdentity() const
+    {
+        return m_steps.empty();
+    }
+
+    const QByteArray& TileColorTransform::cacheKey() const
+    {
+        return m_cache_key;
+    }
+
+    void TileColorTransform::apply(QImage& image) const
+    {
+        // Nothing to do?
+        if (m_steps.empty() || image.isNull())
+        {
+            return;
+        }
+
+        // The kernels work on (non-premultiplied) 32-bit pixels.
+        if (image.format() != QImage::Format_RGB32 && image.format() != QImage::Format_ARGB32)
+        {
+            image = image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+        }
+
+        // Apply each step, a scanline at a time.
+        const int width = image.width();
+        for (int y = 0; y < image.height(); ++y)
+        {
+            QRgb* pixels = reinterpret_cast<QRgb*>(image.scanLine(y));
+            for (const auto& step : m_steps)
+            {
+                if (step.is_matrix)
+                {
+                    applyMatrix(pixels, width, step.matrix);
+                }
+                else
+                {
+                    applyLuts(pixels, width, step.luts);
+                }
+            }
+        }
+    }
+
+    void TileColorTransform::append(const Step& step)
+    {
+        // Is the step of a different kind to the last one?
+        if (m_steps.empty() || m_steps.back().is_matrix != step.is_matrix)
+        {
+            m_steps.push_back(step);
+        }
+        else if (step.is_matrix)
+        {
+            // Fold the matrices (the intermediate colour is no longer clamped).
+            const Matrix& p = m_steps.back().matrix;
+            const Matrix& n = step.matrix;
+            Matrix folded;
+            for (int row = 0; row < 3; ++row)
+            {
+                for (int column = 0; column < 4; ++column)
+                {
+                    folded[row * 4 + column] = n[row * 4 + 0] * p[column]
+                                             + n[row * 4 + 1] * p[4 + column]
+                                             + n[row * 4 + 2] * p[8 + column];
+                }
+                folded[row * 4 + 3] += n[row * 4 + 3];
+            }
+            m_steps.back().matrix = folded;
+        }
+        else
+        {
+            // Fold the lookup tables.
+            for (int channel = 0; channel < 3; ++channel)
+            {
+                Lut& lut = m_steps.back().luts[channel];
+                for (auto& value : lut)
+                {
+                    value = step.luts[channel][value];
+                }
+            }
+        }
+    }
+
+    void TileColorTransform::updateCacheKey()
+    {
+        // The identity has no key.
+        if (m_steps.empty())
+        {
+            m_cache_key.clear();
+            return;
+        }
+
+        // Hash the steps.
+        QCryptographicHash hash(QCryptographicHash::Md5);
+        for (const auto& step : m_steps)
+        {
+            if (step.is_matrix)
+            {
+                hash.addData("m", 1);
+                hash.addData(reinterpret_cast<const char*>(step.matrix.data()), int(sizeof(step.matrix)));
+            }
+            else
+            {
+                hash.addData("l", 1);
+                hash.addData(reinterpret_cast<const char*>(step.luts.data()), int(sizeof(step.luts)));
+            }
+        }
+        m_cache_key = hash.result().toHex();
+    }
+}
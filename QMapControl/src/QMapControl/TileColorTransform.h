@@ -0,0 +1,163 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// Qt includes.
+#include <QtCore/QByteArray>
+#include <QtGui/QImage>
+
+// STL includes.
+#include <array>
+#include <vector>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+
+namespace qmapcontrol
+{
+    //! Colour transform applied to tiles when they are decoded (eg: night mode, grayscale, dimming).
+    /*!
+     * A transform is a sequence of colour matrices and lookup tables, built from the factory
+     * functions and chained with then(). Consecutive matrices (and consecutive lookup tables)
+     * are folded into one, so a transform costs at most one pass per kind of step. Alpha is kept.
+     *
+     * The transform is applied once per tile (see TileDecodeOptions) and the transformed tiles
+     * are cached under cacheKey(), rather than blending over the whole screen on every frame.
+     */
+    class QMAPCONTROL_EXPORT TileColorTransform
+    {
+    public:
+        /// A colour matrix: 3 rows (red, green, blue) of the red, green and blue factors and an offset (0-255).
+        using Matrix = std::array<float, 12>;
+
+        /// A lookup table of one channel.
+        using Lut = std::array<quint8, 256>;
+
+    public:
+        //! Constructor (identity).
+        TileColorTransform();
+
+        /*!
+         * Create a colour matrix transform.
+         * @param matrix The colour matrix.
+         * @return the transform.
+         */
+        static TileColorTransform matrix(const Matrix& matrix);
+
+        /*!
+         * Create a lookup table transform.
+         * @param red The red channel lookup table.
+         * @param green The green channel lookup table.
+         * @param blue The blue channel lookup table.
+         * @return the transform.
+         */
+        static TileColorTransform lut(const Lut& red, const Lut& green, const Lut& blue);
+
+        /*!
+         * Create a lookup table transform (the same table for every channel).
+         * @param lut The lookup table.
+         * @return the transform.
+         */
+        static TileColorTransform lut(const Lut& lut);
+
+        /*!
+         * Create a transform that inverts the colours.
+         * @return the transform.
+         */
+        static TileColorTransform invert();
+
+        /*!
+         * Create a transform to grayscale (Rec. 709 luminance).
+         * @return the transform.
+         */
+        static TileColorTransform grayscale();
+
+        /*!
+         * Create a brightness/contrast transform.
+         * @param brightness The brightness offset (-1 to 1, 0 for none, eg: -0.3 to dim).
+         * @param contrast The contrast factor around mid-gray (1 for none).
+         * @return the transform.
+         */
+        static TileColorTransform brightnessContrast(const double brightness, const double contrast = 1.0);
+
+        /*!
+         * Chain a transform after this one.
+         * @param next The transform to apply after this one.
+         * @return the chained transform.
+         */
+        TileColorTransform then(const TileColorTransform& next) const;
+
+        /*!
+         * Whether the transform leaves the colours unchanged.
+         * @return whether the transform is the identity.
+         */
+        bool isIdentity() const;
+
+        /*!
+         * Fetch the key that identifies the transform (for the cache).
+         * @return the key (empty for the identity).
+         */
+        const QByteArray& cacheKey() const;
+
+        /*!
+         * Apply the transform to an image.
+         * @param image The image to transform (converted to 32-bit ARGB/RGB).
+         */
+        void apply(QImage& image) const;
+
+    private:
+        //! A step of the transform.
+        struct Step
+        {
+            /// Whether the step is a colour matrix (otherwise lookup tables).
+            bool is_matrix;
+
+            /// The colour matrix.
+            Matrix matrix;
+
+            /// The lookup tables (red, green then blue).
+            std::array<Lut, 3> luts;
+        };
+
+        /*!
+         * Append a step, folding it into the last step when they are of the same kind.
+         * @param step The step to append.
+         */
+        void append(const Step& step);
+
+        /*!
+         * Update the cache key from the steps.
+         */
+        void updateCacheKey();
+
+    private:
+        /// The steps, in order.
+        std::vector<Step> m_steps;
+
+        /// The key that identifies the transform.
+        QByteArray m_cache_key;
+    };
+}
@@ -0,0 +1,292 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "TileDecode.h"
+
+// Qt includes.
+#include <QtCore/QBuffer>
+#include <QtGui/QImageReader>
+
+// STL includes.
+#include <algorithm>
+
+namespace qmapcontrol
+{
+    namespace
+    {
+        /*!
+         * Round a scale divisor down to a power of two (that JPEG can downscale by while decoding).
+         * @param scale_divisor The scale divisor.
+         * @return the supported scale divisor (1, 2, 4 or 8).
+         */
+        int supportedScaleDivisor(const int scale_divisor)
+        {
+            int supported = 1;
+            while (supported * 2 <= std::min(scale_divisor, 8))
+            {
+                supported *= 2;
+            }
+            return supported;
+        }
+
+        /*!
+         * Calculate the reduced size of a tile.
+         * @param size The full size.
+         * @param options The decode options.
+         * @return the reduced size (at least 1x1).
+         */
+        QSize scaledSize(const QSize& size, const TileDecodeOptions& options)
+        {
+            return QSize(std::max(1, size.width() / options.scale_divisor), std::max(1, size.height() / options.scale_divisor));
+        }
+
+        /// JPEG markers.
+        const uchar kMarkerSOF0 = 0xC0;
+        const uchar kMarkerSOF2 = 0xC2;
+        const uchar kMarkerSOF15 = 0xCF;
+        const uchar kMarkerDHT = 0xC4;
+        const uchar kMarkerJPG = 0xC8;
+        const uchar kMarkerDAC = 0xCC;
+        const uchar kMarkerRST0 = 0xD0;
+        const uchar kMarkerRST7 = 0xD7;
+        const uchar kMarkerSOI = 0xD8;
+        const uchar kMarkerEOI = 0xD9;
+        const uchar kMarkerSOS = 0xDA;
+        const uchar kMarkerTEM = 0x01;
+    }
+
+    TileDecodeOptions::TileDecodeOptions(const int scale_divisor, const TileColorTransform& color_transform)
+        : scale_divisor(supportedScaleDivisor(scale_divisor)),
+          color_transform(color_transform)
+    {
+
+    }
+
+    bool TileDecodeOptions::isDefault() const
+    {
+        // Full size tiles without a colour transform.
+        return scale_divisor == 1 && color_transform.isIdentity();
+    }
+
+    QByteArray TileDecodeOptions::cacheKeySuffix() const
+    {
+        // The default options have no suffix (their entries are the plain tile entries).
+        QByteArray suffix;
+        if (scale_divisor != 1)
+        {
+            suffix += "/scale:" + QByteArray::number(scale_divisor);
+        }
+        if (color_transform.isIdentity() == false)
+        {
+            suffix += "/color:" + color_transform.cacheKey();
+        }
+        return suffix;
+    }
+
+    namespace tiledecode
+    {
+        QImage decode(QIODevice* device, const TileDecodeOptions& options)
+        {
+            QImageReader reader(device);
+
+            // Ask the reader to decode at the reduced size (JPEG scales while decoding, others scale after).
+            if (options.scale_divisor > 1)
+            {
+                const QSize size = reader.size();
+                if (size.isValid())
+                {
+                    reader.setScaledSize(scaledSize(size, options));
+                }
+            }
+
+            // Decode the tile.
+            QImage image = reader.read();
+
+            // Did the reader not know the size beforehand?
+            if (options.scale_divisor > 1 && image.isNull() == false && reader.scaledSize().isValid() == false)
+            {
+                image = image.scaled(scaledSize(image.size(), options), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            }
+
+            // Apply the colour transform.
+            options.color_transform.apply(image);
+            return image;
+        }
+
+        QImage apply(const QImage& image, const TileDecodeOptions& options)
+        {
+            // Nothing to do?
+            if (image.isNull())
+            {
+                return image;
+            }
+
+            // Downscale the tile.
+            QImage result = image;
+            if (options.scale_divisor > 1)
+            {
+                result = image.scaled(scaledSize(image.size(), options), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            }
+
+            // Apply the colour transform.
+            options.color_transform.apply(result);
+            return result;
+        }
+
+        TileOpacity classify(const QImage& image)
+        {
+            // Nothing to classify?
+            if (image.isNull())
+            {
+                return TileOpacity::Mixed;
+            }
+
+            // Formats without an alpha channel are opaque.
+            if (image.hasAlphaChannel() == false)
+            {
+                return TileOpacity::Opaque;
+            }
+
+            // Scan the alpha of each row (AND/OR of the pixels, stopping at the first row that has both).
+            const QImage argb = (image.format() == QImage::Format_ARGB32 || image.format() == QImage::Format_ARGB32_Premultiplied) ? image : image.convertToFormat(QImage::Format_ARGB32);
+            QRgb all_pixels = 0xFFFFFFFF;
+            QRgb any_pixel = 0;
+            for (int y = 0; y < argb.height(); ++y)
+            {
+                const QRgb* line = reinterpret_cast<const QRgb*>(argb.constScanLine(y));
+                for (int x = 0; x < argb.width(); ++x)
+                {
+                    all_pixels &= line[x];
+                    any_pixel |= line[x];
+                }
+                if (qAlpha(all_pixels) != 255 && qAlpha(any_pixel) != 0)
+                {
+                    return TileOpacity::Mixed;
+                }
+            }
+
+            // Every pixel is opaque, or every pixel is transparent.
+            return qAlpha(all_pixels) == 255 ? TileOpacity::Opaque : TileOpacity::Transparent;
+        }
+
+        int progressiveScansLength(const QByteArray& data)
+        {
+            const uchar* bytes = reinterpret_cast<const uchar*>(data.constData());
+            const int size = data.size();
+
+            // Check the start of image marker.
+            if (size < 4 || bytes[0] != 0xFF || bytes[1] != kMarkerSOI)
+            {
+                return 0;
+            }
+
+            // Walk the marker segments, skipping the entropy-coded data of each scan.
+            bool progressive = false;
+            int complete_length = 0;
+            int i = 2;
+            while (i + 1 < size)
+            {
+                // Markers start with 0xFF (possibly repeated as fill bytes).
+                if (bytes[i] != 0xFF)
+                {
+                    return complete_length;
+                }
+                const uchar marker = bytes[i + 1];
+                if (marker == 0xFF)
+                {
+                    ++i;
+                    continue;
+                }
+
+                // The image is complete (the caller decodes it in full).
+                if (marker == kMarkerEOI)
+                {
+                    return complete_length;
+                }
+
+                // Standalone markers have no length.
+                if (marker == kMarkerTEM || (marker >= kMarkerRST0 && marker <= kMarkerRST7))
+                {
+                    i += 2;
+                    continue;
+                }
+
+                // Read the segment length.
+                if (i + 3 >= size)
+                {
+                    return complete_length;
+                }
+                const int segment_end = i + 2 + ((int(bytes[i + 2]) << 8) | int(bytes[i + 3]));
+
+                // Only progressive frames refine the whole tile with each scan.
+                if (marker >= kMarkerSOF0 && marker <= kMarkerSOF15 && marker != kMarkerDHT && marker != kMarkerJPG && marker != kMarkerDAC)
+                {
+                    if (marker != kMarkerSOF2)
+                    {
+                        return 0;
+                    }
+                    progressive = true;
+                }
+
+                // Skip the entropy-coded data of a scan, up to the next marker (0xFF00 is a stuffed 0xFF).
+                if (marker == kMarkerSOS)
+                {
+                    if (progressive == false)
+                    {
+                        return 0;
+                    }
+                    i = segment_end;
+                    while (i + 1 < size && (bytes[i] != 0xFF || bytes[i + 1] == 0x00 || (bytes[i + 1] >= kMarkerRST0 && bytes[i + 1] <= kMarkerRST7)))
+                    {
+                        ++i;
+                    }
+
+                    // The scan is complete once the next marker has arrived.
+                    if (i + 1 < size)
+                    {
+                        complete_length = i;
+                    }
+                    continue;
+                }
+                i = segment_end;
+            }
+            return complete_length;
+        }
+
+        QImage decodeScans(const QByteArray& data, const int length)
+        {
+            // Close the complete scans with an end of image marker.
+            QByteArray scans = data.left(length);
+            scans.append(char(0xFF));
+            scans.append(char(kMarkerEOI));
+
+            // Decode them (the missing scans leave the tile coarser).
+            QBuffer buffer(&scans);
+            buffer.open(QIODevice::ReadOnly);
+            QImageReader reader(&buffer, "jpeg");
+            return reader.read();
+        }
+    }
+}
@@ -0,0 +1,125 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// Qt includes.
+#include <QtCore/QByteArray>
+#include <QtCore/QIODevice>
+#include <QtGui/QImage>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+#include "TileColorTransform.h"
+
+namespace qmapcontrol
+{
+    //! How a tile is decoded (see ImageManager::getImage() and LayerMapAdapter::setTileDecodeOptions()).
+    /*!
+     * Each set of options has its own entries in the memory cache.
+     */
+    struct QMAPCONTROL_EXPORT TileDecodeOptions
+    {
+        /// Decode the tile at 1/scale_divisor of its size (1, 2, 4 or 8), eg: for previews and low-detail layers.
+        int scale_divisor;
+
+        /// The colour transform applied to the tile once decoded (eg: night mode).
+        TileColorTransform color_transform;
+
+        /*!
+         * Constructor.
+         * @param scale_divisor The scale divisor (rounded down to 1, 2, 4 or 8).
+         * @param color_transform The colour transform.
+         */
+        TileDecodeOptions(const int scale_divisor = 1, const TileColorTransform& color_transform = TileColorTransform());
+
+        /*!
+         * Whether these are the default options (full size tiles).
+         * @return whether these are the default options (full size, no colour transform).
+         */
+        bool isDefault() const;
+
+        /*!
+         * Fetch the suffix that tells the options' memory cache entries apart.
+         * @return the suffix (empty for the default options).
+         */
+        QByteArray cacheKeySuffix() const;
+    };
+
+    //! How opaque a tile is (classified when it is decoded, see ImageManager::tileOpacity()).
+    enum class TileOpacity
+    {
+        /// Partly transparent (or not classified).
+        Mixed,
+        /// Fully opaque: the tiles below it are hidden.
+        Opaque,
+        /// Fully transparent: nothing to draw.
+        Transparent
+    };
+
+    namespace tiledecode
+    {
+        /*!
+         * Decode a tile with the options. The tile is decoded directly at the reduced size where the format supports
+         * it (JPEG downscales in the DCT domain), otherwise it is decoded in full and downscaled. The colour transform
+         * is then applied.
+         * @param device The encoded tile.
+         * @param options The decode options.
+         * @return the decoded tile (null if it could not be decoded).
+         */
+        QMAPCONTROL_EXPORT QImage decode(QIODevice* device, const TileDecodeOptions& options);
+
+        /*!
+         * Apply the options to a tile decoded at full size (downscale and colour transform).
+         * @param image The full size tile.
+         * @param options The decode options.
+         * @return the tile as if decoded with the options.
+         */
+        QMAPCONTROL_EXPORT QImage apply(const QImage& image, const TileDecodeOptions& options);
+
+        /*!
+         * Classify how opaque a decoded tile is.
+         * @param image The decoded tile.
+         * @return whether the tile is fully opaque, fully transparent or mixed (a null tile is mixed).
+         */
+        QMAPCONTROL_EXPORT TileOpacity classify(const QImage& image);
+
+        /*!
+         * Find the complete scans of a progressive JPEG that is still arriving (each scan refines the whole tile).
+         * @param data The start of the encoded tile.
+         * @return the length of the data up to the end of the last complete scan (0 if the data is not a
+         * progressive JPEG, or has no complete scan yet).
+         */
+        QMAPCONTROL_EXPORT int progressiveScansLength(const QByteArray& data);
+
+        /*!
+         * Decode the complete scans of a progressive JPEG that is still arriving.
+         * @param data The start of the encoded tile.
+         * @param length The length of the complete scans (see progressiveScansLength()).
+         * @return the tile at the detail of the complete scans (null if it could not be decoded).
+         */
+        QMAPCONTROL_EXPORT QImage decodeScans(const QByteArray& data, const int length);
+    }
+}
@@ -0,0 +1,130 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "TileOcclusion.h"
+
+// STL includes.
+#include <algorithm>
+#include <cmath>
+
+namespace qmapcontrol
+{
+    TileOcclusion::TileOcclusion()
+        : m_left(0),
+          m_top(0),
+          m_columns(0),
+          m_rows(0),
+          m_depth(0),
+          m_empty(true),
+          m_layer_count(0)
+    {
+
+    }
+
+    void TileOcclusion::reset(const RectWorldPx& backbuffer_rect_px, const int tile_size_px, const int layer_count)
+    {
+        // Calculate the tiles of the backbuffer (as the layers do).
+        m_left = int(std::floor(backbuffer_rect_px.leftPx() / double(tile_size_px)));
+        m_top = int(std::floor(backbuffer_rect_px.topPx() / double(tile_size_px)));
+        m_columns = std::max(0, int(std::floor(backbuffer_rect_px.rightPx() / double(tile_size_px))) - m_left + 1);
+        m_rows = std::max(0, int(std::floor(backbuffer_rect_px.bottomPx() / double(tile_size_px))) - m_top + 1);
+
+        // Uncover the tiles.
+        m_depth = 0;
+        m_empty = true;
+        m_occluder_depths.assign(std::size_t(m_columns) * std::size_t(m_rows), -1);
+
+        // Forget the tiles looked up (releasing their pixmaps).
+        m_layer_count = std::max(0, layer_count);
+        m_tiles.assign(m_occluder_depths.size() * std::size_t(m_layer_count), Tile());
+        m_tiles_set.assign(m_tiles.size(), false);
+    }
+
+    void TileOcclusion::setDepth(const int depth)
+    {
+        // Set the depth.
+        m_depth = depth;
+    }
+
+    bool TileOcclusion::isOccluded(const int x, const int y) const
+    {
+        // Is the tile covered by a layer above?
+        const int i = index(x, y);
+        return i >= 0 && m_occluder_depths[std::size_t(i)] > m_depth;
+    }
+
+    void TileOcclusion::occlude(const int x, const int y)
+    {
+        // Keep the top most layer covering the tile.
+        const int i = index(x, y);
+        if (i >= 0 && m_occluder_depths[std::size_t(i)] < m_depth)
+        {
+            m_occluder_depths[std::size_t(i)] = m_depth;
+            m_empty = false;
+        }
+    }
+
+    void TileOcclusion::setTile(const int x, const int y, const Tile& tile)
+    {
+        // Keep the tile for the layer at the current depth.
+        const int i = index(x, y);
+        if (i >= 0 && m_depth >= 0 && m_depth < m_layer_count)
+        {
+            const std::size_t tile_index = std::size_t(m_depth) * m_occluder_depths.size() + std::size_t(i);
+            m_tiles[tile_index] = tile;
+            m_tiles_set[tile_index] = true;
+        }
+    }
+
+    const TileOcclusion::Tile* TileOcclusion::findTile(const int x, const int y) const
+    {
+        // Was the tile looked up by the layer at the current depth?
+        const int i = index(x, y);
+        if (i < 0 || m_depth < 0 || m_depth >= m_layer_count)
+        {
+            return nullptr;
+        }
+        const std::size_t tile_index = std::size_t(m_depth) * m_occluder_depths.size() + std::size_t(i);
+        return m_tiles_set[tile_index] ? &m_tiles[tile_index] : nullptr;
+    }
+
+    bool TileOcclusion::isEmpty() const
+    {
+        // Return whether any tile is covered.
+        return m_empty;
+    }
+
+    int TileOcclusion::index(const int x, const int y) const
+    {
+        // Is the tile outside the backbuffer?
+        if (x < m_left || y < m_top || x >= m_left + m_columns || y >= m_top + m_rows)
+        {
+            return -1;
+        }
+
+        // Return the index.
+        return (y - m_top) * m_columns + (x - m_left);
+    }
+}
@@ -0,0 +1,160 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// Qt includes.
+#include <QtCore/QUrl>
+#include <QtGui/QPixmap>
+
+// STL includes.
+#include <vector>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+#include "Point.h"
+#include "TileDecode.h"
+
+namespace qmapcontrol
+{
+    //! The tiles of a backbuffer covered by opaque tiles (see Layer::occludeTiles() and Layer::drawUnoccluded()).
+    /*!
+     * The layers are walked front to back (top layer first): each tile remembers the top most layer
+     * that covers it with an opaque tile, and the layers below that layer skip it when drawn. The
+     * tiles a layer looks up while walked are kept for its draw, so they are neither looked up again
+     * nor evicted by the layers below in between.
+     */
+    class QMAPCONTROL_EXPORT TileOcclusion
+    {
+    public:
+        //! A tile looked up by a layer while walked (see setTile()).
+        struct Tile
+        {
+            /// The tile url.
+            QUrl url;
+
+            /// The tile (null if it was not in the memory cache).
+            QPixmap pixmap;
+
+            /// How opaque the tile is.
+            TileOpacity opacity = TileOpacity::Mixed;
+        };
+
+    public:
+        //! Constructor (no tiles are covered).
+        TileOcclusion();
+
+        /*!
+         * Uncover all the tiles of a backbuffer and forget the tiles looked up (keeps the capacity).
+         * @param backbuffer_rect_px The backbuffer rect (pixels).
+         * @param tile_size_px The tile size (pixels).
+         * @param layer_count The number of layers (the depths are 0 to layer_count - 1).
+         */
+        void reset(const RectWorldPx& backbuffer_rect_px, const int tile_size_px, const int layer_count);
+
+        /*!
+         * Set the depth of the layer being walked or drawn (the layers above have larger depths).
+         * @param depth The depth of the layer.
+         */
+        void setDepth(const int depth);
+
+        /*!
+         * Whether a tile is covered by an opaque tile of a layer above the current depth.
+         * @param x The x coordinate of the tile.
+         * @param y The y coordinate of the tile.
+         * @return whether the tile is covered (tiles outside the backbuffer are not).
+         */
+        bool isOccluded(const int x, const int y) const;
+
+        /*!
+         * Cover a tile with an opaque tile of the layer at the current depth.
+         * @param x The x coordinate of the tile.
+         * @param y The y coordinate of the tile.
+         */
+        void occlude(const int x, const int y);
+
+        /*!
+         * Keep a tile looked up by the layer at the current depth, for its draw.
+         * @param x The x coordinate of the tile.
+         * @param y The y coordinate of the tile.
+         * @param tile The tile.
+         */
+        void setTile(const int x, const int y, const Tile& tile);
+
+        /*!
+         * Find a tile looked up by the layer at the current depth.
+         * @param x The x coordinate of the tile.
+         * @param y The y coordinate of the tile.
+         * @return the tile (nullptr if it was not looked up).
+         */
+        const Tile* findTile(const int x, const int y) const;
+
+        /*!
+         * Whether any tile is covered.
+         * @return whether any tile is covered.
+         */
+        bool isEmpty() const;
+
+    private:
+        /*!
+         * Fetch the index of a tile.
+         * @param x The x coordinate of the tile.
+         * @param y The y coordinate of the tile.
+         * @return the index (-1 if the tile is outside the backbuffer).
+         */
+        int index(const int x, const int y) const;
+
+    private:
+        /// The left most tile of the backbuffer.
+        int m_left;
+
+        /// The top most tile of the backbuffer.
+        int m_top;
+
+        /// The number of tile columns.
+        int m_columns;
+
+        /// The number of tile rows.
+        int m_rows;
+
+        /// The depth of the layer being walked or drawn.
+        int m_depth;
+
+        /// Whether any tile is covered.
+        bool m_empty;
+
+        /// The number of layers.
+        int m_layer_count;
+
+        /// The depth of the top most layer covering each tile (-1 if none).
+        std::vector<int> m_occluder_depths;
+
+        /// The tiles looked up by each layer (by depth, then tile index).
+        std::vector<Tile> m_tiles;
+
+        /// Whether each tile of m_tiles was looked up.
+        std::vector<bool> m_tiles_set;
+    };
+}
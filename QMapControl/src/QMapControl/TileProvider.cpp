@@ -0,0 +1,164 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "TileProvider.h"
+
+// Qt includes.
+#include <QtConcurrent/QtConcurrentRun>
+
+// STL includes.
+#include <algorithm>
+#include <iterator>
+
+namespace qmapcontrol
+{
+    std::vector<TileResult> ITileProvider::getTilesData(const std::vector<TileRequest>& requests)
+    {
+        // Fetch each tile.
+        std::vector<TileResult> results;
+        results.reserve(requests.size());
+        for (const auto& request : requests)
+        {
+            TileResult result{ request.url, false, QByteArray() };
+            result.found = getTileData(request.url, result.data);
+            results.push_back(std::move(result));
+        }
+
+        // Return the tiles.
+        return results;
+    }
+
+    SyncTileProviderAdapter::SyncTileProviderAdapter(ITileProvider* provider, const int max_batch_size)
+        : m_provider(provider),
+          m_max_batch_size(std::max(1, max_batch_size)),
+          m_processing(false),
+          m_stopping(false)
+    {
+        // Call the provider from a single thread.
+        m_thread.setMaxThreadCount(1);
+    }
+
+    SyncTileProviderAdapter::~SyncTileProviderAdapter()
+    {
+        // Stop after the batch in progress.
+        m_stopping.store(true);
+        m_thread.waitForDone();
+    }
+
+    ITileProvider* SyncTileProviderAdapter::provider() const
+    {
+        // Return the synchronous tile provider.
+        return m_provider;
+    }
+
+    bool SyncTileProviderAdapter::getTileData(const QUrl& url, QByteArray& data)
+    {
+        // Gain a lock to serialise the calls to the provider.
+        QMutexLocker locker(&m_provider_mutex);
+
+        // Fetch the tile.
+        return m_provider->getTileData(url, data);
+    }
+
+    void SyncTileProviderAdapter::requestTiles(const std::vector<TileRequest>& requests, const Completion& completion)
+    {
+        // Gain a lock to protect the queue.
+        QMutexLocker locker(&m_mutex);
+
+        // Queue the requests.
+        for (const auto& request : requests)
+        {
+            m_pending.push_back({ request, completion });
+        }
+
+        // Start the background thread, if it is not already processing the queue.
+        if (m_processing == false && m_pending.empty() == false)
+        {
+            m_processing = true;
+            QtConcurrent::run(&m_thread, this, &SyncTileProviderAdapter::processRequests);
+        }
+    }
+
+    void SyncTileProviderAdapter::cancelRequests()
+    {
+        // Gain a lock to protect the queue.
+        QMutexLocker locker(&m_mutex);
+
+        // Drop the queued requests (the batch in progress still completes).
+        m_pending.clear();
+    }
+
+    void SyncTileProviderAdapter::processRequests()
+    {
+        std::vector<PendingTile> batch;
+        std::vector<TileRequest> requests;
+        while (m_stopping.load() == false)
+        {
+            // Take the highest priority requests.
+            batch.clear();
+            {
+                QMutexLocker locker(&m_mutex);
+                if (m_pending.empty())
+                {
+                    m_processing = false;
+                    return;
+                }
+                std::stable_sort(m_pending.begin(), m_pending.end(), [](const PendingTile& a, const PendingTile& b) { return a.request.priority > b.request.priority; });
+                const auto batch_end = m_pending.begin() + std::min<std::ptrdiff_t>(m_max_batch_size, std::ptrdiff_t(m_pending.size()));
+                std::move(m_pending.begin(), batch_end, std::back_inserter(batch));
+                m_pending.erase(m_pending.begin(), batch_end);
+            }
+
+            // Fetch the tiles.
+            requests.clear();
+            for (const auto& pending : batch)
+            {
+                requests.push_back(pending.request);
+            }
+            std::vector<TileResult> results;
+            {
+                QMutexLocker locker(&m_provider_mutex);
+                results = m_provider->getTilesData(requests);
+            }
+
+            // Complete the requests (a missing result is a miss).
+            for (std::size_t i = 0; i < batch.size(); ++i)
+            {
+                if (i < results.size())
+                {
+                    batch[i].completion(results[i]);
+                }
+                else
+                {
+                    batch[i].completion({ batch[i].request.url, false, QByteArray() });
+                }
+            }
+        }
+
+        // Stopping.
+        QMutexLocker locker(&m_mutex);
+        m_processing = false;
+    }
+}
@@ -0,0 +1,219 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// Qt includes.
+#include <QtCore/QByteArray>
+#include <QtCore/QMutex>
+#include <QtCore/QThreadPool>
+#include <QtCore/QUrl>
+
+// STL includes.
+#include <atomic>
+#include <functional>
+#include <vector>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+
+/*!
+ * Custom tile providers (see ImageManager::setCustomTileProvider() and ImageManager::setAsyncTileProvider()).
+ */
+namespace qmapcontrol
+{
+    /// Priority of a tile that is displayed.
+    const int kTilePriorityVisible = 1;
+
+    /// Priority of a tile that is prefetched (offscreen).
+    const int kTilePriorityPrefetch = 0;
+
+    //! A tile requested from a tile provider.
+    struct QMAPCONTROL_EXPORT TileRequest
+    {
+        /// The tile url.
+        QUrl url;
+
+        /// The priority (higher first, see kTilePriorityVisible and kTilePriorityPrefetch).
+        int priority;
+    };
+
+    //! A tile returned by a tile provider.
+    struct QMAPCONTROL_EXPORT TileResult
+    {
+        /// The tile url.
+        QUrl url;
+
+        /// Whether the provider has the tile.
+        bool found;
+
+        /// The encoded image.
+        QByteArray data;
+    };
+
+    //! Synchronous tile provider (eg: tiles stored in a database).
+    class QMAPCONTROL_EXPORT ITileProvider
+    {
+    public:
+        //! Destructor.
+        virtual ~ITileProvider() { }
+
+        /*!
+         * Fetch a tile.
+         * @param url The tile url.
+         * @param data The encoded image.
+         * @return whether the provider has the tile.
+         */
+        virtual bool getTileData(const QUrl& url, QByteArray& data) = 0;
+
+        /*!
+         * Fetch several tiles (eg: a whole viewport with one query). Calls getTileData() for each tile by default.
+         * @param requests The tiles, highest priority first.
+         * @return the tiles (one result per request).
+         */
+        virtual std::vector<TileResult> getTilesData(const std::vector<TileRequest>& requests);
+    };
+
+    //! Asynchronous tile provider.
+    /*!
+     * The image manager collects the tiles requested while drawing and passes them to the
+     * provider in batches, without waiting for them. The provider completes each request once,
+     * from any thread and in any order, after which the tile is displayed.
+     */
+    class QMAPCONTROL_EXPORT IAsyncTileProvider
+    {
+    public:
+        /// Completion callback of a request (thread-safe).
+        using Completion = std::function<void(const TileResult& result)>;
+
+    public:
+        //! Destructor.
+        virtual ~IAsyncTileProvider() { }
+
+        /*!
+         * Request tiles (must not block).
+         * @param requests The tiles, in no particular order.
+         * @param completion The callback to complete each request with.
+         */
+        virtual void requestTiles(const std::vector<TileRequest>& requests, const Completion& completion) = 0;
+
+        /*!
+         * Cancel the pending requests (eg: the zoom changed); cancelled requests need not be completed.
+         */
+        virtual void cancelRequests() { }
+    };
+
+    //! Asynchronous tile provider that calls a synchronous tile provider in a background thread.
+    /*!
+     * The requests are queued and passed to ITileProvider::getTilesData() in batches, highest
+     * priority first, from a single thread (so the synchronous provider needs no locking).
+     */
+    class QMAPCONTROL_EXPORT SyncTileProviderAdapter : public IAsyncTileProvider
+    {
+    public:
+        //! Constructor.
+        /*!
+         * @param provider The synchronous tile provider (must outlive the adapter).
+         * @param max_batch_size The maximum number of tiles passed to the provider at once.
+         */
+        explicit SyncTileProviderAdapter(ITileProvider* provider, const int max_batch_size = 64);
+
+        //! Disable copy constructor.
+        SyncTileProviderAdapter(const SyncTileProviderAdapter&) = delete;
+
+        //! Disable copy assignment.
+        SyncTileProviderAdapter& operator=(const SyncTileProviderAdapter&) = delete;
+
+        //! Destructor (waits for the batch in progress).
+        ~SyncTileProviderAdapter();
+
+        /*!
+         * Fetch the synchronous tile provider.
+         * @return the synchronous tile provider.
+         */
+        ITileProvider* provider() const;
+
+        /*!
+         * Fetch a tile synchronously (serialised with the background thread's calls).
+         * @param url The tile url.
+         * @param data The encoded image.
+         * @return whether the provider has the tile.
+         */
+        bool getTileData(const QUrl& url, QByteArray& data);
+
+        /*!
+         * Request tiles (queued for the background thread).
+         * @param requests The tiles.
+         * @param completion The callback to complete each request with.
+         */
+        void requestTiles(const std::vector<TileRequest>& requests, const Completion& completion) override;
+
+        /*!
+         * Cancel the queued requests.
+         */
+        void cancelRequests() override;
+
+    private:
+        //! A queued request.
+        struct PendingTile
+        {
+            /// The request.
+            TileRequest request;
+
+            /// The callback to complete it with.
+            Completion completion;
+        };
+
+        /*!
+         * Pass the queued requests to the provider until the queue is empty (background thread).
+         */
+        void processRequests();
+
+    private:
+        /// The synchronous tile provider.
+        ITileProvider* const m_provider;
+
+        /// The maximum number of tiles passed to the provider at once.
+        const int m_max_batch_size;
+
+        /// Mutex to serialise the calls to the provider.
+        QMutex m_provider_mutex;
+
+        /// The thread to call the provider from.
+        QThreadPool m_thread;
+
+        /// Mutex to protect the queue.
+        QMutex m_mutex;
+
+        /// The queued requests.
+        std::vector<PendingTile> m_pending;
+
+        /// Whether the background thread is processing the queue.
+        bool m_processing;
+
+        /// Whether the adapter is being destroyed.
+        std::atomic<bool> m_stopping;
+    };
+}
@@ -0,0 +1,303 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "Trace.h"
+
+// Qt includes.
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QThread>
+
+// STL includes.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace qmapcontrol
+{
+    namespace trace
+    {
+        namespace
+        {
+            /// Default number of events kept per thread.
+            const int kDefaultBufferCapacity = 64 * 1024;
+
+            /// Number of events a ring buffer is first allocated for (it grows up to its capacity).
+            const std::size_t kInitialBufferEvents = 256;
+
+            //! A recorded event.
+            struct Event
+            {
+                /// The event category.
+                const char* category;
+
+                /// The event name.
+                const char* name;
+
+                /// The event phase ('X' complete, 'b'/'e' async begin/end).
+                char phase;
+
+                /// The event time (ns).
+                qint64 time_ns;
+
+                /// The event duration (ns, complete events only).
+                qint64 duration_ns;
+
+                /// The async id.
+                quint64 id;
+
+                /// The event detail.
+                QString arg;
+            };
+
+            //! The ring buffer of a thread.
+            struct ThreadBuffer
+            {
+                /// Mutex to protect the events (only contended while dumping).
+                QMutex mutex;
+
+                /// The events (ring buffer, grown as events are recorded up to the capacity).
+                std::vector<Event> events;
+
+                /// The number of events kept.
+                std::size_t capacity;
+
+                /// The next event to write.
+                std::size_t next;
+
+                /// Whether the ring buffer has wrapped around.
+                bool wrapped;
+
+                /// The trace thread id.
+                int thread_id;
+
+                /// The thread name.
+                QString thread_name;
+            };
+
+            /// Whether events are recorded.
+            std::atomic<bool> g_enabled(true);
+
+            /// The ring buffer capacity of new threads.
+            std::atomic<int> g_buffer_capacity(kDefaultBufferCapacity);
+
+            /// The trace clock epoch.
+            const std::chrono::steady_clock::time_point g_epoch(std::chrono::steady_clock::now());
+
+            /// Mutex to protect the thread buffers list.
+            QMutex g_buffers_mutex;
+
+            /// The thread buffers (kept after their thread has finished, until cleared).
+            std::vector<std::shared_ptr<ThreadBuffer>> g_buffers;
+
+            /// The trace thread id of the next thread buffer.
+            int g_next_thread_id(1);
+
+            /// The ring buffer of the current thread.
+            thread_local std::shared_ptr<ThreadBuffer> t_buffer;
+
+            /// Fetch (or create) the ring buffer of the current thread.
+            ThreadBuffer& threadBuffer()
+            {
+                if (t_buffer == nullptr)
+                {
+                    // Create the buffer.
+                    t_buffer = std::make_shared<ThreadBuffer>();
+                    t_buffer->capacity = std::size_t(std::max(1, g_buffer_capacity.load()));
+                    t_buffer->next = 0;
+                    t_buffer->wrapped = false;
+
+                    // Name the thread.
+                    QThread* thread = QThread::currentThread();
+                    if (QCoreApplication::instance() != nullptr && thread == QCoreApplication::instance()->thread())
+                    {
+                        t_buffer->thread_name = "main";
+                    }
+                    else if (thread != nullptr && thread->objectName().isEmpty() == false)
+                    {
+                        t_buffer->thread_name = thread->objectName();
+                    }
+
+                    // Register the buffer.
+                    QMutexLocker locker(&g_buffers_mutex);
+                    t_buffer->thread_id = g_next_thread_id++;
+                    if (t_buffer->thread_name.isEmpty())
+                    {
+                        t_buffer->thread_name = QString("thread %1").arg(t_buffer->thread_id);
+                    }
+                    g_buffers.push_back(t_buffer);
+                }
+                return *t_buffer;
+            }
+
+            /// Record an event into the ring buffer of the current thread.
+            void record(const char* category, const char* name, const char phase, const qint64 time_ns, const qint64 duration_ns, const quint64 id, const QString& arg)
+            {
+                ThreadBuffer& buffer = threadBuffer();
+                QMutexLocker locker(&buffer.mutex);
+
+                // Grow the ring buffer until it is full (threads that record few events keep small buffers).
+                if (buffer.wrapped == false && buffer.next == buffer.events.size())
+                {
+                    if (buffer.events.size() == buffer.events.capacity())
+                    {
+                        buffer.events.reserve(std::min(buffer.capacity, std::max(kInitialBufferEvents, buffer.events.size() * 2)));
+                    }
+                    buffer.events.emplace_back();
+                }
+
+                // Overwrite the oldest event.
+                Event& event = buffer.events[buffer.next];
+                event.category = category;
+                event.name = name;
+                event.phase = phase;
+                event.time_ns = time_ns;
+                event.duration_ns = duration_ns;
+                event.id = id;
+                event.arg = arg;
+
+                // Move to the next event.
+                if (++buffer.next == buffer.capacity)
+                {
+                    buffer.next = 0;
+                    buffer.wrapped = true;
+                }
+            }
+        }
+
+        void setEnabled(const bool enabled)
+        {
+            g_enabled.store(enabled, std::memory_order_relaxed);
+        }
+
+        bool isEnabled()
+        {
+            return g_enabled.load(std::memory_order_relaxed);
+        }
+
+        void setBufferCapacity(const int events)
+        {
+            g_buffer_capacity.store(events);
+        }
+
+        qint64 now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_epoch).count();
+        }
+
+        void complete(const char* category, const char* name, const qint64 start_ns, const qint64 end_ns, const QString& arg)
+        {
+            record(category, name, 'X', start_ns, end_ns - start_ns, 0, arg);
+        }
+
+        void asyncBegin(const char* category, const char* name, const quint64 id, const QString& arg)
+        {
+            record(category, name, 'b', now(), 0, id, arg);
+        }
+
+        void asyncEnd(const char* category, const char* name, const quint64 id, const QString& arg)
+        {
+            record(category, name, 'e', now(), 0, id, arg);
+        }
+
+        void clear()
+        {
+            QMutexLocker locker(&g_buffers_mutex);
+
+            // Drop the buffers of the threads that have finished (only referenced from here).
+            g_buffers.erase(std::remove_if(g_buffers.begin(), g_buffers.end(),
+                                           [](const std::shared_ptr<ThreadBuffer>& buffer) { return buffer.use_count() == 1; }),
+                            g_buffers.end());
+
+            // Release the events of the others (they grow again as they record).
+            for (const auto& buffer : g_buffers)
+            {
+                QMutexLocker buffer_locker(&buffer->mutex);
+                std::vector<Event>().swap(buffer->events);
+                buffer->capacity = std::size_t(std::max(1, g_buffer_capacity.load()));
+                buffer->next = 0;
+                buffer->wrapped = false;
+            }
+        }
+
+        bool dump(const QString& file_path)
+        {
+            QJsonArray events;
+
+            // Capture the thread buffers.
+            std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+            {
+                QMutexLocker locker(&g_buffers_mutex);
+                buffers = g_buffers;
+            }
+
+            for (const auto& buffer : buffers)
+            {
+                // Name the thread.
+                events.append(QJsonObject{ { "name", "thread_name" }, { "ph", "M" }, { "pid", 1 }, { "tid", buffer->thread_id },
+                                           { "args", QJsonObject{ { "name", buffer->thread_name } } } });
+
+                // Add the events (oldest first).
+                QMutexLocker locker(&buffer->mutex);
+                const std::size_t count = buffer->wrapped ? buffer->events.size() : buffer->next;
+                const std::size_t first = buffer->wrapped ? buffer->next : 0;
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    const Event& event = buffer->events[(first + i) % buffer->events.size()];
+                    QJsonObject json{ { "name", event.name }, { "cat", event.category }, { "ph", QString(QChar(event.phase)) },
+                                      { "pid", 1 }, { "tid", buffer->thread_id }, { "ts", double(event.time_ns) / 1000.0 } };
+                    if (event.phase == 'X')
+                    {
+                        json["dur"] = double(event.duration_ns) / 1000.0;
+                    }
+                    else
+                    {
+                        json["id"] = QString::number(event.id, 16);
+                    }
+                    if (event.arg.isEmpty() == false)
+                    {
+                        json["args"] = QJsonObject{ { "detail", event.arg } };
+                    }
+                    events.append(json);
+                }
+            }
+
+            // Write the trace.
+            QFile file(file_path);
+            if (file.open(QIODevice::WriteOnly | QIODevice::Truncate) == false)
+            {
+                return false;
+            }
+            file.write(QJsonDocument(QJsonObject{ { "traceEvents", events }, { "displayTimeUnit", "ms" } }).toJson(QJsonDocument::Compact));
+            return true;
+        }
+    }
+}
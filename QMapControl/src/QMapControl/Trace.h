@@ -0,0 +1,222 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// Qt includes.
+#include <QString>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+
+/*!
+ * Tracing of the render and tile pipeline, dumped in the Chrome trace event format (load the file
+ * in chrome://tracing or https://ui.perfetto.dev).
+ *
+ * Tracing is compiled in when QMC_TRACE is defined, otherwise the QMC_TRACE_* macros expand to
+ * nothing and the functions below are empty inline stubs.
+ *
+ * Each thread records its events into its own ring buffer (the oldest events are overwritten), so
+ * recording never blocks on other threads. Category and name arguments must be string literals
+ * (only the pointers are stored).
+ */
+namespace qmapcontrol
+{
+    namespace trace
+    {
+#ifdef QMC_TRACE
+        /*!
+         * Enable/disable recording (enabled by default when compiled in).
+         * @param enabled Whether events are recorded.
+         */
+        QMAPCONTROL_EXPORT void setEnabled(const bool enabled);
+
+        /*!
+         * Whether events are recorded.
+         * @return whether events are recorded.
+         */
+        QMAPCONTROL_EXPORT bool isEnabled();
+
+        /*!
+         * Set the ring buffer capacity of each thread (applies to threads that record afterwards, and to all after clear()).
+         * @param events The number of events kept per thread.
+         */
+        QMAPCONTROL_EXPORT void setBufferCapacity(const int events);
+
+        /*!
+         * Fetch the trace clock.
+         * @return the time since tracing started (ns).
+         */
+        QMAPCONTROL_EXPORT qint64 now();
+
+        /*!
+         * Record a complete event (a span).
+         * @param category The event category.
+         * @param name The event name.
+         * @param start_ns The start time (trace clock).
+         * @param end_ns The end time (trace clock).
+         * @param arg An optional detail (eg: url, layer name).
+         */
+        QMAPCONTROL_EXPORT void complete(const char* category, const char* name, const qint64 start_ns, const qint64 end_ns, const QString& arg = QString());
+
+        /*!
+         * Record the start of an asynchronous span (eg: a network request).
+         * @param category The event category.
+         * @param name The event name.
+         * @param id The id matching the start and end events.
+         * @param arg An optional detail.
+         */
+        QMAPCONTROL_EXPORT void asyncBegin(const char* category, const char* name, const quint64 id, const QString& arg = QString());
+
+        /*!
+         * Record the end of an asynchronous span.
+         * @param category The event category.
+         * @param name The event name.
+         * @param id The id matching the start and end events.
+         * @param arg An optional detail (eg: the outcome).
+         */
+        QMAPCONTROL_EXPORT void asyncEnd(const char* category, const char* name, const quint64 id, const QString& arg = QString());
+
+        /*!
+         * Discard all recorded events (and the buffers of the threads that have finished).
+         */
+        QMAPCONTROL_EXPORT void clear();
+
+        /*!
+         * Write the recorded events in the Chrome trace event format.
+         * @param file_path The file to write to.
+         * @return whether the trace was written.
+         */
+        QMAPCONTROL_EXPORT bool dump(const QString& file_path);
+
+        //! Records a span from construction to destruction.
+        class ScopedSpan
+        {
+        public:
+            /*!
+             * Start the span.
+             * @param category The event category.
+             * @param name The event name.
+             */
+            ScopedSpan(const char* category, const char* name)
+                : m_category(category),
+                  m_name(name),
+                  m_start_ns(isEnabled() ? now() : -1)
+            {
+
+            }
+
+            /*!
+             * Start the span, with a detail.
+             * @param category The event category.
+             * @param name The event name.
+             * @param arg_function Returns the detail (only called when the span is recorded).
+             */
+            template <typename ArgFunction>
+            ScopedSpan(const char* category, const char* name, const ArgFunction& arg_function)
+                : ScopedSpan(category, name)
+            {
+                if (active())
+                {
+                    m_arg = arg_function();
+                }
+            }
+
+            //! Disable copy constructor.
+            ScopedSpan(const ScopedSpan&) = delete;
+
+            //! Disable copy assignment.
+            ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+            //! End the span.
+            ~ScopedSpan()
+            {
+                // Record the span (if tracing was enabled at the start).
+                if (m_start_ns >= 0)
+                {
+                    complete(m_category, m_name, m_start_ns, now(), m_arg);
+                }
+            }
+
+            /*!
+             * Whether the span is recorded (use to avoid building arguments needlessly).
+             * @return whether the span is recorded.
+             */
+            bool active() const { return m_start_ns >= 0; }
+
+            /*!
+             * Set the span detail.
+             * @param arg The detail.
+             */
+            void setArg(const QString& arg) { m_arg = arg; }
+
+        private:
+            /// The event category.
+            const char* m_category;
+
+            /// The event name.
+            const char* m_name;
+
+            /// The start time (-1 if not recorded).
+            const qint64 m_start_ns;
+
+            /// The span detail.
+            QString m_arg;
+        };
+#else
+        inline void setEnabled(const bool) { }
+        inline bool isEnabled() { return false; }
+        inline void setBufferCapacity(const int) { }
+        inline void clear() { }
+        inline bool dump(const QString&) { return false; }
+#endif
+    }
+}
+
+#ifdef QMC_TRACE
+    #define QMC_TRACE_CONCAT_INNER(a, b) a##b
+    #define QMC_TRACE_CONCAT(a, b) QMC_TRACE_CONCAT_INNER(a, b)
+
+    /// Record a span until the end of the current scope.
+    #define QMC_TRACE_SCOPE(category, name) \
+        qmapcontrol::trace::ScopedSpan QMC_TRACE_CONCAT(qmc_trace_span_, __LINE__)(category, name)
+
+    /// Record a span until the end of the current scope, with a detail (only evaluated when recording).
+    #define QMC_TRACE_SCOPE_ARG(category, name, arg) \
+        qmapcontrol::trace::ScopedSpan QMC_TRACE_CONCAT(qmc_trace_span_, __LINE__)(category, name, [&]() { return QString(arg); })
+
+    /// Record the start of an asynchronous span.
+    #define QMC_TRACE_ASYNC_BEGIN(category, name, id, arg) \
+        do { if (qmapcontrol::trace::isEnabled()) qmapcontrol::trace::asyncBegin(category, name, quint64(id), arg); } while (false)
+
+    /// Record the end of an asynchronous span.
+    #define QMC_TRACE_ASYNC_END(category, name, id, arg) \
+        do { if (qmapcontrol::trace::isEnabled()) qmapcontrol::trace::asyncEnd(category, name, quint64(id), arg); } while (false)
+#else
+    #define QMC_TRACE_SCOPE(category, name)
+    #define QMC_TRACE_SCOPE_ARG(category, name, arg)
+    #define QMC_TRACE_ASYNC_BEGIN(category, name, id, arg) do { } while (false)
+    #define QMC_TRACE_ASYNC_END(category, name, id, arg) do { } while (false)
+#endif
@@ -0,0 +1,292 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "WarmStart.h"
+
+// Qt includes.
+#include <QSaveFile>
+
+// STL includes.
+#include <cstring>
+
+namespace qmapcontrol
+{
+    namespace
+    {
+        /// The file magic ("QMCW", also detects a file written with another byte order).
+        const quint32 kMagic = 0x57434D51;
+
+        /// The file format version.
+        const quint32 kVersion = 1;
+
+        /// The size of a memory cache key (md5 hex).
+        const int kKeySize = 32;
+
+        /// The alignment of the pixel data in the file.
+        const qint64 kAlignment = 64;
+
+        //! The file header.
+        struct FileHeader
+        {
+            quint32 magic;
+            quint32 version;
+            qint32 epsg;
+            qint32 tile_size_px;
+            qint32 zoom;
+            qint32 screen_width;
+            qint32 screen_height;
+            qint32 screen_bytes_per_line;
+            double map_focus_longitude;
+            double map_focus_latitude;
+            double screen_map_focus_x;
+            double screen_map_focus_y;
+            double screen_backbuffer_left;
+            double screen_backbuffer_top;
+            double screen_backbuffer_right;
+            double screen_backbuffer_bottom;
+            qint64 screen_offset;
+            quint32 tile_count;
+            quint32 reserved;
+        };
+
+        //! An entry of the file's tile table (follows the header).
+        struct FileTile
+        {
+            char key[kKeySize];
+            qint32 width;
+            qint32 height;
+            qint32 bytes_per_line;
+            qint32 reserved;
+            qint64 offset;
+        };
+
+        /// Round an offset up to the pixel data alignment.
+        qint64 align(const qint64 offset)
+        {
+            return (offset + kAlignment - 1) / kAlignment * kAlignment;
+        }
+
+        /// Write the pixels of an image (tightly packed rows).
+        bool writePixels(QSaveFile& file, const QImage& image)
+        {
+            const qint64 row_bytes = qint64(image.width()) * 4;
+            for (int y = 0; y < image.height(); ++y)
+            {
+                if (file.write(reinterpret_cast<const char*>(image.constScanLine(y)), row_bytes) != row_bytes)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /// Pad the file up to the pixel data alignment.
+        bool writePadding(QSaveFile& file)
+        {
+            const qint64 padding = align(file.pos()) - file.pos();
+            return padding == 0 || file.write(QByteArray(int(padding), '\0')) == padding;
+        }
+
+        /// Whether an image stored at the offset lies within the file.
+        bool withinFile(const qint64 offset, const int height, const int bytes_per_line, const qint64 file_size)
+        {
+            return offset >= 0 && height >= 0 && bytes_per_line >= 0
+                    && offset % kAlignment == 0
+                    && offset + qint64(height) * bytes_per_line <= file_size;
+        }
+    }
+
+    WarmStartView::WarmStartView()
+        : epsg(0),
+          tile_size_px(0),
+          zoom(0),
+          map_focus_coord(0.0, 0.0),
+          screen_map_focus_point_px(0.0, 0.0),
+          screen_backbuffer_rect_px(PointWorldPx(0.0, 0.0), PointWorldPx(0.0, 0.0))
+    {
+        // Nothing else to do.
+    }
+
+    bool WarmStartFile::write(const QString& file_path, const WarmStartView& view, const std::vector<WarmStartTile>& tiles)
+    {
+        // Convert the images to the stored format (no-op for raster pixmaps with alpha).
+        const QImage screen = view.screen.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        std::vector<QImage> images;
+        std::vector<FileTile> table;
+        for (const auto& tile : tiles)
+        {
+            // Skip tiles with a foreign key.
+            if (tile.key.size() != kKeySize || tile.image.isNull())
+            {
+                continue;
+            }
+            images.push_back(tile.image.convertToFormat(QImage::Format_ARGB32_Premultiplied));
+
+            FileTile entry;
+            std::memset(&entry, 0, sizeof(entry));
+            std::memcpy(entry.key, tile.key.constData(), kKeySize);
+            entry.width = images.back().width();
+            entry.height = images.back().height();
+            entry.bytes_per_line = entry.width * 4;
+            table.push_back(entry);
+        }
+
+        // Lay out the pixel data: the screen then the tiles, each aligned.
+        FileHeader header;
+        std::memset(&header, 0, sizeof(header));
+        header.magic = kMagic;
+        header.version = kVersion;
+        header.epsg = view.epsg;
+        header.tile_size_px = view.tile_size_px;
+        header.zoom = view.zoom;
+        header.screen_width = screen.width();
+        header.screen_height = screen.height();
+        header.screen_bytes_per_line = screen.width() * 4;
+        header.map_focus_longitude = view.map_focus_coord.longitude();
+        header.map_focus_latitude = view.map_focus_coord.latitude();
+        header.screen_map_focus_x = view.screen_map_focus_point_px.x();
+        header.screen_map_focus_y = view.screen_map_focus_point_px.y();
+        header.screen_backbuffer_left = view.screen_backbuffer_rect_px.leftPx();
+        header.screen_backbuffer_top = view.screen_backbuffer_rect_px.topPx();
+        header.screen_backbuffer_right = view.screen_backbuffer_rect_px.rightPx();
+        header.screen_backbuffer_bottom = view.screen_backbuffer_rect_px.bottomPx();
+        header.screen_offset = align(qint64(sizeof(FileHeader)) + qint64(table.size() * sizeof(FileTile)));
+        header.tile_count = quint32(table.size());
+        qint64 offset = align(header.screen_offset + qint64(header.screen_height) * header.screen_bytes_per_line);
+        for (auto& entry : table)
+        {
+            entry.offset = offset;
+            offset = align(offset + qint64(entry.height) * entry.bytes_per_line);
+        }
+
+        // Write the file (replaces the existing file only once complete).
+        QSaveFile file(file_path);
+        if (file.open(QIODevice::WriteOnly) == false)
+        {
+            return false;
+        }
+        bool success = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == qint64(sizeof(header));
+        for (const auto& entry : table)
+        {
+            success = success && file.write(reinterpret_cast<const char*>(&entry), sizeof(entry)) == qint64(sizeof(entry));
+        }
+        success = success && writePadding(file) && writePixels(file, screen);
+        for (const auto& image : images)
+        {
+            success = success && writePadding(file) && writePixels(file, image);
+        }
+        if (success == false)
+        {
+            file.cancelWriting();
+            return false;
+        }
+        return file.commit();
+    }
+
+    std::shared_ptr<WarmStartFile> WarmStartFile::open(const QString& file_path)
+    {
+        // Open and map the file.
+        std::shared_ptr<WarmStartFile> snapshot(new WarmStartFile);
+        snapshot->m_file.setFileName(file_path);
+        if (snapshot->m_file.open(QIODevice::ReadOnly) == false || snapshot->m_file.size() < qint64(sizeof(FileHeader)))
+        {
+            return nullptr;
+        }
+        const qint64 file_size = snapshot->m_file.size();
+        snapshot->m_data = snapshot->m_file.map(0, file_size);
+        if (snapshot->m_data == nullptr)
+        {
+            return nullptr;
+        }
+
+        // Check the header.
+        FileHeader header;
+        std::memcpy(&header, snapshot->m_data, sizeof(header));
+        if (header.magic != kMagic || header.version != kVersion
+                || qint64(sizeof(FileHeader)) + qint64(header.tile_count) * qint64(sizeof(FileTile)) > file_size
+                || header.screen_width < 0 || header.screen_bytes_per_line < qint64(header.screen_width) * 4
+                || withinFile(header.screen_offset, header.screen_height, header.screen_bytes_per_line, file_size) == false)
+        {
+            return nullptr;
+        }
+
+        // Read the view (the screen refers to the mapped file).
+        WarmStartView& view = snapshot->m_view;
+        view.epsg = header.epsg;
+        view.tile_size_px = header.tile_size_px;
+        view.zoom = header.zoom;
+        view.map_focus_coord = PointWorldCoord(header.map_focus_longitude, header.map_focus_latitude);
+        view.screen_map_focus_point_px = PointWorldPx(header.screen_map_focus_x, header.screen_map_focus_y);
+        view.screen_backbuffer_rect_px = RectWorldPx(PointWorldPx(header.screen_backbuffer_left, header.screen_backbuffer_top),
+                                                     PointWorldPx(header.screen_backbuffer_right, header.screen_backbuffer_bottom));
+        if (header.screen_width > 0 && header.screen_height > 0)
+        {
+            view.screen = QImage(snapshot->m_data + header.screen_offset, header.screen_width, header.screen_height,
+                                 header.screen_bytes_per_line, QImage::Format_ARGB32_Premultiplied);
+        }
+
+        // Read the tile table (skipping damaged entries).
+        const FileTile* table = reinterpret_cast<const FileTile*>(snapshot->m_data + sizeof(FileHeader));
+        snapshot->m_tiles.reserve(header.tile_count);
+        for (quint32 i = 0; i < header.tile_count; ++i)
+        {
+            FileTile entry;
+            std::memcpy(&entry, &table[i], sizeof(entry));
+            if (entry.width > 0 && entry.bytes_per_line >= qint64(entry.width) * 4
+                    && withinFile(entry.offset, entry.height, entry.bytes_per_line, file_size))
+            {
+                snapshot->m_tiles.push_back({ QByteArray(entry.key, kKeySize), entry.width, entry.height, entry.bytes_per_line, entry.offset });
+            }
+        }
+
+        // Return the snapshot.
+        return snapshot;
+    }
+
+    WarmStartFile::WarmStartFile()
+        : m_data(nullptr)
+    {
+        // Nothing else to do.
+    }
+
+    const WarmStartView& WarmStartFile::view() const
+    {
+        // Return the view.
+        return m_view;
+    }
+
+    std::size_t WarmStartFile::tileCount() const
+    {
+        // Return the number of tiles.
+        return m_tiles.size();
+    }
+
+    WarmStartTile WarmStartFile::tile(const std::size_t index) const
+    {
+        // Wrap the mapped pixels (read-only, no copy).
+        const TileEntry& entry = m_tiles.at(index);
+        return { entry.key, QImage(m_data + entry.offset, entry.width, entry.height, entry.bytes_per_line, QImage::Format_ARGB32_Premultiplied) };
+    }
+}
@@ -0,0 +1,171 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// Qt includes.
+#include <QByteArray>
+#include <QFile>
+#include <QImage>
+#include <QString>
+
+// STL includes.
+#include <memory>
+#include <vector>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+#include "Point.h"
+
+/*!
+ * Warm start snapshot: the last composed primary screen and the hot set of decoded tiles, stored
+ * in a single file that is memory mapped on startup (see QMapControl::saveWarmStart()).
+ */
+namespace qmapcontrol
+{
+    //! A decoded tile of the memory cache.
+    struct QMAPCONTROL_EXPORT WarmStartTile
+    {
+        /// The memory cache key of the tile.
+        QByteArray key;
+
+        /// The decoded tile (QImage::Format_ARGB32_Premultiplied).
+        QImage image;
+    };
+
+    //! The view that was displayed when the snapshot was taken.
+    struct QMAPCONTROL_EXPORT WarmStartView
+    {
+        //! Constructor.
+        WarmStartView();
+
+        /// The projection EPSG code (the snapshot is only valid for the same projection).
+        int epsg;
+
+        /// The tile size in pixels (the snapshot is only valid for the same tile size).
+        int tile_size_px;
+
+        /// The zoom.
+        int zoom;
+
+        /// The map focus point in coordinates.
+        PointWorldCoord map_focus_coord;
+
+        /// The map focus point when the primary screen was created.
+        PointWorldPx screen_map_focus_point_px;
+
+        /// The primary screen backbuffer rect in pixels.
+        RectWorldPx screen_backbuffer_rect_px;
+
+        /// The primary screen (QImage::Format_ARGB32_Premultiplied).
+        QImage screen;
+    };
+
+    //! A memory mapped warm start snapshot file.
+    class QMAPCONTROL_EXPORT WarmStartFile
+    {
+    public:
+        /*!
+         * Write a snapshot file (replacing any existing file).
+         * @param file_path The file path.
+         * @param view The view to store.
+         * @param tiles The tiles to store.
+         * @return whether the file was written.
+         */
+        static bool write(const QString& file_path, const WarmStartView& view, const std::vector<WarmStartTile>& tiles);
+
+        /*!
+         * Open and memory map a snapshot file.
+         * @param file_path The file path.
+         * @return the snapshot, or nullptr if the file is missing or invalid.
+         */
+        static std::shared_ptr<WarmStartFile> open(const QString& file_path);
+
+    public:
+        //! Disable copy constructor.
+        WarmStartFile(const WarmStartFile&) = delete;
+
+        //! Disable copy assignment.
+        WarmStartFile& operator=(const WarmStartFile&) = delete;
+
+        //! Destructor.
+        ~WarmStartFile() = default;
+
+        /*!
+         * Fetch the stored view.
+         * @return the view (its screen refers to the mapped file, copy it to keep it longer than the file).
+         */
+        const WarmStartView& view() const;
+
+        /*!
+         * Fetch the number of stored tiles.
+         * @return the number of tiles.
+         */
+        std::size_t tileCount() const;
+
+        /*!
+         * Fetch a stored tile, most recently used first.
+         * @param index The tile index.
+         * @return the tile (its image refers to the mapped file, copy it to keep it longer than the file).
+         */
+        WarmStartTile tile(const std::size_t index) const;
+
+    private:
+        //! Constructor.
+        WarmStartFile();
+
+        //! A tile of the file's tile table.
+        struct TileEntry
+        {
+            /// The memory cache key of the tile.
+            QByteArray key;
+
+            /// The tile width in pixels.
+            int width;
+
+            /// The tile height in pixels.
+            int height;
+
+            /// The tile bytes per line.
+            int bytes_per_line;
+
+            /// The offset of the tile pixels in the file.
+            qint64 offset;
+        };
+
+    private:
+        /// The snapshot file.
+        QFile m_file;
+
+        /// The mapped file.
+        uchar* m_data;
+
+        /// The stored view.
+        WarmStartView m_view;
+
+        /// The tile table.
+        std::vector<TileEntry> m_tiles;
+    };
+}
@@ -0,0 +1,378 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#include "WriteBehindDiskCache.h"
+
+// Qt includes.
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtCore/QBuffer>
+
+// STL includes.
+#include <algorithm>
+
+namespace qmapcontrol
+{
+    WriteBehindDiskCache::WriteBehindDiskCache(QObject* parent)
+        : QNetworkDiskCache(parent),
+          m_cache_mutex(QMutex::Recursive),
+          m_pending_bytes(0),
+          m_flush_delay(500),
+          m_max_pending_bytes(8 * 1024 * 1024),
+          m_writer_running(false),
+          m_flush_requested(false)
+    {
+        // Write from a single thread.
+        m_writer.setMaxThreadCount(1);
+    }
+
+    WriteBehindDiskCache::~WriteBehindDiskCache()
+    {
+        // Write the pending tiles.
+        flush();
+        m_writer.waitForDone();
+
+        // Drop the replies still being received.
+        qDeleteAll(m_prepared.keys());
+    }
+
+    void WriteBehindDiskCache::setFlushDelay(const std::chrono::milliseconds& delay)
+    {
+        // Set the flush delay.
+        QMutexLocker locker(&m_mutex);
+        m_flush_delay = delay;
+    }
+
+    void WriteBehindDiskCache::setMaxPendingBytes(const qint64 bytes)
+    {
+        // Set the maximum pending size.
+        QMutexLocker locker(&m_mutex);
+        m_max_pending_bytes = std::max<qint64>(0, bytes);
+    }
+
+    qint64 WriteBehindDiskCache::pendingBytes() const
+    {
+        // Return the pending size.
+        QMutexLocker locker(&m_mutex);
+        return m_pending_bytes;
+    }
+
+    void WriteBehindDiskCache::flush()
+    {
+        // Gain a lock to protect the pending tiles.
+        QMutexLocker locker(&m_mutex);
+
+        // Start the writer if needed, and wake it.
+        m_flush_requested = true;
+        if (m_writer_running == false && m_pending.isEmpty() == false)
+        {
+            m_writer_running = true;
+            QtConcurrent::run(&m_writer, this, &WriteBehindDiskCache::writePending);
+        }
+        m_pending_condition.wakeAll();
+
+        // Wait for it to finish.
+        while (m_writer_running)
+        {
+            m_idle_condition.wait(&m_mutex);
+        }
+        m_flush_requested = false;
+    }
+
+    QNetworkCacheMetaData WriteBehindDiskCache::fileMetaData(const QString& file_path) const
+    {
+        QMutexLocker locker(&m_cache_mutex);
+        return QNetworkDiskCache::fileMetaData(file_path);
+    }
+
+    void WriteBehindDiskCache::setCacheDirectory(const QString& cache_dir, const qint64 size)
+    {
+        QMutexLocker locker(&m_cache_mutex);
+        QNetworkDiskCache::setCacheDirectory(cache_dir);
+        QNetworkDiskCache::setMaximumCacheSize(size);
+    }
+
+    QString WriteBehindDiskCache::cacheDirectory() const
+    {
+        QMutexLocker locker(&m_cache_mutex);
+        return QNetworkDiskCache::cacheDirectory();
+    }
+
+    qint64 WriteBehindDiskCache::maximumCacheSize() const
+    {
+        QMutexLocker locker(&m_cache_mutex);
+        return QNetworkDiskCache::maximumCacheSize();
+    }
+
+    QNetworkCacheMetaData WriteBehindDiskCache::metaData(const QUrl& url)
+    {
+        // Pending tiles first.
+        PendingTile tile;
+        if (findPending(url, tile))
+        {
+            return tile.meta_data;
+        }
+
+        QMutexLocker locker(&m_cache_mutex);
+        return QNetworkDiskCache::metaData(url);
+    }
+
+    void WriteBehindDiskCache::updateMetaData(const QNetworkCacheMetaData& metaData)
+    {
+        // Update a pending tile in place.
+        {
+            QMutexLocker locker(&m_mutex);
+            auto pending = m_pending.find(metaData.url());
+            if (pending != m_pending.end())
+            {
+                pending->meta_data = metaData;
+                return;
+            }
+        }
+
+        // Rewrite the tile (read here, written through prepare()/insert() by the writer).
+        QNetworkDiskCache::updateMetaData(metaData);
+    }
+
+    QIODevice* WriteBehindDiskCache::data(const QUrl& url)
+    {
+        // Pending tiles first.
+        PendingTile tile;
+        if (findPending(url, tile))
+        {
+            QBuffer* buffer = new QBuffer();
+            buffer->setData(tile.data);
+            buffer->open(QIODevice::ReadOnly);
+            return buffer;
+        }
+
+        QMutexLocker locker(&m_cache_mutex);
+        return QNetworkDiskCache::data(url);
+    }
+
+    bool WriteBehindDiskCache::remove(const QUrl& url)
+    {
+        // Drop the replies being received and the pending copies.
+        bool removed = false;
+        {
+            QMutexLocker locker(&m_mutex);
+            for (auto it = m_prepared.begin(); it != m_prepared.end(); )
+            {
+                if (it.value().url() == url)
+                {
+                    delete it.key();
+                    it = m_prepared.erase(it);
+                    removed = true;
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+            auto pending = m_pending.find(url);
+            if (pending != m_pending.end())
+            {
+                m_pending_bytes -= pending->data.size();
+                m_pending.erase(pending);
+                removed = true;
+            }
+            removed = m_writing.remove(url) > 0 || removed;
+        }
+
+        // Remove the written copy.
+        QMutexLocker locker(&m_cache_mutex);
+        return QNetworkDiskCache::remove(url) || removed;
+    }
+
+    qint64 WriteBehindDiskCache::cacheSize() const
+    {
+        // The written tiles and the pending tiles.
+        const qint64 pending_bytes = pendingBytes();
+        QMutexLocker locker(&m_cache_mutex);
+        return QNetworkDiskCache::cacheSize() + pending_bytes;
+    }
+
+    QIODevice* WriteBehindDiskCache::prepare(const QNetworkCacheMetaData& metaData)
+    {
+        // Only the replies that may be stored (see QNetworkDiskCache::prepare()).
+        if (metaData.isValid() == false || metaData.url().isValid() == false || metaData.saveToDisk() == false || cacheDirectory().isEmpty())
+        {
+            return nullptr;
+        }
+
+        // Nor the replies too large for the cache (see QNetworkDiskCache::prepare()).
+        const qint64 max_size = (maximumCacheSize() * 3) / 4;
+        for (const auto& header : metaData.rawHeaders())
+        {
+            if (header.first.compare("content-length", Qt::CaseInsensitive) == 0)
+            {
+                if (header.second.toLongLong() > max_size)
+                {
+                    return nullptr;
+                }
+                break;
+            }
+        }
+
+        // Receive the reply in memory.
+        QBuffer* buffer = new QBuffer();
+        buffer->open(QIODevice::ReadWrite);
+        QMutexLocker locker(&m_mutex);
+        m_prepared.insert(buffer, metaData);
+        return buffer;
+    }
+
+    void WriteBehindDiskCache::insert(QIODevice* device)
+    {
+        // The largest tile stored (see QNetworkDiskCache::prepare(), read before locking the pending tiles).
+        const qint64 max_size = (maximumCacheSize() * 3) / 4;
+
+        // Gain a lock to protect the pending tiles.
+        QMutexLocker locker(&m_mutex);
+
+        // Find the reply.
+        auto prepared = m_prepared.find(device);
+        if (prepared == m_prepared.end())
+        {
+            return;
+        }
+        const QNetworkCacheMetaData meta_data = prepared.value();
+        m_prepared.erase(prepared);
+
+        // Queue the tile (replacing a pending copy), unless it is too large for the cache (without a content length).
+        const QByteArray data = static_cast<QBuffer*>(device)->data();
+        delete device;
+        if (data.size() > max_size)
+        {
+            return;
+        }
+        auto pending = m_pending.find(meta_data.url());
+        if (pending != m_pending.end())
+        {
+            m_pending_bytes -= pending->data.size();
+        }
+        m_pending.insert(meta_data.url(), { meta_data, data });
+        m_pending_bytes += data.size();
+
+        // Start the writer, or wake it if too much is pending.
+        if (m_writer_running == false)
+        {
+            m_writer_running = true;
+            QtConcurrent::run(&m_writer, this, &WriteBehindDiskCache::writePending);
+        }
+        else if (m_pending_bytes >= m_max_pending_bytes)
+        {
+            m_pending_condition.wakeAll();
+        }
+    }
+
+    void WriteBehindDiskCache::clear()
+    {
+        // Drop the pending tiles.
+        {
+            QMutexLocker locker(&m_mutex);
+            m_pending.clear();
+            m_writing.clear();
+            m_pending_bytes = 0;
+        }
+
+        // Remove the written tiles.
+        QMutexLocker locker(&m_cache_mutex);
+        QNetworkDiskCache::clear();
+    }
+
+    bool WriteBehindDiskCache::findPending(const QUrl& url, PendingTile& tile) const
+    {
+        // Gain a lock to protect the pending tiles.
+        QMutexLocker locker(&m_mutex);
+
+        // Waiting or being written?
+        auto pending = m_pending.constFind(url);
+        if (pending == m_pending.constEnd())
+        {
+            pending = m_writing.constFind(url);
+            if (pending == m_writing.constEnd())
+            {
+                return false;
+            }
+        }
+        tile = pending.value();
+        return true;
+    }
+
+    void WriteBehindDiskCache::writePending()
+    {
+        QMutexLocker locker(&m_mutex);
+        while (true)
+        {
+            // Wait for more tiles to batch (unless flushing or too much is pending).
+            if (m_flush_requested == false && m_pending_bytes < m_max_pending_bytes)
+            {
+                m_pending_condition.wait(&m_mutex, static_cast<unsigned long>(m_flush_delay.count()));
+            }
+
+            // Take the batch (kept visible to the readers until written).
+            if (m_pending.isEmpty())
+            {
+                m_writer_running = false;
+                m_idle_condition.wakeAll();
+                return;
+            }
+            m_writing.swap(m_pending);
+            m_pending_bytes = 0;
+            const QList<QUrl> urls = m_writing.keys();
+            locker.unlock();
+
+            // Write the batch.
+            for (const auto& url : urls)
+            {
+                QMutexLocker cache_locker(&m_cache_mutex);
+
+                // Skip the tiles removed meanwhile.
+                PendingTile tile;
+                {
+                    QMutexLocker pending_locker(&m_mutex);
+                    auto writing = m_writing.constFind(url);
+                    if (writing == m_writing.constEnd())
+                    {
+                        continue;
+                    }
+                    tile = writing.value();
+                }
+
+                // Write the tile through QNetworkDiskCache.
+                QIODevice* device = QNetworkDiskCache::prepare(tile.meta_data);
+                if (device != nullptr)
+                {
+                    device->write(tile.data);
+                    QNetworkDiskCache::insert(device);
+                }
+            }
+
+            // The batch is on disk.
+            locker.relock();
+            m_writing.clear();
+        }
+    }
+}
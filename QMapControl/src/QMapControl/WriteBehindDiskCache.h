@@ -0,0 +1,203 @@
+/*
+*
+* This file is part of QMapControl,
+* an open-source cross-platform map widget
+*
+* Copyright (C) 2007 - 2008 Kai Winter
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with QMapControl. If not, see <http://www.gnu.org/licenses/>.
+*
+* Contact e-mail: kaiwinter@gmx.de
+* Program URL   : http://qmapcontrol.sourceforge.net/
+*
+*/
+
+#pragma once
+
+// Qt includes.
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QThreadPool>
+#include <QtCore/QUrl>
+#include <QtCore/QWaitCondition>
+#include <QtNetwork/QNetworkDiskCache>
+
+// STL includes.
+#include <chrono>
+
+// Local includes.
+#include "qmapcontrol_global.h"
+
+namespace qmapcontrol
+{
+    //! A disk cache that writes the tiles to disk in a background thread.
+    /*!
+     * The replies stored by the network access manager are kept in memory and written in batches
+     * by a background thread once no more have arrived for the flush delay (or too much is
+     * pending), so no file is written from the thread that handles the replies. A tile stored
+     * again before it is written replaces the pending copy. The pending tiles are returned by
+     * metaData() and data() until they are written.
+     *
+     * The cache is thread-safe (unlike QNetworkDiskCache), so the tiles can be read from any thread.
+     */
+    class QMAPCONTROL_EXPORT WriteBehindDiskCache : public QNetworkDiskCache
+    {
+        Q_OBJECT
+    public:
+        //! Constructor.
+        /*!
+         * @param parent QObject parent ownership.
+         */
+        explicit WriteBehindDiskCache(QObject* parent = nullptr);
+
+        //! Disable copy constructor.
+        WriteBehindDiskCache(const WriteBehindDiskCache&) = delete;
+
+        //! Disable copy assignment.
+        WriteBehindDiskCache& operator=(const WriteBehindDiskCache&) = delete;
+
+        //! Destructor (writes the pending tiles).
+        ~WriteBehindDiskCache();
+
+        /*!
+         * Set how long to wait for more tiles before writing a batch (default: 500 ms).
+         * @param delay The flush delay.
+         */
+        void setFlushDelay(const std::chrono::milliseconds& delay);
+
+        /*!
+         * Set the size of the pending tiles beyond which they are written without delay (default: 8 MiB).
+         * @param bytes The maximum pending size.
+         */
+        void setMaxPendingBytes(const qint64 bytes);
+
+        /*!
+         * Fetch the size of the tiles not written yet.
+         * @return the pending size in bytes.
+         */
+        qint64 pendingBytes() const;
+
+        /*!
+         * Write the pending tiles now (blocks until they are written).
+         */
+        void flush();
+
+        /*!
+         * Read the metadata of a file of the cache directory (see QNetworkDiskCache::fileMetaData()).
+         * @param file_path The path of the cache file.
+         * @return the metadata (invalid if the file is not a cache entry).
+         */
+        QNetworkCacheMetaData fileMetaData(const QString& file_path) const;
+
+        /*!
+         * Set the cache directory and its maximum size (see QNetworkDiskCache::setCacheDirectory()
+         * and QNetworkDiskCache::setMaximumCacheSize(), which are not thread-safe).
+         * @param cache_dir The cache directory.
+         * @param size The maximum cache size in bytes.
+         */
+        void setCacheDirectory(const QString& cache_dir, const qint64 size);
+
+        /*!
+         * Fetch the cache directory (see QNetworkDiskCache::cacheDirectory()).
+         * @return the cache directory.
+         */
+        QString cacheDirectory() const;
+
+        /*!
+         * Fetch the maximum cache size (see QNetworkDiskCache::maximumCacheSize()).
+         * @return the maximum cache size in bytes.
+         */
+        qint64 maximumCacheSize() const;
+
+        /// QAbstractNetworkCache interface.
+        QNetworkCacheMetaData metaData(const QUrl& url) override;
+        void updateMetaData(const QNetworkCacheMetaData& metaData) override;
+        QIODevice* data(const QUrl& url) override;
+        bool remove(const QUrl& url) override;
+        qint64 cacheSize() const override;
+        QIODevice* prepare(const QNetworkCacheMetaData& metaData) override;
+        void insert(QIODevice* device) override;
+
+    public slots:
+        /*!
+         * Remove all the tiles (including the pending tiles).
+         */
+        void clear() override;
+
+    private:
+        //! A tile waiting to be written.
+        struct PendingTile
+        {
+            /// The metadata.
+            QNetworkCacheMetaData meta_data;
+
+            /// The encoded tile.
+            QByteArray data;
+        };
+
+        /*!
+         * Find a pending tile.
+         * @param url The tile url.
+         * @param tile The pending tile.
+         * @return whether the tile is pending.
+         */
+        bool findPending(const QUrl& url, PendingTile& tile) const;
+
+        /*!
+         * Write the pending tiles in batches until there are none left (background thread).
+         */
+        void writePending();
+
+    private:
+        /// Mutex to serialise the calls to QNetworkDiskCache (recursive, as it calls the virtual methods).
+        mutable QMutex m_cache_mutex;
+
+        /// Mutex to protect the pending tiles.
+        mutable QMutex m_mutex;
+
+        /// Wakes the writer early (flush or too much pending).
+        QWaitCondition m_pending_condition;
+
+        /// Wakes flush() once the writer has finished.
+        QWaitCondition m_idle_condition;
+
+        /// The replies being received, by their buffer.
+        QHash<QIODevice*, QNetworkCacheMetaData> m_prepared;
+
+        /// The tiles waiting to be written.
+        QHash<QUrl, PendingTile> m_pending;
+
+        /// The tiles being written.
+        QHash<QUrl, PendingTile> m_writing;
+
+        /// The size of the tiles waiting to be written.
+        qint64 m_pending_bytes;
+
+        /// How long to wait for more tiles before writing a batch.
+        std::chrono::milliseconds m_flush_delay;
+
+        /// The size of the pending tiles beyond which they are written without delay.
+        qint64 m_max_pending_bytes;
+
+        /// Whether the background thread is writing.
+        bool m_writer_running;
+
+        /// Whether the pending tiles must be written without delay.
+        bool m_flush_requested;
+
+        /// The thread to write from.
+        QThreadPool m_writer;
+    };
+}